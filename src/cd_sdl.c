@@ -21,36 +21,175 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <SDL2/SDL_mixer.h>
 #include "quakedef.h"
 
-static Mix_Music* tracks[12];
+//
+// music/trackNN.wav is streamed through the sound mixer (snd_stream.c).
+// Otherwise music/trackNN.ogg is handed to SDL_mixer, which decodes it a
+// little at a time as it plays.  Either way the file is found through the
+// search paths, so tracks can live in a pak.
+//
 
-void CDAudio_Play(byte track, qboolean looping)
+static Mix_Music	*music;
+
+typedef struct
+{
+	FILE	*file;
+	Sint64	start;
+	Sint64	length;
+} cdfile_t;
+
+static Sint64 SDLCALL CD_RWSize (SDL_RWops *rw)
+{
+	return ((cdfile_t *)rw->hidden.unknown.data1)->length;
+}
+
+static Sint64 SDLCALL CD_RWSeek (SDL_RWops *rw, Sint64 offset, int whence)
 {
-	if (track <= 11 && tracks[track])
+	cdfile_t	*cf = (cdfile_t *)rw->hidden.unknown.data1;
+	Sint64		pos;
+
+	switch (whence)
 	{
-		Mix_PlayMusic(tracks[track], looping ? -1 : 1);
+	case RW_SEEK_SET:
+		pos = offset;
+		break;
+	case RW_SEEK_CUR:
+		pos = ftell (cf->file) - cf->start + offset;
+		break;
+	case RW_SEEK_END:
+		pos = cf->length + offset;
+		break;
+	default:
+		return -1;
 	}
+	if (pos < 0 || pos > cf->length)
+		return -1;
+	if (fseek (cf->file, cf->start + pos, SEEK_SET))
+		return -1;
+	return pos;
 }
 
+static size_t SDLCALL CD_RWRead (SDL_RWops *rw, void *ptr, size_t size, size_t maxnum)
+{
+	cdfile_t	*cf = (cdfile_t *)rw->hidden.unknown.data1;
+	Sint64		left;
+
+	if (!size)
+		return 0;
+	left = cf->start + cf->length - ftell (cf->file);
+	if (left <= 0)
+		return 0;
+	if (maxnum > left / size)
+		maxnum = left / size;
+	return fread (ptr, size, maxnum, cf->file);
+}
 
-void CDAudio_Stop(void)
+static size_t SDLCALL CD_RWWrite (SDL_RWops *rw, const void *ptr, size_t size, size_t num)
 {
-	Mix_PauseMusic();
-	Mix_RewindMusic();
+	return 0;
+}
+
+static int SDLCALL CD_RWClose (SDL_RWops *rw)
+{
+	cdfile_t	*cf = (cdfile_t *)rw->hidden.unknown.data1;
+
+	fclose (cf->file);
+	free (cf);
+	SDL_FreeRW (rw);
+	return 0;
 }
 
+/*
+============
+CD_OpenRW
+
+Wraps a file from the search paths, which may be a range inside a pak
+============
+*/
+static SDL_RWops *CD_OpenRW (char *name)
+{
+	FILE		*f;
+	int			len;
+	cdfile_t	*cf;
+	SDL_RWops	*rw;
+
+	len = COM_FOpenFile (name, &f);
+	if (!f)
+		return NULL;
+
+	cf = malloc (sizeof(*cf));
+	rw = SDL_AllocRW ();
+	if (!cf || !rw)
+	{
+		free (cf);
+		if (rw)
+			SDL_FreeRW (rw);
+		fclose (f);
+		return NULL;
+	}
+	cf->file = f;
+	cf->start = ftell (f);
+	cf->length = len;
+
+	rw->size = CD_RWSize;
+	rw->seek = CD_RWSeek;
+	rw->read = CD_RWRead;
+	rw->write = CD_RWWrite;
+	rw->close = CD_RWClose;
+	rw->type = SDL_RWOPS_UNKNOWN;
+	rw->hidden.unknown.data1 = cf;
+	return rw;
+}
+
+static void CD_FreeMusic (void)
+{
+	if (music)
+	{
+		Mix_HaltMusic ();
+		Mix_FreeMusic (music);
+		music = NULL;
+	}
+}
+
+void CDAudio_Play(byte track, qboolean looping)
+{
+	SDL_RWops	*rw;
+
+	CD_FreeMusic ();
+	S_StopMusic ();
+
+	if (S_StartMusic (va("music/track%02i.wav", track), looping))
+		return;
+
+	rw = CD_OpenRW (va("music/track%02i.ogg", track));
+	if (!rw)
+		return;
+	music = Mix_LoadMUS_RW (rw, 1);
+	if (!music)
+	{
+		Con_DPrintf ("CDAudio_Play: %s\n", Mix_GetError ());
+		return;
+	}
+	Mix_PlayMusic (music, looping ? -1 : 1);
+}
+
+void CDAudio_Stop(void)
+{
+	CD_FreeMusic ();
+	S_StopMusic ();
+}
 
 void CDAudio_Pause(void)
 {
 	Mix_PauseMusic();
+	S_PauseMusic (true);
 }
 
-
 void CDAudio_Resume(void)
 {
 	Mix_ResumeMusic();
+	S_PauseMusic (false);
 }
 
-
 void CDAudio_Update(void)
 {
 	static float currentvolume = 0.0f;
@@ -61,36 +200,21 @@ void CDAudio_Update(void)
 	}
 }
 
-
 int CDAudio_Init(void)
 {
-	char filename[32];
-
 	if (Mix_Init(MIX_INIT_OGG) != MIX_INIT_OGG)
 		Con_Printf("init ogg failed\n");
 	if (Mix_OpenAudio(44100, AUDIO_S16, 2, 4096) != 0)
 		Con_Printf("init mixer failed\n");
-
-	for (int i = 2; i < 12; ++i)
-	{
-		sprintf(filename, "id1/music/track%02d.ogg", i);
-		tracks[i] = Mix_LoadMUS(filename);
-		Con_Printf("loading track %s ... %s\n", filename, tracks[i] ? "done" : "failed");
-	}
-
 	Mix_VolumeMusic(MIX_MAX_VOLUME * bgmvolume.value);
 	
 	return 0;
 }
 
-
 void CDAudio_Shutdown(void)
 {
-	for (int i = 2; i < 12; ++i)
-	{
-		Mix_FreeMusic(tracks[i]);
-		tracks[i] = NULL;
-	}
+	CD_FreeMusic ();
+	S_StopMusic ();
 	Mix_CloseAudio();
 	Mix_Quit();
-}
\ No newline at end of file
+}
@@ -32,8 +32,6 @@ vec3_t	chase_angles;
 vec3_t	chase_dest;
 vec3_t	chase_dest_angles;
 
-extern qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
-
 void Chase_Init (void)
 {
 	Cvar_RegisterVariable (&chase_back);
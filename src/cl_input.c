@@ -367,6 +367,8 @@ void CL_SendMove (usercmd_t *cmd)
 	
     MSG_WriteByte (&buf, bits);
 
+	CL_StorePredictCmd (cmd, bits);
+
     MSG_WriteByte (&buf, in_impulse);
 	in_impulse = 0;
 
@@ -393,6 +393,16 @@ float	CL_LerpPoint (void)
 	float	f, frac;
 
 	f = cl.mtime[0] - cl.mtime[1];
+
+	if (sv.active && host_tickrate.value > 0 && f > 0 && f < 0.2 && !cl_nolerp.value && !cls.timedemo)
+	{	// the local server runs fixed ticks, so show the time between the last
+		// two by how much of the next one has passed
+		frac = host_tickfrac;
+		if (frac > 1)
+			frac = 1;
+		cl.time = cl.mtime[1] + f * frac;
+		return frac;
+	}
 	
 	if (!f || cl_nolerp.value || cls.timedemo || sv.active)
 	{
@@ -597,6 +607,7 @@ void CL_RelinkEntities (void)
 		}
 	}
 
+	CL_PredictMove ();
 }
 
 
@@ -696,6 +707,7 @@ void CL_Init (void)
 
 	CL_InitInput ();
 	CL_InitTEnts ();
+	CL_InitPrediction ();
 	
 //
 // register our commands
@@ -0,0 +1,498 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_pred.c -- client side player movement prediction
+
+#include "quakedef.h"
+
+//
+// Every frame the player is moved on from the last origin and velocity the
+// server sent, through the commands sent since, with the same PM_ moves
+// SV_ClientThink and SV_Physics_Client make on the server.  Nothing is kept
+// from one frame's prediction to the next, so each server update replaces
+// whatever the client guessed and the error never builds up.
+//
+// Everything is clipped against at its origin in the last update.  Brush
+// models are used when they are part of the map, the others are items.
+// Alias models are taken to be monsters and players of the player's size,
+// since the real bounds are never sent.  Models that rotate or leave trails
+// are items and missiles, which are not solid to the player.  Neither is
+// anything moving faster than anyone can run or already inside the player
+// box, which leaves out the player's own missiles and a corpse stood on,
+// but a corpse in the way blocks until the server says otherwise.
+// Triggers, touches and teleports are left to the next update.
+//
+
+cvar_t	cl_predict = {"cl_predict", "1"};
+cvar_t	cl_predictlag = {"cl_predictlag", "0"};	// round trip to a remote server
+
+extern	cvar_t	sv_gravity;
+extern	cvar_t	sv_maxvelocity;
+
+#define	PRED_CMDS		64			// power of two
+#define	PRED_MAXTIME	0.25		// never guess further ahead than this
+#define	PRED_MAXSTEP	0.05		// longest single movement step
+#define	PRED_MAXSPEED	600			// faster than this is a missile
+
+typedef struct
+{
+	vec3_t		viewangles;
+	float		forwardmove;
+	float		sidemove;
+	float		upmove;
+	int			buttons;
+	float		frametime;
+} predcmd_t;
+
+static predcmd_t	pred_cmds[PRED_CMDS];
+static int			pred_sequence;		// commands stored since startup
+
+static vec3_t	player_mins = {-16, -16, -24};
+static vec3_t	player_maxs = {16, 16, 32};
+
+// entities to clip against this frame
+static entity_t	*pred_solids[MAX_VISEDICTS];
+static int		pred_numsolids;
+
+// what trace.ent is set to, the moves only look at the solid type
+static edict_t	pred_bsp;
+static edict_t	pred_box;
+
+/*
+==================
+CL_StorePredictCmd
+
+Called from CL_SendMove with every command that goes to the server
+==================
+*/
+void CL_StorePredictCmd (usercmd_t *cmd, int buttons)
+{
+	predcmd_t	*pc;
+
+	pc = &pred_cmds[pred_sequence & (PRED_CMDS-1)];
+	VectorCopy (cl.viewangles, pc->viewangles);
+	pc->forwardmove = cmd->forwardmove;
+	pc->sidemove = cmd->sidemove;
+	pc->upmove = cmd->upmove;
+	pc->buttons = buttons;
+	pc->frametime = host_frametime;
+	pred_sequence++;
+}
+
+/*
+===============================================================================
+
+CLIPPING
+
+===============================================================================
+*/
+
+/*
+==================
+CL_PredictSolids
+
+Collects the entities in the last update, which is the state the prediction
+starts from at org
+==================
+*/
+static void CL_PredictSolids (vec3_t org)
+{
+	entity_t	*ent;
+	float		speed, dt;
+	vec3_t		move;
+	int			i, j;
+
+	dt = cl.mtime[0] - cl.mtime[1];
+
+	pred_numsolids = 0;
+	for (i=1,ent=cl_entities+1 ; i<cl.num_entities ; i++,ent++)
+	{
+		if (!ent->model || ent->msgtime != cl.mtime[0] || i == cl.viewentity)
+			continue;
+
+		if (ent->model->type == mod_brush)
+		{
+			if (ent->model->name[0] != '*')
+				continue;		// a health box or ammo
+		}
+		else if (ent->model->type == mod_alias)
+		{
+			if (ent->model->flags)
+				continue;		// rotating item or trail
+			for (j=0 ; j<3 ; j++)
+				if (ent->msg_origins[0][j] + player_maxs[j] <= org[j] + player_mins[j]
+				|| ent->msg_origins[0][j] + player_mins[j] >= org[j] + player_maxs[j])
+					break;
+			if (j == 3)
+				continue;		// already inside it
+			if (dt > 0 && !ent->forcelink)
+			{
+				VectorSubtract (ent->msg_origins[0], ent->msg_origins[1], move);
+				speed = Length (move) / dt;
+				if (speed > PRED_MAXSPEED)
+					continue;
+			}
+		}
+		else
+			continue;
+
+		if (pred_numsolids == MAX_VISEDICTS)
+			break;
+		pred_solids[pred_numsolids++] = ent;
+	}
+}
+
+/*
+==================
+CL_ClipToHull
+
+Hull 1 of a brush model is already expanded by the player size and hull 0 is
+used for points, so in both cases the hull is offset by the model origin alone
+==================
+*/
+static trace_t CL_ClipToHull (hull_t *hull, vec3_t offset, vec3_t start, vec3_t end, edict_t *solid)
+{
+	trace_t		trace;
+	vec3_t		start_l, end_l;
+
+	memset (&trace, 0, sizeof(trace_t));
+	trace.fraction = 1;
+	trace.allsolid = true;
+	VectorCopy (end, trace.endpos);
+
+	VectorSubtract (start, offset, start_l);
+	VectorSubtract (end, offset, end_l);
+	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+
+	if (trace.fraction != 1)
+		VectorAdd (trace.endpos, offset, trace.endpos);
+
+	if (trace.allsolid || trace.startsolid || trace.fraction < 1)
+		trace.ent = solid;
+
+	return trace;
+}
+
+/*
+==================
+CL_PredictTrace
+
+The pmove_t trace, a point (hull 0) or the player box (hull 1) through the
+world and the solids, combining the results the way SV_ClipToLinks does
+==================
+*/
+static trace_t CL_PredictTrace (pmove_t *pm, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type)
+{
+	trace_t		total, trace;
+	entity_t	*ent;
+	vec3_t		boxmins, boxmaxs;
+	int			i, hullnum;
+
+	hullnum = maxs[0] - mins[0] < 3 ? 0 : 1;
+
+	total = CL_ClipToHull (&cl.worldmodel->hulls[hullnum], vec3_origin, start, end, &pred_bsp);
+
+	for (i=0 ; i<pred_numsolids ; i++)
+	{
+		if (total.allsolid)
+			break;
+		ent = pred_solids[i];
+		if (ent->model->type == mod_brush)
+			trace = CL_ClipToHull (&ent->model->hulls[hullnum], ent->msg_origins[0], start, end, &pred_bsp);
+		else
+		{
+			if (type == MOVE_NOMONSTERS)
+				continue;
+			VectorSubtract (player_mins, maxs, boxmins);
+			VectorSubtract (player_maxs, mins, boxmaxs);
+			trace = CL_ClipToHull (SV_HullForBox (boxmins, boxmaxs), ent->msg_origins[0], start, end, &pred_box);
+		}
+
+		if (trace.allsolid || trace.startsolid || trace.fraction < total.fraction)
+		{
+			if (total.startsolid)
+			{
+				total = trace;
+				total.startsolid = true;
+			}
+			else
+				total = trace;
+		}
+		else if (trace.startsolid)
+			total.startsolid = true;
+	}
+
+	return total;
+}
+
+/*
+==================
+CL_PredictContents
+
+SV_PointContents on the client's world model
+==================
+*/
+static int CL_PredictContents (vec3_t p)
+{
+	int		cont;
+
+	cont = SV_HullPointContents (&cl.worldmodel->hulls[0], 0, p);
+	if (cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN)
+		cont = CONTENTS_WATER;
+	return cont;
+}
+
+/*
+==================
+CL_PredictPush
+
+SV_PushEntity without the links and touches
+==================
+*/
+static trace_t CL_PredictPush (pmove_t *pm, vec3_t push)
+{
+	trace_t	trace;
+	vec3_t	end;
+
+	VectorAdd (pm->v->origin, push, end);
+	trace = CL_PredictTrace (pm, pm->v->origin, pm->v->mins, pm->v->maxs, end, MOVE_NORMAL);
+	VectorCopy (trace.endpos, pm->v->origin);
+	return trace;
+}
+
+/*
+===============================================================================
+
+PLAYER MOVEMENT
+
+===============================================================================
+*/
+
+/*
+==================
+CL_PredictJump
+
+What the progs PlayerPreThink does with the jump button
+==================
+*/
+static void CL_PredictJump (entvars_t *v, predcmd_t *pc, qboolean *jumpreleased)
+{
+	if (!(pc->buttons & 2))
+	{
+		*jumpreleased = true;
+		return;
+	}
+
+	if (v->waterlevel >= 2)
+	{	// swimming up
+		if (v->watertype == CONTENTS_WATER)
+			v->velocity[2] = 100;
+		else if (v->watertype == CONTENTS_SLIME)
+			v->velocity[2] = 80;
+		else
+			v->velocity[2] = 50;
+		return;
+	}
+
+	if (!((int)v->flags & FL_ONGROUND) || !*jumpreleased)
+		return;
+
+	*jumpreleased = false;
+	v->flags = (int)v->flags & ~FL_ONGROUND;
+	v->velocity[2] += 270;
+}
+
+/*
+==================
+CL_PredictPlayerMove
+
+One server frame of SV_ClientThink followed by SV_Physics_Client
+==================
+*/
+static void CL_PredictPlayerMove (pmove_t *pm, predcmd_t *pc, qboolean *jumpreleased)
+{
+	entvars_t	*v;
+	int			i;
+
+	v = pm->v;
+
+	pm->cmd.forwardmove = pc->forwardmove;
+	pm->cmd.sidemove = pc->sidemove;
+	pm->cmd.upmove = pc->upmove;
+	VectorCopy (pc->viewangles, v->v_angle);
+	v->angles[ROLL] = V_CalcRoll (v->angles, v->velocity)*4;
+	v->angles[PITCH] = -v->v_angle[PITCH]/3;
+	v->angles[YAW] = v->v_angle[YAW];
+
+	if (v->waterlevel >= 2)
+		PM_WaterMove (pm);
+	else
+		PM_AirMove (pm);
+
+	CL_PredictJump (v, pc, jumpreleased);
+
+	for (i=0 ; i<3 ; i++)
+	{
+		if (v->velocity[i] > sv_maxvelocity.value)
+			v->velocity[i] = sv_maxvelocity.value;
+		else if (v->velocity[i] < -sv_maxvelocity.value)
+			v->velocity[i] = -sv_maxvelocity.value;
+	}
+
+	if (!PM_CheckWater (pm))
+		v->velocity[2] -= sv_gravity.value * pm->frametime;
+
+	PM_WalkMove (pm);
+}
+
+/*
+==================
+CL_PredictTime
+
+How much game time the last update is behind the commands already sent.  A
+local server with host_tickrate set has run all of it but the tick it still
+owes, a remote one is behind by the time since the update plus the trip there
+and back.
+==================
+*/
+static float CL_PredictTime (void)
+{
+	float	time;
+
+	if (sv.active)
+		time = host_tickaccum;
+	else
+		time = realtime - cl.last_received_message + cl_predictlag.value;
+
+	if (time < 0)
+		time = 0;
+	if (time > PRED_MAXTIME)
+		time = PRED_MAXTIME;
+	return time;
+}
+
+/*
+==================
+CL_PredictMove
+
+Replaces the interpolated origin of the view entity with a prediction from
+the last update through the latest commands, called at the end of
+CL_RelinkEntities
+==================
+*/
+void CL_PredictMove (void)
+{
+	entity_t	*ent;
+	entvars_t	v;
+	pmove_t		pm;
+	predcmd_t	*pc;
+	qboolean	jumpreleased;
+	float		time, covered, step;
+	int			i, first, count;
+
+	if (!cl_predict.value || cls.demoplayback || !cl.worldmodel)
+		return;
+	if (cl.paused || cl.intermission || noclip_anglehack)
+		return;
+	if (cl.stats[STAT_HEALTH] <= 0)
+		return;
+	if (cl.viewentity < 1 || cl.viewentity > cl.maxclients)
+		return;
+
+	ent = &cl_entities[cl.viewentity];
+	if (!ent->model || ent->msgtime != cl.mtime[0])
+		return;
+
+// the fields of the player edict the moves use
+	memset (&v, 0, sizeof(v));
+	VectorCopy (ent->msg_origins[0], v.origin);
+	VectorCopy (cl.mvelocity[0], v.velocity);
+	VectorCopy (ent->msg_angles[0], v.angles);
+	VectorCopy (player_mins, v.mins);
+	VectorCopy (player_maxs, v.maxs);
+	v.view_ofs[2] = DEFAULT_VIEWHEIGHT;
+	v.movetype = MOVETYPE_WALK;
+	v.solid = SOLID_SLIDEBOX;
+	if (cl.onground)
+		v.flags = FL_ONGROUND;
+
+	memset (&pm, 0, sizeof(pm));
+	pm.v = &v;
+	pm.trace = CL_PredictTrace;
+	pm.pointcontents = CL_PredictContents;
+	pm.push = CL_PredictPush;
+
+	time = CL_PredictTime ();
+
+// find the commands that cover the time, newest first
+	count = 0;
+	covered = 0;
+	while (covered < time && count < PRED_CMDS-1 && count < pred_sequence)
+	{
+		count++;
+		covered += pred_cmds[(pred_sequence - count) & (PRED_CMDS-1)].frametime;
+	}
+
+	if (count)
+	{
+		CL_PredictSolids (v.origin);
+
+		if (CL_PredictTrace (&pm, v.origin, v.mins, v.maxs, v.origin, MOVE_NORMAL).startsolid)
+			return;		// the server will have to sort this out
+
+		PM_CheckWater (&pm);
+
+		first = pred_sequence - count;
+		jumpreleased = true;
+		if (first > 0)
+			jumpreleased = !(pred_cmds[(first-1) & (PRED_CMDS-1)].buttons & 2);
+
+	// the oldest command only runs for the part of its frame inside the time
+		for (i=first ; i<pred_sequence ; i++)
+		{
+			pc = &pred_cmds[i & (PRED_CMDS-1)];
+			step = pc->frametime;
+			if (i == first)
+				step -= covered - time;
+			while (step > 0)
+			{
+				pm.frametime = step > PRED_MAXSTEP ? PRED_MAXSTEP : step;
+				CL_PredictPlayerMove (&pm, pc, &jumpreleased);
+				step -= pm.frametime;
+			}
+		}
+	}
+
+	VectorCopy (v.origin, ent->origin);
+	VectorCopy (v.velocity, cl.velocity);
+}
+
+/*
+==================
+CL_InitPrediction
+==================
+*/
+void CL_InitPrediction (void)
+{
+	Cvar_RegisterVariable (&cl_predict);
+	Cvar_RegisterVariable (&cl_predictlag);
+
+	pred_bsp.v.solid = SOLID_BSP;
+	pred_box.v.solid = SOLID_SLIDEBOX;
+}
@@ -356,6 +356,13 @@ void V_ParseDamage (void);
 void V_SetContentsColor (int contents);
 
 
+//
+// cl_pred
+//
+void CL_InitPrediction (void);
+void CL_StorePredictCmd (usercmd_t *cmd, int buttons);
+void CL_PredictMove (void);
+
 //
 // cl_tent
 //
@@ -20,6 +20,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // host.c -- coordinates spawning and killing of local servers
 
 #include "quakedef.h"
+#include "simd.h"
+#include "job.h"
 #include "r_local.h"
 
 /*
@@ -41,6 +43,8 @@ double		host_frametime;
 double		host_time;
 double		realtime;				// without any filtering or bounding
 double		oldrealtime;			// last frame run
+double		host_tickfrac;			// part of a server tick owed, 0 - 1
+double		host_tickaccum;			// server time not run yet
 int			host_framecount;
 
 int			host_hunklevel;
@@ -56,6 +60,8 @@ byte		*host_colormap;
 
 cvar_t	host_framerate = {"host_framerate","0"};	// set for slow motion
 cvar_t	host_speeds = {"host_speeds","0"};			// set for running times
+cvar_t	host_maxfps = {"host_maxfps","72"};
+cvar_t	host_tickrate = {"host_tickrate","0"};		// fixed server ticks per second
 
 cvar_t	sys_ticrate = {"sys_ticrate","0.05"};
 cvar_t	serverprofile = {"serverprofile","0"};
@@ -208,6 +214,8 @@ void Host_InitLocal (void)
 	
 	Cvar_RegisterVariable (&host_framerate);
 	Cvar_RegisterVariable (&host_speeds);
+	Cvar_RegisterVariable (&host_maxfps);
+	Cvar_RegisterVariable (&host_tickrate);
 
 	Cvar_RegisterVariable (&sys_ticrate);
 	Cvar_RegisterVariable (&serverprofile);
@@ -406,6 +414,9 @@ void Host_ShutdownServer(qboolean crash)
 	char		message[4];
 	double	start;
 
+	SV_StopRecord ();
+	SV_StopReplay ();
+
 	if (!sv.active)
 		return;
 
@@ -496,9 +507,14 @@ Returns false if the time is too short to run a frame
 */
 qboolean Host_FilterTime (float time)
 {
+	float	maxfps;
+
 	realtime += time;
 
-	if (!cls.timedemo && realtime - oldrealtime < 1.0/72.0)
+	maxfps = host_maxfps.value;
+	if (maxfps < 10)
+		maxfps = 10;
+	if (!cls.timedemo && realtime - oldrealtime < 1.0/maxfps)
 		return false;		// framerate is too high
 
 	host_frametime = realtime - oldrealtime;
@@ -566,6 +582,8 @@ void Host_ServerFrame (void)
 	float	save_host_frametime;
 	float	temp_host_frametime;
 
+	SV_RecordFrame ();
+
 // run the world state	
 	pr_global_struct->frametime = host_frametime;
 
@@ -589,12 +607,16 @@ void Host_ServerFrame (void)
 
 // send all messages to the clients
 	SV_SendClientMessages ();
+
+	SV_RecordState ();
 }
 
 #else
 
 void Host_ServerFrame (void)
 {
+	SV_RecordFrame ();
+
 // run the world state	
 	pr_global_struct->frametime = host_frametime;
 
@@ -614,11 +636,61 @@ void Host_ServerFrame (void)
 
 // send all messages to the clients
 	SV_SendClientMessages ();
+
+	SV_RecordState ();
 }
 
 #endif
 
 
+/*
+==================
+Host_RunServer
+
+With host_tickrate set the server runs whole ticks of a fixed length, as many
+as the time since the last frame pays for, and the client interpolates
+between the last two by the time left over.  Otherwise it runs once a frame.
+==================
+*/
+#define	MAX_CATCHUP_TICKS	8
+
+void Host_RunServer (void)
+{
+	double	tick;
+	double	save_host_frametime;
+
+	if (host_tickrate.value <= 0)
+	{
+		host_tickaccum = 0;
+		host_tickfrac = 1;
+		Host_ServerFrame ();
+		return;
+	}
+
+	tick = 1.0 / host_tickrate.value;
+	if (tick > 0.1)
+		tick = 0.1;
+	if (tick < 0.001)
+		tick = 0.001;
+
+// after a long stall drop the time instead of running a burst of ticks
+	host_tickaccum += host_frametime;
+	if (host_tickaccum > tick * MAX_CATCHUP_TICKS)
+		host_tickaccum = tick * MAX_CATCHUP_TICKS;
+
+	save_host_frametime = host_frametime;
+	host_frametime = tick;
+	while (host_tickaccum >= tick && sv.active)
+	{
+		Host_ServerFrame ();
+		host_tickaccum -= tick;
+	}
+	host_frametime = save_host_frametime;
+
+	host_tickfrac = host_tickaccum / tick;
+}
+
+
 /*
 ==================
 Host_Frame
@@ -668,7 +740,9 @@ void _Host_Frame (float time)
 	Host_GetConsoleCommands ();
 	
 	if (sv.active)
-		Host_ServerFrame ();
+		Host_RunServer ();
+	else
+		host_tickaccum = 0;
 
 //-------------------
 //
@@ -855,6 +929,8 @@ void Host_Init (quakeparms_t *parms)
 	Host_InitVCR (parms);
 	COM_Init (parms->basedir);
 	Host_InitLocal ();
+	SIMD_Init ();
+	Job_Init ();
 	W_LoadWadFile ("gfx.wad");
 	Key_Init ();
 	Con_Init ();	
@@ -934,6 +1010,7 @@ void Host_Shutdown(void)
 	NET_Shutdown ();
 	S_Shutdown();
 	IN_Shutdown ();
+	Job_Shutdown ();
 
 	if (cls.state != ca_dedicated)
 	{
@@ -0,0 +1,188 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// job.c -- worker threads for data parallel loops
+
+#include "quakedef.h"
+#include "job.h"
+
+#define	MAX_JOB_THREADS		16
+
+cvar_t	sys_jobs = {"sys_jobs", "1"};	// 0 runs parallel loops on the main thread
+
+static	void	*job_threads[MAX_JOB_THREADS];
+static	int		job_numthreads;
+static	void	*job_wake;			// posted once per worker per loop
+static	void	*job_done;			// posted by a worker when it runs out of work
+static	volatile qboolean	job_quit;
+
+// the loop being run, only written while the workers are idle
+static	jobfunc_t	job_func;
+static	void	*job_arg;
+static	int		job_count;
+static	int		job_grain;
+static	volatile int	job_next;
+
+/*
+================
+Job_Work
+
+Runs slices of the current loop until there are none left
+================
+*/
+static void Job_Work (void)
+{
+	int		i;
+	int		start, end;
+
+	while (1)
+	{
+		start = Sys_AtomicAdd (&job_next, job_grain) - job_grain;
+		if (start >= job_count)
+			return;
+		end = start + job_grain;
+		if (end > job_count)
+			end = job_count;
+		for (i=start ; i<end ; i++)
+			job_func (i, job_arg);
+	}
+}
+
+/*
+================
+Job_Thread
+================
+*/
+static void Job_Thread (void *arg)
+{
+	while (1)
+	{
+		Sys_SemaphoreWait (job_wake);
+		if (job_quit)
+			return;
+		Job_Work ();
+		Sys_SemaphorePost (job_done);
+	}
+}
+
+/*
+================
+Job_Init
+
+One worker per extra processor, or -threads <n> in total
+================
+*/
+void Job_Init (void)
+{
+	int		i;
+	int		count;
+
+	Cvar_RegisterVariable (&sys_jobs);
+
+	count = Sys_NumCPUs () - 1;
+	i = COM_CheckParm ("-threads");
+	if (i && i < com_argc-1)
+		count = Q_atoi (com_argv[i+1]) - 1;
+	if (count > MAX_JOB_THREADS)
+		count = MAX_JOB_THREADS;
+	if (count <= 0)
+		return;
+
+	job_wake = Sys_CreateSemaphore (0);
+	job_done = Sys_CreateSemaphore (0);
+	for (i=0 ; i<count ; i++)
+		job_threads[i] = Sys_CreateThread (Job_Thread, NULL);
+	job_numthreads = count;
+
+	Con_Printf ("%i worker threads\n", count);
+}
+
+/*
+================
+Job_Shutdown
+================
+*/
+void Job_Shutdown (void)
+{
+	int		i;
+
+	if (!job_numthreads)
+		return;
+
+	job_quit = true;
+	for (i=0 ; i<job_numthreads ; i++)
+		Sys_SemaphorePost (job_wake);
+	for (i=0 ; i<job_numthreads ; i++)
+		Sys_WaitThread (job_threads[i]);
+	job_numthreads = 0;
+
+	Sys_DestroySemaphore (job_wake);
+	Sys_DestroySemaphore (job_done);
+}
+
+/*
+================
+Job_Threads
+================
+*/
+int Job_Threads (void)
+{
+	if (!sys_jobs.value)
+		return 1;
+	return job_numthreads + 1;
+}
+
+/*
+================
+Job_ParallelFor
+================
+*/
+void Job_ParallelFor (int count, int grain, jobfunc_t func, void *arg)
+{
+	int		i;
+	int		workers;
+
+	if (grain < 1)
+		grain = 1;
+
+	workers = (count + grain - 1) / grain - 1;
+	if (workers > job_numthreads)
+		workers = job_numthreads;
+	if (!sys_jobs.value)
+		workers = 0;
+
+	if (workers <= 0)
+	{
+		for (i=0 ; i<count ; i++)
+			func (i, arg);
+		return;
+	}
+
+	job_func = func;
+	job_arg = arg;
+	job_count = count;
+	job_grain = grain;
+	job_next = 0;
+
+	for (i=0 ; i<workers ; i++)
+		Sys_SemaphorePost (job_wake);
+	Job_Work ();
+	for (i=0 ; i<workers ; i++)
+		Sys_SemaphoreWait (job_done);
+}
@@ -0,0 +1,45 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// job.h -- worker threads for data parallel loops
+
+#ifndef __JOB__
+#define __JOB__
+
+//
+// Job_ParallelFor hands out the indices of a loop to the worker threads and
+// the calling thread, and returns once every index has been run.  It is
+// only called from the main thread, never from inside a job.  The job
+// function must not touch the console, the zone or the hunk.
+//
+
+typedef void (*jobfunc_t) (int index, void *arg);
+
+extern	cvar_t	sys_jobs;
+
+void Job_Init (void);
+void Job_Shutdown (void);
+
+// threads a parallel loop runs on, including the caller
+int Job_Threads (void);
+
+// runs func for 0 to count-1, grain indices at a time
+void Job_ParallelFor (int count, int grain, jobfunc_t func, void *arg);
+
+#endif
@@ -936,6 +936,34 @@ void Mod_LoadLeafs (lump_t *l)
 	}	
 }
 
+/*
+=================
+Mod_PackClipnodes
+
+Builds the traced form of a clipping hull, each node next to its plane
+=================
+*/
+mclipnode_t *Mod_PackClipnodes (dclipnode_t *in, int count)
+{
+	mclipnode_t	*out, *nodes;
+	mplane_t	*plane;
+	int			i;
+
+	nodes = out = Hunk_AllocName ( count*sizeof(*out), loadname);
+
+	for (i=0 ; i<count ; i++, out++, in++)
+	{
+		plane = loadmodel->planes + in->planenum;
+		VectorCopy (plane->normal, out->normal);
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->children[0] = in->children[0];
+		out->children[1] = in->children[1];
+	}
+
+	return nodes;
+}
+
 /*
 =================
 Mod_LoadClipnodes
@@ -986,6 +1014,9 @@ void Mod_LoadClipnodes (lump_t *l)
 		out->children[0] = LittleShort(in->children[0]);
 		out->children[1] = LittleShort(in->children[1]);
 	}
+
+	loadmodel->hulls[1].nodes = Mod_PackClipnodes (loadmodel->clipnodes, count);
+	loadmodel->hulls[2].nodes = loadmodel->hulls[1].nodes;
 }
 
 /*
@@ -1025,6 +1056,8 @@ void Mod_MakeHull0 (void)
 				out->children[j] = child - loadmodel->nodes;
 		}
 	}
+
+	hull->nodes = Mod_PackClipnodes (hull->clipnodes, count);
 }
 
 /*
@@ -168,8 +168,21 @@ typedef struct mleaf_s
 	int			nummarksurfaces;
 	int			key;			// BSP sequence number for leaf's contents
 	byte		ambient_sound_level[NUM_AMBIENTS];
+
+	int			dlightframe;	// dynamic lights that may reach the leaf
+	int			dlightbits;
 } mleaf_t;
 
+// a clipnode with its plane copied in, so walking a hull reads one record per
+// node instead of a clipnode and then a plane somewhere else
+typedef struct
+{
+	vec3_t		normal;
+	float		dist;
+	short		children[2];	// negative numbers are contents
+	int			type;
+} mclipnode_t;
+
 // !!! if this is changed, it must be changed in asm_i386.h too !!!
 typedef struct
 {
@@ -179,6 +192,7 @@ typedef struct
 	int			lastclipnode;
 	vec3_t		clip_mins;
 	vec3_t		clip_maxs;
+	mclipnode_t	*nodes;			// clipnodes and planes packed for tracing
 } hull_t;
 
 /*
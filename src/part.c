@@ -0,0 +1,1030 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// part.c -- particle effects and physics, shared by the renderers
+
+#include "quakedef.h"
+#include "part.h"
+#include "simd.h"
+
+#define MAX_PARTICLES			2048	// default max # of particles at one
+										//  time
+#define ABSOLUTE_MIN_PARTICLES	512		// no fewer than this no matter what's
+										//  on the command line
+
+int		ramp1[8] = {0x6f, 0x6d, 0x6b, 0x69, 0x67, 0x65, 0x63, 0x61};
+int		ramp2[8] = {0x6f, 0x6e, 0x6d, 0x6c, 0x6b, 0x6a, 0x68, 0x66};
+int		ramp3[8] = {0x6d, 0x6b, 6, 5, 4, 3};
+
+partblock_t	*part_blocks[PART_NUMTYPES];
+int			part_count, part_max;
+
+static partblock_t	*part_allblocks;
+static int			part_numblocks;
+static partblock_t	*part_free;
+
+// the per frame steps of the physics
+typedef struct
+{
+	float	frametime;
+	float	time1, time2, time3;
+	float	grav;
+	float	dvel;
+} partframe_t;
+
+typedef void (*partupdatefunc_t) (partblock_t *b, ptype_t type, partframe_t *f);
+
+static partupdatefunc_t	part_update[SIMD_AVX2+1];
+
+void Part_Bench_f (void);
+
+
+/*
+===============
+R_InitParticles
+===============
+*/
+void R_InitParticles (void)
+{
+	int		i;
+
+	i = COM_CheckParm ("-particles");
+
+	if (i && i < com_argc-1)
+	{
+		part_max = (int)(Q_atoi(com_argv[i+1]));
+		if (part_max < ABSOLUTE_MIN_PARTICLES)
+			part_max = ABSOLUTE_MIN_PARTICLES;
+		if (part_max > PART_MAXPARTICLES)
+			part_max = PART_MAXPARTICLES;
+	}
+	else
+	{
+		part_max = MAX_PARTICLES;
+	}
+
+// the first block of each type can be partly full
+	part_numblocks = (part_max + PART_BLOCK - 1) / PART_BLOCK + PART_NUMTYPES;
+	part_allblocks = (partblock_t *)
+			Hunk_AllocName (part_numblocks * sizeof(partblock_t), "particles");
+
+	Cmd_AddCommand ("r_partbench", Part_Bench_f);
+}
+
+
+/*
+===============
+R_ClearParticles
+===============
+*/
+void R_ClearParticles (void)
+{
+	int		i;
+
+	for (i=0 ; i<PART_NUMTYPES ; i++)
+		part_blocks[i] = NULL;
+
+	part_free = &part_allblocks[0];
+	for (i=0 ; i<part_numblocks ; i++)
+	{
+		part_allblocks[i].count = 0;
+		part_allblocks[i].next = &part_allblocks[i+1];
+	}
+	part_allblocks[part_numblocks-1].next = NULL;
+
+	part_count = 0;
+}
+
+
+/*
+===============
+Part_Add
+===============
+*/
+qboolean Part_Add (particle_t *p)
+{
+	partblock_t	*b;
+	int			i;
+
+	if (part_count == part_max)
+		return false;
+
+	b = part_blocks[p->type];
+	if (!b || b->count == PART_BLOCK)
+	{
+		b = part_free;
+		part_free = b->next;
+		b->count = 0;
+		b->next = part_blocks[p->type];
+		part_blocks[p->type] = b;
+	}
+
+	i = b->count++;
+	b->org[0][i] = p->org[0];
+	b->org[1][i] = p->org[1];
+	b->org[2][i] = p->org[2];
+	b->vel[0][i] = p->vel[0];
+	b->vel[1][i] = p->vel[1];
+	b->vel[2][i] = p->vel[2];
+	b->ramp[i] = p->ramp;
+	b->die[i] = p->die;
+	b->color[i] = (int)p->color;
+
+	part_count++;
+	return true;
+}
+
+
+/*
+===============
+Part_Clean
+
+A dead particle is replaced by the last particle of the first block of its
+type, which has either been checked already or is checked next
+===============
+*/
+void Part_Clean (void)
+{
+	int			t, i, last;
+	partblock_t	*b, *next, *head;
+
+	for (t=0 ; t<PART_NUMTYPES ; t++)
+	{
+		for (b=part_blocks[t] ; b ; b=next)
+		{
+			next = b->next;
+			for (i=0 ; i<b->count ; )
+			{
+				if (b->die[i] >= cl.time)
+				{
+					i++;
+					continue;
+				}
+
+				head = part_blocks[t];
+				last = --head->count;
+				b->org[0][i] = head->org[0][last];
+				b->org[1][i] = head->org[1][last];
+				b->org[2][i] = head->org[2][last];
+				b->vel[0][i] = head->vel[0][last];
+				b->vel[1][i] = head->vel[1][last];
+				b->vel[2][i] = head->vel[2][last];
+				b->ramp[i] = head->ramp[last];
+				b->die[i] = head->die[last];
+				b->color[i] = head->color[last];
+				part_count--;
+
+				if (!head->count)
+				{
+					part_blocks[t] = head->next;
+					head->next = part_free;
+					part_free = head;
+					if (head == b)
+						break;
+				}
+			}
+		}
+	}
+}
+
+
+/*
+===============
+Part_SetupFrame
+===============
+*/
+extern	cvar_t	sv_gravity;
+
+static void Part_SetupFrame (partframe_t *f)
+{
+	float	frametime;
+
+	frametime = cl.time - cl.oldtime;
+	f->frametime = frametime;
+	f->time3 = frametime * 15;
+	f->time2 = frametime * 10; // 15;
+	f->time1 = frametime * 5;
+	f->grav = frametime * sv_gravity.value * 0.05;
+	f->dvel = 4*frametime;
+}
+
+
+/*
+===============
+Part_UpdateBlock_C
+===============
+*/
+static void Part_UpdateBlock_C (partblock_t *b, ptype_t type, partframe_t *f)
+{
+	int		i, j, n;
+
+	n = b->count;
+
+	for (j=0 ; j<3 ; j++)
+		for (i=0 ; i<n ; i++)
+			b->org[j][i] += b->vel[j][i]*f->frametime;
+
+	switch (type)
+	{
+	case pt_static:
+		break;
+
+	case pt_fire:
+		for (i=0 ; i<n ; i++)
+		{
+			b->ramp[i] += f->time1;
+			if (b->ramp[i] >= 6)
+				b->die[i] = -1;
+			else
+				b->color[i] = ramp3[(int)b->ramp[i]];
+			b->vel[2][i] += f->grav;
+		}
+		break;
+
+	case pt_explode:
+		for (i=0 ; i<n ; i++)
+		{
+			b->ramp[i] += f->time2;
+			if (b->ramp[i] >= 8)
+				b->die[i] = -1;
+			else
+				b->color[i] = ramp1[(int)b->ramp[i]];
+		}
+		for (j=0 ; j<3 ; j++)
+			for (i=0 ; i<n ; i++)
+				b->vel[j][i] += b->vel[j][i]*f->dvel;
+		for (i=0 ; i<n ; i++)
+			b->vel[2][i] -= f->grav;
+		break;
+
+	case pt_explode2:
+		for (i=0 ; i<n ; i++)
+		{
+			b->ramp[i] += f->time3;
+			if (b->ramp[i] >= 8)
+				b->die[i] = -1;
+			else
+				b->color[i] = ramp2[(int)b->ramp[i]];
+		}
+		for (j=0 ; j<3 ; j++)
+			for (i=0 ; i<n ; i++)
+				b->vel[j][i] -= b->vel[j][i]*f->frametime;
+		for (i=0 ; i<n ; i++)
+			b->vel[2][i] -= f->grav;
+		break;
+
+	case pt_blob:
+		for (j=0 ; j<3 ; j++)
+			for (i=0 ; i<n ; i++)
+				b->vel[j][i] += b->vel[j][i]*f->dvel;
+		for (i=0 ; i<n ; i++)
+			b->vel[2][i] -= f->grav;
+		break;
+
+	case pt_blob2:
+		for (j=0 ; j<2 ; j++)
+			for (i=0 ; i<n ; i++)
+				b->vel[j][i] -= b->vel[j][i]*f->dvel;
+		for (i=0 ; i<n ; i++)
+			b->vel[2][i] -= f->grav;
+		break;
+
+	case pt_grav:
+	case pt_slowgrav:
+		for (i=0 ; i<n ; i++)
+			b->vel[2][i] -= f->grav;
+		break;
+	}
+}
+
+/*
+=============================================================================
+
+VECTOR PHYSICS
+
+The kernels run four particles at a time up to the block's count rounded up;
+the slots past the count are never drawn, so what is left in them doesn't
+matter.  The arithmetic is the same as the C version, one operation at a
+time, so the results are identical.
+
+=============================================================================
+*/
+
+#if SIMD_X86
+
+/*
+===============
+Part_Ramp_SSE2
+
+Moves four particles along a color ramp, killing those that run off its end
+===============
+*/
+SIMD_TARGET("sse2")
+static void Part_Ramp_SSE2 (partblock_t *b, int i, int n, __m128 step, float end, int *ramp)
+{
+	__m128	r, dead;
+	int		k, mask, index[4];
+
+	r = _mm_add_ps (_mm_loadu_ps (b->ramp + i), step);
+	_mm_storeu_ps (b->ramp + i, r);
+
+	dead = _mm_cmpge_ps (r, _mm_set1_ps (end));
+	_mm_storeu_ps (b->die + i, _mm_or_ps (_mm_and_ps (dead, _mm_set1_ps (-1)),
+		_mm_andnot_ps (dead, _mm_loadu_ps (b->die + i))));
+
+	_mm_storeu_si128 ((__m128i *)index, _mm_cvttps_epi32 (r));
+	mask = _mm_movemask_ps (dead);
+	for (k=0 ; k<4 && i+k<n ; k++)
+		if (!(mask & (1<<k)))
+			b->color[i+k] = ramp[index[k]];
+}
+
+/*
+===============
+Part_Scale_SSE2
+
+vel += vel*scale for the first count axes
+===============
+*/
+SIMD_TARGET("sse2")
+static void Part_Scale_SSE2 (partblock_t *b, int i, int count, __m128 scale)
+{
+	__m128	v;
+	int		j;
+
+	for (j=0 ; j<count ; j++)
+	{
+		v = _mm_loadu_ps (b->vel[j] + i);
+		_mm_storeu_ps (b->vel[j] + i, _mm_add_ps (v, _mm_mul_ps (v, scale)));
+	}
+}
+
+/*
+===============
+Part_Shrink_SSE2
+
+vel -= vel*scale for the first count axes
+===============
+*/
+SIMD_TARGET("sse2")
+static void Part_Shrink_SSE2 (partblock_t *b, int i, int count, __m128 scale)
+{
+	__m128	v;
+	int		j;
+
+	for (j=0 ; j<count ; j++)
+	{
+		v = _mm_loadu_ps (b->vel[j] + i);
+		_mm_storeu_ps (b->vel[j] + i, _mm_sub_ps (v, _mm_mul_ps (v, scale)));
+	}
+}
+
+/*
+===============
+Part_UpdateBlock_SSE2
+===============
+*/
+SIMD_TARGET("sse2")
+static void Part_UpdateBlock_SSE2 (partblock_t *b, ptype_t type, partframe_t *f)
+{
+	int		i, j, n;
+	__m128	frametime, grav, dvel, v;
+
+	n = b->count;
+	frametime = _mm_set1_ps (f->frametime);
+	grav = _mm_set1_ps (f->grav);
+	dvel = _mm_set1_ps (f->dvel);
+
+	for (i=0 ; i<n ; i+=4)
+	{
+		for (j=0 ; j<3 ; j++)
+		{
+			v = _mm_mul_ps (_mm_loadu_ps (b->vel[j] + i), frametime);
+			_mm_storeu_ps (b->org[j] + i, _mm_add_ps (_mm_loadu_ps (b->org[j] + i), v));
+		}
+
+		switch (type)
+		{
+		case pt_static:
+			continue;
+
+		case pt_fire:
+			Part_Ramp_SSE2 (b, i, n, _mm_set1_ps (f->time1), 6, ramp3);
+			v = _mm_add_ps (_mm_loadu_ps (b->vel[2] + i), grav);
+			_mm_storeu_ps (b->vel[2] + i, v);
+			continue;
+
+		case pt_explode:
+			Part_Ramp_SSE2 (b, i, n, _mm_set1_ps (f->time2), 8, ramp1);
+			Part_Scale_SSE2 (b, i, 3, dvel);
+			break;
+
+		case pt_explode2:
+			Part_Ramp_SSE2 (b, i, n, _mm_set1_ps (f->time3), 8, ramp2);
+			Part_Shrink_SSE2 (b, i, 3, frametime);
+			break;
+
+		case pt_blob:
+			Part_Scale_SSE2 (b, i, 3, dvel);
+			break;
+
+		case pt_blob2:
+			Part_Shrink_SSE2 (b, i, 2, dvel);
+			break;
+
+		case pt_grav:
+		case pt_slowgrav:
+			break;
+		}
+
+		v = _mm_sub_ps (_mm_loadu_ps (b->vel[2] + i), grav);
+		_mm_storeu_ps (b->vel[2] + i, v);
+	}
+}
+
+static partupdatefunc_t	part_update[SIMD_AVX2+1] = {
+	Part_UpdateBlock_C, Part_UpdateBlock_SSE2, Part_UpdateBlock_SSE2, Part_UpdateBlock_SSE2
+};
+
+#else
+
+static partupdatefunc_t	part_update[SIMD_AVX2+1] = {
+	Part_UpdateBlock_C, Part_UpdateBlock_C, Part_UpdateBlock_C, Part_UpdateBlock_C
+};
+
+#endif
+
+
+/*
+===============
+Part_Update
+===============
+*/
+void Part_Update (void)
+{
+	int				t;
+	partblock_t		*b;
+	partframe_t		f;
+	partupdatefunc_t	update;
+
+	Part_SetupFrame (&f);
+	update = part_update[SIMD_Level ()];
+
+	for (t=0 ; t<PART_NUMTYPES ; t++)
+		for (b=part_blocks[t] ; b ; b=b->next)
+			update (b, t, &f);
+}
+
+
+#define	PARTBENCH_BLOCKS	256
+#define	PARTBENCH_LOOPS		16
+
+/*
+===============
+Part_Bench_f
+
+For program optimization: times a frame of physics for 16k particles of
+every type at every available SIMD level, and checks them against the C
+version
+===============
+*/
+void Part_Bench_f (void)
+{
+	int			i, j, level, maxlevel;
+	partblock_t	*start, *ref, *b;
+	partframe_t	f;
+	double		time;
+
+	start = Hunk_TempAlloc (3*PARTBENCH_BLOCKS*sizeof(partblock_t));
+	ref = start + PARTBENCH_BLOCKS;
+	b = ref + PARTBENCH_BLOCKS;
+
+	srand (0);
+	for (i=0 ; i<PARTBENCH_BLOCKS ; i++)
+	{
+		start[i].count = PART_BLOCK - (i & 7);
+		for (j=0 ; j<PART_BLOCK ; j++)
+		{
+			start[i].org[0][j] = (rand()&1023) - 512;
+			start[i].org[1][j] = (rand()&1023) - 512;
+			start[i].org[2][j] = (rand()&1023) - 512;
+			start[i].vel[0][j] = (rand()%512) - 256;
+			start[i].vel[1][j] = (rand()%512) - 256;
+			start[i].vel[2][j] = (rand()%512) - 256;
+			start[i].ramp[j] = (rand()&63) * 0.125;
+			start[i].die[j] = 1;
+			start[i].color[j] = rand();
+		}
+	}
+
+	f.frametime = 0.0137;
+	f.time3 = f.frametime * 15;
+	f.time2 = f.frametime * 10;
+	f.time1 = f.frametime * 5;
+	f.grav = f.frametime * 800 * 0.05;
+	f.dvel = 4*f.frametime;
+
+	maxlevel = SIMD_Level ();
+
+	Con_Printf ("usec per %ik particles:", PARTBENCH_BLOCKS*PART_BLOCK/1024);
+	for (level=SIMD_NONE ; level<=maxlevel ; level++)
+	{
+		time = 0;
+		for (j=0 ; j<PARTBENCH_LOOPS ; j++)
+		{
+			Q_memcpy (b, start, PARTBENCH_BLOCKS*sizeof(partblock_t));
+			time -= Sys_FloatTime ();
+			for (i=0 ; i<PARTBENCH_BLOCKS ; i++)
+				part_update[level] (&b[i], i % PART_NUMTYPES, &f);
+			time += Sys_FloatTime ();
+		}
+
+		Con_Printf (" %s %6.1f", SIMD_Name (level), time / PARTBENCH_LOOPS * 1000000);
+
+	// only the live slots have to match
+		if (!level)
+			Q_memcpy (ref, b, PARTBENCH_BLOCKS*sizeof(partblock_t));
+		else
+		{
+			for (i=0 ; i<PARTBENCH_BLOCKS ; i++)
+			{
+				for (j=0 ; j<b[i].count ; j++)
+					if (b[i].org[0][j] != ref[i].org[0][j] || b[i].org[1][j] != ref[i].org[1][j]
+					|| b[i].org[2][j] != ref[i].org[2][j] || b[i].vel[0][j] != ref[i].vel[0][j]
+					|| b[i].vel[1][j] != ref[i].vel[1][j] || b[i].vel[2][j] != ref[i].vel[2][j]
+					|| b[i].ramp[j] != ref[i].ramp[j] || b[i].die[j] != ref[i].die[j]
+					|| b[i].color[j] != ref[i].color[j])
+						break;
+				if (j < b[i].count)
+					break;
+			}
+			if (i < PARTBENCH_BLOCKS)
+				Con_Printf (" (MISMATCH)");
+		}
+	}
+	Con_Printf ("\n");
+}
+
+/*
+=============================================================================
+
+EFFECTS
+
+=============================================================================
+*/
+
+/*
+===============
+R_EntityParticles
+===============
+*/
+
+#define NUMVERTEXNORMALS	162
+extern	float	r_avertexnormals[NUMVERTEXNORMALS][3];
+vec3_t	avelocities[NUMVERTEXNORMALS];
+float	beamlength = 16;
+vec3_t	avelocity = {23, 7, 3};
+float	partstep = 0.01;
+float	timescale = 0.01;
+
+void R_EntityParticles (entity_t *ent)
+{
+	int			count;
+	int			i;
+	particle_t	p;
+	float		angle;
+	float		sr, sp, sy, cr, cp, cy;
+	vec3_t		forward;
+	float		dist;
+
+	dist = 64;
+	count = 50;
+
+if (!avelocities[0][0])
+{
+for (i=0 ; i<NUMVERTEXNORMALS*3 ; i++)
+avelocities[0][i] = (rand()&255) * 0.01;
+}
+
+
+	for (i=0 ; i<NUMVERTEXNORMALS ; i++)
+	{
+		angle = cl.time * avelocities[i][0];
+		sy = sin(angle);
+		cy = cos(angle);
+		angle = cl.time * avelocities[i][1];
+		sp = sin(angle);
+		cp = cos(angle);
+		angle = cl.time * avelocities[i][2];
+		sr = sin(angle);
+		cr = cos(angle);
+
+		forward[0] = cp*cy;
+		forward[1] = cp*sy;
+		forward[2] = -sp;
+
+		p.die = cl.time + 0.01;
+		p.color = 0x6f;
+		p.type = pt_explode;
+		p.ramp = 0;
+		VectorCopy (vec3_origin, p.vel);
+
+		p.org[0] = ent->origin[0] + r_avertexnormals[i][0]*dist + forward[0]*beamlength;
+		p.org[1] = ent->origin[1] + r_avertexnormals[i][1]*dist + forward[1]*beamlength;
+		p.org[2] = ent->origin[2] + r_avertexnormals[i][2]*dist + forward[2]*beamlength;
+
+		if (!Part_Add (&p))
+			return;
+	}
+}
+
+
+/*
+===============
+R_ParseParticleEffect
+
+Parse an effect out of the server message
+===============
+*/
+void R_ParseParticleEffect (void)
+{
+	vec3_t		org, dir;
+	int			i, count, msgcount, color;
+
+	for (i=0 ; i<3 ; i++)
+		org[i] = MSG_ReadCoord ();
+	for (i=0 ; i<3 ; i++)
+		dir[i] = MSG_ReadChar () * (1.0/16);
+	msgcount = MSG_ReadByte ();
+	color = MSG_ReadByte ();
+
+if (msgcount == 255)
+	count = 1024;
+else
+	count = msgcount;
+
+	R_RunParticleEffect (org, dir, color, count);
+}
+
+/*
+===============
+R_ParticleExplosion
+
+===============
+*/
+void R_ParticleExplosion (vec3_t org)
+{
+	int			i, j;
+	particle_t	p;
+
+	for (i=0 ; i<1024 ; i++)
+	{
+		p.die = cl.time + 5;
+		p.color = ramp1[0];
+		p.ramp = rand()&3;
+		if (i & 1)
+		{
+			p.type = pt_explode;
+			for (j=0 ; j<3 ; j++)
+			{
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
+			}
+		}
+		else
+		{
+			p.type = pt_explode2;
+			for (j=0 ; j<3 ; j++)
+			{
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
+			}
+		}
+
+		if (!Part_Add (&p))
+			return;
+	}
+}
+
+/*
+===============
+R_ParticleExplosion2
+
+===============
+*/
+void R_ParticleExplosion2 (vec3_t org, int colorStart, int colorLength)
+{
+	int			i, j;
+	particle_t	p;
+	int			colorMod = 0;
+
+	for (i=0; i<512; i++)
+	{
+		p.die = cl.time + 0.3;
+		p.color = colorStart + (colorMod % colorLength);
+		colorMod++;
+
+		p.type = pt_blob;
+		p.ramp = 0;
+		for (j=0 ; j<3 ; j++)
+		{
+			p.org[j] = org[j] + ((rand()%32)-16);
+			p.vel[j] = (rand()%512)-256;
+		}
+
+		if (!Part_Add (&p))
+			return;
+	}
+}
+
+/*
+===============
+R_BlobExplosion
+
+===============
+*/
+void R_BlobExplosion (vec3_t org)
+{
+	int			i, j;
+	particle_t	p;
+
+	for (i=0 ; i<1024 ; i++)
+	{
+		p.die = cl.time + 1 + (rand()&8)*0.05;
+		p.ramp = 0;
+
+		if (i & 1)
+		{
+			p.type = pt_blob;
+			p.color = 66 + rand()%6;
+			for (j=0 ; j<3 ; j++)
+			{
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
+			}
+		}
+		else
+		{
+			p.type = pt_blob2;
+			p.color = 150 + rand()%6;
+			for (j=0 ; j<3 ; j++)
+			{
+				p.org[j] = org[j] + ((rand()%32)-16);
+				p.vel[j] = (rand()%512)-256;
+			}
+		}
+
+		if (!Part_Add (&p))
+			return;
+	}
+}
+
+/*
+===============
+R_RunParticleEffect
+
+===============
+*/
+void R_RunParticleEffect (vec3_t org, vec3_t dir, int color, int count)
+{
+	int			i, j;
+	particle_t	p;
+
+	for (i=0 ; i<count ; i++)
+	{
+		if (count == 1024)
+		{	// rocket explosion
+			p.die = cl.time + 5;
+			p.color = ramp1[0];
+			p.ramp = rand()&3;
+			if (i & 1)
+			{
+				p.type = pt_explode;
+				for (j=0 ; j<3 ; j++)
+				{
+					p.org[j] = org[j] + ((rand()%32)-16);
+					p.vel[j] = (rand()%512)-256;
+				}
+			}
+			else
+			{
+				p.type = pt_explode2;
+				for (j=0 ; j<3 ; j++)
+				{
+					p.org[j] = org[j] + ((rand()%32)-16);
+					p.vel[j] = (rand()%512)-256;
+				}
+			}
+		}
+		else
+		{
+			p.die = cl.time + 0.1*(rand()%5);
+			p.color = (color&~7) + (rand()&7);
+			p.type = pt_slowgrav;
+			p.ramp = 0;
+			for (j=0 ; j<3 ; j++)
+			{
+				p.org[j] = org[j] + ((rand()&15)-8);
+				p.vel[j] = dir[j]*15;// + (rand()%300)-150;
+			}
+		}
+
+		if (!Part_Add (&p))
+			return;
+	}
+}
+
+
+/*
+===============
+R_LavaSplash
+
+===============
+*/
+void R_LavaSplash (vec3_t org)
+{
+	int			i, j, k;
+	particle_t	p;
+	float		vel;
+	vec3_t		dir;
+
+	for (i=-16 ; i<16 ; i++)
+		for (j=-16 ; j<16 ; j++)
+			for (k=0 ; k<1 ; k++)
+			{
+				p.die = cl.time + 2 + (rand()&31) * 0.02;
+				p.color = 224 + (rand()&7);
+				p.type = pt_slowgrav;
+				p.ramp = 0;
+
+				dir[0] = j*8 + (rand()&7);
+				dir[1] = i*8 + (rand()&7);
+				dir[2] = 256;
+
+				p.org[0] = org[0] + dir[0];
+				p.org[1] = org[1] + dir[1];
+				p.org[2] = org[2] + (rand()&63);
+
+				VectorNormalize (dir);
+				vel = 50 + (rand()&63);
+				VectorScale (dir, vel, p.vel);
+
+				if (!Part_Add (&p))
+					return;
+			}
+}
+
+/*
+===============
+R_TeleportSplash
+
+===============
+*/
+void R_TeleportSplash (vec3_t org)
+{
+	int			i, j, k;
+	particle_t	p;
+	float		vel;
+	vec3_t		dir;
+
+	for (i=-16 ; i<16 ; i+=4)
+		for (j=-16 ; j<16 ; j+=4)
+			for (k=-24 ; k<32 ; k+=4)
+			{
+				p.die = cl.time + 0.2 + (rand()&7) * 0.02;
+				p.color = 7 + (rand()&7);
+				p.type = pt_slowgrav;
+				p.ramp = 0;
+
+				dir[0] = j*8;
+				dir[1] = i*8;
+				dir[2] = k*8;
+
+				p.org[0] = org[0] + i + (rand()&3);
+				p.org[1] = org[1] + j + (rand()&3);
+				p.org[2] = org[2] + k + (rand()&3);
+
+				VectorNormalize (dir);
+				vel = 50 + (rand()&63);
+				VectorScale (dir, vel, p.vel);
+
+				if (!Part_Add (&p))
+					return;
+			}
+}
+
+void R_RocketTrail (vec3_t start, vec3_t end, int type)
+{
+	vec3_t		vec;
+	float		len;
+	int			j;
+	particle_t	p;
+	int			dec;
+	static int	tracercount;
+
+	VectorSubtract (end, start, vec);
+	len = VectorNormalize (vec);
+	if (type < 128)
+		dec = 3;
+	else
+	{
+		dec = 1;
+		type -= 128;
+	}
+
+	while (len > 0)
+	{
+		len -= dec;
+
+		VectorCopy (vec3_origin, p.vel);
+		p.die = cl.time + 2;
+		p.ramp = 0;
+
+		switch (type)
+		{
+			case 0:	// rocket trail
+				p.ramp = (rand()&3);
+				p.color = ramp3[(int)p.ramp];
+				p.type = pt_fire;
+				for (j=0 ; j<3 ; j++)
+					p.org[j] = start[j] + ((rand()%6)-3);
+				break;
+
+			case 1:	// smoke smoke
+				p.ramp = (rand()&3) + 2;
+				p.color = ramp3[(int)p.ramp];
+				p.type = pt_fire;
+				for (j=0 ; j<3 ; j++)
+					p.org[j] = start[j] + ((rand()%6)-3);
+				break;
+
+			case 2:	// blood
+				p.type = pt_grav;
+				p.color = 67 + (rand()&3);
+				for (j=0 ; j<3 ; j++)
+					p.org[j] = start[j] + ((rand()%6)-3);
+				break;
+
+			case 3:
+			case 5:	// tracer
+				p.die = cl.time + 0.5;
+				p.type = pt_static;
+				if (type == 3)
+					p.color = 52 + ((tracercount&4)<<1);
+				else
+					p.color = 230 + ((tracercount&4)<<1);
+
+				tracercount++;
+
+				VectorCopy (start, p.org);
+				if (tracercount & 1)
+				{
+					p.vel[0] = 30*vec[1];
+					p.vel[1] = 30*-vec[0];
+				}
+				else
+				{
+					p.vel[0] = 30*-vec[1];
+					p.vel[1] = 30*vec[0];
+				}
+				break;
+
+			case 4:	// slight blood
+				p.type = pt_grav;
+				p.color = 67 + (rand()&3);
+				for (j=0 ; j<3 ; j++)
+					p.org[j] = start[j] + ((rand()%6)-3);
+				len -= 3;
+				break;
+
+			case 6:	// voor trail
+				p.color = 9*16 + 8 + (rand()&3);
+				p.type = pt_static;
+				p.die = cl.time + 0.3;
+				for (j=0 ; j<3 ; j++)
+					p.org[j] = start[j] + ((rand()&15)-8);
+				break;
+		}
+
+		if (!Part_Add (&p))
+			return;
+
+		VectorAdd (start, vec, start);
+	}
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// part.h -- particle store shared by the renderers
+
+#ifndef __PART__
+#define __PART__
+
+//
+// Particles live in blocks of PART_BLOCK, each field in its own array, and
+// every block holds particles of a single type, so a frame's physics is one
+// straight loop per block with no per particle switch.  The spawning code
+// fills in a particle_t and hands it to Part_Add.  A renderer's
+// R_DrawParticles calls Part_Clean, walks part_blocks to draw, then calls
+// Part_Update.
+//
+
+#define	PART_BLOCK			64		// multiple of the widest vector
+#define	PART_NUMTYPES		(pt_blob2+1)
+#define	PART_MAXPARTICLES	(512*1024)
+
+typedef struct partblock_s
+{
+	float		org[3][PART_BLOCK];
+	float		vel[3][PART_BLOCK];
+	float		ramp[PART_BLOCK];
+	float		die[PART_BLOCK];
+	byte		color[PART_BLOCK];
+	int			count;
+	struct partblock_s	*next;
+} partblock_t;
+
+// the first block of each type is the only one that can be partly full
+extern	partblock_t	*part_blocks[PART_NUMTYPES];
+extern	int			part_count, part_max;
+
+void R_InitParticles (void);
+void R_ClearParticles (void);
+
+// false if the store is full
+qboolean Part_Add (particle_t *p);
+
+// frees particles whose time is up
+void Part_Clean (void);
+
+// moves the particles along and runs their type's physics
+void Part_Update (void);
+
+#endif
@@ -0,0 +1,622 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pmove.c -- player movement shared by the server and client prediction
+
+#include "quakedef.h"
+
+//
+// Everything here works on an entvars_t and reaches the world only through
+// the pmove_t callbacks.  The server passes the edict's own fields and
+// SV_Move, so the touches and ground entities happen as they always did.
+// Client prediction passes a copy it filled in from the last update and
+// traces against what it knows of the world.
+//
+
+extern	cvar_t	sv_friction;
+extern	cvar_t	sv_edgefriction;
+extern	cvar_t	sv_stopspeed;
+extern	cvar_t	sv_maxspeed;
+extern	cvar_t	sv_accelerate;
+extern	cvar_t	sv_nostep;
+
+#define	STEPSIZE		18
+#define	MAX_CLIP_PLANES	5
+
+/*
+============
+PM_FlyMove
+
+The basic solid body movement clip that slides along multiple planes
+Returns the clipflags if the velocity was modified (hit something solid)
+1 = floor
+2 = wall / step
+4 = dead stop
+If steptrace is not NULL, the trace of any vertical wall hit will be stored
+============
+*/
+int PM_FlyMove (pmove_t *pm, float time, trace_t *steptrace)
+{
+	entvars_t	*v;
+	int			bumpcount, numbumps;
+	vec3_t		dir;
+	float		d;
+	int			numplanes;
+	vec3_t		planes[MAX_CLIP_PLANES];
+	vec3_t		primal_velocity, original_velocity, new_velocity;
+	int			i, j;
+	trace_t		trace;
+	vec3_t		end;
+	float		time_left;
+	int			blocked;
+
+	v = pm->v;
+	numbumps = 4;
+
+	blocked = 0;
+	VectorCopy (v->velocity, original_velocity);
+	VectorCopy (v->velocity, primal_velocity);
+	numplanes = 0;
+
+	time_left = time;
+
+	for (bumpcount=0 ; bumpcount<numbumps ; bumpcount++)
+	{
+		if (!v->velocity[0] && !v->velocity[1] && !v->velocity[2])
+			break;
+
+		for (i=0 ; i<3 ; i++)
+			end[i] = v->origin[i] + time_left * v->velocity[i];
+
+		trace = pm->trace (pm, v->origin, v->mins, v->maxs, end, MOVE_NORMAL);
+
+		if (trace.allsolid)
+		{	// entity is trapped in another solid
+			VectorCopy (vec3_origin, v->velocity);
+			return 3;
+		}
+
+		if (trace.fraction > 0)
+		{	// actually covered some distance
+			VectorCopy (trace.endpos, v->origin);
+			VectorCopy (v->velocity, original_velocity);
+			numplanes = 0;
+		}
+
+		if (trace.fraction == 1)
+			 break;		// moved the entire distance
+
+		if (!trace.ent)
+			Sys_Error ("PM_FlyMove: !trace.ent");
+
+		if (trace.plane.normal[2] > 0.7)
+		{
+			blocked |= 1;		// floor
+			if (trace.ent->v.solid == SOLID_BSP)
+			{
+				v->flags = (int)v->flags | FL_ONGROUND;
+				if (pm->ground)
+					pm->ground (pm, trace.ent);
+			}
+		}
+		if (!trace.plane.normal[2])
+		{
+			blocked |= 2;		// step
+			if (steptrace)
+				*steptrace = trace;	// save for player extrafriction
+		}
+
+//
+// run the impact function
+//
+		if (pm->impact && !pm->impact (pm, trace.ent))
+			break;		// removed by the impact function
+
+		time_left -= time_left * trace.fraction;
+
+	// cliped to another plane
+		if (numplanes >= MAX_CLIP_PLANES)
+		{	// this shouldn't really happen
+			VectorCopy (vec3_origin, v->velocity);
+			return 3;
+		}
+
+		VectorCopy (trace.plane.normal, planes[numplanes]);
+		numplanes++;
+
+//
+// modify original_velocity so it parallels all of the clip planes
+//
+		for (i=0 ; i<numplanes ; i++)
+		{
+			ClipVelocity (original_velocity, planes[i], new_velocity, 1);
+			for (j=0 ; j<numplanes ; j++)
+				if (j != i)
+				{
+					if (DotProduct (new_velocity, planes[j]) < 0)
+						break;	// not ok
+				}
+			if (j == numplanes)
+				break;
+		}
+
+		if (i != numplanes)
+		{	// go along this plane
+			VectorCopy (new_velocity, v->velocity);
+		}
+		else
+		{	// go along the crease
+			if (numplanes != 2)
+			{
+				VectorCopy (vec3_origin, v->velocity);
+				return 7;
+			}
+			CrossProduct (planes[0], planes[1], dir);
+			d = DotProduct (dir, v->velocity);
+			VectorScale (dir, d, v->velocity);
+		}
+
+//
+// if original velocity is against the original velocity, stop dead
+// to avoid tiny occilations in sloping corners
+//
+		if (DotProduct (v->velocity, primal_velocity) <= 0)
+		{
+			VectorCopy (vec3_origin, v->velocity);
+			return blocked;
+		}
+	}
+
+	return blocked;
+}
+
+/*
+=============
+PM_CheckWater
+=============
+*/
+qboolean PM_CheckWater (pmove_t *pm)
+{
+	entvars_t	*v;
+	vec3_t		point;
+	int			cont;
+
+	v = pm->v;
+	point[0] = v->origin[0];
+	point[1] = v->origin[1];
+	point[2] = v->origin[2] + v->mins[2] + 1;
+
+	v->waterlevel = 0;
+	v->watertype = CONTENTS_EMPTY;
+	cont = pm->pointcontents (point);
+	if (cont <= CONTENTS_WATER)
+	{
+		v->watertype = cont;
+		v->waterlevel = 1;
+		point[2] = v->origin[2] + (v->mins[2] + v->maxs[2])*0.5;
+		cont = pm->pointcontents (point);
+		if (cont <= CONTENTS_WATER)
+		{
+			v->waterlevel = 2;
+			point[2] = v->origin[2] + v->view_ofs[2];
+			cont = pm->pointcontents (point);
+			if (cont <= CONTENTS_WATER)
+				v->waterlevel = 3;
+		}
+	}
+
+	return v->waterlevel > 1;
+}
+
+/*
+============
+PM_WallFriction
+
+============
+*/
+static void PM_WallFriction (pmove_t *pm, trace_t *trace)
+{
+	entvars_t	*v;
+	vec3_t		forward, right, up;
+	float		d, i;
+	vec3_t		into, side;
+
+	v = pm->v;
+	AngleVectors (v->v_angle, forward, right, up);
+	d = DotProduct (trace->plane.normal, forward);
+
+	d += 0.5;
+	if (d >= 0)
+		return;
+
+// cut the tangential velocity
+	i = DotProduct (trace->plane.normal, v->velocity);
+	VectorScale (trace->plane.normal, i, into);
+	VectorSubtract (v->velocity, into, side);
+
+	v->velocity[0] = side[0] * (1 + d);
+	v->velocity[1] = side[1] * (1 + d);
+}
+
+/*
+=====================
+PM_TryUnstick
+
+Player has come to a dead stop, possibly due to the problem with limited
+float precision at some angle joins in the BSP hull.
+
+Try fixing by pushing one pixel in each direction.
+
+This is a hack, but in the interest of good gameplay...
+======================
+*/
+static int PM_TryUnstick (pmove_t *pm, vec3_t oldvel)
+{
+	static vec3_t	dirs[8] = {
+		{2, 0, 0}, {0, 2, 0}, {-2, 0, 0}, {0, -2, 0},
+		{2, 2, 0}, {-2, 2, 0}, {2, -2, 0}, {-2, -2, 0}};
+	entvars_t	*v;
+	int			i;
+	vec3_t		oldorg;
+	int			clip;
+	trace_t		steptrace;
+
+	v = pm->v;
+	VectorCopy (v->origin, oldorg);
+
+	for (i=0 ; i<8 ; i++)
+	{
+// try pushing a little in an axial direction
+		pm->push (pm, dirs[i]);
+
+// retry the original move
+		v->velocity[0] = oldvel[0];
+		v->velocity[1] = oldvel[1];
+		v->velocity[2] = 0;
+		clip = PM_FlyMove (pm, 0.1, &steptrace);
+
+		if ( fabs(oldorg[1] - v->origin[1]) > 4
+		|| fabs(oldorg[0] - v->origin[0]) > 4 )
+			return clip;
+
+// go back to the original pos and try again
+		VectorCopy (oldorg, v->origin);
+	}
+
+	VectorCopy (vec3_origin, v->velocity);
+	return 7;		// still not moving
+}
+
+/*
+=====================
+PM_WalkMove
+
+Only used by players
+======================
+*/
+void PM_WalkMove (pmove_t *pm)
+{
+	entvars_t	*v;
+	vec3_t		upmove, downmove;
+	vec3_t		oldorg, oldvel;
+	vec3_t		nosteporg, nostepvel;
+	int			clip;
+	int			oldonground;
+	trace_t		steptrace, downtrace;
+
+	v = pm->v;
+
+//
+// do a regular slide move unless it looks like you ran into a step
+//
+	oldonground = (int)v->flags & FL_ONGROUND;
+	v->flags = (int)v->flags & ~FL_ONGROUND;
+
+	VectorCopy (v->origin, oldorg);
+	VectorCopy (v->velocity, oldvel);
+
+	clip = PM_FlyMove (pm, pm->frametime, &steptrace);
+
+	if ( !(clip & 2) )
+		return;		// move didn't block on a step
+
+	if (!oldonground && v->waterlevel == 0)
+		return;		// don't stair up while jumping
+
+	if (v->movetype != MOVETYPE_WALK)
+		return;		// gibbed by a trigger
+
+	if (sv_nostep.value)
+		return;
+
+	if ( (int)v->flags & FL_WATERJUMP )
+		return;
+
+	VectorCopy (v->origin, nosteporg);
+	VectorCopy (v->velocity, nostepvel);
+
+//
+// try moving up and forward to go up a step
+//
+	VectorCopy (oldorg, v->origin);	// back to start pos
+
+	VectorCopy (vec3_origin, upmove);
+	VectorCopy (vec3_origin, downmove);
+	upmove[2] = STEPSIZE;
+	downmove[2] = -STEPSIZE + oldvel[2]*pm->frametime;
+
+// move up
+	pm->push (pm, upmove);	// FIXME: don't link?
+
+// move forward
+	v->velocity[0] = oldvel[0];
+	v->velocity[1] = oldvel[1];
+	v->velocity[2] = 0;
+	clip = PM_FlyMove (pm, pm->frametime, &steptrace);
+
+// check for stuckness, possibly due to the limited precision of floats
+// in the clipping hulls
+	if (clip)
+	{
+		if ( fabs(oldorg[1] - v->origin[1]) < 0.03125
+		&& fabs(oldorg[0] - v->origin[0]) < 0.03125 )
+		{	// stepping up didn't make any progress
+			clip = PM_TryUnstick (pm, oldvel);
+		}
+	}
+
+// extra friction based on view angle
+	if ( clip & 2 )
+		PM_WallFriction (pm, &steptrace);
+
+// move down
+	downtrace = pm->push (pm, downmove);	// FIXME: don't link?
+
+	if (downtrace.plane.normal[2] > 0.7)
+	{
+		if (v->solid == SOLID_BSP)
+		{
+			v->flags = (int)v->flags | FL_ONGROUND;
+			if (pm->ground)
+				pm->ground (pm, downtrace.ent);
+		}
+	}
+	else
+	{
+// if the push down didn't end up on good ground, use the move without
+// the step up.  This happens near wall / slope combinations, and can
+// cause the player to hop up higher on a slope too steep to climb
+		VectorCopy (nosteporg, v->origin);
+		VectorCopy (nostepvel, v->velocity);
+	}
+}
+
+/*
+==================
+PM_Friction
+
+==================
+*/
+static void PM_Friction (pmove_t *pm)
+{
+	entvars_t	*v;
+	float	*vel;
+	float	speed, newspeed, control;
+	vec3_t	start, stop;
+	float	friction;
+	trace_t	trace;
+
+	v = pm->v;
+	vel = v->velocity;
+
+	speed = sqrt(vel[0]*vel[0] +vel[1]*vel[1]);
+	if (!speed)
+		return;
+
+// if the leading edge is over a dropoff, increase friction
+	start[0] = stop[0] = v->origin[0] + vel[0]/speed*16;
+	start[1] = stop[1] = v->origin[1] + vel[1]/speed*16;
+	start[2] = v->origin[2] + v->mins[2];
+	stop[2] = start[2] - 34;
+
+	trace = pm->trace (pm, start, vec3_origin, vec3_origin, stop, MOVE_NOMONSTERS);
+
+	if (trace.fraction == 1.0)
+		friction = sv_friction.value*sv_edgefriction.value;
+	else
+		friction = sv_friction.value;
+
+// apply friction
+	control = speed < sv_stopspeed.value ? sv_stopspeed.value : speed;
+	newspeed = speed - pm->frametime*control*friction;
+
+	if (newspeed < 0)
+		newspeed = 0;
+	newspeed /= speed;
+
+	vel[0] = vel[0] * newspeed;
+	vel[1] = vel[1] * newspeed;
+	vel[2] = vel[2] * newspeed;
+}
+
+/*
+==============
+PM_Accelerate
+==============
+*/
+static void PM_Accelerate (pmove_t *pm, vec3_t wishdir, float wishspeed)
+{
+	int			i;
+	float		addspeed, accelspeed, currentspeed;
+
+	currentspeed = DotProduct (pm->v->velocity, wishdir);
+	addspeed = wishspeed - currentspeed;
+	if (addspeed <= 0)
+		return;
+	accelspeed = sv_accelerate.value*pm->frametime*wishspeed;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	for (i=0 ; i<3 ; i++)
+		pm->v->velocity[i] += accelspeed*wishdir[i];
+}
+
+static void PM_AirAccelerate (pmove_t *pm, vec3_t wishveloc, float wishspeed)
+{
+	int			i;
+	float		addspeed, wishspd, accelspeed, currentspeed;
+
+	wishspd = VectorNormalize (wishveloc);
+	if (wishspd > 30)
+		wishspd = 30;
+	currentspeed = DotProduct (pm->v->velocity, wishveloc);
+	addspeed = wishspd - currentspeed;
+	if (addspeed <= 0)
+		return;
+	accelspeed = sv_accelerate.value*wishspeed * pm->frametime;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	for (i=0 ; i<3 ; i++)
+		pm->v->velocity[i] += accelspeed*wishveloc[i];
+}
+
+/*
+===================
+PM_WaterMove
+
+===================
+*/
+void PM_WaterMove (pmove_t *pm)
+{
+	entvars_t	*v;
+	int		i;
+	vec3_t	wishvel, forward, right, up;
+	float	speed, newspeed, wishspeed, addspeed, accelspeed;
+
+	v = pm->v;
+
+//
+// user intentions
+//
+	AngleVectors (v->v_angle, forward, right, up);
+
+	for (i=0 ; i<3 ; i++)
+		wishvel[i] = forward[i]*pm->cmd.forwardmove + right[i]*pm->cmd.sidemove;
+
+	if (!pm->cmd.forwardmove && !pm->cmd.sidemove && !pm->cmd.upmove)
+		wishvel[2] -= 60;		// drift towards bottom
+	else
+		wishvel[2] += pm->cmd.upmove;
+
+	wishspeed = Length(wishvel);
+	if (wishspeed > sv_maxspeed.value)
+	{
+		VectorScale (wishvel, sv_maxspeed.value/wishspeed, wishvel);
+		wishspeed = sv_maxspeed.value;
+	}
+	wishspeed *= 0.7;
+
+//
+// water friction
+//
+	speed = Length (v->velocity);
+	if (speed)
+	{
+		newspeed = speed - pm->frametime * speed * sv_friction.value;
+		if (newspeed < 0)
+			newspeed = 0;
+		VectorScale (v->velocity, newspeed/speed, v->velocity);
+	}
+	else
+		newspeed = 0;
+
+//
+// water acceleration
+//
+	if (!wishspeed)
+		return;
+
+	addspeed = wishspeed - newspeed;
+	if (addspeed <= 0)
+		return;
+
+	VectorNormalize (wishvel);
+	accelspeed = sv_accelerate.value * wishspeed * pm->frametime;
+	if (accelspeed > addspeed)
+		accelspeed = addspeed;
+
+	for (i=0 ; i<3 ; i++)
+		v->velocity[i] += accelspeed * wishvel[i];
+}
+
+/*
+===================
+PM_AirMove
+
+===================
+*/
+void PM_AirMove (pmove_t *pm)
+{
+	entvars_t	*v;
+	int			i;
+	vec3_t		wishvel, wishdir, forward, right, up;
+	float		wishspeed;
+	float		fmove, smove;
+
+	v = pm->v;
+	AngleVectors (v->angles, forward, right, up);
+
+	fmove = pm->cmd.forwardmove;
+	smove = pm->cmd.sidemove;
+
+// hack to not let you back into teleporter
+	if (pm->time < v->teleport_time && fmove < 0)
+		fmove = 0;
+
+	for (i=0 ; i<3 ; i++)
+		wishvel[i] = forward[i]*fmove + right[i]*smove;
+
+	if ( (int)v->movetype != MOVETYPE_WALK)
+		wishvel[2] = pm->cmd.upmove;
+	else
+		wishvel[2] = 0;
+
+	VectorCopy (wishvel, wishdir);
+	wishspeed = VectorNormalize(wishdir);
+	if (wishspeed > sv_maxspeed.value)
+	{
+		VectorScale (wishvel, sv_maxspeed.value/wishspeed, wishvel);
+		wishspeed = sv_maxspeed.value;
+	}
+
+	if ( v->movetype == MOVETYPE_NOCLIP)
+	{	// noclip
+		VectorCopy (wishvel, v->velocity);
+	}
+	else if ( (int)v->flags & FL_ONGROUND )
+	{
+		PM_Friction (pm);
+		PM_Accelerate (pm, wishdir, wishspeed);
+	}
+	else
+	{	// not on ground, so little effect on velocity
+		PM_AirAccelerate (pm, wishvel, wishspeed);
+	}
+}
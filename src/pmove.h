@@ -0,0 +1,58 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// pmove.h -- player movement shared by the server and client prediction
+
+typedef struct pmove_s
+{
+	entvars_t	*v;				// the edict fields, or the client's copy of them
+	usercmd_t	cmd;
+	double		frametime;
+	double		time;			// compared with v->teleport_time
+	edict_t		*ent;			// the mover on the server, NULL when predicting
+
+// traces a box or a point through everything the mover clips against,
+// trace.ent is set to something with the right solid type whenever it hits
+	trace_t		(*trace) (struct pmove_s *pm, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type);
+	int			(*pointcontents) (vec3_t p);
+
+// moves v->origin by push without changing the velocity, SV_PushEntity
+	trace_t		(*push) (struct pmove_s *pm, vec3_t push);
+
+// optional, v->flags already has FL_ONGROUND when ground is called
+	void		(*ground) (struct pmove_s *pm, edict_t *ground);
+	qboolean	(*impact) (struct pmove_s *pm, edict_t *other);	// false if the mover was removed
+} pmove_t;
+
+int PM_FlyMove (pmove_t *pm, float time, trace_t *steptrace);
+// slides v along everything it hits, returns the blocked flags
+// (1 = floor, 2 = wall / step, 4 = dead stop)
+
+void PM_WalkMove (pmove_t *pm);
+// PM_FlyMove with stepping up stairs, only used by players
+
+qboolean PM_CheckWater (pmove_t *pm);
+// sets v->waterlevel and v->watertype, true when the mover is swimming
+
+void PM_WaterMove (pmove_t *pm);
+void PM_AirMove (pmove_t *pm);
+// change v->velocity by pm->cmd, with friction and acceleration
+
+void SV_InitMove (pmove_t *pm, edict_t *ent);
+// sets up pm to move ent through the server world for a frame, sv_phys.c
@@ -471,7 +471,7 @@ void PF_random (void)
 {
 	float		num;
 		
-	num = (rand ()&0x7fff) / ((float)0x7fff);
+	num = SV_Random () / ((float)0x7fff);
 	
 	G_FLOAT(OFS_RETURN) = num;
 }
@@ -36,6 +36,9 @@ typedef struct edict_s
 {
 	qboolean	free;
 	link_t		area;				// linked to a division node or leaf
+	struct areanode_s	*areanode;	// the node area is linked into
+	qboolean	areapassive;		// linked as SOLID_NOT, not counted in the node
+	qboolean	areasolid;			// linked into a solid list, where moves see it
 	
 	int			num_leafs;
 	short		leafnums[MAX_ENT_LEAFS];
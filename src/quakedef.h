@@ -218,6 +218,7 @@ typedef struct
 
 #include "input.h"
 #include "world.h"
+#include "pmove.h"
 #include "keys.h"
 #include "console.h"
 #include "view.h"
@@ -255,11 +256,14 @@ extern qboolean noclip_anglehack;
 extern	quakeparms_t host_parms;
 
 extern	cvar_t		sys_ticrate;
+extern	cvar_t		host_tickrate;
 extern	cvar_t		sys_nostdout;
 extern	cvar_t		developer;
 
 extern	qboolean	host_initialized;		// true if into command execution
 extern	double		host_frametime;
+extern	double		host_tickfrac;		// fraction of a fixed server tick left over
+extern	double		host_tickaccum;		// server time owed, less than one tick
 extern	byte		*host_basepal;
 extern	byte		*host_colormap;
 extern	int			host_framecount;	// incremented every frame, never reset
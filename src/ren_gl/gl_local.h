@@ -29,15 +29,12 @@ struct Camera
     }
 };
 
-// particle interface to quake
-void R_InitParticles ();
-void R_ClearParticles();
+// particle interface to quake, the rest is in part.h
 void R_DrawParticles (const Camera& camera);
 
 // particle interface to GL backend
-struct particle_s;
 void GL_StartParticles ();
-void GL_DrawParticle (particle_s* pparticle);
+void GL_DrawParticle (float x, float y, float z, int color);
 void GL_EndParticles (const Camera& camera);
 
 // setup for 2D
@@ -8,6 +8,7 @@
 extern "C"
 {
 #include "quakedef.h"
+#include "part.h"
 
 refdef_t r_refdef;
 vec3_t	r_origin, vpn, vright, vup;
@@ -143,12 +144,10 @@ void GL_StartParticles ()
     }
 }
 
-void GL_DrawParticle (particle_s* pparticle)
+void GL_DrawParticle (float x, float y, float z, int color)
 {
-    activeParticles.emplace_back(ParticleVertex{{
-            pparticle->org[0], pparticle->org[2], -pparticle->org[1]
-        },
-        vid_current_palette[uint8_t(pparticle->color)]});
+    activeParticles.emplace_back(ParticleVertex{{x, z, -y},
+        vid_current_palette[uint8_t(color)]});
 }
 
 void GL_EndParticles (const Camera& camera)
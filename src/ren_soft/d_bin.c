@@ -0,0 +1,379 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// d_bin.c: alias models and particles drawn in parallel screen bands
+
+#include "quakedef.h"
+#include "r_local.h"
+#include "d_local.h"
+#include "job.h"
+
+//
+// With d_binned set, D_PolysetDraw, D_PolysetDrawFinalVerts and
+// D_DrawParticle don't draw; they copy what they were asked to draw into the
+// bin buffer.  When the buffer fills, before a sprite is drawn, and after the
+// particles, the screen is cut into bands of rows and the worker threads each
+// take bands, setting up and drawing every binned triangle and particle that
+// reaches into the band, in the order they were binned.  A band only writes
+// its own rows of the view and z buffers, and each of its pixels sees the
+// same z tests in the same order as when drawing straight away, so the
+// picture is the same.
+//
+
+cvar_t	d_binned = {"d_binned", "0"};
+
+#define	BIN_BYTES		(256*1024)
+#define	BIN_BANDSPERTHREAD	4
+#define	BIN_MINBANDHEIGHT	8
+
+enum {BIN_POLYSET, BIN_FINALVERTS, BIN_PARTICLE};
+
+typedef struct
+{
+	int		type;
+	int		size;			// bytes, including this header
+	int		top, bottom;	// rows the command can draw, inclusive
+} bincmd_t;
+
+typedef struct
+{
+	bincmd_t		cmd;
+	affinetridesc_t	desc;
+	void			*colormap;
+	int				numverts;
+	qboolean		copiedtri;	// a single triangle, moved to follow the verts
+} binpolyset_t;
+
+typedef struct
+{
+	bincmd_t	cmd;
+	int			u, v, izi, pix, color;
+} binparticle_t;
+
+qboolean		d_binning;		// drawing functions bin instead of draw
+
+static byte		*bin_buffer;
+static int		bin_used;
+static int		bin_bandheight;
+
+static int		bin_flushes;
+static int		bin_commands;
+
+
+/*
+==============
+D_AllocBins
+
+Called by R_NewMap
+==============
+*/
+void D_AllocBins (void)
+{
+	bin_buffer = Hunk_AllocName (BIN_BYTES, "bins");
+	bin_used = 0;
+}
+
+
+/*
+==============
+D_BinAlloc
+
+Room for a command, drawing what is already binned if it is full
+==============
+*/
+static bincmd_t *D_BinAlloc (int type, int size)
+{
+	bincmd_t	*cmd;
+
+	size = (size + 7) & ~7;
+	if (size > BIN_BYTES)
+		Sys_Error ("D_BinAlloc: %i byte command", size);
+
+	if (bin_used + size > BIN_BYTES)
+		D_FlushBins ();
+
+	cmd = (bincmd_t *)(bin_buffer + bin_used);
+	bin_used += size;
+	bin_commands++;
+
+	cmd->type = type;
+	cmd->size = size;
+	return cmd;
+}
+
+
+/*
+==============
+D_BinPolyset
+
+Called by D_PolysetDraw in place of drawing
+==============
+*/
+void D_BinPolyset (void)
+{
+	int				i, numverts;
+	binpolyset_t	*p;
+	finalvert_t		*fv;
+	mtriangle_t		*ptri;
+
+// the models' own triangles stay where they are, but a single triangle is
+// usually one R_AliasClipTriangle built on the stack
+	ptri = r_affinetridesc.ptriangles;
+	if (r_affinetridesc.numtriangles == 1)
+	{
+		numverts = 3;
+		p = (binpolyset_t *)D_BinAlloc (BIN_POLYSET, sizeof(binpolyset_t)
+				+ 3*sizeof(finalvert_t) + sizeof(mtriangle_t));
+		fv = (finalvert_t *)(p + 1);
+		for (i=0 ; i<3 ; i++)
+			fv[i] = r_affinetridesc.pfinalverts[ptri->vertindex[i]];
+		ptri = (mtriangle_t *)(fv + 3);
+		ptri->facesfront = r_affinetridesc.ptriangles->facesfront;
+		ptri->vertindex[0] = 0;
+		ptri->vertindex[1] = 1;
+		ptri->vertindex[2] = 2;
+		p->copiedtri = true;
+	}
+	else
+	{
+		numverts = 0;
+		for (i=0 ; i<r_affinetridesc.numtriangles ; i++)
+		{
+			if (ptri[i].vertindex[0] >= numverts)
+				numverts = ptri[i].vertindex[0] + 1;
+			if (ptri[i].vertindex[1] >= numverts)
+				numverts = ptri[i].vertindex[1] + 1;
+			if (ptri[i].vertindex[2] >= numverts)
+				numverts = ptri[i].vertindex[2] + 1;
+		}
+		p = (binpolyset_t *)D_BinAlloc (BIN_POLYSET, sizeof(binpolyset_t)
+				+ numverts*sizeof(finalvert_t));
+		fv = (finalvert_t *)(p + 1);
+		memcpy (fv, r_affinetridesc.pfinalverts, numverts*sizeof(finalvert_t));
+		p->copiedtri = false;
+	}
+
+	p->desc = r_affinetridesc;
+	p->colormap = acolormap;
+	p->numverts = numverts;
+
+	p->cmd.top = MAXHEIGHT;
+	p->cmd.bottom = -1;
+	for (i=0 ; i<numverts ; i++)
+	{
+		if (fv[i].v[1] < p->cmd.top)
+			p->cmd.top = fv[i].v[1];
+		if (fv[i].v[1] > p->cmd.bottom)
+			p->cmd.bottom = fv[i].v[1];
+	}
+}
+
+
+/*
+==============
+D_BinFinalVerts
+
+Called by D_PolysetDrawFinalVerts in place of drawing
+==============
+*/
+void D_BinFinalVerts (finalvert_t *fv, int numverts)
+{
+	int				i;
+	binpolyset_t	*p;
+	finalvert_t		*out;
+
+	p = (binpolyset_t *)D_BinAlloc (BIN_FINALVERTS, sizeof(binpolyset_t)
+			+ numverts*sizeof(finalvert_t));
+	out = (finalvert_t *)(p + 1);
+	memcpy (out, fv, numverts*sizeof(finalvert_t));
+
+	p->desc = r_affinetridesc;
+	p->colormap = acolormap;
+	p->numverts = numverts;
+	p->copiedtri = false;
+
+	p->cmd.top = MAXHEIGHT;
+	p->cmd.bottom = -1;
+	for (i=0 ; i<numverts ; i++)
+	{
+		if (out[i].v[1] < p->cmd.top)
+			p->cmd.top = out[i].v[1];
+		if (out[i].v[1] > p->cmd.bottom)
+			p->cmd.bottom = out[i].v[1];
+	}
+}
+
+
+/*
+==============
+D_BinParticle
+
+Called by D_DrawParticle in place of drawing
+==============
+*/
+void D_BinParticle (int u, int v, int izi, int pix, int color)
+{
+	binparticle_t	*p;
+
+	p = (binparticle_t *)D_BinAlloc (BIN_PARTICLE, sizeof(binparticle_t));
+	p->u = u;
+	p->v = v;
+	p->izi = izi;
+	p->pix = pix;
+	p->color = color;
+
+	p->cmd.top = v;
+	p->cmd.bottom = v + (pix << d_y_aspect_shift) - 1;
+}
+
+
+/*
+==============
+D_DrawBand
+
+Draws everything binned that reaches into one band of rows
+==============
+*/
+static void D_DrawBand (int band, void *arg)
+{
+	bincmd_t		*cmd, *end;
+	binpolyset_t	*p;
+	binparticle_t	*part;
+	finalvert_t		*fv;
+
+	d_bandtop = band * bin_bandheight;
+	d_bandbottom = d_bandtop + bin_bandheight;
+
+	end = (bincmd_t *)(bin_buffer + bin_used);
+	for (cmd = (bincmd_t *)bin_buffer ; cmd < end ; cmd = (bincmd_t *)((byte *)cmd + cmd->size))
+	{
+		if (cmd->bottom < d_bandtop || cmd->top >= d_bandbottom)
+			continue;
+
+		switch (cmd->type)
+		{
+		case BIN_POLYSET:
+		case BIN_FINALVERTS:
+			p = (binpolyset_t *)cmd;
+			fv = (finalvert_t *)(p + 1);
+
+			r_affinetridesc = p->desc;
+			acolormap = p->colormap;
+			if (r_affinetridesc.drawtype)
+				D_PolysetUpdateTables ();
+
+			if (cmd->type == BIN_FINALVERTS)
+			{
+				D_PolysetDrawFinalVerts (fv, p->numverts);
+				break;
+			}
+
+			r_affinetridesc.pfinalverts = fv;
+			if (p->copiedtri)
+				r_affinetridesc.ptriangles = (mtriangle_t *)(fv + p->numverts);
+			D_PolysetDraw ();
+			break;
+
+		case BIN_PARTICLE:
+			part = (binparticle_t *)cmd;
+			D_DrawParticleRows (part->u, part->v, part->izi, part->pix, part->color);
+			break;
+		}
+	}
+}
+
+
+/*
+==============
+D_FlushBins
+
+Draws and empties the bins
+==============
+*/
+void D_FlushBins (void)
+{
+	int				numbands;
+	affinetridesc_t	savedesc;
+	void			*savecolormap;
+
+	if (!bin_used)
+		return;
+
+	bin_flushes++;
+
+	numbands = Job_Threads () * BIN_BANDSPERTHREAD;
+	bin_bandheight = (vid.height + numbands - 1) / numbands;
+	if (bin_bandheight < BIN_MINBANDHEIGHT)
+		bin_bandheight = BIN_MINBANDHEIGHT;
+	numbands = (vid.height + bin_bandheight - 1) / bin_bandheight;
+
+// the main thread draws bands too, and the model being set up may still be
+// using its descriptor
+	savedesc = r_affinetridesc;
+	savecolormap = acolormap;
+
+	d_binning = false;
+	Job_ParallelFor (numbands, 1, D_DrawBand, NULL);
+	d_binning = true;
+
+	d_bandtop = 0;
+	d_bandbottom = MAXHEIGHT;
+	r_affinetridesc = savedesc;
+	acolormap = savecolormap;
+	if (r_affinetridesc.drawtype)
+		D_PolysetUpdateTables ();
+
+	bin_used = 0;
+}
+
+
+/*
+==============
+D_BeginBins
+
+Called before the entities are drawn
+==============
+*/
+void D_BeginBins (void)
+{
+	bin_used = 0;
+	bin_flushes = 0;
+	bin_commands = 0;
+	d_binning = d_binned.value && bin_buffer;
+}
+
+
+/*
+==============
+D_EndBins
+
+Called after the particles are drawn
+==============
+*/
+void D_EndBins (void)
+{
+	if (!d_binning)
+		return;
+
+	D_FlushBins ();
+	d_binning = false;
+
+	if (d_binned.value > 1)
+		Con_Printf ("%i binned, %i flushes\n", bin_commands, bin_flushes);
+}
@@ -26,7 +26,6 @@ static int	miplevel;
 
 float		scale_for_mip;
 int			screenwidth;
-int			ubasestep, errorterm, erroradjustup, erroradjustdown;
 int			vstartscan;
 
 // FIXME: should go away
@@ -82,9 +81,23 @@ D_DrawSolidSurface
 
 void D_DrawSolidSurface (surf_t *surf, int color)
 {
-	espan_t	*span;
-	byte	*pdest;
-	int		u, u2, pix;
+	espan_t		*span;
+	byte		*pdest;
+	unsigned	*pdest32;
+	int			u, u2, pix;
+
+	if (r_pixbytes == 4)
+	{
+		pix = d_8to24table[color];
+		for (span=surf->spans ; span ; span=span->pnext)
+		{
+			pdest32 = (unsigned *)d_viewbuffer + screenwidth*span->v;
+			u2 = span->u + span->count;
+			for (u=span->u ; u<u2 ; u++)
+				pdest32[u] = pix;
+		}
+		return;
+	}
 
 	pix = (color<<24) | (color<<16) | (color<<8) | color;
 	for (span=surf->spans ; span ; span=span->pnext)
@@ -219,7 +232,7 @@ void D_DrawSurfaces (void)
 					R_MakeSky ();
 				}
 
-				D_DrawSkyScans8 (s->spans);
+				(*d_drawskyscans) (s->spans);
 				D_DrawZSpans (s->spans);
 			}
 			else if (s->flags & SURF_DRAWBACKGROUND)
@@ -257,7 +270,7 @@ void D_DrawSurfaces (void)
 				}
 
 				D_CalcGradients (pface);
-				Turbulent8 (s->spans);
+				(*d_drawturbulent) (s->spans);
 				D_DrawZSpans (s->spans);
 
 				if (s->insubmodel)
@@ -296,15 +309,23 @@ void D_DrawSurfaces (void)
 				miplevel = D_MipLevelForScale (s->nearzi * scale_for_mip
 				* pface->texinfo->mipadjust);
 
-			// FIXME: make this passed in to D_CacheSurface
-				pcurrentcache = D_CacheSurface (pface, miplevel);
+				if (d_directspans.value && D_LightSurface (pface, miplevel))
+				{
+					D_CalcGradients (pface);
+					D_DrawLitSpans8 (s->spans);
+				}
+				else
+				{
+				// FIXME: make this passed in to D_CacheSurface
+					pcurrentcache = D_CacheSurface (pface, miplevel);
 
-				cacheblock = (pixel_t *)pcurrentcache->data;
-				cachewidth = pcurrentcache->width;
+					cacheblock = (pixel_t *)pcurrentcache->data;
+					cachewidth = pcurrentcache->width;
 
-				D_CalcGradients (pface);
+					D_CalcGradients (pface);
 
-				(*d_drawspans) (s->spans);
+					(*d_drawspans) (s->spans);
+				}
 
 				D_DrawZSpans (s->spans);
 
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // d_clear: clears a specified rectangle to the specified color
 
 #include "quakedef.h"
+#include "d_local.h"
 
 
 /*
@@ -56,6 +57,18 @@ void D_FillRect (vrect_t *rect, int color)
 	if (rwidth < 1 || rheight < 1)
 		return;
 
+	if (r_pixbytes != 1)
+	{
+		ldest = (unsigned *)((byte *)vid.buffer + ry*vid.rowbytes) + rx;
+		for (ry=0 ; ry<rheight ; ry++)
+		{
+			for (rx=0 ; rx<rwidth ; rx++)
+				ldest[rx] = d_8to24table[color];
+			ldest = (unsigned *)((byte*)ldest + vid.rowbytes);
+		}
+		return;
+	}
+
 	dest = ((byte *)vid.buffer + ry*vid.rowbytes + rx);
 
 	if (((rwidth & 0x03) == 0) && (((intptr_t)dest & 0x03) == 0))
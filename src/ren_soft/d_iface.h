@@ -32,14 +32,11 @@ typedef enum {
 	pt_static, pt_grav, pt_slowgrav, pt_fire, pt_explode, pt_explode2, pt_blob, pt_blob2
 } ptype_t;
 
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
+// a particle being spawned, the live ones are kept in part.c
 typedef struct particle_s
 {
-// driver-usable fields
 	vec3_t		org;
 	float		color;
-// drivers never touch the following fields
-	struct particle_s	*next;
 	vec3_t		vel;
 	float		ramp;
 	float		die;
@@ -125,7 +122,7 @@ extern float	r_aliasuvscale;		// scale-up factor for screen u and v
 									//  on Alias vertices passed to driver
 extern qboolean	r_dowarp;
 
-extern affinetridesc_t	r_affinetridesc;
+extern THREADLOCAL affinetridesc_t	r_affinetridesc;
 extern spritedesc_t		r_spritedesc;
 extern zpointdesc_t		r_zpointdesc;
 extern polydesc_t		r_polydesc;
@@ -143,7 +140,7 @@ void D_BeginDirectRect (int x, int y, byte *pbitmap, int width, int height);
 void D_EndDirectRect (int x, int y, int width, int height);
 void D_PolysetDraw (void);
 void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts);
-void D_DrawParticle (particle_t *pparticle);
+void D_DrawParticle (vec3_t org, int color);
 void D_DrawPoly (void);
 void D_DrawSprite (void);
 void D_DrawSurfaces (void);
@@ -159,6 +156,15 @@ void D_WarpScreen (void);
 void D_FillRect (vrect_t *vrect, int color);
 void D_DrawRect (void);
 
+// alias models and particles drawn in parallel screen bands when d_binned
+// is set; bins are filled between D_BeginBins and D_EndBins
+extern qboolean	d_binning;
+
+void D_AllocBins (void);
+void D_BeginBins (void);
+void D_EndBins (void);
+void D_FlushBins (void);
+
 // currently for internal use only, and should be a do-nothing function in
 // hardware drivers
 // FIXME: this should go away
@@ -175,7 +181,7 @@ extern byte				*r_skysource;
 // !!! must be kept the same as in quakeasm.h !!!
 #define TRANSPARENT_COLOR	0xFF
 
-extern void *acolormap;	// FIXME: should go away
+extern THREADLOCAL void *acolormap;	// FIXME: should go away
 
 //=======================================================================//
 
@@ -197,6 +203,8 @@ typedef struct
 extern drawsurf_t	r_drawsurf;
 
 void R_DrawSurface (void);
+void R_BuildLightMap (void);	// into blocklights, for r_drawsurf.surf
+extern unsigned	blocklights[18*18];
 void R_GenTile (msurface_t *psurf, void *pdest);
 
 
@@ -27,6 +27,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 cvar_t	d_subdiv16 = {"d_subdiv16", "1"};
 cvar_t	d_mipcap = {"d_mipcap", "0"};
 cvar_t	d_mipscale = {"d_mipscale", "1"};
+cvar_t	d_directspans = {"d_directspans", "0"};
 
 surfcache_t		*d_initial_rover;
 qboolean		d_roverwrapped;
@@ -38,6 +39,8 @@ static float	basemip[NUM_MIPS-1] = {1.0, 0.5*0.8, 0.25*0.8};
 extern int			d_aflatcolor;
 
 void (*d_drawspans) (espan_t *pspan);
+void (*d_drawturbulent) (espan_t *pspan);
+void (*d_drawskyscans) (espan_t *pspan);
 
 
 /*
@@ -53,6 +56,12 @@ void D_Init (void)
 	Cvar_RegisterVariable (&d_subdiv16);
 	Cvar_RegisterVariable (&d_mipcap);
 	Cvar_RegisterVariable (&d_mipscale);
+	Cvar_RegisterVariable (&d_binned);
+	Cvar_RegisterVariable (&d_directspans);
+
+	Cmd_AddCommand ("d_spanbench", D_SpanBench_f);
+	Cmd_AddCommand ("d_warpbench", D_WarpBench_f);
+	Cmd_AddCommand ("d_directbench", D_DirectBench_f);
 
 	r_drawpolys = false;
 	r_worldpolysbacktofront = false;
@@ -103,7 +112,9 @@ void D_SetupFrame (void)
 	else
 		d_viewbuffer = (void *)(byte *)vid.buffer;
 
-	screenwidth = vid.rowbytes;
+	screenwidth = vid.rowbytes / r_pixbytes;
+
+	D_SkySetupFrame ();
 
 	d_roverwrapped = false;
 	d_initial_rover = sc_rover;
@@ -117,7 +128,18 @@ void D_SetupFrame (void)
 	for (i=0 ; i<(NUM_MIPS-1) ; i++)
 		d_scalemip[i] = basemip[i] * d_mipscale.value;
 
-	d_drawspans = D_DrawSpans8;
+	if (r_pixbytes == 1)
+	{
+		d_drawspans = D_DrawSpans8;
+		d_drawturbulent = Turbulent8;
+		d_drawskyscans = D_DrawSkyScans8;
+	}
+	else
+	{
+		d_drawspans = D_DrawSpans32;
+		d_drawturbulent = Turbulent32;
+		d_drawskyscans = D_DrawSkyScans32;
+	}
 
 	d_aflatcolor = 0;
 }
@@ -55,6 +55,8 @@ typedef struct sspan_s
 } sspan_t;
 
 extern cvar_t	d_subdiv16;
+extern cvar_t	d_binned;
+extern cvar_t	d_directspans;
 
 extern float	scale_for_mip;
 
@@ -72,16 +74,39 @@ extern fixed16_t	bbextents, bbextentt;
 
 void D_DrawSpans8 (espan_t *pspans);
 void D_DrawSpans16 (espan_t *pspans);
+void D_DrawSpans32 (espan_t *pspans);
 void D_DrawZSpans (espan_t *pspans);
+void D_DrawLitSpans8 (espan_t *pspans);
+void D_DrawParticleRows (int u, int v, int izi, int pix, int color);
+
+void D_BinPolyset (void);
+void D_BinFinalVerts (finalvert_t *fv, int numverts);
+void D_BinParticle (int u, int v, int izi, int pix, int color);
+
+extern THREADLOCAL int	d_bandtop, d_bandbottom;
+void D_SpanBench_f (void);
+void D_WarpBench_f (void);
+void D_DirectBench_f (void);
 void Turbulent8 (espan_t *pspan);
+void Turbulent32 (espan_t *pspan);
 void D_SpriteDrawSpans (sspan_t *pspan);
+void D_SpriteDrawSpans32 (sspan_t *pspan);
 
 void D_DrawSkyScans8 (espan_t *pspan);
 void D_DrawSkyScans16 (espan_t *pspan);
+void D_DrawSkyScans32 (espan_t *pspan);
+void D_SkySetupFrame (void);
 
 void R_ShowSubDiv (void);
 void (*prealspandrawer)(void);
 surfcache_t	*D_CacheSurface (msurface_t *surface, int miplevel);
+qboolean	D_LightSurface (msurface_t *surface, int miplevel);
+
+// D_DrawLitSpans8 state, set by D_LightSurface
+extern byte	*d_littexture;
+extern int	d_litsmask, d_littmask, d_litwidthshift;
+extern int	d_litsoffset, d_littoffset;		// texturemins, in texels
+extern int	d_litlightwidth, d_litlightshift, d_litlighthalf;
 
 extern int D_MipLevelForScale (float scale);
 
@@ -103,4 +128,6 @@ extern int		d_minmip;
 extern float	d_scalemip[3];
 
 extern void (*d_drawspans) (espan_t *pspan);
+extern void (*d_drawturbulent) (espan_t *pspan);
+extern void (*d_drawskyscans) (espan_t *pspan);
 
@@ -38,7 +38,7 @@ void D_ViewChanged (void)
 {
 	int rowbytes;
 
-	rowbytes = vid.rowbytes;
+	rowbytes = vid.rowbytes / r_pixbytes;	// d_scantable is in pixels
 
 	scale_for_mip = xscale;
 	if (yscale > xscale)
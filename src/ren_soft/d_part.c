@@ -50,16 +50,14 @@ void D_StartParticles (void)
 D_DrawParticle
 ==============
 */
-void D_DrawParticle (particle_t *pparticle)
+void D_DrawParticle (vec3_t org, int color)
 {
 	vec3_t	local, transformed;
 	float	zi;
-	byte	*pdest;
-	short	*pz;
-	int		i, izi, pix, count, u, v;
+	int		izi, pix, u, v;
 
 // transform point
-	VectorSubtract (pparticle->org, r_origin, local);
+	VectorSubtract (org, r_origin, local);
 
 	transformed[0] = DotProduct(local, r_pright);
 	transformed[1] = DotProduct(local, r_pup);
@@ -82,8 +80,6 @@ void D_DrawParticle (particle_t *pparticle)
 		return;
 	}
 
-	pz = d_pzbuffer + (d_zwidth * v) + u;
-	pdest = d_viewbuffer + d_scantable[v] + u;
 	izi = (int)(zi * 0x8000);
 
 	pix = izi >> d_pix_shift;
@@ -93,99 +89,144 @@ void D_DrawParticle (particle_t *pparticle)
 	else if (pix > d_pix_max)
 		pix = d_pix_max;
 
+	if (d_binning)
+		D_BinParticle (u, v, izi, pix, color);
+	else
+		D_DrawParticleRows (u, v, izi, pix, color);
+}
+
+
+/*
+==============
+D_DrawParticleRows
+
+Draws the square of a projected particle that falls in this thread's band
+==============
+*/
+void D_DrawParticleRows (int u, int v, int izi, int pix, int color)
+{
+	byte	*pdest;
+	short	*pz;
+	int		i, count;
+
+	count = pix << d_y_aspect_shift;
+	if (v < d_bandtop)
+	{
+		count -= d_bandtop - v;
+		v = d_bandtop;
+	}
+	if (v + count > d_bandbottom)
+		count = d_bandbottom - v;
+	if (count <= 0)
+		return;
+
+	pz = d_pzbuffer + (d_zwidth * v) + u;
+
+	if (r_pixbytes != 1)
+	{
+		unsigned	*pdest32, color32;
+
+		pdest32 = (unsigned *)d_viewbuffer + d_scantable[v] + u;
+		color32 = d_8to24table[color];
+		for ( ; count ; count--, pz += d_zwidth, pdest32 += screenwidth)
+		{
+			for (i=0 ; i<pix ; i++)
+			{
+				if (pz[i] <= izi)
+				{
+					pz[i] = izi;
+					pdest32[i] = color32;
+				}
+			}
+		}
+		return;
+	}
+
+	pdest = d_viewbuffer + d_scantable[v] + u;
+
 	switch (pix)
 	{
 	case 1:
-		count = 1 << d_y_aspect_shift;
-
 		for ( ; count ; count--, pz += d_zwidth, pdest += screenwidth)
 		{
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 		}
 		break;
 
 	case 2:
-		count = 2 << d_y_aspect_shift;
-
 		for ( ; count ; count--, pz += d_zwidth, pdest += screenwidth)
 		{
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 
 			if (pz[1] <= izi)
 			{
 				pz[1] = izi;
-				pdest[1] = pparticle->color;
+				pdest[1] = color;
 			}
 		}
 		break;
 
 	case 3:
-		count = 3 << d_y_aspect_shift;
-
 		for ( ; count ; count--, pz += d_zwidth, pdest += screenwidth)
 		{
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 
 			if (pz[1] <= izi)
 			{
 				pz[1] = izi;
-				pdest[1] = pparticle->color;
+				pdest[1] = color;
 			}
 
 			if (pz[2] <= izi)
 			{
 				pz[2] = izi;
-				pdest[2] = pparticle->color;
+				pdest[2] = color;
 			}
 		}
 		break;
 
 	case 4:
-		count = 4 << d_y_aspect_shift;
-
 		for ( ; count ; count--, pz += d_zwidth, pdest += screenwidth)
 		{
 			if (pz[0] <= izi)
 			{
 				pz[0] = izi;
-				pdest[0] = pparticle->color;
+				pdest[0] = color;
 			}
 
 			if (pz[1] <= izi)
 			{
 				pz[1] = izi;
-				pdest[1] = pparticle->color;
+				pdest[1] = color;
 			}
 
 			if (pz[2] <= izi)
 			{
 				pz[2] = izi;
-				pdest[2] = pparticle->color;
+				pdest[2] = color;
 			}
 
 			if (pz[3] <= izi)
 			{
 				pz[3] = izi;
-				pdest[3] = pparticle->color;
+				pdest[3] = color;
 			}
 		}
 		break;
 
 	default:
-		count = pix << d_y_aspect_shift;
-
 		for ( ; count ; count--, pz += d_zwidth, pdest += screenwidth)
 		{
 			for (i=0 ; i<pix ; i++)
@@ -193,7 +234,7 @@ void D_DrawParticle (particle_t *pparticle)
 				if (pz[i] <= izi)
 				{
 					pz[i] = izi;
-					pdest[i] = pparticle->color;
+					pdest[i] = color;
 				}
 			}
 		}
@@ -38,60 +38,70 @@ typedef struct {
 	int				sfrac, tfrac, light, zi;
 } spanpackage_t;
 
+// the vertices are numbered 0 to 2 for r_p0 to r_p2, -1 for none, because
+// the r_p arrays are per thread
 typedef struct {
 	int		isflattop;
 	int		numleftedges;
-	int		*pleftedgevert0;
-	int		*pleftedgevert1;
-	int		*pleftedgevert2;
+	int		leftedgevert0;
+	int		leftedgevert1;
+	int		leftedgevert2;
 	int		numrightedges;
-	int		*prightedgevert0;
-	int		*prightedgevert1;
-	int		*prightedgevert2;
+	int		rightedgevert0;
+	int		rightedgevert1;
+	int		rightedgevert2;
 } edgetable;
 
-int	r_p0[6], r_p1[6], r_p2[6];
+// everything the rasterizer changes is per thread, so screen bands can be
+// drawn at the same time (see d_bin.c)
+THREADLOCAL int	r_p0[6], r_p1[6], r_p2[6];
 
-byte		*d_pcolormap;
+THREADLOCAL byte	*d_pcolormap;
 
-int			d_aflatcolor;
-int			d_xdenom;
+THREADLOCAL int		d_aflatcolor;
+THREADLOCAL int		d_xdenom;
 
-edgetable	*pedgetable;
+THREADLOCAL edgetable	*pedgetable;
 
 edgetable	edgetables[12] = {
-	{0, 1, r_p0, r_p2, NULL, 2, r_p0, r_p1, r_p2 },
-	{0, 2, r_p1, r_p0, r_p2,   1, r_p1, r_p2, NULL},
-	{1, 1, r_p0, r_p2, NULL, 1, r_p1, r_p2, NULL},
-	{0, 1, r_p1, r_p0, NULL, 2, r_p1, r_p2, r_p0 },
-	{0, 2, r_p0, r_p2, r_p1,   1, r_p0, r_p1, NULL},
-	{0, 1, r_p2, r_p1, NULL, 1, r_p2, r_p0, NULL},
-	{0, 1, r_p2, r_p1, NULL, 2, r_p2, r_p0, r_p1 },
-	{0, 2, r_p2, r_p1, r_p0,   1, r_p2, r_p0, NULL},
-	{0, 1, r_p1, r_p0, NULL, 1, r_p1, r_p2, NULL},
-	{1, 1, r_p2, r_p1, NULL, 1, r_p0, r_p1, NULL},
-	{1, 1, r_p1, r_p0, NULL, 1, r_p2, r_p0, NULL},
-	{0, 1, r_p0, r_p2, NULL, 1, r_p0, r_p1, NULL},
+	{0, 1, 0, 2, -1, 2, 0, 1, 2 },
+	{0, 2, 1, 0, 2,   1, 1, 2, -1},
+	{1, 1, 0, 2, -1, 1, 1, 2, -1},
+	{0, 1, 1, 0, -1, 2, 1, 2, 0 },
+	{0, 2, 0, 2, 1,   1, 0, 1, -1},
+	{0, 1, 2, 1, -1, 1, 2, 0, -1},
+	{0, 1, 2, 1, -1, 2, 2, 0, 1 },
+	{0, 2, 2, 1, 0,   1, 2, 0, -1},
+	{0, 1, 1, 0, -1, 1, 1, 2, -1},
+	{1, 1, 2, 1, -1, 1, 0, 1, -1},
+	{1, 1, 1, 0, -1, 1, 2, 0, -1},
+	{0, 1, 0, 2, -1, 1, 0, 1, -1},
 };
 
 // FIXME: some of these can become statics
-int				a_sstepxfrac, a_tstepxfrac, r_lstepx, a_ststepxwhole;
-int				r_sstepx, r_tstepx, r_lstepy, r_sstepy, r_tstepy;
-int				r_zistepx, r_zistepy;
-int				d_aspancount, d_countextrastep;
-
-spanpackage_t			*a_spans;
-spanpackage_t			*d_pedgespanpackage;
-static int				ystart;
-byte					*d_pdest, *d_ptex;
-short					*d_pz;
-int						d_sfrac, d_tfrac, d_light, d_zi;
-int						d_ptexextrastep, d_sfracextrastep;
-int						d_tfracextrastep, d_lightextrastep, d_pdestextrastep;
-int						d_lightbasestep, d_pdestbasestep, d_ptexbasestep;
-int						d_sfracbasestep, d_tfracbasestep;
-int						d_ziextrastep, d_zibasestep;
-int						d_pzextrastep, d_pzbasestep;
+THREADLOCAL int		a_sstepxfrac, a_tstepxfrac, r_lstepx, a_ststepxwhole;
+THREADLOCAL int		r_sstepx, r_tstepx, r_lstepy, r_sstepy, r_tstepy;
+THREADLOCAL int		r_zistepx, r_zistepy;
+THREADLOCAL int		d_aspancount, d_countextrastep;
+
+THREADLOCAL int		ubasestep, errorterm, erroradjustup, erroradjustdown;
+
+THREADLOCAL spanpackage_t	*a_spans;
+THREADLOCAL spanpackage_t	*d_pedgespanpackage;
+static THREADLOCAL int		ystart;
+THREADLOCAL byte			*d_pdest, *d_ptex;
+THREADLOCAL short			*d_pz;
+THREADLOCAL int				d_sfrac, d_tfrac, d_light, d_zi;
+THREADLOCAL int				d_ptexextrastep, d_sfracextrastep;
+THREADLOCAL int				d_tfracextrastep, d_lightextrastep, d_pdestextrastep;
+THREADLOCAL int				d_lightbasestep, d_pdestbasestep, d_ptexbasestep;
+THREADLOCAL int				d_sfracbasestep, d_tfracbasestep;
+THREADLOCAL int				d_ziextrastep, d_zibasestep;
+THREADLOCAL int				d_pzextrastep, d_pzbasestep;
+
+// rows this thread draws, all of them unless a band is being binned
+THREADLOCAL int				d_bandtop, d_bandbottom = MAXHEIGHT;
+static THREADLOCAL short	*d_bandpz0, *d_bandpz1;
 
 typedef struct {
 	int		quotient;
@@ -102,11 +112,12 @@ static adivtab_t	adivtab[32*32] = {
 #include "adivtab.h"
 };
 
-byte	*skintable[MAX_LBM_HEIGHT];
-int		skinwidth;
-byte	*skinstart;
+THREADLOCAL byte	*skintable[MAX_LBM_HEIGHT];
+THREADLOCAL int		skinwidth;
+THREADLOCAL byte	*skinstart;
 
 void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage);
+void D_PolysetDrawSpans32 (spanpackage_t *pspanpackage);
 void D_PolysetCalcGradients (int skinwidth);
 void D_DrawSubdiv (void);
 void D_DrawNonSubdiv (void);
@@ -126,9 +137,18 @@ void D_PolysetDraw (void)
 			((CACHE_SIZE - 1) / sizeof(spanpackage_t)) + 1];
 						// one extra because of cache line pretouching
 
+	if (d_binning)
+	{
+		D_BinPolyset ();
+		return;
+	}
+
 	a_spans = (spanpackage_t *)
 			(((intptr_t)&spans[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
 
+	d_bandpz0 = d_pzbuffer + d_bandtop * d_zwidth;
+	d_bandpz1 = d_pzbuffer + d_bandbottom * d_zwidth;
+
 	if (r_affinetridesc.drawtype)
 	{
 		D_DrawSubdiv ();
@@ -150,12 +170,19 @@ void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts)
 	int		i, z;
 	short	*zbuf;
 
+	if (d_binning)
+	{
+		D_BinFinalVerts (fv, numverts);
+		return;
+	}
+
 	for (i=0 ; i<numverts ; i++, fv++)
 	{
 	// valid triangle coordinates for filling can include the bottom and
 	// right clip edges, due to the fill rule; these shouldn't be drawn
 		if ((fv->v[0] < r_refdef.vrectright) &&
-			(fv->v[1] < r_refdef.vrectbottom))
+			(fv->v[1] < r_refdef.vrectbottom) &&
+			(fv->v[1] >= d_bandtop) && (fv->v[1] < d_bandbottom))
 		{
 			z = fv->v[5]>>16;
 			zbuf = zspantable[fv->v[1]] + fv->v[0];
@@ -166,13 +193,34 @@ void D_PolysetDrawFinalVerts (finalvert_t *fv, int numverts)
 				*zbuf = z;
 				pix = skintable[fv->v[3]>>16][fv->v[2]>>16];
 				pix = ((byte *)acolormap)[pix + (fv->v[4] & 0xFF00) ];
-				d_viewbuffer[d_scantable[fv->v[1]] + fv->v[0]] = pix;
+				if (r_pixbytes == 1)
+					d_viewbuffer[d_scantable[fv->v[1]] + fv->v[0]] = pix;
+				else
+					((unsigned *)d_viewbuffer)[d_scantable[fv->v[1]] + fv->v[0]] =
+							d_8to24table[pix];
 			}
 		}
 	}
 }
 
 
+/*
+================
+D_PolysetOutsideBand
+
+True if the triangle has no rows in this thread's band
+================
+*/
+static qboolean D_PolysetOutsideBand (finalvert_t *index0, finalvert_t *index1, finalvert_t *index2)
+{
+	if (index0->v[1] < d_bandtop && index1->v[1] < d_bandtop && index2->v[1] < d_bandtop)
+		return true;
+	if (index0->v[1] >= d_bandbottom && index1->v[1] >= d_bandbottom && index2->v[1] >= d_bandbottom)
+		return true;
+	return false;
+}
+
+
 /*
 ================
 D_DrawSubdiv
@@ -203,6 +251,9 @@ void D_DrawSubdiv (void)
 			continue;
 		}
 
+		if (D_PolysetOutsideBand (index0, index1, index2))
+			continue;
+
 		d_pcolormap = &((byte *)acolormap)[index0->v[4] & 0xFF00];
 
 		if (ptri[i].facesfront)
@@ -211,24 +262,21 @@ void D_DrawSubdiv (void)
 		}
 		else
 		{
-			int		s0, s1, s2;
+			int		v0[6], v1[6], v2[6];
 
-			s0 = index0->v[2];
-			s1 = index1->v[2];
-			s2 = index2->v[2];
+		// fix the seam on copies, other bands may be reading the vertices
+			memcpy (v0, index0->v, sizeof(v0));
+			memcpy (v1, index1->v, sizeof(v1));
+			memcpy (v2, index2->v, sizeof(v2));
 
 			if (index0->flags & ALIAS_ONSEAM)
-				index0->v[2] += r_affinetridesc.seamfixupX16;
+				v0[2] += r_affinetridesc.seamfixupX16;
 			if (index1->flags & ALIAS_ONSEAM)
-				index1->v[2] += r_affinetridesc.seamfixupX16;
+				v1[2] += r_affinetridesc.seamfixupX16;
 			if (index2->flags & ALIAS_ONSEAM)
-				index2->v[2] += r_affinetridesc.seamfixupX16;
+				v2[2] += r_affinetridesc.seamfixupX16;
 
-			D_PolysetRecursiveTriangle(index0->v, index1->v, index2->v);
-
-			index0->v[2] = s0;
-			index1->v[2] = s1;
-			index2->v[2] = s2;
+			D_PolysetRecursiveTriangle(v0, v1, v2);
 		}
 	}
 }
@@ -265,6 +313,9 @@ void D_DrawNonSubdiv (void)
 			continue;
 		}
 
+		if (D_PolysetOutsideBand (index0, index1, index2))
+			continue;
+
 		r_p0[0] = index0->v[0];		// u
 		r_p0[1] = index0->v[1];		// v
 		r_p0[2] = index0->v[2];		// s
@@ -367,6 +418,9 @@ split:
 		goto nodraw;
 
 
+	if (new[1] < d_bandtop || new[1] >= d_bandbottom)
+		goto nodraw;
+
 	z = new[5]>>16;
 	zbuf = zspantable[new[1]] + new[0];
 	if (z >= *zbuf)
@@ -375,7 +429,11 @@ split:
 
 		*zbuf = z;
 		pix = d_pcolormap[skintable[new[3]>>16][new[2]>>16]];
-		d_viewbuffer[d_scantable[new[1]] + new[0]] = pix;
+		if (r_pixbytes == 1)
+			d_viewbuffer[d_scantable[new[1]] + new[0]] = pix;
+		else
+			((unsigned *)d_viewbuffer)[d_scantable[new[1]] + new[0]] =
+					d_8to24table[pix];
 	}
 
 nodraw:
@@ -617,7 +675,7 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 			d_aspancount += ubasestep;
 		}
 
-		if (lcount)
+		if (lcount && pspanpackage->pz >= d_bandpz0 && pspanpackage->pz < d_bandpz1)
 		{
 			lpdest = pspanpackage->pdest;
 			lptex = pspanpackage->ptex;
@@ -657,6 +715,75 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 }
 
 
+/*
+================
+D_PolysetDrawSpans32
+================
+*/
+void D_PolysetDrawSpans32 (spanpackage_t *pspanpackage)
+{
+	int			lcount;
+	unsigned	*lpdest;
+	byte	*lptex;
+	int		lsfrac, ltfrac;
+	int		llight;
+	int		lzi;
+	short	*lpz;
+
+	do
+	{
+		lcount = d_aspancount - pspanpackage->count;
+
+		errorterm += erroradjustup;
+		if (errorterm >= 0)
+		{
+			d_aspancount += d_countextrastep;
+			errorterm -= erroradjustdown;
+		}
+		else
+		{
+			d_aspancount += ubasestep;
+		}
+
+		if (lcount && pspanpackage->pz >= d_bandpz0 && pspanpackage->pz < d_bandpz1)
+		{
+			lpdest = (unsigned *)pspanpackage->pdest;
+			lptex = pspanpackage->ptex;
+			lpz = pspanpackage->pz;
+			lsfrac = pspanpackage->sfrac;
+			ltfrac = pspanpackage->tfrac;
+			llight = pspanpackage->light;
+			lzi = pspanpackage->zi;
+
+			do
+			{
+				if ((lzi >> 16) >= *lpz)
+				{
+					*lpdest = d_8to24table[((byte *)acolormap)[*lptex + (llight & 0xFF00)]];
+					*lpz = lzi >> 16;
+				}
+				lpdest++;
+				lzi += r_zistepx;
+				lpz++;
+				llight += r_lstepx;
+				lptex += a_ststepxwhole;
+				lsfrac += a_sstepxfrac;
+				lptex += lsfrac >> 16;
+				lsfrac &= 0xFFFF;
+				ltfrac += a_tstepxfrac;
+				if (ltfrac & 0x10000)
+				{
+					lptex += r_affinetridesc.skinwidth;
+					ltfrac &= 0xFFFF;
+				}
+			} while (--lcount);
+		}
+
+		pspanpackage++;
+	} while (pspanpackage->count != -999999);
+}
+
+
 /*
 ================
 D_PolysetFillSpans8
@@ -694,6 +821,23 @@ void D_PolysetFillSpans8 (spanpackage_t *pspanpackage)
 	}
 }
 
+/*
+================
+D_PolysetVert
+
+This thread's r_p0, r_p1 or r_p2
+================
+*/
+static int *D_PolysetVert (int vert)
+{
+	if (vert == 0)
+		return r_p0;
+	if (vert == 1)
+		return r_p1;
+	return r_p2;
+}
+
+
 /*
 ================
 D_RasterizeAliasPolySmooth
@@ -705,11 +849,11 @@ void D_RasterizeAliasPolySmooth (void)
 	int				*plefttop, *prighttop, *pleftbottom, *prightbottom;
 	int				working_lstepx, originalcount;
 
-	plefttop = pedgetable->pleftedgevert0;
-	prighttop = pedgetable->prightedgevert0;
+	plefttop = D_PolysetVert (pedgetable->leftedgevert0);
+	prighttop = D_PolysetVert (pedgetable->rightedgevert0);
 
-	pleftbottom = pedgetable->pleftedgevert1;
-	prightbottom = pedgetable->prightedgevert1;
+	pleftbottom = D_PolysetVert (pedgetable->leftedgevert1);
+	prightbottom = D_PolysetVert (pedgetable->rightedgevert1);
 
 	initialleftheight = pleftbottom[1] - plefttop[1];
 	initialrightheight = prightbottom[1] - prighttop[1];
@@ -740,7 +884,7 @@ void D_RasterizeAliasPolySmooth (void)
 	d_zi = plefttop[5];
 
 	d_pdest = (byte *)d_viewbuffer +
-			ystart * screenwidth + plefttop[0];
+			(ystart * screenwidth + plefttop[0]) * r_pixbytes;
 	d_pz = d_pzbuffer + ystart * d_zwidth + plefttop[0];
 
 	if (initialleftheight == 1)
@@ -767,8 +911,8 @@ void D_RasterizeAliasPolySmooth (void)
 		d_pzbasestep = d_zwidth + ubasestep;
 		d_pzextrastep = d_pzbasestep + 1;
 
-		d_pdestbasestep = screenwidth + ubasestep;
-		d_pdestextrastep = d_pdestbasestep + 1;
+		d_pdestbasestep = (screenwidth + ubasestep) * r_pixbytes;
+		d_pdestextrastep = d_pdestbasestep + r_pixbytes;
 
 	// TODO: can reuse partial expressions here
 
@@ -808,7 +952,7 @@ void D_RasterizeAliasPolySmooth (void)
 		int		height;
 
 		plefttop = pleftbottom;
-		pleftbottom = pedgetable->pleftedgevert2;
+		pleftbottom = D_PolysetVert (pedgetable->leftedgevert2);
 
 		height = pleftbottom[1] - plefttop[1];
 
@@ -823,7 +967,8 @@ void D_RasterizeAliasPolySmooth (void)
 		d_light = plefttop[4];
 		d_zi = plefttop[5];
 
-		d_pdest = (byte *)d_viewbuffer + ystart * screenwidth + plefttop[0];
+		d_pdest = (byte *)d_viewbuffer +
+				(ystart * screenwidth + plefttop[0]) * r_pixbytes;
 		d_pz = d_pzbuffer + ystart * d_zwidth + plefttop[0];
 
 		if (height == 1)
@@ -847,8 +992,8 @@ void D_RasterizeAliasPolySmooth (void)
 			D_PolysetSetUpForLineScan(plefttop[0], plefttop[1],
 								  pleftbottom[0], pleftbottom[1]);
 
-			d_pdestbasestep = screenwidth + ubasestep;
-			d_pdestextrastep = d_pdestbasestep + 1;
+			d_pdestbasestep = (screenwidth + ubasestep) * r_pixbytes;
+			d_pdestextrastep = d_pdestbasestep + r_pixbytes;
 
 			d_pzbasestep = d_zwidth + ubasestep;
 			d_pzextrastep = d_pzbasestep + 1;
@@ -889,7 +1034,10 @@ void D_RasterizeAliasPolySmooth (void)
 	d_countextrastep = ubasestep + 1;
 	originalcount = a_spans[initialrightheight].count;
 	a_spans[initialrightheight].count = -999999; // mark end of the spanpackages
-	D_PolysetDrawSpans8 (a_spans);
+	if (r_pixbytes == 1)
+		D_PolysetDrawSpans8 (a_spans);
+	else
+		D_PolysetDrawSpans32 (a_spans);
 
 // scan out the bottom part of the right edge, if it exists
 	if (pedgetable->numrightedges == 2)
@@ -903,7 +1051,7 @@ void D_RasterizeAliasPolySmooth (void)
 		d_aspancount = prightbottom[0] - prighttop[0];
 
 		prighttop = prightbottom;
-		prightbottom = pedgetable->prightedgevert2;
+		prightbottom = D_PolysetVert (pedgetable->rightedgevert2);
 
 		height = prightbottom[1] - prighttop[1];
 
@@ -913,7 +1061,10 @@ void D_RasterizeAliasPolySmooth (void)
 		d_countextrastep = ubasestep + 1;
 		a_spans[initialrightheight + height].count = -999999;
 											// mark end of the spanpackages
-		D_PolysetDrawSpans8 (pstart);
+		if (r_pixbytes == 1)
+			D_PolysetDrawSpans8 (pstart);
+		else
+			D_PolysetDrawSpans32 (pstart);
 	}
 }
 
@@ -24,6 +24,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "r_local.h"
 #include "d_local.h"
+#include "simd.h"
+#include "job.h"
 
 unsigned char	*r_turb_pbase, *r_turb_pdest;
 fixed16_t		r_turb_s, r_turb_t, r_turb_sstep, r_turb_tstep;
@@ -31,26 +33,194 @@ int				*r_turb_turb;
 int				r_turb_spancount;
 
 void D_DrawTurbulent8Span (void);
+void D_DrawTurbulent32Span (void);
 
 
+/*
+==============================================================================
+
+SCREEN WARP
+
+==============================================================================
+*/
+
+//
+// The warp is run a row at a time by the jobs, each taking bands of rows.
+// Row v, column u of the screen comes from the view row warp_rowofs[v +
+// turb[u]] and the view column warp_column[turb[v] + u], where both tables
+// are in pixels from warp_base.
+//
+
+#define	WARP_BANDSPERTHREAD	4
+#define	WARP_MINBANDHEIGHT	8
+#define	WARPBENCH_LOOPS		32
+
+typedef void (*warprowfunc_t) (int v, byte *dest);
+
+static int				warp_rowofs[MAXHEIGHT+(AMP2*2)];
+static int				warp_column[MAXWIDTH+(AMP2*2)];
+static int				*warp_turb;
+static byte				*warp_base;
+static int				warp_width, warp_height, warp_bandheight;
+static byte				*warp_dest;
+static int				warp_destrowbytes;
+static warprowfunc_t	warp_rowfunc;
+
+// for the vector 8 bit warp: per 16 pixel chunk a bit for each turb value
+// in it, or 0 if the source columns spread too far
+static byte				warp_shuffles[AMP2*2+1][MAXWIDTH];
+static byte				warp_turbbytes[MAXWIDTH];
+static int				warp_chunkrows[MAXWIDTH/16];
+
 /*
 =============
-D_WarpScreen
+D_WarpRow8_C
+=============
+*/
+static void D_WarpRow8_C (int v, byte *dest)
+{
+	int		u;
+	int		*turb, *col, *row;
 
-// this performs a slight compression of the screen at the same time as
-// the sine warp, to keep the edges from wrapping
+	turb = warp_turb;
+	col = &warp_column[turb[v]];
+	row = &warp_rowofs[v];
+
+	for (u=0 ; u<warp_width ; u+=4)
+	{
+		dest[u+0] = warp_base[row[turb[u+0]] + col[u+0]];
+		dest[u+1] = warp_base[row[turb[u+1]] + col[u+1]];
+		dest[u+2] = warp_base[row[turb[u+2]] + col[u+2]];
+		dest[u+3] = warp_base[row[turb[u+3]] + col[u+3]];
+	}
+}
+
+/*
+=============
+D_WarpRow32_C
 =============
 */
-void D_WarpScreen (void)
+static void D_WarpRow32_C (int v, byte *dest)
+{
+	int		u;
+	int		*turb, *col, *row;
+
+	turb = warp_turb;
+	col = &warp_column[turb[v]];
+	row = &warp_rowofs[v];
+
+	for (u=0 ; u<warp_width ; u++)
+		((unsigned *)dest)[u] = ((unsigned *)warp_base)[row[turb[u]] + col[u]];
+}
+
+#if SIMD_X86
+
+/*
+=============
+D_WarpRow8_SSE41
+
+16 pixels a step.  Over 16 pixels the source columns advance by at most 15
+and turb takes only a few values, so each row the chunk reads from is loaded
+whole and shuffled into place, and the pixels taken from it are blended in.
+D_WarpSetup builds the shuffles and the rows a chunk reads.
+=============
+*/
+SIMD_TARGET("sse4.1") static void D_WarpRow8_SSE41 (int v, byte *dest)
+{
+	int		u, k, chunk, rows;
+	int		*turb, *col, *row;
+	byte	*shuf;
+	__m128i	mask, turbs, pixels;
+
+	turb = warp_turb;
+	col = &warp_column[turb[v]];
+	row = &warp_rowofs[v];
+	shuf = warp_shuffles[turb[v]];
+
+	for (u=0, chunk=0 ; u+16<=warp_width ; u+=16, chunk++)
+	{
+		rows = warp_chunkrows[chunk];
+		if (!rows)
+		{
+			for (k=u ; k<u+16 ; k++)
+				dest[k] = warp_base[row[turb[k]] + col[k]];
+			continue;
+		}
+
+		mask = _mm_loadu_si128 ((__m128i *)(shuf + u));
+		turbs = _mm_loadu_si128 ((__m128i *)(warp_turbbytes + u));
+		pixels = _mm_setzero_si128 ();
+		for (k=0 ; rows ; k++, rows>>=1)
+		{
+			if (!(rows & 1))
+				continue;
+			pixels = _mm_blendv_epi8 (pixels,
+				_mm_shuffle_epi8 (_mm_loadu_si128 ((__m128i *)(warp_base + row[k] + col[u])), mask),
+				_mm_cmpeq_epi8 (turbs, _mm_set1_epi8 (k)));
+		}
+		_mm_storeu_si128 ((__m128i *)(dest + u), pixels);
+	}
+
+// as far as the C version's unrolled loop goes
+	for ( ; u<((warp_width + 3) & ~3) ; u++)
+		dest[u] = warp_base[row[turb[u]] + col[u]];
+}
+
+/*
+=============
+D_WarpRow32_AVX2
+=============
+*/
+SIMD_TARGET("avx2") static void D_WarpRow32_AVX2 (int v, byte *dest)
+{
+	int		u;
+	int		*turb, *col, *row;
+	__m256i	ofs;
+
+	turb = warp_turb;
+	col = &warp_column[turb[v]];
+	row = &warp_rowofs[v];
+
+	for (u=0 ; u+8<=warp_width ; u+=8)
+	{
+		ofs = _mm256_i32gather_epi32 (row, _mm256_loadu_si256 ((__m256i *)(turb + u)), 4);
+		ofs = _mm256_add_epi32 (ofs, _mm256_loadu_si256 ((__m256i *)(col + u)));
+		_mm256_storeu_si256 ((__m256i *)dest + (u >> 3),
+			_mm256_i32gather_epi32 ((const int *)warp_base, ofs, 4));
+	}
+
+	for ( ; u<warp_width ; u++)
+		((unsigned *)dest)[u] = ((unsigned *)warp_base)[row[turb[u]] + col[u]];
+}
+
+static warprowfunc_t	d_warprows8[SIMD_AVX2+1] =
+	{D_WarpRow8_C, D_WarpRow8_C, D_WarpRow8_SSE41, D_WarpRow8_SSE41};
+static warprowfunc_t	d_warprows32[SIMD_AVX2+1] =
+	{D_WarpRow32_C, D_WarpRow32_C, D_WarpRow32_C, D_WarpRow32_AVX2};
+
+#else	// !SIMD_X86
+
+static warprowfunc_t	d_warprows8[SIMD_AVX2+1] =
+	{D_WarpRow8_C, D_WarpRow8_C, D_WarpRow8_C, D_WarpRow8_C};
+static warprowfunc_t	d_warprows32[SIMD_AVX2+1] =
+	{D_WarpRow32_C, D_WarpRow32_C, D_WarpRow32_C, D_WarpRow32_C};
+
+#endif	// SIMD_X86
+
+/*
+=============
+D_WarpSetup
+
+Builds the row and column tables for warping the view in d_viewbuffer out
+to scr_vrect, and the chunk tables for D_WarpRow8_SSE41.  This performs a
+slight compression of the screen at the same time as the sine warp, to keep
+the edges from wrapping.
+=============
+*/
+static void D_WarpSetup (void)
 {
 	int		w, h;
-	int		u,v;
-	byte	*dest;
-	int		*turb;
-	int		*col;
-	byte	**row;
-	byte	*rowptr[MAXHEIGHT+(AMP2*2)];
-	int		column[MAXWIDTH+(AMP2*2)];
+	int		u, v, i, chunk, shift;
 	float	wratio, hratio;
 
 	w = r_refdef.vrect.width;
@@ -61,31 +231,158 @@ void D_WarpScreen (void)
 
 	for (v=0 ; v<scr_vrect.height+AMP2*2 ; v++)
 	{
-		rowptr[v] = d_viewbuffer + (r_refdef.vrect.y * screenwidth) +
+		warp_rowofs[v] = (r_refdef.vrect.y * screenwidth) +
 				 (screenwidth * (int)((float)v * hratio * h / (h + AMP2 * 2)));
 	}
 
 	for (u=0 ; u<scr_vrect.width+AMP2*2 ; u++)
 	{
-		column[u] = r_refdef.vrect.x +
+		warp_column[u] = r_refdef.vrect.x +
 				(int)((float)u * wratio * w / (w + AMP2 * 2));
 	}
 
-	turb = intsintable + ((int)(cl.time*SPEED)&(CYCLE-1));
-	dest = vid.buffer + scr_vrect.y * vid.rowbytes + scr_vrect.x;
+	warp_turb = intsintable + ((int)(cl.time*SPEED)&(CYCLE-1));
+	warp_base = (byte *)d_viewbuffer;
+	warp_width = scr_vrect.width;
+	warp_height = scr_vrect.height;
+
+	if (r_pixbytes != 1)
+		return;
+
+	for (u=0 ; u<warp_width ; u++)
+		warp_turbbytes[u] = warp_turb[u];
+
+	for (chunk=0 ; chunk*16+16<=warp_width ; chunk++)
+	{
+		u = chunk*16;
+		warp_chunkrows[chunk] = 0;
+		for (i=0 ; i<16 ; i++)
+			warp_chunkrows[chunk] |= 1 << warp_turb[u+i];
+
+		for (shift=0 ; shift<=AMP2*2 ; shift++)
+		{
+			if (warp_column[shift+u+15] - warp_column[shift+u] > 15)
+				warp_chunkrows[chunk] = 0;
+			for (i=0 ; i<16 ; i++)
+				warp_shuffles[shift][u+i] = warp_column[shift+u+i] - warp_column[shift+u];
+		}
+	}
+}
+
+/*
+=============
+D_WarpBand
+
+Warps one band of rows into warp_dest
+=============
+*/
+static void D_WarpBand (int band, void *arg)
+{
+	int		v, bottom;
+
+	v = band * warp_bandheight;
+	bottom = v + warp_bandheight;
+	if (bottom > warp_height)
+		bottom = warp_height;
+
+	for ( ; v<bottom ; v++)
+		warp_rowfunc (v, warp_dest + v*warp_destrowbytes);
+}
+
+/*
+=============
+D_WarpBands
+
+Runs the warp over the jobs, returning the number of bands
+=============
+*/
+static int D_WarpBands (void)
+{
+	int		numbands;
+
+	numbands = Job_Threads () * WARP_BANDSPERTHREAD;
+	warp_bandheight = (warp_height + numbands - 1) / numbands;
+	if (warp_bandheight < WARP_MINBANDHEIGHT)
+		warp_bandheight = WARP_MINBANDHEIGHT;
+	numbands = (warp_height + warp_bandheight - 1) / warp_bandheight;
 
-	for (v=0 ; v<scr_vrect.height ; v++, dest += vid.rowbytes)
+	Job_ParallelFor (numbands, 1, D_WarpBand, NULL);
+	return numbands;
+}
+
+/*
+=============
+D_WarpScreen
+=============
+*/
+void D_WarpScreen (void)
+{
+	D_WarpSetup ();
+
+	warp_dest = vid.buffer + scr_vrect.y * vid.rowbytes + scr_vrect.x * r_pixbytes;
+	warp_destrowbytes = vid.rowbytes;
+	if (r_pixbytes == 1)
+		warp_rowfunc = d_warprows8[SIMD_Level ()];
+	else
+		warp_rowfunc = d_warprows32[SIMD_Level ()];
+
+	D_WarpBands ();
+}
+
+/*
+=============
+D_WarpBench_f
+
+For program optimization: run from underwater, times the warp of the last
+frame at every available SIMD level, on this thread and on the jobs, and
+checks it against the C version
+=============
+*/
+void D_WarpBench_f (void)
+{
+	int				i, level, maxlevel, size, numbands;
+	byte			*ref, *out;
+	warprowfunc_t	*rowfuncs;
+	double			start, tone, tall;
+
+	if (!r_dowarp)
+		Con_Printf ("not underwater, warping a stale buffer\n");
+
+	D_WarpSetup ();
+	warp_base = (byte *)r_warpbuffer;
+
+	warp_destrowbytes = ((warp_width + 3) & ~3) * r_pixbytes;
+	size = warp_destrowbytes * warp_height;
+	ref = Hunk_TempAlloc (size*2);
+	out = ref + size;
+
+	rowfuncs = r_pixbytes == 1 ? d_warprows8 : d_warprows32;
+	maxlevel = SIMD_Level ();
+
+	Con_Printf ("usec per %ix%i warp, 1 / %i threads\n", warp_width, warp_height, Job_Threads ());
+	for (level=SIMD_NONE ; level<=maxlevel ; level++)
 	{
-		col = &column[turb[v]];
-		row = &rowptr[v];
+		warp_rowfunc = rowfuncs[level];
+		warp_dest = level ? out : ref;
+		Q_memset (warp_dest, 0, size);
 
-		for (u=0 ; u<scr_vrect.width ; u+=4)
+		start = Sys_FloatTime ();
+		for (i=0 ; i<WARPBENCH_LOOPS ; i++)
 		{
-			dest[u+0] = row[turb[u+0]][col[u+0]];
-			dest[u+1] = row[turb[u+1]][col[u+1]];
-			dest[u+2] = row[turb[u+2]][col[u+2]];
-			dest[u+3] = row[turb[u+3]][col[u+3]];
+			warp_bandheight = warp_height;
+			D_WarpBand (0, NULL);
 		}
+		tone = (Sys_FloatTime () - start) / WARPBENCH_LOOPS;
+
+		start = Sys_FloatTime ();
+		for (i=0 ; i<WARPBENCH_LOOPS ; i++)
+			numbands = D_WarpBands ();
+		tall = (Sys_FloatTime () - start) / WARPBENCH_LOOPS;
+
+		Con_Printf ("%s %6.0f / %6.0f (%i bands)", SIMD_Name (level), tone*1000000, tall*1000000, numbands);
+		if (level && Q_memcmp (ref, out, size))
+			Con_Printf (" (MISMATCH)");
+		Con_Printf ("\n");
 	}
 }
 
@@ -112,10 +409,141 @@ void D_DrawTurbulent8Span (void)
 
 /*
 =============
-Turbulent8
+D_DrawTurbulent32Span
 =============
 */
-void Turbulent8 (espan_t *pspan)
+void D_DrawTurbulent32Span (void)
+{
+	int			sturb, tturb;
+	unsigned	*pdest;
+
+	pdest = (unsigned *)r_turb_pdest;
+	do
+	{
+		sturb = ((r_turb_s + r_turb_turb[(r_turb_t>>16)&(CYCLE-1)])>>16)&63;
+		tturb = ((r_turb_t + r_turb_turb[(r_turb_s>>16)&(CYCLE-1)])>>16)&63;
+		*pdest++ = d_8to24table[*(r_turb_pbase + (tturb<<6) + sturb)];
+		r_turb_s += r_turb_sstep;
+		r_turb_t += r_turb_tstep;
+	} while (--r_turb_spancount > 0);
+	r_turb_pdest = (unsigned char *)pdest;
+}
+
+
+#if SIMD_X86
+
+/*
+=============
+D_TurbulentOffsets_AVX2
+
+Texel offsets of the next 8 pixels of a turbulent span, stepping s and t
+=============
+*/
+SIMD_TARGET("avx2") static inline __m256i D_TurbulentOffsets_AVX2 (__m256i *vs, __m256i *vt, __m256i sstep8, __m256i tstep8)
+{
+	__m256i	cyclemask, texmask, sturb, tturb;
+
+	cyclemask = _mm256_set1_epi32 (CYCLE-1);
+	texmask = _mm256_set1_epi32 (63);
+
+	sturb = _mm256_i32gather_epi32 (r_turb_turb,
+		_mm256_and_si256 (_mm256_srai_epi32 (*vt, 16), cyclemask), 4);
+	tturb = _mm256_i32gather_epi32 (r_turb_turb,
+		_mm256_and_si256 (_mm256_srai_epi32 (*vs, 16), cyclemask), 4);
+	sturb = _mm256_and_si256 (_mm256_srai_epi32 (_mm256_add_epi32 (*vs, sturb), 16), texmask);
+	tturb = _mm256_and_si256 (_mm256_srai_epi32 (_mm256_add_epi32 (*vt, tturb), 16), texmask);
+
+	*vs = _mm256_add_epi32 (*vs, sstep8);
+	*vt = _mm256_add_epi32 (*vt, tstep8);
+
+	return _mm256_add_epi32 (_mm256_slli_epi32 (tturb, 6), sturb);
+}
+
+/*
+=============
+D_DrawTurbulent8Span_AVX2
+
+The turbulence worked out 8 pixels at a time.  The last few pixels are done
+here rather than in D_DrawTurbulent8Span, which is built without AVX and
+would run with the upper halves of the registers dirty.
+=============
+*/
+SIMD_TARGET("avx2") static void D_DrawTurbulent8Span_AVX2 (void)
+{
+	int		i, n;
+	int		ofs[8];
+	__m256i	ramp, vs, vt, sstep8, tstep8;
+
+	ramp = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+	vs = _mm256_add_epi32 (_mm256_set1_epi32 (r_turb_s), _mm256_mullo_epi32 (_mm256_set1_epi32 (r_turb_sstep), ramp));
+	vt = _mm256_add_epi32 (_mm256_set1_epi32 (r_turb_t), _mm256_mullo_epi32 (_mm256_set1_epi32 (r_turb_tstep), ramp));
+	sstep8 = _mm256_set1_epi32 ((int)((unsigned)r_turb_sstep * 8));
+	tstep8 = _mm256_set1_epi32 ((int)((unsigned)r_turb_tstep * 8));
+
+	for ( ; r_turb_spancount > 0 ; r_turb_spancount -= n, r_turb_pdest += n)
+	{
+		_mm256_storeu_si256 ((__m256i *)ofs, D_TurbulentOffsets_AVX2 (&vs, &vt, sstep8, tstep8));
+
+		n = r_turb_spancount < 8 ? r_turb_spancount : 8;
+		for (i=0 ; i<n ; i++)
+			r_turb_pdest[i] = r_turb_pbase[ofs[i]];
+	}
+}
+
+/*
+=============
+D_DrawTurbulent32Span_AVX2
+=============
+*/
+SIMD_TARGET("avx2") static void D_DrawTurbulent32Span_AVX2 (void)
+{
+	int			i, n;
+	int			ofs[8];
+	unsigned	*pdest;
+	__m256i		ramp, vs, vt, sstep8, tstep8;
+
+	ramp = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+	vs = _mm256_add_epi32 (_mm256_set1_epi32 (r_turb_s), _mm256_mullo_epi32 (_mm256_set1_epi32 (r_turb_sstep), ramp));
+	vt = _mm256_add_epi32 (_mm256_set1_epi32 (r_turb_t), _mm256_mullo_epi32 (_mm256_set1_epi32 (r_turb_tstep), ramp));
+	sstep8 = _mm256_set1_epi32 ((int)((unsigned)r_turb_sstep * 8));
+	tstep8 = _mm256_set1_epi32 ((int)((unsigned)r_turb_tstep * 8));
+
+	pdest = (unsigned *)r_turb_pdest;
+	for ( ; r_turb_spancount > 0 ; r_turb_spancount -= n, pdest += n)
+	{
+		_mm256_storeu_si256 ((__m256i *)ofs, D_TurbulentOffsets_AVX2 (&vs, &vt, sstep8, tstep8));
+
+		n = r_turb_spancount < 8 ? r_turb_spancount : 8;
+		for (i=0 ; i<n ; i++)
+			pdest[i] = d_8to24table[r_turb_pbase[ofs[i]]];
+	}
+	r_turb_pdest = (unsigned char *)pdest;
+}
+
+static void (*d_turb8spans[SIMD_AVX2+1]) (void) =
+	{D_DrawTurbulent8Span, D_DrawTurbulent8Span, D_DrawTurbulent8Span, D_DrawTurbulent8Span_AVX2};
+static void (*d_turb32spans[SIMD_AVX2+1]) (void) =
+	{D_DrawTurbulent32Span, D_DrawTurbulent32Span, D_DrawTurbulent32Span, D_DrawTurbulent32Span_AVX2};
+
+#else	// !SIMD_X86
+
+static void (*d_turb8spans[SIMD_AVX2+1]) (void) =
+	{D_DrawTurbulent8Span, D_DrawTurbulent8Span, D_DrawTurbulent8Span, D_DrawTurbulent8Span};
+static void (*d_turb32spans[SIMD_AVX2+1]) (void) =
+	{D_DrawTurbulent32Span, D_DrawTurbulent32Span, D_DrawTurbulent32Span, D_DrawTurbulent32Span};
+
+#endif	// SIMD_X86
+
+
+/*
+=============
+D_DrawTurbulent
+
+Steps across the spans of a warped surface, calling drawspan for each run
+of up to 16 pixels
+=============
+*/
+static void D_DrawTurbulent (espan_t *pspan, void (*drawspan) (void))
 {
 	int				count;
 	fixed16_t		snext, tnext;
@@ -136,7 +564,7 @@ void Turbulent8 (espan_t *pspan)
 	do
 	{
 		r_turb_pdest = (unsigned char *)((byte *)d_viewbuffer +
-				(screenwidth * pspan->v) + pspan->u);
+				((screenwidth * pspan->v) + pspan->u) * r_pixbytes);
 
 		count = pspan->count;
 
@@ -232,7 +660,7 @@ void Turbulent8 (espan_t *pspan)
 			r_turb_s = r_turb_s & ((CYCLE<<16)-1);
 			r_turb_t = r_turb_t & ((CYCLE<<16)-1);
 
-			D_DrawTurbulent8Span ();
+			(*drawspan) ();
 
 			r_turb_s = snext;
 			r_turb_t = tnext;
@@ -243,6 +671,28 @@ void Turbulent8 (espan_t *pspan)
 }
 
 
+/*
+=============
+Turbulent8
+=============
+*/
+void Turbulent8 (espan_t *pspan)
+{
+	D_DrawTurbulent (pspan, d_turb8spans[SIMD_Level ()]);
+}
+
+
+/*
+=============
+Turbulent32
+=============
+*/
+void Turbulent32 (espan_t *pspan)
+{
+	D_DrawTurbulent (pspan, d_turb32spans[SIMD_Level ()]);
+}
+
+
 /*
 =============
 D_DrawSpans8
@@ -379,50 +829,185 @@ void D_DrawSpans8 (espan_t *pspan)
 
 /*
 =============
-D_DrawZSpans
+D_DrawSpans32
+
+D_DrawSpans8 from a 32 bit surface cache to a 32 bit buffer
 =============
 */
-void D_DrawZSpans (espan_t *pspan)
+void D_DrawSpans32 (espan_t *pspan)
 {
-	int				count, doublecount, izistep;
-	int				izi;
-	short			*pdest;
-	unsigned		ltemp;
-	double			zi;
-	float			du, dv;
+	int				count, spancount;
+	unsigned		*pbase, *pdest;
+	fixed16_t		s, t, snext, tnext, sstep, tstep;
+	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
+	float			sdivz8stepu, tdivz8stepu, zi8stepu;
 
-// FIXME: check for clamping/range problems
-// we count on FP exceptions being turned off to avoid range problems
-	izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+	sstep = 0;	// keep compiler happy
+	tstep = 0;	// ditto
+
+	pbase = (unsigned *)cacheblock;
+
+	sdivz8stepu = d_sdivzstepu * 8;
+	tdivz8stepu = d_tdivzstepu * 8;
+	zi8stepu = d_zistepu * 8;
 
 	do
 	{
-		pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+		pdest = (unsigned *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u;
 
 		count = pspan->count;
 
-	// calculate the initial 1/z
+	// calculate the initial s/z, t/z, 1/z, s, and t and clamp
 		du = (float)pspan->u;
 		dv = (float)pspan->v;
 
+		sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
+		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
 		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
-	// we count on FP exceptions being turned off to avoid range problems
-		izi = (int)(zi * 0x8000 * 0x10000);
+		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
 
-		if ((intptr_t)pdest & 0x02)
-		{
-			*pdest++ = (short)(izi >> 16);
-			izi += izistep;
-			count--;
-		}
+		s = (int)(sdivz * z) + sadjust;
+		if (s > bbextents)
+			s = bbextents;
+		else if (s < 0)
+			s = 0;
 
-		if ((doublecount = count >> 1) > 0)
+		t = (int)(tdivz * z) + tadjust;
+		if (t > bbextentt)
+			t = bbextentt;
+		else if (t < 0)
+			t = 0;
+
+		do
 		{
-			do
-			{
-				ltemp = izi >> 16;
-				izi += izistep;
-				ltemp |= izi & 0xFFFF0000;
+		// calculate s and t at the far end of the span
+			if (count >= 8)
+				spancount = 8;
+			else
+				spancount = count;
+
+			count -= spancount;
+
+			if (count)
+			{
+			// calculate s/z, t/z, zi->fixed s and t at far end of span,
+			// calculate s and t steps across span by shifting
+				sdivz += sdivz8stepu;
+				tdivz += tdivz8stepu;
+				zi += zi8stepu;
+				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+
+				snext = (int)(sdivz * z) + sadjust;
+				if (snext > bbextents)
+					snext = bbextents;
+				else if (snext < 8)
+					snext = 8;	// prevent round-off error on <0 steps from
+								//  from causing overstepping & running off the
+								//  edge of the texture
+
+				tnext = (int)(tdivz * z) + tadjust;
+				if (tnext > bbextentt)
+					tnext = bbextentt;
+				else if (tnext < 8)
+					tnext = 8;	// guard against round-off error on <0 steps
+
+				sstep = (snext - s) >> 3;
+				tstep = (tnext - t) >> 3;
+			}
+			else
+			{
+			// calculate s/z, t/z, zi->fixed s and t at last pixel in span (so
+			// can't step off polygon), clamp, calculate s and t steps across
+			// span by division, biasing steps low so we don't run off the
+			// texture
+				spancountminus1 = (float)(spancount - 1);
+				sdivz += d_sdivzstepu * spancountminus1;
+				tdivz += d_tdivzstepu * spancountminus1;
+				zi += d_zistepu * spancountminus1;
+				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+				snext = (int)(sdivz * z) + sadjust;
+				if (snext > bbextents)
+					snext = bbextents;
+				else if (snext < 8)
+					snext = 8;	// prevent round-off error on <0 steps from
+								//  from causing overstepping & running off the
+								//  edge of the texture
+
+				tnext = (int)(tdivz * z) + tadjust;
+				if (tnext > bbextentt)
+					tnext = bbextentt;
+				else if (tnext < 8)
+					tnext = 8;	// guard against round-off error on <0 steps
+
+				if (spancount > 1)
+				{
+					sstep = (snext - s) / (spancount - 1);
+					tstep = (tnext - t) / (spancount - 1);
+				}
+			}
+
+			do
+			{
+				*pdest++ = *(pbase + (s >> 16) + (t >> 16) * cachewidth);
+				s += sstep;
+				t += tstep;
+			} while (--spancount > 0);
+
+			s = snext;
+			t = tnext;
+
+		} while (count > 0);
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+
+/*
+=============
+D_DrawZSpans_C
+=============
+*/
+static void D_DrawZSpans_C (espan_t *pspan)
+{
+	int				count, doublecount, izistep;
+	int				izi;
+	short			*pdest;
+	unsigned		ltemp;
+	double			zi;
+	float			du, dv;
+
+// FIXME: check for clamping/range problems
+// we count on FP exceptions being turned off to avoid range problems
+	izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+
+	do
+	{
+		pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+
+		count = pspan->count;
+
+	// calculate the initial 1/z
+		du = (float)pspan->u;
+		dv = (float)pspan->v;
+
+		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+	// we count on FP exceptions being turned off to avoid range problems
+		izi = (int)(zi * 0x8000 * 0x10000);
+
+		if ((intptr_t)pdest & 0x02)
+		{
+			*pdest++ = (short)(izi >> 16);
+			izi += izistep;
+			count--;
+		}
+
+		if ((doublecount = count >> 1) > 0)
+		{
+			do
+			{
+				ltemp = izi >> 16;
+				izi += izistep;
+				ltemp |= izi & 0xFFFF0000;
 				izi += izistep;
 				*(int *)pdest = ltemp;
 				pdest += 2;
@@ -434,3 +1019,501 @@ void D_DrawZSpans (espan_t *pspan)
 
 	} while ((pspan = pspan->pnext) != NULL);
 }
+
+
+/*
+=============
+D_DrawLitSpans8
+
+D_DrawSpans8 for a surface that isn't cached: each pixel's texel and
+nearest lightmap sample are looked up and lit through the colormap here,
+as set up by D_LightSurface
+=============
+*/
+void D_DrawLitSpans8 (espan_t *pspan)
+{
+	int				count, spancount;
+	unsigned char	*pdest, *colormap;
+	fixed16_t		s, t, snext, tnext, sstep, tstep;
+	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
+	float			sdivz8stepu, tdivz8stepu, zi8stepu;
+	int				u, v, light;
+
+	sstep = 0;	// keep compiler happy
+	tstep = 0;	// ditto
+
+	colormap = (unsigned char *)vid.colormap;
+
+	sdivz8stepu = d_sdivzstepu * 8;
+	tdivz8stepu = d_tdivzstepu * 8;
+	zi8stepu = d_zistepu * 8;
+
+	do
+	{
+		pdest = (unsigned char *)((byte *)d_viewbuffer +
+				(screenwidth * pspan->v) + pspan->u);
+
+		count = pspan->count;
+
+	// calculate the initial s/z, t/z, 1/z, s, and t and clamp
+		du = (float)pspan->u;
+		dv = (float)pspan->v;
+
+		sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
+		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
+		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+
+		s = (int)(sdivz * z) + sadjust;
+		if (s > bbextents)
+			s = bbextents;
+		else if (s < 0)
+			s = 0;
+
+		t = (int)(tdivz * z) + tadjust;
+		if (t > bbextentt)
+			t = bbextentt;
+		else if (t < 0)
+			t = 0;
+
+		do
+		{
+		// calculate s and t at the far end of the span
+			if (count >= 8)
+				spancount = 8;
+			else
+				spancount = count;
+
+			count -= spancount;
+
+			if (count)
+			{
+				sdivz += sdivz8stepu;
+				tdivz += tdivz8stepu;
+				zi += zi8stepu;
+				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+
+				snext = (int)(sdivz * z) + sadjust;
+				if (snext > bbextents)
+					snext = bbextents;
+				else if (snext < 8)
+					snext = 8;
+
+				tnext = (int)(tdivz * z) + tadjust;
+				if (tnext > bbextentt)
+					tnext = bbextentt;
+				else if (tnext < 8)
+					tnext = 8;
+
+				sstep = (snext - s) >> 3;
+				tstep = (tnext - t) >> 3;
+			}
+			else
+			{
+				spancountminus1 = (float)(spancount - 1);
+				sdivz += d_sdivzstepu * spancountminus1;
+				tdivz += d_tdivzstepu * spancountminus1;
+				zi += d_zistepu * spancountminus1;
+				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+				snext = (int)(sdivz * z) + sadjust;
+				if (snext > bbextents)
+					snext = bbextents;
+				else if (snext < 8)
+					snext = 8;
+
+				tnext = (int)(tdivz * z) + tadjust;
+				if (tnext > bbextentt)
+					tnext = bbextentt;
+				else if (tnext < 8)
+					tnext = 8;
+
+				if (spancount > 1)
+				{
+					sstep = (snext - s) / (spancount - 1);
+					tstep = (tnext - t) / (spancount - 1);
+				}
+			}
+
+			do
+			{
+				u = s >> 16;
+				v = t >> 16;
+				light = blocklights[((v + d_litlighthalf) >> d_litlightshift) * d_litlightwidth
+						+ ((u + d_litlighthalf) >> d_litlightshift)];
+				*pdest++ = colormap[(light & 0xFF00) + d_littexture[
+						(((v + d_littoffset) & d_littmask) << d_litwidthshift)
+						+ ((u + d_litsoffset) & d_litsmask)]];
+				s += sstep;
+				t += tstep;
+			} while (--spancount > 0);
+
+			s = snext;
+			t = tnext;
+
+		} while (count > 0);
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+
+/*
+===============================================================================
+
+VECTOR SPANS
+
+The z span kernels below give the same z values as D_DrawZSpans_C, stepping
+and storing 8 or 16 at a time.  Texture spans stay scalar: their time goes
+into the dependent texel loads, and neither a batched divide nor a gather
+made them faster.
+
+===============================================================================
+*/
+
+typedef void (*spanfunc_t) (espan_t *pspan);
+
+#if SIMD_X86
+
+/*
+=============
+D_DrawZSpans_SSE41
+
+8 z values a store, the high halves of the 16.16 steps packed together
+=============
+*/
+SIMD_TARGET("sse4.1") static void D_DrawZSpans_SSE41 (espan_t *pspan)
+{
+	int				count, izistep, izi;
+	short			*pdest;
+	double			zi;
+	float			du, dv;
+	__m128i			v0, v1, step8;
+
+	izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+	step8 = _mm_set1_epi32 ((int)((unsigned)izistep * 8));
+
+	do
+	{
+		pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+
+		count = pspan->count;
+
+		du = (float)pspan->u;
+		dv = (float)pspan->v;
+
+		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+		izi = (int)(zi * 0x8000 * 0x10000);
+
+		v0 = _mm_add_epi32 (_mm_set1_epi32 (izi),
+			_mm_mullo_epi32 (_mm_set1_epi32 (izistep), _mm_setr_epi32 (0, 1, 2, 3)));
+		v1 = _mm_add_epi32 (v0, _mm_set1_epi32 ((int)((unsigned)izistep * 4)));
+
+		for ( ; count >= 8 ; count -= 8, pdest += 8)
+		{
+			_mm_storeu_si128 ((__m128i *)pdest,
+				_mm_packus_epi32 (_mm_srli_epi32 (v0, 16), _mm_srli_epi32 (v1, 16)));
+			v0 = _mm_add_epi32 (v0, step8);
+			v1 = _mm_add_epi32 (v1, step8);
+		}
+
+		izi = _mm_cvtsi128_si32 (v0);
+		for ( ; count > 0 ; count--)
+		{
+			*pdest++ = (short)(izi >> 16);
+			izi += izistep;
+		}
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+/*
+=============
+D_DrawZSpans_AVX2
+
+16 z values a store
+=============
+*/
+SIMD_TARGET("avx2") static void D_DrawZSpans_AVX2 (espan_t *pspan)
+{
+	int				count, izistep, izi;
+	short			*pdest;
+	double			zi;
+	float			du, dv;
+	__m256i			v0, v1, step16, packed;
+
+	izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+	step16 = _mm256_set1_epi32 ((int)((unsigned)izistep * 16));
+
+	do
+	{
+		pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+
+		count = pspan->count;
+
+		du = (float)pspan->u;
+		dv = (float)pspan->v;
+
+		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
+		izi = (int)(zi * 0x8000 * 0x10000);
+
+		v0 = _mm256_add_epi32 (_mm256_set1_epi32 (izi),
+			_mm256_mullo_epi32 (_mm256_set1_epi32 (izistep), _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)));
+		v1 = _mm256_add_epi32 (v0, _mm256_set1_epi32 ((int)((unsigned)izistep * 8)));
+
+		for ( ; count >= 16 ; count -= 16, pdest += 16)
+		{
+		// packus works within 128 bit lanes, the permute puts them back in order
+			packed = _mm256_packus_epi32 (_mm256_srli_epi32 (v0, 16), _mm256_srli_epi32 (v1, 16));
+			_mm256_storeu_si256 ((__m256i *)pdest, _mm256_permute4x64_epi64 (packed, 0xd8));
+			v0 = _mm256_add_epi32 (v0, step16);
+			v1 = _mm256_add_epi32 (v1, step16);
+		}
+
+		izi = _mm_cvtsi128_si32 (_mm256_castsi256_si128 (v0));
+		for ( ; count > 0 ; count--)
+		{
+			*pdest++ = (short)(izi >> 16);
+			izi += izistep;
+		}
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+static spanfunc_t	d_zspans[SIMD_AVX2+1] =
+	{D_DrawZSpans_C, D_DrawZSpans_C, D_DrawZSpans_SSE41, D_DrawZSpans_AVX2};
+
+#else	// !SIMD_X86
+
+static spanfunc_t	d_zspans[SIMD_AVX2+1] =
+	{D_DrawZSpans_C, D_DrawZSpans_C, D_DrawZSpans_C, D_DrawZSpans_C};
+
+#endif	// SIMD_X86
+
+/*
+=============
+D_DrawZSpans
+=============
+*/
+void D_DrawZSpans (espan_t *pspan)
+{
+	d_zspans[SIMD_Level ()] (pspan);
+}
+
+#define	SPANBENCH_WIDTH		320
+#define	SPANBENCH_HEIGHT	200
+#define	SPANBENCH_CACHE		256
+#define	SPANBENCH_LOOPS		32
+
+typedef struct
+{
+	float	sdivzorigin, sdivzstepu, sdivzstepv;
+	float	tdivzorigin, tdivzstepu, tdivzstepv;
+	float	ziorigin, zistepu, zistepv;
+} spanbenchgrad_t;
+
+static spanbenchgrad_t	spanbench_grads[] =
+{
+	{0.05, 0.0008, 0.0001, 0.1, 0.0001, 0.0005, 0.002, 0.000001, 0.000002},	// ordinary wall
+	{0.5, -0.0006, 0.0002, 0.4, 0.0003, -0.0004, 0.002, 0.000001, 0.000001},	// steps going down
+	{0.02, 0.002, -0.001, 0.3, -0.0015, 0.002, 0.001, 0.00002, 0.000004},		// steep, clamped
+};
+
+/*
+=============
+D_SpanBenchSpans
+
+Rows alternate between one span across the screen and runs of short spans.
+Returns the number of spans, only counting them if spans is NULL.
+=============
+*/
+static int D_SpanBenchSpans (espan_t *spans)
+{
+	int		u, v, count, numspans;
+
+	numspans = 0;
+	for (v=0 ; v<SPANBENCH_HEIGHT ; v++)
+	{
+		for (u=0 ; u<SPANBENCH_WIDTH ; u+=count)
+		{
+			if (v & 1)
+				count = 1 + (u*7 + v) % 29;
+			else
+				count = SPANBENCH_WIDTH - u;
+			if (count > SPANBENCH_WIDTH - u)
+				count = SPANBENCH_WIDTH - u;
+			if (spans)
+			{
+				spans[numspans].u = u;
+				spans[numspans].v = v;
+				spans[numspans].count = count;
+				spans[numspans].pnext = &spans[numspans+1];
+			}
+			numspans++;
+		}
+	}
+	if (spans)
+		spans[numspans-1].pnext = NULL;
+
+	return numspans;
+}
+
+/*
+=============
+D_SpanBench
+
+Seconds per screen of z spans and turbulent spans, the turbulent spans drawn
+into turbview
+=============
+*/
+static void D_SpanBench (int level, espan_t *spans, byte *turbview, double *z, double *turb)
+{
+	int		i;
+	double	start;
+	pixel_t	*viewbuffer;
+
+	start = Sys_FloatTime ();
+	for (i=0 ; i<SPANBENCH_LOOPS ; i++)
+		d_zspans[level] (spans);
+	*z = (Sys_FloatTime () - start) / SPANBENCH_LOOPS;
+
+	viewbuffer = d_viewbuffer;
+	d_viewbuffer = turbview;
+	start = Sys_FloatTime ();
+	for (i=0 ; i<SPANBENCH_LOOPS ; i++)
+		D_DrawTurbulent (spans, d_turb8spans[level]);
+	*turb = (Sys_FloatTime () - start) / SPANBENCH_LOOPS;
+	d_viewbuffer = viewbuffer;
+}
+
+/*
+=============
+D_SpanBench_f
+
+For program optimization: times the texture span drawer, and the z and
+turbulent span drawers at every available SIMD level on a screen of spans,
+checking those against the C versions
+=============
+*/
+void D_SpanBench_f (void)
+{
+	int				i, g, level, maxlevel, numspans;
+	espan_t			*spans;
+	byte			*buf, *view, *refturb, *turb;
+	short			*refz, *z;
+	surfcache_t		*cache;
+	double			start, ttex, tz, tturb;
+	spanbenchgrad_t	*grad;
+	pixel_t			*save_viewbuffer, *save_cacheblock;
+	short			*save_pzbuffer;
+	int				save_screenwidth, save_cachewidth, save_pixbytes;
+	unsigned int	save_zwidth;
+	fixed16_t		save_adjust[4];
+	spanbenchgrad_t	save_grad;
+
+	numspans = D_SpanBenchSpans (NULL);
+	buf = Hunk_TempAlloc (numspans*sizeof(espan_t)
+		+ SPANBENCH_WIDTH*SPANBENCH_HEIGHT*(3 + 2*sizeof(short))
+		+ sizeof(surfcache_t) + SPANBENCH_CACHE*SPANBENCH_CACHE);
+	spans = (espan_t *)buf;
+	refz = (short *)(spans + numspans);
+	z = refz + SPANBENCH_WIDTH*SPANBENCH_HEIGHT;
+	view = (byte *)(z + SPANBENCH_WIDTH*SPANBENCH_HEIGHT);
+	refturb = view + SPANBENCH_WIDTH*SPANBENCH_HEIGHT;
+	turb = refturb + SPANBENCH_WIDTH*SPANBENCH_HEIGHT;
+	cache = (surfcache_t *)(turb + SPANBENCH_WIDTH*SPANBENCH_HEIGHT);
+
+	D_SpanBenchSpans (spans);
+	Q_memset (cache, 0, sizeof(surfcache_t));
+	for (i=0 ; i<SPANBENCH_CACHE*SPANBENCH_CACHE ; i++)
+		cache->data[i] = (byte)((i * 2654435761u) >> 24);
+
+// draw into the bench buffers instead of the screen
+	save_viewbuffer = d_viewbuffer;
+	save_screenwidth = screenwidth;
+	save_pixbytes = r_pixbytes;
+	save_pzbuffer = d_pzbuffer;
+	save_zwidth = d_zwidth;
+	save_cacheblock = cacheblock;
+	save_cachewidth = cachewidth;
+	save_adjust[0] = sadjust;
+	save_adjust[1] = tadjust;
+	save_adjust[2] = bbextents;
+	save_adjust[3] = bbextentt;
+	save_grad.sdivzorigin = d_sdivzorigin;
+	save_grad.sdivzstepu = d_sdivzstepu;
+	save_grad.sdivzstepv = d_sdivzstepv;
+	save_grad.tdivzorigin = d_tdivzorigin;
+	save_grad.tdivzstepu = d_tdivzstepu;
+	save_grad.tdivzstepv = d_tdivzstepv;
+	save_grad.ziorigin = d_ziorigin;
+	save_grad.zistepu = d_zistepu;
+	save_grad.zistepv = d_zistepv;
+
+	screenwidth = SPANBENCH_WIDTH;
+	r_pixbytes = 1;
+	d_zwidth = SPANBENCH_WIDTH;
+	cacheblock = (pixel_t *)cache->data;
+	cachewidth = SPANBENCH_CACHE;
+	sadjust = 0;
+	tadjust = 0;
+	bbextents = (SPANBENCH_CACHE << 16) - 1;
+	bbextentt = (SPANBENCH_CACHE << 16) - 1;
+
+	maxlevel = SIMD_Level ();
+
+	Con_Printf ("usec per %ix%i screen of spans, texture, then z / turbulent\n", SPANBENCH_WIDTH, SPANBENCH_HEIGHT);
+	for (g=0 ; g<(int)(sizeof(spanbench_grads)/sizeof(spanbench_grads[0])) ; g++)
+	{
+		grad = &spanbench_grads[g];
+		d_sdivzorigin = grad->sdivzorigin;
+		d_sdivzstepu = grad->sdivzstepu;
+		d_sdivzstepv = grad->sdivzstepv;
+		d_tdivzorigin = grad->tdivzorigin;
+		d_tdivzstepu = grad->tdivzstepu;
+		d_tdivzstepv = grad->tdivzstepv;
+		d_ziorigin = grad->ziorigin;
+		d_zistepu = grad->zistepu;
+		d_zistepv = grad->zistepv;
+
+		d_viewbuffer = view;
+		start = Sys_FloatTime ();
+		for (i=0 ; i<SPANBENCH_LOOPS ; i++)
+			D_DrawSpans8 (spans);
+		ttex = (Sys_FloatTime () - start) / SPANBENCH_LOOPS;
+		Con_Printf ("%i: %5.0f,", g, ttex*1000000);
+
+		for (level=SIMD_NONE ; level<=maxlevel ; level++)
+		{
+			d_pzbuffer = level ? z : refz;
+			Q_memset (d_pzbuffer, 0, SPANBENCH_WIDTH*SPANBENCH_HEIGHT*sizeof(short));
+			Q_memset (level ? turb : refturb, 0, SPANBENCH_WIDTH*SPANBENCH_HEIGHT);
+
+			D_SpanBench (level, spans, level ? turb : refturb, &tz, &tturb);
+			Con_Printf (" %s %4.0f / %4.0f", SIMD_Name (level), tz*1000000, tturb*1000000);
+			if (level && (Q_memcmp (refz, z, SPANBENCH_WIDTH*SPANBENCH_HEIGHT*sizeof(short))
+			|| Q_memcmp (refturb, turb, SPANBENCH_WIDTH*SPANBENCH_HEIGHT)))
+				Con_Printf (" (MISMATCH)");
+		}
+		Con_Printf ("\n");
+	}
+
+	d_viewbuffer = save_viewbuffer;
+	screenwidth = save_screenwidth;
+	r_pixbytes = save_pixbytes;
+	d_pzbuffer = save_pzbuffer;
+	d_zwidth = save_zwidth;
+	cacheblock = save_cacheblock;
+	cachewidth = save_cachewidth;
+	sadjust = save_adjust[0];
+	tadjust = save_adjust[1];
+	bbextents = save_adjust[2];
+	bbextentt = save_adjust[3];
+	d_sdivzorigin = save_grad.sdivzorigin;
+	d_sdivzstepu = save_grad.sdivzstepu;
+	d_sdivzstepv = save_grad.sdivzstepv;
+	d_tdivzorigin = save_grad.tdivzorigin;
+	d_tdivzstepu = save_grad.tdivzstepu;
+	d_tdivzstepv = save_grad.tdivzstepv;
+	d_ziorigin = save_grad.ziorigin;
+	d_zistepu = save_grad.zistepu;
+	d_zistepv = save_grad.zistepv;
+}
@@ -25,6 +25,45 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define SKY_SPAN_SHIFT	5
 #define SKY_SPAN_MAX	(1 << SKY_SPAN_SHIFT)
+#define	SKY_NODES		(MAXWIDTH/SKY_SPAN_MAX + 2)
+
+typedef struct
+{
+	fixed16_t	s, t;
+} skynode_t;
+
+//
+// The sky's s and t are worked out exactly every SKY_SPAN_MAX pixels along
+// a row and stepped linearly between.  The exact points, the nodes, sit at
+// fixed columns so every span on a row shares them; a row's nodes are made
+// the first time a sky span lands on it in a frame.
+//
+
+static float		d_skyscale, d_skyshift;
+static int			d_skyframe;
+static int			d_skyrowframe[MAXHEIGHT];
+static skynode_t	d_skynodes[MAXHEIGHT][SKY_NODES];
+
+
+/*
+=================
+D_SkySetupFrame
+
+Called by D_SetupFrame
+=================
+*/
+void D_SkySetupFrame (void)
+{
+	if (r_refdef.vrect.width >= r_refdef.vrect.height)
+		d_skyscale = 8192.0 / (float)r_refdef.vrect.width;
+	else
+		d_skyscale = 8192.0 / (float)r_refdef.vrect.height;
+
+	d_skyshift = skytime*skyspeed;
+
+// every row's nodes are out of date
+	d_skyframe++;
+}
 
 
 /*
@@ -34,16 +73,11 @@ D_Sky_uv_To_st
 */
 void D_Sky_uv_To_st (int u, int v, fixed16_t *s, fixed16_t *t)
 {
-	float	wu, wv, temp;
+	float	wu, wv;
 	vec3_t	end;
 
-	if (r_refdef.vrect.width >= r_refdef.vrect.height)
-		temp = (float)r_refdef.vrect.width;
-	else
-		temp = (float)r_refdef.vrect.height;
-
-	wu = 8192.0 * (float)(u-((int)vid.width>>1)) / temp;
-	wv = 8192.0 * (float)(((int)vid.height>>1)-v) / temp;
+	wu = d_skyscale * (float)(u-((int)vid.width>>1));
+	wv = d_skyscale * (float)(((int)vid.height>>1)-v);
 
 	end[0] = 4096*vpn[0] + wu*vright[0] + wv*vup[0];
 	end[1] = 4096*vpn[1] + wu*vright[1] + wv*vup[1];
@@ -51,9 +85,33 @@ void D_Sky_uv_To_st (int u, int v, fixed16_t *s, fixed16_t *t)
 	end[2] *= 3;
 	VectorNormalize (end);
 
-	temp = skytime*skyspeed;	// TODO: add D_SetupFrame & set this there
-	*s = (int)((temp + 6*(SKYSIZE/2-1)*end[0]) * 0x10000);
-	*t = (int)((temp + 6*(SKYSIZE/2-1)*end[1]) * 0x10000);
+	*s = (int)((d_skyshift + 6*(SKYSIZE/2-1)*end[0]) * 0x10000);
+	*t = (int)((d_skyshift + 6*(SKYSIZE/2-1)*end[1]) * 0x10000);
+}
+
+
+/*
+=================
+D_SkyRow
+
+The nodes of row v, made if this frame hasn't needed them yet
+=================
+*/
+static skynode_t *D_SkyRow (int v)
+{
+	int			i, numnodes;
+	skynode_t	*nodes;
+
+	nodes = d_skynodes[v];
+	if (d_skyrowframe[v] == d_skyframe)
+		return nodes;
+	d_skyrowframe[v] = d_skyframe;
+
+	numnodes = ((vid.width - 1) >> SKY_SPAN_SHIFT) + 2;
+	for (i=0 ; i<numnodes ; i++)
+		D_Sky_uv_To_st (i << SKY_SPAN_SHIFT, v, &nodes[i].s, &nodes[i].t);
+
+	return nodes;
 }
 
 
@@ -64,13 +122,12 @@ D_DrawSkyScans8
 */
 void D_DrawSkyScans8 (espan_t *pspan)
 {
-	int				count, spancount, u, v;
-	unsigned char	*pdest;
-	fixed16_t		s, t, snext, tnext, sstep, tstep;
-	int				spancountminus1;
+	int				count, spancount, u, node, frac;
+	unsigned char	*pdest, *pbase;
+	fixed16_t		s, t, sstep, tstep;
+	skynode_t		*nodes;
 
-	sstep = 0;	// keep compiler happy
-	tstep = 0;	// ditto
+	pbase = r_skysource;
 
 	do
 	{
@@ -78,61 +135,90 @@ void D_DrawSkyScans8 (espan_t *pspan)
 				(screenwidth * pspan->v) + pspan->u);
 
 		count = pspan->count;
-
-	// calculate the initial s & t
 		u = pspan->u;
-		v = pspan->v;
-		D_Sky_uv_To_st (u, v, &s, &t);
+		nodes = D_SkyRow (pspan->v);
 
 		do
 		{
-			if (count >= SKY_SPAN_MAX)
-				spancount = SKY_SPAN_MAX;
-			else
+		// step from the node at or left of u towards the next one
+			node = u >> SKY_SPAN_SHIFT;
+			frac = u & (SKY_SPAN_MAX - 1);
+
+			spancount = SKY_SPAN_MAX - frac;
+			if (spancount > count)
 				spancount = count;
 
 			count -= spancount;
+			u += spancount;
 
-			if (count)
+			sstep = (nodes[node+1].s - nodes[node].s) >> SKY_SPAN_SHIFT;
+			tstep = (nodes[node+1].t - nodes[node].t) >> SKY_SPAN_SHIFT;
+			s = nodes[node].s + sstep*frac;
+			t = nodes[node].t + tstep*frac;
+
+			do
 			{
-				u += spancount;
+				*pdest++ = pbase[((t & R_SKY_TMASK) >> 8) +
+						((s & R_SKY_SMASK) >> 16)];
+				s += sstep;
+				t += tstep;
+			} while (--spancount > 0);
 
-			// calculate s and t at far end of span,
-			// calculate s and t steps across span by shifting
-				D_Sky_uv_To_st (u, v, &snext, &tnext);
+		} while (count > 0);
+
+	} while ((pspan = pspan->pnext) != NULL);
+}
 
-				sstep = (snext - s) >> SKY_SPAN_SHIFT;
-				tstep = (tnext - t) >> SKY_SPAN_SHIFT;
-			}
-			else
-			{
-			// calculate s and t at last pixel in span,
-			// calculate s and t steps across span by division
-				spancountminus1 = (float)(spancount - 1);
 
-				if (spancountminus1 > 0)
-				{
-					u += spancountminus1;
-					D_Sky_uv_To_st (u, v, &snext, &tnext);
+/*
+=================
+D_DrawSkyScans32
+=================
+*/
+void D_DrawSkyScans32 (espan_t *pspan)
+{
+	int				count, spancount, u, node, frac;
+	unsigned		*pdest;
+	unsigned char	*pbase;
+	fixed16_t		s, t, sstep, tstep;
+	skynode_t		*nodes;
 
-					sstep = (snext - s) / spancountminus1;
-					tstep = (tnext - t) / spancountminus1;
-				}
-			}
+	pbase = r_skysource;
+
+	do
+	{
+		pdest = (unsigned *)d_viewbuffer + (screenwidth * pspan->v) + pspan->u;
+
+		count = pspan->count;
+		u = pspan->u;
+		nodes = D_SkyRow (pspan->v);
+
+		do
+		{
+			node = u >> SKY_SPAN_SHIFT;
+			frac = u & (SKY_SPAN_MAX - 1);
+
+			spancount = SKY_SPAN_MAX - frac;
+			if (spancount > count)
+				spancount = count;
+
+			count -= spancount;
+			u += spancount;
+
+			sstep = (nodes[node+1].s - nodes[node].s) >> SKY_SPAN_SHIFT;
+			tstep = (nodes[node+1].t - nodes[node].t) >> SKY_SPAN_SHIFT;
+			s = nodes[node].s + sstep*frac;
+			t = nodes[node].t + tstep*frac;
 
 			do
 			{
-				*pdest++ = r_skysource[((t & R_SKY_TMASK) >> 8) +
-						((s & R_SKY_SMASK) >> 16)];
+				*pdest++ = d_8to24table[pbase[((t & R_SKY_TMASK) >> 8) +
+						((s & R_SKY_SMASK) >> 16)]];
 				s += sstep;
 				t += tstep;
 			} while (--spancount > 0);
 
-			s = snext;
-			t = tnext;
-
 		} while (count > 0);
 
 	} while ((pspan = pspan->pnext) != NULL);
 }
-
@@ -114,7 +114,7 @@ surfcache_t     *D_SCAlloc (int width, int size)
 	if ((width < 0) || (width > 256))
 		Sys_Error ("D_SCAlloc: bad cache width %d\n", width);
 
-	if ((size <= 0) || (size > 0x10000))
+	if ((size <= 0) || (size > 0x10000 * r_pixbytes))
 		Sys_Error ("D_SCAlloc: bad cache size %d\n", size);
 
 	size = (int)((intptr_t)&((surfcache_t *)0)->data[size]);
@@ -169,7 +169,8 @@ surfcache_t     *D_SCAlloc (int width, int size)
 	new->width = width;
 // DEBUG
 	if (width > 0)
-		new->height = (size - sizeof(*new) + sizeof(new->data)) / width;
+		new->height = (size - sizeof(*new) + sizeof(new->data)) /
+				(width * r_pixbytes);
 
 	new->owner = NULL;              // should be set properly after return
 
@@ -272,7 +273,7 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 	surfscale = 1.0 / (1<<miplevel);
 	r_drawsurf.surfmip = miplevel;
 	r_drawsurf.surfwidth = surface->extents[0] >> miplevel;
-	r_drawsurf.rowbytes = r_drawsurf.surfwidth;
+	r_drawsurf.rowbytes = r_drawsurf.surfwidth * r_pixbytes;
 	r_drawsurf.surfheight = surface->extents[1] >> miplevel;
 
 //
@@ -280,8 +281,8 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 //
 	if (!cache)     // if a texture just animated, don't reallocate it
 	{
-		cache = D_SCAlloc (r_drawsurf.surfwidth,
-						   r_drawsurf.surfwidth * r_drawsurf.surfheight);
+		cache = D_SCAlloc (r_drawsurf.surfwidth, r_drawsurf.surfwidth *
+						   r_drawsurf.surfheight * r_pixbytes);
 		surface->cachespots[miplevel] = cache;
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
@@ -310,3 +311,205 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 
 	return surface->cachespots[miplevel];
 }
+
+
+/*
+=============================================================================
+
+DIRECT SURFACES
+
+With d_directspans set, a surface is drawn by D_DrawLitSpans8 straight from
+its texture and lightmap instead of being built into the surface cache and
+sampled from there.  Each screen pixel costs a texel, a lightmap sample and
+a colormap lookup instead of a single cache read, but no texel is lit that
+doesn't reach the screen, which only wins where a surface covers fewer
+pixels than it has texels.  The mip level keeps that rare, so at high
+resolutions the cache is faster.  The lightmap is point sampled, nearest
+the texel, so the lighting shows its 16 texel steps where the cache blends
+them.  Textures that aren't a power of two across and down are still cached.
+
+d_directbench times a view both ways and measures how far apart they look.
+
+=============================================================================
+*/
+
+#define	DIRECTBENCH_FRAMES	32
+
+byte		*d_littexture;
+int			d_litsmask, d_littmask, d_litwidthshift;
+int			d_litsoffset, d_littoffset;
+int			d_litlightwidth, d_litlightshift, d_litlighthalf;
+
+static int	d_directsurfs, d_directskipped;		// counted for d_directbench
+
+/*
+================
+D_LightSurface
+
+Sets up D_DrawLitSpans8 for a surface.  False if its texture isn't a power
+of two across and down, so can't be wrapped with a mask, or the buffer is 32
+bit color, and the surface has to be cached instead.
+================
+*/
+qboolean D_LightSurface (msurface_t *surface, int miplevel)
+{
+	texture_t	*mt;
+	int			width, height;
+
+	if (r_pixbytes != 1)
+		return false;
+
+	mt = R_TextureAnimation (surface->texinfo->texture);
+	width = mt->width >> miplevel;
+	height = mt->height >> miplevel;
+	if ((width & (width - 1)) || (height & (height - 1)))
+	{
+		d_directskipped++;
+		return false;
+	}
+	d_directsurfs++;
+
+	r_drawsurf.texture = mt;
+	r_drawsurf.lightadj[0] = d_lightstylevalue[surface->styles[0]];
+	r_drawsurf.lightadj[1] = d_lightstylevalue[surface->styles[1]];
+	r_drawsurf.lightadj[2] = d_lightstylevalue[surface->styles[2]];
+	r_drawsurf.lightadj[3] = d_lightstylevalue[surface->styles[3]];
+	r_drawsurf.surf = surface;
+	R_BuildLightMap ();
+
+	d_littexture = (byte *)mt + mt->offsets[miplevel];
+	d_litsmask = width - 1;
+	d_littmask = height - 1;
+	for (d_litwidthshift=0 ; (1<<d_litwidthshift) < width ; d_litwidthshift++)
+		;
+	d_litsoffset = surface->texturemins[0] >> miplevel;
+	d_littoffset = surface->texturemins[1] >> miplevel;
+
+	d_litlightwidth = (surface->extents[0]>>4)+1;
+	d_litlightshift = 4 - miplevel;
+	d_litlighthalf = 8 >> miplevel;
+
+	return true;
+}
+
+/*
+================
+D_DirectBenchFrames
+
+Seconds per frame of the current view, with the surface cache flushed before
+each frame if cold, as it mostly is while the view moves
+================
+*/
+static double D_DirectBenchFrames (qboolean cold)
+{
+	int		i;
+	double	start, time;
+
+	time = 0;
+	for (i=0 ; i<DIRECTBENCH_FRAMES ; i++)
+	{
+		if (cold)
+			D_FlushCaches ();
+		start = Sys_FloatTime ();
+		R_RenderView ();
+		time += Sys_FloatTime () - start;
+	}
+	return time / DIRECTBENCH_FRAMES;
+}
+
+/*
+================
+D_DirectBenchCopy
+
+Copies the view out of the screen
+================
+*/
+static void D_DirectBenchCopy (byte *out)
+{
+	int		v;
+	byte	*src;
+
+	src = vid.buffer + r_refdef.vrect.y*vid.rowbytes + r_refdef.vrect.x;
+	for (v=0 ; v<r_refdef.vrect.height ; v++)
+	{
+		Q_memcpy (out, src, r_refdef.vrect.width);
+		src += vid.rowbytes;
+		out += r_refdef.vrect.width;
+	}
+}
+
+/*
+================
+D_DirectBench_f
+
+For program optimization: times the current view drawn through the surface
+cache, cold and warm, and with d_directspans, and measures how far the
+direct pixels are from the cached ones in the base palette
+================
+*/
+void D_DirectBench_f (void)
+{
+	int		i, c, d, size, differ, maxdiff;
+	byte	*cached, *direct, *a, *b;
+	double	tcold, twarm, tdirect, sum;
+	float	save;
+
+	if (!cl.worldmodel)
+	{
+		Con_Printf ("no map running\n");
+		return;
+	}
+	if (r_pixbytes != 1)
+	{
+		Con_Printf ("d_directspans only draws 8 bit color\n");
+		return;
+	}
+
+	save = d_directspans.value;
+
+	d_directspans.value = 0;
+	tcold = D_DirectBenchFrames (true);
+	twarm = D_DirectBenchFrames (false);
+
+	d_directspans.value = 1;
+	d_directsurfs = d_directskipped = 0;
+	tdirect = D_DirectBenchFrames (false);
+
+	Con_Printf ("%ix%i view, msec per frame:\n", r_refdef.vrect.width, r_refdef.vrect.height);
+	Con_Printf ("cached cold %.2f, cached warm %.2f, direct %.2f\n", tcold*1000, twarm*1000, tdirect*1000);
+	Con_Printf ("%i surfaces direct, %i cached for non power of two textures\n",
+		d_directsurfs / DIRECTBENCH_FRAMES, d_directskipped / DIRECTBENCH_FRAMES);
+
+// the same view each way, compared by color
+	size = r_refdef.vrect.width * r_refdef.vrect.height;
+	cached = Hunk_TempAlloc (size*2);
+	direct = cached + size;
+
+	d_directspans.value = 0;
+	R_RenderView ();
+	D_DirectBenchCopy (cached);
+	d_directspans.value = 1;
+	R_RenderView ();
+	D_DirectBenchCopy (direct);
+	d_directspans.value = save;
+
+	differ = maxdiff = 0;
+	sum = 0;
+	for (i=0 ; i<size ; i++)
+	{
+		if (cached[i] == direct[i])
+			continue;
+		differ++;
+		a = host_basepal + cached[i]*3;
+		b = host_basepal + direct[i]*3;
+		for (c=0 ; c<3 ; c++)
+		{
+			d = abs (a[c] - b[c]);
+			sum += d;
+			if (d > maxdiff)
+				maxdiff = d;
+		}
+	}
+	Con_Printf ("%.1f%% of pixels differ, by %.2f on average and %i at most per channel\n",
+		differ*100.0/size, sum/(size*3), maxdiff);
+}
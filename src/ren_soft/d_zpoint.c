@@ -35,13 +35,16 @@ void D_DrawZPoint (void)
 	int		izi;
 	
 	pz = d_pzbuffer + (d_zwidth * r_zpointdesc.v) + r_zpointdesc.u;
-	pdest = d_viewbuffer + d_scantable[r_zpointdesc.v] + r_zpointdesc.u;
+	pdest = d_viewbuffer + (d_scantable[r_zpointdesc.v] + r_zpointdesc.u) * r_pixbytes;
 	izi = (int)(r_zpointdesc.zi * 0x8000);
 
 	if (*pz <= izi)
 	{
 		*pz = izi;
-		*pdest = r_zpointdesc.color;
+		if (r_pixbytes == 1)
+			*pdest = r_zpointdesc.color;
+		else
+			*(unsigned *)pdest = d_8to24table[r_zpointdesc.color];
 	}
 }
 
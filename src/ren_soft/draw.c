@@ -22,6 +22,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // vid buffer
 
 #include "quakedef.h"
+#include "d_local.h"
 
 typedef struct {
 	vrect_t	rect;
@@ -72,7 +73,7 @@ void Draw_Character (int x, int y, int num)
 {
 	byte			*dest;
 	byte			*source;
-	unsigned short	*pusdest;
+	unsigned		*pudest;
 	int				drawline;	
 	int				row, col;
 
@@ -102,6 +103,21 @@ void Draw_Character (int x, int y, int num)
 		drawline = 8;
 
 
+	if (r_pixbytes == 4)
+	{
+		pudest = (unsigned *)(vid.conbuffer + y*vid.conrowbytes) + x;
+
+		while (drawline--)
+		{
+			for (col=0 ; col<8 ; col++)
+				if (source[col])
+					pudest[col] = d_8to24table[source[col]];
+			source += 128;
+			pudest = (unsigned *)((byte *)pudest + vid.conrowbytes);
+		}
+		return;
+	}
+
 	dest = vid.conbuffer + y*vid.conrowbytes + x;
 
 	while (drawline--)
@@ -193,7 +209,7 @@ Draw_Pic
 void Draw_Pic (int x, int y, qpic_t *pic)
 {
 	byte			*dest, *source;
-	unsigned short	*pusdest;
+	unsigned		*pudest;
 	int				v, u;
 
 	if ((x < 0) ||
@@ -206,13 +222,29 @@ void Draw_Pic (int x, int y, qpic_t *pic)
 
 	source = pic->data;
 
-	dest = vid.buffer + y * vid.rowbytes + x;
+	if (r_pixbytes == 1)
+	{
+		dest = vid.buffer + y * vid.rowbytes + x;
 
-	for (v=0 ; v<pic->height ; v++)
+		for (v=0 ; v<pic->height ; v++)
+		{
+			Q_memcpy (dest, source, pic->width);
+			dest += vid.rowbytes;
+			source += pic->width;
+		}
+	}
+	else
 	{
-		Q_memcpy (dest, source, pic->width);
-		dest += vid.rowbytes;
-		source += pic->width;
+		pudest = (unsigned *)(vid.buffer + y * vid.rowbytes) + x;
+
+		for (v=0 ; v<pic->height ; v++)
+		{
+			for (u=0 ; u<pic->width ; u++)
+				pudest[u] = d_8to24table[source[u]];
+
+			pudest = (unsigned *)((byte *)pudest + vid.rowbytes);
+			source += pic->width;
+		}
 	}
 }
 
@@ -225,7 +257,7 @@ Draw_TransPic
 void Draw_TransPic (int x, int y, qpic_t *pic)
 {
 	byte	*dest, *source, tbyte;
-	unsigned short	*pusdest;
+	unsigned		*pudest;
 	int				v, u;
 
 	if (x < 0 || (unsigned)(x + pic->width) > vid.width || y < 0 ||
@@ -236,6 +268,22 @@ void Draw_TransPic (int x, int y, qpic_t *pic)
 		
 	source = pic->data;
 
+	if (r_pixbytes == 4)
+	{
+		pudest = (unsigned *)(vid.buffer + y * vid.rowbytes) + x;
+
+		for (v=0 ; v<pic->height ; v++)
+		{
+			for (u=0 ; u<pic->width ; u++)
+				if ( (tbyte=source[u]) != TRANSPARENT_COLOR)
+					pudest[u] = d_8to24table[tbyte];
+
+			pudest = (unsigned *)((byte *)pudest + vid.rowbytes);
+			source += pic->width;
+		}
+		return;
+	}
+
 	dest = vid.buffer + y * vid.rowbytes + x;
 
 	if (pic->width & 7)
@@ -288,7 +336,7 @@ Draw_TransPicTranslate
 void Draw_TransPicTranslate (int x, int y, qpic_t *pic, byte *translation)
 {
 	byte	*dest, *source, tbyte;
-	unsigned short	*pusdest;
+	unsigned		*pudest;
 	int				v, u;
 
 	if (x < 0 || (unsigned)(x + pic->width) > vid.width || y < 0 ||
@@ -299,6 +347,22 @@ void Draw_TransPicTranslate (int x, int y, qpic_t *pic, byte *translation)
 		
 	source = pic->data;
 
+	if (r_pixbytes == 4)
+	{
+		pudest = (unsigned *)(vid.buffer + y * vid.rowbytes) + x;
+
+		for (v=0 ; v<pic->height ; v++)
+		{
+			for (u=0 ; u<pic->width ; u++)
+				if ( (tbyte=source[u]) != TRANSPARENT_COLOR)
+					pudest[u] = d_8to24table[translation[tbyte]];
+
+			pudest = (unsigned *)((byte *)pudest + vid.rowbytes);
+			source += pic->width;
+		}
+		return;
+	}
+
 	dest = vid.buffer + y * vid.rowbytes + x;
 
 	if (pic->width & 7)
@@ -377,7 +441,7 @@ void Draw_ConsoleBackground (int lines)
 {
 	int				x, y, v;
 	byte			*src, *dest;
-	unsigned short	*pusdest;
+	unsigned		*pudest;
 	int				f, fstep;
 	qpic_t			*conback;
 	char			ver[100];
@@ -409,7 +473,18 @@ void Draw_ConsoleBackground (int lines)
 	{
 		v = (vid.conheight - lines + y)*200/vid.conheight;
 		src = conback->data + v*320;
-		if (vid.conwidth == 320)
+		if (r_pixbytes == 4)
+		{
+			pudest = (unsigned *)dest;
+			f = 0;
+			fstep = 320*0x10000/vid.conwidth;
+			for (x=0 ; x<vid.conwidth ; x++)
+			{
+				pudest[x] = d_8to24table[src[f>>16]];
+				f += fstep;
+			}
+		}
+		else if (vid.conwidth == 320)
 			memcpy (dest, src, vid.conwidth);
 		else
 		{
@@ -442,6 +517,26 @@ void R_DrawRect8 (vrect_t *prect, int rowbytes, byte *psrc,
 	byte	t;
 	int		i, j, srcdelta, destdelta;
 	byte	*pdest;
+	unsigned	*pudest;
+
+	if (r_pixbytes == 4)
+	{
+		pudest = (unsigned *)(vid.buffer + prect->y * vid.rowbytes) + prect->x;
+
+		for (i=0 ; i<prect->height ; i++)
+		{
+			for (j=0 ; j<prect->width ; j++)
+			{
+				t = psrc[j];
+				if (!transparent || t != TRANSPARENT_COLOR)
+					pudest[j] = d_8to24table[t];
+			}
+
+			psrc += rowbytes;
+			pudest = (unsigned *)((byte *)pudest + vid.rowbytes);
+		}
+		return;
+	}
 
 	pdest = vid.buffer + (prect->y * vid.rowbytes) + prect->x;
 
@@ -556,14 +651,26 @@ Fills a box of pixels with a single color
 void Draw_Fill (int x, int y, int w, int h, int c)
 {
 	byte			*dest;
-	unsigned short	*pusdest;
+	unsigned		*pudest;
 	unsigned		uc;
 	int				u, v;
 
-	dest = vid.buffer + y*vid.rowbytes + x;
-	for (v=0 ; v<h ; v++, dest += vid.rowbytes)
-		for (u=0 ; u<w ; u++)
-			dest[u] = c;
+	if (r_pixbytes == 1)
+	{
+		dest = vid.buffer + y*vid.rowbytes + x;
+		for (v=0 ; v<h ; v++, dest += vid.rowbytes)
+			for (u=0 ; u<w ; u++)
+				dest[u] = c;
+	}
+	else
+	{
+		uc = d_8to24table[c];
+
+		pudest = (unsigned *)(vid.buffer + y*vid.rowbytes) + x;
+		for (v=0 ; v<h ; v++, pudest = (unsigned *)((byte *)pudest + vid.rowbytes))
+			for (u=0 ; u<w ; u++)
+				pudest[u] = uc;
+	}
 }
 //=============================================================================
 
@@ -588,7 +695,12 @@ void Draw_FadeScreen (void)
 		for (x=0 ; x<vid.width ; x++)
 		{
 			if ((x & 3) != t)
-				pbuf[x] = 0;
+			{
+				if (r_pixbytes == 1)
+					pbuf[x] = 0;
+				else
+					((unsigned *)pbuf)[x] = d_8to24table[0];
+			}
 		}
 	}
 }
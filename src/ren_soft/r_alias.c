@@ -23,14 +23,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "r_local.h"
 #include "d_local.h"	// FIXME: shouldn't be needed (is needed for patch
 						// right now, but that should move)
+#include "simd.h"
 
 #define LIGHT_MIN	5		// lowest light value we'll allow, to avoid the
 							//  need for inner-loop light clamping
 
 mtriangle_t		*ptriangles;
-affinetridesc_t	r_affinetridesc;
+THREADLOCAL affinetridesc_t	r_affinetridesc;	// per thread for d_bin.c
 
-void *			acolormap;	// FIXME: should go away
+THREADLOCAL void	*acolormap;	// FIXME: should go away
 
 trivertx_t		*r_apverts;
 
@@ -80,6 +81,31 @@ void R_AliasTransformFinalVert (finalvert_t *fv, auxvert_t *av,
 	trivertx_t *pverts, stvert_t *pstverts);
 void R_AliasProjectFinalVert (finalvert_t *fv, auxvert_t *av);
 
+typedef void (*aliasclipfunc_t) (finalvert_t *fv, auxvert_t *av, stvert_t *pstverts,
+	trivertx_t *pverts, int numverts);
+typedef void (*aliasprojectfunc_t) (finalvert_t *fv, stvert_t *pstverts,
+	trivertx_t *pverts, int numverts);
+typedef void (*aliascornersfunc_t) (float basepts[8][3], auxvert_t *viewaux);
+
+static aliasclipfunc_t		r_aliasclip[SIMD_AVX2+1];
+static aliasprojectfunc_t	r_aliasproject[SIMD_AVX2+1];
+static aliascornersfunc_t	r_aliascorners[SIMD_AVX2+1];
+
+
+/*
+================
+R_AliasCacheCheck
+
+Loading a model can push others out of the cache, so the triangles and
+skins of binned models are drawn first
+================
+*/
+static void R_AliasCacheCheck (model_t *mod)
+{
+	if (d_binning && !Cache_Check (&mod->cache))
+		D_FlushBins ();
+}
+
 
 /*
 ================
@@ -102,6 +128,7 @@ qboolean R_AliasCheckBBox (void)
 
 	currententity->trivial_accept = 0;
 	pmodel = currententity->model;
+	R_AliasCacheCheck (pmodel);
 	pahdr = Mod_Extradata (pmodel);
 	pmdl = (mdl_t *)((byte *)pahdr + pahdr->model);
 
@@ -141,10 +168,9 @@ qboolean R_AliasCheckBBox (void)
 	zfullyclipped = true;
 
 	minz = 9999;
+	r_aliascorners[SIMD_Level ()] (basepts, viewaux);
 	for (i=0; i<8 ; i++)
 	{
-		R_AliasTransformVector  (&basepts[i][0], &viewaux[i].fv[0]);
-
 		if (viewaux[i].fv[2] < ALIAS_Z_CLIP_PLANE)
 		{
 		// we must clip points that are closer than the near clip plane
@@ -279,25 +305,7 @@ void R_AliasPreparePoints (void)
  	fv = pfinalverts;
 	av = pauxverts;
 
-	for (i=0 ; i<r_anumverts ; i++, fv++, av++, r_apverts++, pstverts++)
-	{
-		R_AliasTransformFinalVert (fv, av, r_apverts, pstverts);
-		if (av->fv[2] < ALIAS_Z_CLIP_PLANE)
-			fv->flags |= ALIAS_Z_CLIP;
-		else
-		{
-			 R_AliasProjectFinalVert (fv, av);
-
-			if (fv->v[0] < r_refdef.aliasvrect.x)
-				fv->flags |= ALIAS_LEFT_CLIP;
-			if (fv->v[1] < r_refdef.aliasvrect.y)
-				fv->flags |= ALIAS_TOP_CLIP;
-			if (fv->v[0] > r_refdef.aliasvrectright)
-				fv->flags |= ALIAS_RIGHT_CLIP;
-			if (fv->v[1] > r_refdef.aliasvrectbottom)
-				fv->flags |= ALIAS_BOTTOM_CLIP;
-		}
-	}
+	r_aliasclip[SIMD_Level ()] (fv, av, pstverts, r_apverts, r_anumverts);
 
 //
 // clip and draw all triangles
@@ -455,14 +463,25 @@ R_AliasTransformAndProjectFinalVerts
 ================
 */
 void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
+{
+	r_aliasproject[SIMD_Level ()] (fv, pstverts, r_apverts, r_anumverts);
+}
+
+
+/*
+================
+R_AliasProjectVerts_C
+
+Unclipped case; the transform is scaled so 1/z comes out 31 bits up
+================
+*/
+static void R_AliasProjectVerts_C (finalvert_t *fv, stvert_t *pstverts,
+	trivertx_t *pverts, int numverts)
 {
 	int			i, temp;
 	float		lightcos, *plightnormal, zi;
-	trivertx_t	*pverts;
-
-	pverts = r_apverts;
 
-	for (i=0 ; i<r_anumverts ; i++, fv++, pverts++, pstverts++)
+	for (i=0 ; i<numverts ; i++, fv++, pverts++, pstverts++)
 	{
 	// transform and project
 		zi = 1.0 / (DotProduct(pverts->v, aliastransform[2]) +
@@ -502,6 +521,54 @@ void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
 }
 
 
+/*
+================
+R_AliasClipVerts_C
+
+Clipped case; projects only the vertices in front of the near clip plane
+================
+*/
+static void R_AliasClipVerts_C (finalvert_t *fv, auxvert_t *av, stvert_t *pstverts,
+	trivertx_t *pverts, int numverts)
+{
+	int		i;
+
+	for (i=0 ; i<numverts ; i++, fv++, av++, pverts++, pstverts++)
+	{
+		R_AliasTransformFinalVert (fv, av, pverts, pstverts);
+		if (av->fv[2] < ALIAS_Z_CLIP_PLANE)
+			fv->flags |= ALIAS_Z_CLIP;
+		else
+		{
+			R_AliasProjectFinalVert (fv, av);
+
+			if (fv->v[0] < r_refdef.aliasvrect.x)
+				fv->flags |= ALIAS_LEFT_CLIP;
+			if (fv->v[1] < r_refdef.aliasvrect.y)
+				fv->flags |= ALIAS_TOP_CLIP;
+			if (fv->v[0] > r_refdef.aliasvrectright)
+				fv->flags |= ALIAS_RIGHT_CLIP;
+			if (fv->v[1] > r_refdef.aliasvrectbottom)
+				fv->flags |= ALIAS_BOTTOM_CLIP;
+		}
+	}
+}
+
+
+/*
+================
+R_AliasTransformCorners_C
+================
+*/
+static void R_AliasTransformCorners_C (float basepts[8][3], auxvert_t *viewaux)
+{
+	int		i;
+
+	for (i=0 ; i<8 ; i++)
+		R_AliasTransformVector (&basepts[i][0], &viewaux[i].fv[0]);
+}
+
+
 /*
 ================
 R_AliasProjectFinalVert
@@ -709,6 +776,7 @@ void R_AliasDrawModel (alight_t *plighting)
 			(((intptr_t)&finalverts[0] + CACHE_SIZE - 1) & ~(CACHE_SIZE - 1));
 	pauxverts = &auxverts[0];
 
+	R_AliasCacheCheck (currententity->model);
 	paliashdr = (aliashdr_t *)Mod_Extradata (currententity->model);
 	pmdl = (mdl_t *)((byte *)paliashdr + paliashdr->model);
 
@@ -740,3 +808,576 @@ void R_AliasDrawModel (alight_t *plighting)
 	else
 		R_AliasPreparePoints ();
 }
+
+
+/*
+===============================================================================
+
+VECTOR VERTICES
+
+The trivertx_t bytes of 4 or 8 vertices are unpacked into x, y and z vectors,
+transformed and projected together, and written back a finalvert_t at a time.
+The float operations are the ones the C versions do, in the same order, so the
+results are the same.  Lighting only depends on the normal index, so the
+vector versions light the normals once per model and look the vertices up.
+
+===============================================================================
+*/
+
+#define	ALIAS_LIGHTLEVELS	256		// every value a lightnormalindex can hold
+#define	ALIAS_MINBATCH		64		// fewer vertices are not worth the light table
+
+static int	r_alightlevels[ALIAS_LIGHTLEVELS];
+
+/*
+================
+R_AliasBuildLightLevels
+
+The light R_AliasTransformFinalVert gives each vertex normal; indexes past the
+normals get the ambient light
+================
+*/
+static void R_AliasBuildLightLevels (void)
+{
+	int		i, temp;
+	float	lightcos;
+
+	for (i=0 ; i<NUMVERTEXNORMALS ; i++)
+	{
+		lightcos = DotProduct (r_avertexnormals[i], r_plightvec);
+		temp = r_ambientlight;
+
+		if (lightcos < 0)
+		{
+			temp += (int)(r_shadelight * lightcos);
+			if (temp < 0)
+				temp = 0;
+		}
+
+		r_alightlevels[i] = temp;
+	}
+
+	for ( ; i<ALIAS_LIGHTLEVELS ; i++)
+		r_alightlevels[i] = r_ambientlight;
+}
+
+#if SIMD_X86
+
+/*
+================
+R_AliasUnpack_SSE2
+================
+*/
+SIMD_TARGET("sse2") static inline void R_AliasUnpack_SSE2 (trivertx_t *pverts,
+	__m128 *x, __m128 *y, __m128 *z, int *normals)
+{
+	__m128i	raw, mask;
+
+	raw = _mm_loadu_si128 ((__m128i *)pverts);
+	mask = _mm_set1_epi32 (0xff);
+
+	*x = _mm_cvtepi32_ps (_mm_and_si128 (raw, mask));
+	*y = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 8), mask));
+	*z = _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (raw, 16), mask));
+	_mm_storeu_si128 ((__m128i *)normals, _mm_srli_epi32 (raw, 24));
+}
+
+/*
+================
+R_AliasTransform_SSE2
+
+One row of aliastransform, DotProduct order
+================
+*/
+SIMD_TARGET("sse2") static inline __m128 R_AliasTransform_SSE2 (__m128 x, __m128 y, __m128 z, float *row)
+{
+	__m128	d;
+
+	d = _mm_add_ps (_mm_mul_ps (x, _mm_set1_ps (row[0])), _mm_mul_ps (y, _mm_set1_ps (row[1])));
+	d = _mm_add_ps (d, _mm_mul_ps (z, _mm_set1_ps (row[2])));
+	return _mm_add_ps (d, _mm_set1_ps (row[3]));
+}
+
+/*
+================
+R_AliasProjectVerts_SSE2
+================
+*/
+SIMD_TARGET("sse2") static void R_AliasProjectVerts_SSE2 (finalvert_t *fv, stvert_t *pstverts,
+	trivertx_t *pverts, int numverts)
+{
+	int		i, k;
+	int		u[4], v[4], izi[4], normals[4];
+	__m128	x, y, z, zi;
+
+	if (numverts < ALIAS_MINBATCH)
+	{
+		R_AliasProjectVerts_C (fv, pstverts, pverts, numverts);
+		return;
+	}
+
+	R_AliasBuildLightLevels ();
+
+	for (i=0 ; i+4<=numverts ; i+=4)
+	{
+		R_AliasUnpack_SSE2 (pverts + i, &x, &y, &z, normals);
+
+		zi = _mm_div_ps (_mm_set1_ps (1), R_AliasTransform_SSE2 (x, y, z, aliastransform[2]));
+		_mm_storeu_si128 ((__m128i *)izi, _mm_cvttps_epi32 (zi));
+		_mm_storeu_si128 ((__m128i *)u, _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (
+			R_AliasTransform_SSE2 (x, y, z, aliastransform[0]), zi), _mm_set1_ps (aliasxcenter))));
+		_mm_storeu_si128 ((__m128i *)v, _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (
+			R_AliasTransform_SSE2 (x, y, z, aliastransform[1]), zi), _mm_set1_ps (aliasycenter))));
+
+		for (k=0 ; k<4 ; k++, fv++, pstverts++)
+		{
+			fv->v[0] = u[k];
+			fv->v[1] = v[k];
+			fv->v[2] = pstverts->s;
+			fv->v[3] = pstverts->t;
+			fv->v[4] = r_alightlevels[normals[k]];
+			fv->v[5] = izi[k];
+			fv->flags = pstverts->onseam;
+		}
+	}
+
+	R_AliasProjectVerts_C (fv, pstverts, pverts + i, numverts - i);
+}
+
+/*
+================
+R_AliasClipVerts_SSE2
+================
+*/
+SIMD_TARGET("sse2") static void R_AliasClipVerts_SSE2 (finalvert_t *fv, auxvert_t *av,
+	stvert_t *pstverts, trivertx_t *pverts, int numverts)
+{
+	int		i, k;
+	int		u[4], v[4], izi[4], normals[4];
+	float	fx[4], fy[4], fz[4];
+	__m128	x, y, z, vx, vy, vz, zi;
+
+	if (numverts < ALIAS_MINBATCH)
+	{
+		R_AliasClipVerts_C (fv, av, pstverts, pverts, numverts);
+		return;
+	}
+
+	R_AliasBuildLightLevels ();
+
+	for (i=0 ; i+4<=numverts ; i+=4)
+	{
+		R_AliasUnpack_SSE2 (pverts + i, &x, &y, &z, normals);
+
+		vx = R_AliasTransform_SSE2 (x, y, z, aliastransform[0]);
+		vy = R_AliasTransform_SSE2 (x, y, z, aliastransform[1]);
+		vz = R_AliasTransform_SSE2 (x, y, z, aliastransform[2]);
+		_mm_storeu_ps (fx, vx);
+		_mm_storeu_ps (fy, vy);
+		_mm_storeu_ps (fz, vz);
+
+	// projected whether or not they are clipped, only unclipped ones are kept
+		zi = _mm_div_ps (_mm_set1_ps (1), vz);
+		_mm_storeu_si128 ((__m128i *)izi, _mm_cvttps_epi32 (_mm_mul_ps (zi, _mm_set1_ps (ziscale))));
+		_mm_storeu_si128 ((__m128i *)u, _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (
+			_mm_mul_ps (vx, _mm_set1_ps (aliasxscale)), zi), _mm_set1_ps (aliasxcenter))));
+		_mm_storeu_si128 ((__m128i *)v, _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (
+			_mm_mul_ps (vy, _mm_set1_ps (aliasyscale)), zi), _mm_set1_ps (aliasycenter))));
+
+		for (k=0 ; k<4 ; k++, fv++, av++, pstverts++)
+		{
+			av->fv[0] = fx[k];
+			av->fv[1] = fy[k];
+			av->fv[2] = fz[k];
+
+			fv->v[2] = pstverts->s;
+			fv->v[3] = pstverts->t;
+			fv->v[4] = r_alightlevels[normals[k]];
+			fv->flags = pstverts->onseam;
+
+			if (fz[k] < ALIAS_Z_CLIP_PLANE)
+			{
+				fv->flags |= ALIAS_Z_CLIP;
+				continue;
+			}
+
+			fv->v[0] = u[k];
+			fv->v[1] = v[k];
+			fv->v[5] = izi[k];
+
+			if (fv->v[0] < r_refdef.aliasvrect.x)
+				fv->flags |= ALIAS_LEFT_CLIP;
+			if (fv->v[1] < r_refdef.aliasvrect.y)
+				fv->flags |= ALIAS_TOP_CLIP;
+			if (fv->v[0] > r_refdef.aliasvrectright)
+				fv->flags |= ALIAS_RIGHT_CLIP;
+			if (fv->v[1] > r_refdef.aliasvrectbottom)
+				fv->flags |= ALIAS_BOTTOM_CLIP;
+		}
+	}
+
+	R_AliasClipVerts_C (fv, av, pstverts, pverts + i, numverts - i);
+}
+
+/*
+================
+R_AliasTransformCorners_SSE2
+================
+*/
+SIMD_TARGET("sse2") static void R_AliasTransformCorners_SSE2 (float basepts[8][3], auxvert_t *viewaux)
+{
+	int		i, k;
+	float	out[3][4];
+	__m128	x, y, z;
+
+	for (i=0 ; i<8 ; i+=4)
+	{
+		x = _mm_setr_ps (basepts[i][0], basepts[i+1][0], basepts[i+2][0], basepts[i+3][0]);
+		y = _mm_setr_ps (basepts[i][1], basepts[i+1][1], basepts[i+2][1], basepts[i+3][1]);
+		z = _mm_setr_ps (basepts[i][2], basepts[i+1][2], basepts[i+2][2], basepts[i+3][2]);
+
+		_mm_storeu_ps (out[0], R_AliasTransform_SSE2 (x, y, z, aliastransform[0]));
+		_mm_storeu_ps (out[1], R_AliasTransform_SSE2 (x, y, z, aliastransform[1]));
+		_mm_storeu_ps (out[2], R_AliasTransform_SSE2 (x, y, z, aliastransform[2]));
+
+		for (k=0 ; k<4 ; k++)
+		{
+			viewaux[i+k].fv[0] = out[0][k];
+			viewaux[i+k].fv[1] = out[1][k];
+			viewaux[i+k].fv[2] = out[2][k];
+		}
+	}
+}
+
+/*
+================
+R_AliasUnpack_AVX2
+================
+*/
+SIMD_TARGET("avx2") static inline void R_AliasUnpack_AVX2 (trivertx_t *pverts,
+	__m256 *x, __m256 *y, __m256 *z, int *normals)
+{
+	__m256i	raw, mask;
+
+	raw = _mm256_loadu_si256 ((__m256i *)pverts);
+	mask = _mm256_set1_epi32 (0xff);
+
+	*x = _mm256_cvtepi32_ps (_mm256_and_si256 (raw, mask));
+	*y = _mm256_cvtepi32_ps (_mm256_and_si256 (_mm256_srli_epi32 (raw, 8), mask));
+	*z = _mm256_cvtepi32_ps (_mm256_and_si256 (_mm256_srli_epi32 (raw, 16), mask));
+	_mm256_storeu_si256 ((__m256i *)normals, _mm256_srli_epi32 (raw, 24));
+}
+
+/*
+================
+R_AliasTransform_AVX2
+================
+*/
+SIMD_TARGET("avx2") static inline __m256 R_AliasTransform_AVX2 (__m256 x, __m256 y, __m256 z, float *row)
+{
+	__m256	d;
+
+	d = _mm256_add_ps (_mm256_mul_ps (x, _mm256_set1_ps (row[0])), _mm256_mul_ps (y, _mm256_set1_ps (row[1])));
+	d = _mm256_add_ps (d, _mm256_mul_ps (z, _mm256_set1_ps (row[2])));
+	return _mm256_add_ps (d, _mm256_set1_ps (row[3]));
+}
+
+/*
+================
+R_AliasProjectVerts_AVX2
+================
+*/
+SIMD_TARGET("avx2") static void R_AliasProjectVerts_AVX2 (finalvert_t *fv, stvert_t *pstverts,
+	trivertx_t *pverts, int numverts)
+{
+	int		i, k;
+	int		u[8], v[8], izi[8], normals[8];
+	__m256	x, y, z, zi;
+
+	if (numverts < ALIAS_MINBATCH)
+	{
+		R_AliasProjectVerts_C (fv, pstverts, pverts, numverts);
+		return;
+	}
+
+	R_AliasBuildLightLevels ();
+
+	for (i=0 ; i+8<=numverts ; i+=8)
+	{
+		R_AliasUnpack_AVX2 (pverts + i, &x, &y, &z, normals);
+
+		zi = _mm256_div_ps (_mm256_set1_ps (1), R_AliasTransform_AVX2 (x, y, z, aliastransform[2]));
+		_mm256_storeu_si256 ((__m256i *)izi, _mm256_cvttps_epi32 (zi));
+		_mm256_storeu_si256 ((__m256i *)u, _mm256_cvttps_epi32 (_mm256_add_ps (_mm256_mul_ps (
+			R_AliasTransform_AVX2 (x, y, z, aliastransform[0]), zi), _mm256_set1_ps (aliasxcenter))));
+		_mm256_storeu_si256 ((__m256i *)v, _mm256_cvttps_epi32 (_mm256_add_ps (_mm256_mul_ps (
+			R_AliasTransform_AVX2 (x, y, z, aliastransform[1]), zi), _mm256_set1_ps (aliasycenter))));
+
+		for (k=0 ; k<8 ; k++, fv++, pstverts++)
+		{
+			fv->v[0] = u[k];
+			fv->v[1] = v[k];
+			fv->v[2] = pstverts->s;
+			fv->v[3] = pstverts->t;
+			fv->v[4] = r_alightlevels[normals[k]];
+			fv->v[5] = izi[k];
+			fv->flags = pstverts->onseam;
+		}
+	}
+
+	R_AliasProjectVerts_C (fv, pstverts, pverts + i, numverts - i);
+}
+
+/*
+================
+R_AliasClipVerts_AVX2
+================
+*/
+SIMD_TARGET("avx2") static void R_AliasClipVerts_AVX2 (finalvert_t *fv, auxvert_t *av,
+	stvert_t *pstverts, trivertx_t *pverts, int numverts)
+{
+	int		i, k;
+	int		u[8], v[8], izi[8], normals[8];
+	float	fx[8], fy[8], fz[8];
+	__m256	x, y, z, vx, vy, vz, zi;
+
+	if (numverts < ALIAS_MINBATCH)
+	{
+		R_AliasClipVerts_C (fv, av, pstverts, pverts, numverts);
+		return;
+	}
+
+	R_AliasBuildLightLevels ();
+
+	for (i=0 ; i+8<=numverts ; i+=8)
+	{
+		R_AliasUnpack_AVX2 (pverts + i, &x, &y, &z, normals);
+
+		vx = R_AliasTransform_AVX2 (x, y, z, aliastransform[0]);
+		vy = R_AliasTransform_AVX2 (x, y, z, aliastransform[1]);
+		vz = R_AliasTransform_AVX2 (x, y, z, aliastransform[2]);
+		_mm256_storeu_ps (fx, vx);
+		_mm256_storeu_ps (fy, vy);
+		_mm256_storeu_ps (fz, vz);
+
+		zi = _mm256_div_ps (_mm256_set1_ps (1), vz);
+		_mm256_storeu_si256 ((__m256i *)izi, _mm256_cvttps_epi32 (_mm256_mul_ps (zi, _mm256_set1_ps (ziscale))));
+		_mm256_storeu_si256 ((__m256i *)u, _mm256_cvttps_epi32 (_mm256_add_ps (_mm256_mul_ps (
+			_mm256_mul_ps (vx, _mm256_set1_ps (aliasxscale)), zi), _mm256_set1_ps (aliasxcenter))));
+		_mm256_storeu_si256 ((__m256i *)v, _mm256_cvttps_epi32 (_mm256_add_ps (_mm256_mul_ps (
+			_mm256_mul_ps (vy, _mm256_set1_ps (aliasyscale)), zi), _mm256_set1_ps (aliasycenter))));
+
+		for (k=0 ; k<8 ; k++, fv++, av++, pstverts++)
+		{
+			av->fv[0] = fx[k];
+			av->fv[1] = fy[k];
+			av->fv[2] = fz[k];
+
+			fv->v[2] = pstverts->s;
+			fv->v[3] = pstverts->t;
+			fv->v[4] = r_alightlevels[normals[k]];
+			fv->flags = pstverts->onseam;
+
+			if (fz[k] < ALIAS_Z_CLIP_PLANE)
+			{
+				fv->flags |= ALIAS_Z_CLIP;
+				continue;
+			}
+
+			fv->v[0] = u[k];
+			fv->v[1] = v[k];
+			fv->v[5] = izi[k];
+
+			if (fv->v[0] < r_refdef.aliasvrect.x)
+				fv->flags |= ALIAS_LEFT_CLIP;
+			if (fv->v[1] < r_refdef.aliasvrect.y)
+				fv->flags |= ALIAS_TOP_CLIP;
+			if (fv->v[0] > r_refdef.aliasvrectright)
+				fv->flags |= ALIAS_RIGHT_CLIP;
+			if (fv->v[1] > r_refdef.aliasvrectbottom)
+				fv->flags |= ALIAS_BOTTOM_CLIP;
+		}
+	}
+
+	R_AliasClipVerts_C (fv, av, pstverts, pverts + i, numverts - i);
+}
+
+static aliasclipfunc_t		r_aliasclip[SIMD_AVX2+1] =
+	{R_AliasClipVerts_C, R_AliasClipVerts_SSE2, R_AliasClipVerts_SSE2, R_AliasClipVerts_AVX2};
+static aliasprojectfunc_t	r_aliasproject[SIMD_AVX2+1] =
+	{R_AliasProjectVerts_C, R_AliasProjectVerts_SSE2, R_AliasProjectVerts_SSE2, R_AliasProjectVerts_AVX2};
+static aliascornersfunc_t	r_aliascorners[SIMD_AVX2+1] =
+	{R_AliasTransformCorners_C, R_AliasTransformCorners_SSE2, R_AliasTransformCorners_SSE2, R_AliasTransformCorners_SSE2};
+
+#else	// !SIMD_X86
+
+static aliasclipfunc_t		r_aliasclip[SIMD_AVX2+1] =
+	{R_AliasClipVerts_C, R_AliasClipVerts_C, R_AliasClipVerts_C, R_AliasClipVerts_C};
+static aliasprojectfunc_t	r_aliasproject[SIMD_AVX2+1] =
+	{R_AliasProjectVerts_C, R_AliasProjectVerts_C, R_AliasProjectVerts_C, R_AliasProjectVerts_C};
+static aliascornersfunc_t	r_aliascorners[SIMD_AVX2+1] =
+	{R_AliasTransformCorners_C, R_AliasTransformCorners_C, R_AliasTransformCorners_C, R_AliasTransformCorners_C};
+
+#endif	// SIMD_X86
+
+
+#define	ALIASBENCH_CROWD	64
+#define	ALIASBENCH_LOOPS	16
+
+/*
+================
+R_AliasBenchModel
+
+The precached alias model with the most vertices
+================
+*/
+static model_t *R_AliasBenchModel (void)
+{
+	int			i, numverts, best;
+	model_t		*mod, *bestmod;
+	aliashdr_t	*pahdr;
+
+	bestmod = NULL;
+	best = 0;
+	for (i=1 ; i<MAX_MODELS && cl.model_precache[i] ; i++)
+	{
+		mod = cl.model_precache[i];
+		if (mod->type != mod_alias)
+			continue;
+
+		pahdr = Mod_Extradata (mod);
+		numverts = ((mdl_t *)((byte *)pahdr + pahdr->model))->numverts;
+		if (numverts > best)
+		{
+			best = numverts;
+			bestmod = mod;
+		}
+	}
+
+	return bestmod;
+}
+
+/*
+================
+R_AliasBench
+
+Seconds to set up and transform the crowd once
+================
+*/
+static double R_AliasBench (int level, entity_t *crowd, qboolean clipped,
+	finalvert_t *fv, auxvert_t *av)
+{
+	int			i, j, numverts;
+	stvert_t	*pstverts;
+	alight_t	lighting;
+	float		lightvec[3] = {-1, 0, 0};
+	double		start;
+
+	lighting.ambientlight = 64;
+	lighting.shadelight = 96;
+	lighting.plightvec = lightvec;
+
+	pstverts = (stvert_t *)((byte *)paliashdr + paliashdr->stverts);
+	numverts = pmdl->numverts;
+
+	start = Sys_FloatTime ();
+	for (i=0 ; i<ALIASBENCH_LOOPS ; i++)
+	{
+		for (j=0 ; j<ALIASBENCH_CROWD ; j++)
+		{
+			currententity = &crowd[j];
+			VectorSubtract (r_origin, currententity->origin, modelorg);
+
+			R_AliasSetUpTransform (!clipped);
+			R_AliasSetupLighting (&lighting);
+			R_AliasSetupFrame ();
+
+			if (clipped)
+				r_aliasclip[level] (fv + j*numverts, av + j*numverts, pstverts, r_apverts, numverts);
+			else
+				r_aliasproject[level] (fv + j*numverts, pstverts, r_apverts, numverts);
+		}
+	}
+
+	return (Sys_FloatTime () - start) / ALIASBENCH_LOOPS;
+}
+
+/*
+================
+R_AliasBench_f
+
+For program optimization: sets up a crowd of the biggest alias model in
+front of the view, times the vertex transform and lighting for the clipped
+and unclipped cases at every available SIMD level, and checks the vertices
+against the C version
+================
+*/
+void R_AliasBench_f (void)
+{
+	int			i, c, level, maxlevel, numverts, size;
+	model_t		*mod;
+	entity_t	*crowd, *savedentity;
+	finalvert_t	*reffv, *fv;
+	auxvert_t	*refav, *av;
+	vec3_t		savedorg;
+	double		t;
+
+	mod = R_AliasBenchModel ();
+	if (!mod)
+	{
+		Con_Printf ("no alias models loaded\n");
+		return;
+	}
+
+	paliashdr = Mod_Extradata (mod);
+	pmdl = (mdl_t *)((byte *)paliashdr + paliashdr->model);
+	numverts = pmdl->numverts;
+
+	size = ALIASBENCH_CROWD*numverts;
+	crowd = Hunk_TempAlloc (ALIASBENCH_CROWD*sizeof(entity_t)
+		+ size*2*(sizeof(finalvert_t) + sizeof(auxvert_t)));
+	reffv = (finalvert_t *)(crowd + ALIASBENCH_CROWD);
+	fv = reffv + size;
+	refav = (auxvert_t *)(fv + size);
+	av = refav + size;
+
+// rows of models walking away from the view, the nearest row through the
+// near clip plane
+	Q_memset (crowd, 0, ALIASBENCH_CROWD*sizeof(entity_t));
+	for (i=0 ; i<ALIASBENCH_CROWD ; i++)
+	{
+		crowd[i].model = mod;
+		crowd[i].frame = i % pmdl->numframes;
+		crowd[i].angles[YAW] = i*37;
+		crowd[i].colormap = vid.colormap;
+		VectorMA (r_origin, 8 + (i/8)*48, vpn, crowd[i].origin);
+		VectorMA (crowd[i].origin, ((i&7) - 3.5)*40, vright, crowd[i].origin);
+	}
+
+	savedentity = currententity;
+	VectorCopy (modelorg, savedorg);
+	ziscale = (float)0x8000 * (float)0x10000;
+
+	maxlevel = SIMD_Level ();
+
+	Con_Printf ("%s, %i verts, usec per crowd of %i\n", mod->name, numverts, ALIASBENCH_CROWD);
+	for (c=0 ; c<2 ; c++)
+	{
+		Con_Printf (c ? "clipped:  " : "unclipped:");
+		for (level=SIMD_NONE ; level<=maxlevel ; level++)
+		{
+			Q_memset (level ? fv : reffv, 0, size*sizeof(finalvert_t));
+			Q_memset (level ? av : refav, 0, size*sizeof(auxvert_t));
+
+			t = R_AliasBench (level, crowd, c, level ? fv : reffv, level ? av : refav);
+			Con_Printf (" %s %6.1f", SIMD_Name (level), t*1000000);
+			if (level && (Q_memcmp (reffv, fv, size*sizeof(finalvert_t))
+			|| Q_memcmp (refav, av, size*sizeof(auxvert_t))))
+				Con_Printf (" (MISMATCH)");
+		}
+		Con_Printf ("\n");
+	}
+
+	currententity = savedentity;
+	VectorCopy (savedorg, modelorg);
+}
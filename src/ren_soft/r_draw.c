@@ -69,6 +69,251 @@ int				r_ceilv1;
 
 qboolean	r_lastvertvalid;
 
+/*
+=============================================================================
+
+EDGE PROJECTIONS
+
+cachededgeoffset only lets the faces drawn in one frame share an edge.  With
+r_edgecache set, what each world edge projected to is also kept in
+r_edgeprojs, so while the camera doesn't move (menus, intermissions,
+spectating) an edge is put straight back into the edge lists instead of being
+clipped and projected again.  Edges that were partly clipped aren't kept, as
+they leave clip vertices behind for the face's left and right edges.
+
+=============================================================================
+*/
+
+cvar_t	r_edgecache = {"r_edgecache", "0"};
+
+#define	EP_CLIPPED		0		// off screen
+#define	EP_HORIZONTAL	1		// on no scan line, only the 1/z counts
+#define	EP_EDGE			2
+
+typedef struct
+{
+	int			epoch;			// r_edgeepoch when projected, 0 for never
+	int			clipflags;		// view planes it was clipped against
+	int			kind;
+	int			side;			// going from v[0] to v[1]
+	fixed16_t	u, u_step;
+	float		nearzi;
+	int			v, v2;			// first and last scan
+} edgeproj_t;
+
+// everything an edge's projection depends on
+typedef struct
+{
+	vec3_t		origin, vpn, vright, vup;
+	float		xcenter, ycenter, xscale, yscale;
+	float		fvrectx_adj, fvrecty_adj, fvrectright_adj, fvrectbottom_adj;
+	int			vrect_x_adj_shift20, vrectright_adj_shift20;
+	vec3_t		clipnormal[4];
+	float		clipdist[4];
+} edgeview_t;
+
+static edgeproj_t	*r_edgeprojs;
+static int			r_numedgeprojs;
+static edgeproj_t	*r_edgeproj;		// being filled in by R_EmitEdge
+static int			r_edgeepoch;
+static edgeview_t	r_edgeview;
+
+int			c_edgesprojected, c_edgesreused;
+
+
+/*
+================
+R_AllocEdgeProjections
+
+Called by R_NewMap
+================
+*/
+void R_AllocEdgeProjections (void)
+{
+	r_numedgeprojs = cl.worldmodel->numedges;
+	r_edgeprojs = Hunk_AllocName (r_numedgeprojs * sizeof(edgeproj_t),
+								  "edgeproj");
+	r_edgeepoch++;
+}
+
+
+/*
+================
+R_BeginEdgeProjection
+
+Called before the world is drawn; starts a new epoch if the view has changed
+================
+*/
+void R_BeginEdgeProjection (void)
+{
+	int			i;
+	edgeview_t	view;
+
+	memset (&view, 0, sizeof(view));
+	VectorCopy (r_origin, view.origin);
+	VectorCopy (vpn, view.vpn);
+	VectorCopy (vright, view.vright);
+	VectorCopy (vup, view.vup);
+	view.xcenter = xcenter;
+	view.ycenter = ycenter;
+	view.xscale = xscale;
+	view.yscale = yscale;
+	view.fvrectx_adj = r_refdef.fvrectx_adj;
+	view.fvrecty_adj = r_refdef.fvrecty_adj;
+	view.fvrectright_adj = r_refdef.fvrectright_adj;
+	view.fvrectbottom_adj = r_refdef.fvrectbottom_adj;
+	view.vrect_x_adj_shift20 = r_refdef.vrect_x_adj_shift20;
+	view.vrectright_adj_shift20 = r_refdef.vrectright_adj_shift20;
+	for (i=0 ; i<4 ; i++)
+	{
+		VectorCopy (view_clipplanes[i].normal, view.clipnormal[i]);
+		view.clipdist[i] = view_clipplanes[i].dist;
+	}
+
+	if (memcmp (&view, &r_edgeview, sizeof(view)))
+	{
+		r_edgeview = view;
+		if (++r_edgeepoch <= 0)
+		{
+		// wrapped, so old projections could look current
+			memset (r_edgeprojs, 0, r_numedgeprojs * sizeof(edgeproj_t));
+			r_edgeepoch = 1;
+		}
+	}
+
+	c_edgesprojected = 0;
+	c_edgesreused = 0;
+}
+
+
+/*
+================
+R_SortEdge
+
+Sorts a new edge into the scan line it starts on
+================
+*/
+static void R_SortEdge (edge_t *edge, int v, int v2)
+{
+	edge_t	*pcheck;
+	int		u_check;
+
+	u_check = edge->u;
+	if (edge->surfs[0])
+		u_check++;	// sort trailers after leaders
+
+	if (!newedges[v] || newedges[v]->u >= u_check)
+	{
+		edge->next = newedges[v];
+		newedges[v] = edge;
+	}
+	else
+	{
+		pcheck = newedges[v];
+		while (pcheck->next && pcheck->next->u < u_check)
+			pcheck = pcheck->next;
+		edge->next = pcheck->next;
+		pcheck->next = edge;
+	}
+
+	edge->nextremove = removeedges[v2];
+	removeedges[v2] = edge;
+}
+
+
+/*
+================
+R_EmitProjectedEdge
+
+Puts back an edge the way it was projected last frame
+================
+*/
+static void R_EmitProjectedEdge (edgeproj_t *pproj, int reversed)
+{
+	edge_t	*edge;
+
+	c_edgesreused++;
+
+	if (pproj->kind == EP_CLIPPED)
+	{
+		r_pedge->cachededgeoffset = FULLY_CLIPPED_CACHED |
+				(r_framecount & FRAMECOUNT_MASK);
+		return;
+	}
+
+	if (pproj->nearzi > r_nearzi)	// for mipmap finding
+		r_nearzi = pproj->nearzi;
+	r_emitted = 1;
+
+	if (pproj->kind == EP_HORIZONTAL)
+	{
+	// horizontal edges are cached as fully clipped
+		r_pedge->cachededgeoffset = FULLY_CLIPPED_CACHED |
+				(r_framecount & FRAMECOUNT_MASK);
+		return;
+	}
+
+	r_pedge->cachededgeoffset = (byte *)edge_p - (byte *)r_edges;
+	edge = edge_p++;
+
+	edge->owner = r_pedge;
+	edge->nearzi = pproj->nearzi;
+
+	if ((pproj->side ^ reversed) == 0)
+	{
+		edge->surfs[0] = surface_p - surfaces;
+		edge->surfs[1] = 0;
+	}
+	else
+	{
+		edge->surfs[0] = 0;
+		edge->surfs[1] = surface_p - surfaces;
+	}
+
+	edge->u = pproj->u;
+	edge->u_step = pproj->u_step;
+
+	R_SortEdge (edge, pproj->v, pproj->v2);
+}
+
+
+/*
+================
+R_ProjectEdge
+
+Clips and emits a world edge, keeping its projection for later frames if it
+wasn't partly clipped
+================
+*/
+static void R_ProjectEdge (mvertex_t *pv0, mvertex_t *pv1, clipplane_t *pclip,
+	edgeproj_t *pproj, int clipflags, int reversed)
+{
+	c_edgesprojected++;
+
+	if (!pproj)
+	{
+		R_ClipEdge (pv0, pv1, pclip);
+		return;
+	}
+
+	pproj->kind = EP_CLIPPED;
+	r_edgeproj = pproj;
+	R_ClipEdge (pv0, pv1, pclip);
+	r_edgeproj = NULL;
+
+// a part clipped off the right can still leave the edge looking fully
+// clipped, but the face needs to know to make its right edge
+	if (cacheoffset == 0x7FFFFFFF || r_leftclipped || r_rightclipped)
+	{
+		pproj->epoch = 0;
+		return;
+	}
+
+	pproj->epoch = r_edgeepoch;
+	pproj->clipflags = clipflags;
+	pproj->side ^= reversed;
+}
+
 
 /*
 ================
@@ -77,8 +322,7 @@ R_EmitEdge
 */
 void R_EmitEdge (mvertex_t *pv0, mvertex_t *pv1)
 {
-	edge_t	*edge, *pcheck;
-	int		u_check;
+	edge_t	*edge;
 	float	u, u_step;
 	vec3_t	local, transformed;
 	float	*world;
@@ -174,6 +418,12 @@ void R_EmitEdge (mvertex_t *pv0, mvertex_t *pv1)
 					(r_framecount & FRAMECOUNT_MASK);
 		}
 
+		if (r_edgeproj)
+		{
+			r_edgeproj->kind = EP_HORIZONTAL;
+			r_edgeproj->nearzi = lzi0;
+		}
+
 		return;		// horizontal edge
 	}
 
@@ -223,29 +473,18 @@ void R_EmitEdge (mvertex_t *pv0, mvertex_t *pv1)
 	if (edge->u > r_refdef.vrectright_adj_shift20)
 		edge->u = r_refdef.vrectright_adj_shift20;
 
-//
-// sort the edge in normally
-//
-	u_check = edge->u;
-	if (edge->surfs[0])
-		u_check++;	// sort trailers after leaders
-
-	if (!newedges[v] || newedges[v]->u >= u_check)
-	{
-		edge->next = newedges[v];
-		newedges[v] = edge;
-	}
-	else
+	if (r_edgeproj)
 	{
-		pcheck = newedges[v];
-		while (pcheck->next && pcheck->next->u < u_check)
-			pcheck = pcheck->next;
-		edge->next = pcheck->next;
-		pcheck->next = edge;
+		r_edgeproj->kind = EP_EDGE;
+		r_edgeproj->side = side;
+		r_edgeproj->u = edge->u;
+		r_edgeproj->u_step = edge->u_step;
+		r_edgeproj->nearzi = lzi0;
+		r_edgeproj->v = v;
+		r_edgeproj->v2 = v2;
 	}
 
-	edge->nextremove = removeedges[v2];
-	removeedges[v2] = edge;
+	R_SortEdge (edge, v, v2);
 }
 
 
@@ -388,6 +627,7 @@ void R_RenderFace (msurface_t *fa, int clipflags)
 	vec3_t		p_normal;
 	medge_t		*pedges, tedge;
 	clipplane_t	*pclip;
+	edgeproj_t	*pproj;
 
 // skip out if no more surfs
 	if ((surface_p) >= surf_max)
@@ -459,12 +699,26 @@ void R_RenderFace (msurface_t *fa, int clipflags)
 				}
 			}
 
+		// if the view hasn't changed, the last projection still holds
+			pproj = NULL;
+			if (!insubmodel && r_edgecache.value)
+			{
+				pproj = &r_edgeprojs[lindex];
+				if (pproj->epoch == r_edgeepoch &&
+					pproj->clipflags == clipflags)
+				{
+					R_EmitProjectedEdge (pproj, false);
+					r_lastvertvalid = false;
+					continue;
+				}
+			}
+
 		// assume it's cacheable
 			cacheoffset = (byte *)edge_p - (byte *)r_edges;
 			r_leftclipped = r_rightclipped = false;
-			R_ClipEdge (&r_pcurrentvertbase[r_pedge->v[0]],
-						&r_pcurrentvertbase[r_pedge->v[1]],
-						pclip);
+			R_ProjectEdge (&r_pcurrentvertbase[r_pedge->v[0]],
+						   &r_pcurrentvertbase[r_pedge->v[1]],
+						   pclip, pproj, clipflags, false);
 			r_pedge->cachededgeoffset = cacheoffset;
 
 			if (r_leftclipped)
@@ -505,12 +759,26 @@ void R_RenderFace (msurface_t *fa, int clipflags)
 				}
 			}
 
+		// if the view hasn't changed, the last projection still holds
+			pproj = NULL;
+			if (!insubmodel && r_edgecache.value)
+			{
+				pproj = &r_edgeprojs[lindex];
+				if (pproj->epoch == r_edgeepoch &&
+					pproj->clipflags == clipflags)
+				{
+					R_EmitProjectedEdge (pproj, true);
+					r_lastvertvalid = false;
+					continue;
+				}
+			}
+
 		// assume it's cacheable
 			cacheoffset = (byte *)edge_p - (byte *)r_edges;
 			r_leftclipped = r_rightclipped = false;
-			R_ClipEdge (&r_pcurrentvertbase[r_pedge->v[1]],
-						&r_pcurrentvertbase[r_pedge->v[0]],
-						pclip);
+			R_ProjectEdge (&r_pcurrentvertbase[r_pedge->v[1]],
+						   &r_pcurrentvertbase[r_pedge->v[0]],
+						   pclip, pproj, clipflags, true);
 			r_pedge->cachededgeoffset = cacheoffset;
 
 			if (r_leftclipped)
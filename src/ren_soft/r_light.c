@@ -61,6 +61,78 @@ DYNAMIC LIGHTS
 =============================================================================
 */
 
+//
+// Each light is pushed down the world once a frame.  A surface on a node the
+// light straddles is only marked when the light can reach one of its luxels,
+// so a light near a big plane doesn't force a new surface cache for every
+// face on it, and each leaf the light reaches keeps the light's bit, so the
+// models can find the lights that touch them without trying all of them.
+//
+
+int		r_dlightsinuse;		// bits of the lights pushed into the world
+
+
+/*
+=============
+R_LightReachesSurface
+
+The same reach R_AddDynamicLights gives the light, with a texel to spare for
+its rounding
+=============
+*/
+static qboolean R_LightReachesSurface (dlight_t *light, float dist, msurface_t *surf)
+{
+	float		rad, reach;
+	vec3_t		impact;
+	mtexinfo_t	*tex;
+	float		s, t;
+	int			i;
+
+	rad = light->radius - fabs(dist);
+	if (rad < light->minlight)
+		return false;
+	reach = rad - light->minlight + 1;
+
+	for (i=0 ; i<3 ; i++)
+		impact[i] = light->origin[i] - surf->plane->normal[i]*dist;
+
+	tex = surf->texinfo;
+	s = DotProduct (impact, tex->vecs[0]) + tex->vecs[0][3] - surf->texturemins[0];
+	if (s < -reach || s > surf->extents[0] + reach)
+		return false;
+	t = DotProduct (impact, tex->vecs[1]) + tex->vecs[1][3] - surf->texturemins[1];
+	if (t < -reach || t > surf->extents[1] + reach)
+		return false;
+
+	return true;
+}
+
+
+/*
+=============
+R_MarkLeafLight
+=============
+*/
+static void R_MarkLeafLight (dlight_t *light, int bit, mleaf_t *leaf)
+{
+	int		i;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		if (light->origin[i] + light->radius < leaf->minmaxs[i]
+		|| light->origin[i] - light->radius > leaf->minmaxs[3+i])
+			return;
+	}
+
+	if (leaf->dlightframe != r_dlightframecount)
+	{
+		leaf->dlightbits = 0;
+		leaf->dlightframe = r_dlightframecount;
+	}
+	leaf->dlightbits |= bit;
+}
+
+
 /*
 =============
 R_MarkLights
@@ -74,7 +146,10 @@ void R_MarkLights (dlight_t *light, int bit, mnode_t *node)
 	int			i;
 	
 	if (node->contents < 0)
+	{
+		R_MarkLeafLight (light, bit, (mleaf_t *)node);
 		return;
+	}
 
 	splitplane = node->plane;
 	dist = DotProduct (light->origin, splitplane->normal) - splitplane->dist;
@@ -90,10 +165,12 @@ void R_MarkLights (dlight_t *light, int bit, mnode_t *node)
 		return;
 	}
 		
-// mark the polygons
+// mark the polygons the light reaches
 	surf = cl.worldmodel->surfaces + node->firstsurface;
 	for (i=0 ; i<node->numsurfaces ; i++, surf++)
 	{
+		if (!R_LightReachesSurface (light, dist, surf))
+			continue;
 		if (surf->dlightframe != r_dlightframecount)
 		{
 			surf->dlightbits = 0;
@@ -119,17 +196,44 @@ void R_PushDlights (void)
 
 	r_dlightframecount = r_framecount + 1;	// because the count hasn't
 											//  advanced yet for this frame
+	r_dlightsinuse = 0;
 	l = cl_dlights;
 
 	for (i=0 ; i<MAX_DLIGHTS ; i++, l++)
 	{
 		if (l->die < cl.time || !l->radius)
 			continue;
+		r_dlightsinuse |= 1<<i;
 		R_MarkLights ( l, 1<<i, cl.worldmodel->nodes );
 	}
 }
 
 
+/*
+=============
+R_DlightsAtPoint
+
+Bits of the lights that may reach p, a superset of those that do
+=============
+*/
+int R_DlightsAtPoint (vec3_t p)
+{
+	mleaf_t		*leaf;
+
+	if (!r_dlightsinuse)
+		return 0;
+
+// every solid point shares leaf 0, whose bounds qbsp leaves at zero, and items
+// resting on a floor land there, so those have to try all the lights
+	leaf = Mod_PointInLeaf (p, cl.worldmodel);
+	if (leaf->contents == CONTENTS_SOLID)
+		return r_dlightsinuse;
+	if (leaf->dlightframe != r_framecount)
+		return 0;
+	return leaf->dlightbits;
+}
+
+
 /*
 =============================================================================
 
@@ -70,6 +70,7 @@ extern cvar_t	r_numsurfs;
 extern cvar_t	r_reportedgeout;
 extern cvar_t	r_maxedges;
 extern cvar_t	r_numedges;
+extern cvar_t	r_edgecache;
 
 #define XCENTERING	(1.0 / 2.0)
 #define YCENTERING	(1.0 / 2.0)
@@ -130,12 +131,17 @@ extern	vec3_t			r_worldmodelorg;
 
 void R_DrawSprite (void);
 void R_RenderFace (msurface_t *fa, int clipflags);
+void R_AllocEdgeProjections (void);
+void R_BeginEdgeProjection (void);
 void R_RenderPoly (msurface_t *fa, int clipflags);
 void R_RenderBmodelFace (bedge_t *pedges, msurface_t *psurf);
 void R_TransformPlane (mplane_t *p, float *normal, float *dist);
 void R_TransformFrustum (void);
 void R_SetSkyFrame (void);
 void R_DrawSurfaceBlock16 (void);
+void R_DrawSurfaceBlock32 (void);
+void R_DrawSurfaceBlock32RGB (void);
+void R_LoadColoredLight (void);
 void R_DrawSurfaceBlock8 (void);
 texture_t *R_TextureAnimation (texture_t *base);
 
@@ -148,6 +154,7 @@ void R_DrawSolidClippedSubmodelPolygons (model_t *pmodel);
 void R_AddPolygonEdges (emitpoint_t *pverts, int numverts, int miplevel);
 surf_t *R_GetSurf (void);
 void R_AliasDrawModel (alight_t *plighting);
+void R_AliasBench_f (void);
 void R_BeginEdgeFrame (void);
 void R_ScanEdges (void);
 void D_DrawSurfaces (void);
@@ -165,6 +172,7 @@ extern void R_EdgeCodeEnd (void);
 extern void R_RotateBmodel (void);
 
 extern int	c_faceclip;
+extern int	c_edgesprojected, c_edgesreused;
 extern int	r_polycount;
 extern int	r_wholepolycount;
 
@@ -175,7 +183,7 @@ extern int		*pfrustum_indexes[4];
 // !!! if this is changed, it must be changed in asm_draw.h too !!!
 #define	NEAR_CLIP	0.01
 
-extern int			ubasestep, errorterm, erroradjustup, erroradjustdown;
+extern THREADLOCAL int	ubasestep, errorterm, erroradjustup, erroradjustdown;
 extern int			vstartscan;
 
 extern fixed16_t	sadjust, tadjust;
@@ -237,8 +245,6 @@ qboolean R_AliasCheckBBox (void);
 // particle stuff
 
 void R_DrawParticles (void);
-void R_InitParticles (void);
-void R_ClearParticles (void);
 void R_ReadPointFile_f (void);
 void R_SurfacePatch (void);
 
@@ -300,3 +306,4 @@ void R_EmitEdge (mvertex_t *pv0, mvertex_t *pv1);
 void R_ClipEdge (mvertex_t *pv0, mvertex_t *pv1, clipplane_t *clip);
 void R_SplitEntityOnNode2 (mnode_t *node);
 void R_MarkLights (dlight_t *light, int bit, mnode_t *node);
+int R_DlightsAtPoint (vec3_t p);
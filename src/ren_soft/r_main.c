@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include "r_local.h"
+#include "part.h"
 
 void		*colormap;
 vec3_t		viewlightvec;
@@ -48,6 +49,8 @@ int			r_clipflags;
 
 byte		*r_warpbuffer;
 
+int			r_pixbytes = 1;
+
 byte		*r_stack_start;
 
 qboolean	r_fov_greater_than_90;
@@ -185,6 +188,7 @@ void R_Init (void)
 
 	Cmd_AddCommand ("timerefresh", R_TimeRefresh_f);
 	Cmd_AddCommand ("pointfile", R_ReadPointFile_f);
+	Cmd_AddCommand ("r_aliasbench", R_AliasBench_f);
 
 	Cvar_RegisterVariable (&r_draworder);
 	Cvar_RegisterVariable (&r_speeds);
@@ -205,6 +209,7 @@ void R_Init (void)
 	Cvar_RegisterVariable (&r_reportedgeout);
 	Cvar_RegisterVariable (&r_maxedges);
 	Cvar_RegisterVariable (&r_numedges);
+	Cvar_RegisterVariable (&r_edgecache);
 	Cvar_RegisterVariable (&r_aliastransbase);
 	Cvar_RegisterVariable (&r_aliastransadj);
 
@@ -282,6 +287,10 @@ void R_NewMap (void)
 								   "edges");
 	}
 
+	D_AllocBins ();
+	R_AllocEdgeProjections ();
+	R_LoadColoredLight ();
+
 	r_dowarpold = false;
 	r_viewchanged = false;
 }
@@ -495,6 +504,7 @@ void R_DrawEntitiesOnList (void)
 {
 	int			i, j;
 	int			lnum;
+	unsigned	bits;
 	alight_t	lighting;
 // FIXME: remove and do real lighting
 	float		lightvec[3] = {-1, 0, 0};
@@ -534,8 +544,11 @@ void R_DrawEntitiesOnList (void)
 
 				lighting.plightvec = lightvec;
 
-				for (lnum=0 ; lnum<MAX_DLIGHTS ; lnum++)
+				bits = R_DlightsAtPoint (currententity->origin);
+				for (lnum=0 ; bits ; lnum++, bits >>= 1)
 				{
+					if (!(bits & 1))
+						continue;
 					if (cl_dlights[lnum].die >= cl.time)
 					{
 						VectorSubtract (currententity->origin,
@@ -576,6 +589,7 @@ void R_DrawViewModel (void)
 	float		lightvec[3] = {-1, 0, 0};
 	int			j;
 	int			lnum;
+	unsigned	bits;
 	vec3_t		dist;
 	float		add;
 	dlight_t	*dl;
@@ -607,8 +621,11 @@ void R_DrawViewModel (void)
 	r_viewlighting.shadelight = j;
 
 // add dynamic lights
-	for (lnum=0 ; lnum<MAX_DLIGHTS ; lnum++)
+	bits = R_DlightsAtPoint (currententity->origin);
+	for (lnum=0 ; bits ; lnum++, bits >>= 1)
 	{
+		if (!(bits & 1))
+			continue;
 		dl = &cl_dlights[lnum];
 		if (!dl->radius)
 			continue;
@@ -865,6 +882,7 @@ void R_EdgeDrawing (void)
 	}
 
 	R_BeginEdgeFrame ();
+	R_BeginEdgeProjection ();
 
 	if (r_dspeeds.value)
 	{
@@ -886,6 +904,10 @@ void R_EdgeDrawing (void)
 		db_time1 = rw_time2;
 	}
 
+	if (r_edgecache.value > 1)
+		Con_Printf ("%i edges projected, %i reused\n", c_edgesprojected,
+					c_edgesreused);
+
 	R_DrawBEntitiesOnList ();
 
 	if (r_dspeeds.value)
@@ -926,6 +948,8 @@ void R_RenderView_ (void)
 		de_time1 = se_time2;
 	}
 
+	D_BeginBins ();
+
 	R_DrawEntitiesOnList ();
 
 	if (r_dspeeds.value)
@@ -944,6 +968,8 @@ void R_RenderView_ (void)
 
 	R_DrawParticles ();
 
+	D_EndBins ();
+
 	if (r_dspeeds.value)
 		dp_time2 = Sys_FloatTime ();
 
@@ -115,12 +115,27 @@ void R_LineGraph (int x, int y, int h)
 	x += r_refdef.vrect.x;
 	y += r_refdef.vrect.y;
 	
-	dest = vid.buffer + vid.rowbytes*y + x;
-	
 	s = r_graphheight.value;
 	
 	if (h>s)
 		h = s;
+
+	if (r_pixbytes != 1)
+	{
+		unsigned	*dest32;
+		int			rowpixels;
+
+		rowpixels = vid.rowbytes / r_pixbytes;
+		dest32 = (unsigned *)vid.buffer + rowpixels*y + x;
+		for (i=0 ; i<s ; i++, dest32 -= rowpixels*2)
+		{
+			dest32[0] = d_8to24table[i<h ? 0xff : 0x30];
+			*(dest32-rowpixels) = d_8to24table[0x30];
+		}
+		return;
+	}
+
+	dest = vid.buffer + vid.rowbytes*y + x;
 		
 	for (i=0 ; i<h ; i++, dest -= vid.rowbytes*2)
 	{
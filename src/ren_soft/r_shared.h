@@ -46,7 +46,12 @@ extern void	R_DrawLine (polyvert_t *polyvert0, polyvert_t *polyvert1);
 
 extern int		cachewidth;
 extern pixel_t	*cacheblock;
-extern int		screenwidth;
+extern int		screenwidth;	// in pixels
+
+// 1, or 4 when the driver's buffer is 32 bit color; the 32 bit drawers look
+// the 8 bit texels and colors up in d_8to24table and vid.colormap32
+extern int		r_pixbytes;
+extern unsigned	d_8to24table[256];
 
 extern	float	pixelAspect;
 
@@ -127,7 +132,7 @@ extern void SetUpForLineScan(fixed8_t startvertu, fixed8_t startvertv,
 extern int	r_skymade;
 extern void R_MakeSky (void);
 
-extern int	ubasestep, errorterm, erroradjustup, erroradjustdown;
+extern THREADLOCAL int	ubasestep, errorterm, erroradjustup, erroradjustdown;
 
 // flags in finalvert_t.flags
 #define ALIAS_LEFT_CLIP				0x0001
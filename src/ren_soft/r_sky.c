@@ -40,11 +40,24 @@ int r_skydirect;		// not used?
 
 byte	bottomsky[128*131];
 byte	bottommask[128*131];
-byte	newsky[128*256];	// newsky and topsky both pack in here, 128 bytes
+byte	newsky[2][128*256];	// newsky and topsky both pack in here, 128 bytes
 							//  of newsky on the left of each scan, 128 bytes
 							//  of topsky on the right, because the low-level
 							//  drawers need 256-byte scan widths
 
+//
+// r_skysource is one of the two newskys, composited for sky_shift.  While
+// the shift holds, the other one is built for the shift after it a slice of
+// rows a frame, and the two swap when the shift moves on.  A shift that
+// jumps, or comes before the slices are done, is composited all at once.
+//
+
+#define	SKY_SLICEROWS	16
+
+static int	sky_shift = -1;
+static int	sky_nextshift = -1;
+static int	sky_nextrows;		// rows of the other newsky made for sky_nextshift
+
 
 /*
 =============
@@ -64,7 +77,8 @@ void R_InitSky (texture_t *mt)
 	{
 		for (j=0 ; j<128 ; j++)
 		{
-			newsky[(i*256) + j + 128] = src[i*256 + j + 128];
+			newsky[0][(i*256) + j + 128] = src[i*256 + j + 128];
+			newsky[1][(i*256) + j + 128] = src[i*256 + j + 128];
 		}
 	}
 
@@ -85,130 +99,125 @@ void R_InitSky (texture_t *mt)
 		}
 	}
 	
-	r_skysource = newsky;
+	r_skysource = newsky[0];
+
+// nothing made from the last sky can be used
+	sky_shift = -1;
+	sky_nextshift = -1;
 }
 
 
 /*
 =================
-R_MakeSky
+R_CompositeSky
+
+Rows first to first+count-1 of the sky for shift, made from the topsky in
+the right half of newsky and put in dest, rowbytes apart
 =================
 */
-void R_MakeSky (void)
+static void R_CompositeSky (byte *dest, int rowbytes, int shift, int first, int count)
 {
 	int			x, y;
 	int			ofs, baseofs;
-	int			xshift, yshift;
-	unsigned	*pnewsky;
-	static int	xlast = -1, ylast = -1;
-
-	xshift = skytime*skyspeed;
-	yshift = skytime*skyspeed;
-
-	if ((xshift == xlast) && (yshift == ylast))
-		return;
-
-	xlast = xshift;
-	ylast = yshift;
-	
-	pnewsky = (unsigned *)&newsky[0];
+	byte		*ptopsky;
+	unsigned	*pd;
 
-	for (y=0 ; y<SKYSIZE ; y++)
+	for (y=first ; y<first+count ; y++)
 	{
-		baseofs = ((y+yshift) & SKYMASK) * 131;
+		baseofs = ((y+shift) & SKYMASK) * 131;
+		ptopsky = &newsky[0][y*256 + 128];
+		pd = (unsigned *)(dest + y*rowbytes);
 
 // FIXME: clean this up
 #if UNALIGNED_OK
 
 		for (x=0 ; x<SKYSIZE ; x += 4)
 		{
-			ofs = baseofs + ((x+xshift) & SKYMASK);
+			ofs = baseofs + ((x+shift) & SKYMASK);
 
 		// PORT: unaligned dword access to bottommask and bottomsky
 
-			*pnewsky = (*(pnewsky + (128 / sizeof (unsigned))) &
-						*(unsigned *)&bottommask[ofs]) |
-						*(unsigned *)&bottomsky[ofs];
-			pnewsky++;
+			*pd = (*(unsigned *)&ptopsky[x] &
+				   *(unsigned *)&bottommask[ofs]) |
+				   *(unsigned *)&bottomsky[ofs];
+			pd++;
 		}
 
 #else
 
 		for (x=0 ; x<SKYSIZE ; x++)
 		{
-			ofs = baseofs + ((x+xshift) & SKYMASK);
+			ofs = baseofs + ((x+shift) & SKYMASK);
 
-			*(byte *)pnewsky = (*((byte *)pnewsky + 128) &
+			*(byte *)pd = (ptopsky[x] &
 						*(byte *)&bottommask[ofs]) |
 						*(byte *)&bottomsky[ofs];
-			pnewsky = (unsigned *)((byte *)pnewsky + 1);
+			pd = (unsigned *)((byte *)pd + 1);
 		}
 
 #endif
-
-		pnewsky += 128 / sizeof (unsigned);
 	}
-
-	r_skymade = 1;
 }
 
 
 /*
 =================
-R_GenSkyTile
+R_MakeSky
 =================
 */
-void R_GenSkyTile (void *pdest)
+void R_MakeSky (void)
 {
-	int			x, y;
-	int			ofs, baseofs;
-	int			xshift, yshift;
-	unsigned	*pnewsky;
-	unsigned	*pd;
+	int			shift, rows;
+	byte		*nextsky;
 
-	xshift = skytime*skyspeed;
-	yshift = skytime*skyspeed;
+	shift = skytime*skyspeed;
 
-	pnewsky = (unsigned *)&newsky[0];
-	pd = (unsigned *)pdest;
+	nextsky = r_skysource == newsky[0] ? newsky[1] : newsky[0];
 
-	for (y=0 ; y<SKYSIZE ; y++)
+	if (shift != sky_shift)
 	{
-		baseofs = ((y+yshift) & SKYMASK) * 131;
-
-// FIXME: clean this up
-#if UNALIGNED_OK
-
-		for (x=0 ; x<SKYSIZE ; x += 4)
-		{
-			ofs = baseofs + ((x+xshift) & SKYMASK);
+		if (shift == sky_nextshift)
+			R_CompositeSky (nextsky, 256, shift, sky_nextrows, SKYSIZE - sky_nextrows);
+		else
+			R_CompositeSky (nextsky, 256, shift, 0, SKYSIZE);
+
+		r_skysource = nextsky;
+		nextsky = nextsky == newsky[0] ? newsky[1] : newsky[0];
+		sky_shift = shift;
+	}
 
-		// PORT: unaligned dword access to bottommask and bottomsky
+// get on with the next shift
+	if (sky_nextshift != shift + 1)
+	{
+		sky_nextshift = shift + 1;
+		sky_nextrows = 0;
+	}
 
-			*pd = (*(pnewsky + (128 / sizeof (unsigned))) &
-				   *(unsigned *)&bottommask[ofs]) |
-				   *(unsigned *)&bottomsky[ofs];
-			pnewsky++;
-			pd++;
-		}
+	if (sky_nextrows < SKYSIZE)
+	{
+		rows = SKYSIZE - sky_nextrows;
+		if (rows > SKY_SLICEROWS)
+			rows = SKY_SLICEROWS;
+		R_CompositeSky (nextsky, 256, sky_nextshift, sky_nextrows, rows);
+		sky_nextrows += rows;
+	}
 
-#else
+	r_skymade = 1;
+}
 
-		for (x=0 ; x<SKYSIZE ; x++)
-		{
-			ofs = baseofs + ((x+xshift) & SKYMASK);
 
-			*(byte *)pd = (*((byte *)pnewsky + 128) &
-						*(byte *)&bottommask[ofs]) |
-						*(byte *)&bottomsky[ofs];
-			pnewsky = (unsigned *)((byte *)pnewsky + 1);
-			pd = (unsigned *)((byte *)pd + 1);
-		}
+/*
+=================
+R_GenSkyTile
+=================
+*/
+void R_GenSkyTile (void *pdest)
+{
+	int			shift;
 
-#endif
+	shift = skytime*skyspeed;
 
-		pnewsky += 128 / sizeof (unsigned);
-	}
+	R_CompositeSky (pdest, SKYSIZE, shift, 0, SKYSIZE);
 }
 
 
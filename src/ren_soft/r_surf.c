@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 #include "r_local.h"
+#include "simd.h"
 
 drawsurf_t	r_drawsurf;
 
@@ -53,27 +54,109 @@ static void	(*surfmiptable[4])(void) = {
 
 unsigned		blocklights[18*18];
 
+// with 32 bit color and a .lit file, the surfaces are lit from these instead
+static unsigned	blocklightsrgb[3][18*18];
+static byte		*r_litdata;				// 3 bytes for each byte of lightdata
+static byte		r_fullbrights[256];		// texels the colormap doesn't light
+
+/*
+===============
+R_AddLightRow
+
+Adds one light to the luxels s to send of a row td texels from it.  The
+vector versions do the same float and int steps, so the sums match.
+===============
+*/
+typedef void (*addlightrowfunc_t) (unsigned *bl, int s, int send, float local0, int td, float rad, float minlight);
+
+static void R_AddLightRow_C (unsigned *bl, int s, int send, float local0, int td, float rad, float minlight)
+{
+	int			sd;
+	float		dist;
+
+	for ( ; s<send ; s++)
+	{
+		sd = local0 - s*16;
+		if (sd < 0)
+			sd = -sd;
+		if (sd > td)
+			dist = sd + (td>>1);
+		else
+			dist = td + (sd>>1);
+		if (dist < minlight)
+			bl[s] += (rad - dist)*256;
+	}
+}
+
+#if SIMD_X86
+
+SIMD_TARGET("sse4.1") static void R_AddLightRow_SSE41 (unsigned *bl, int s, int send, float local0, int td, float rad, float minlight)
+{
+	__m128i	vs, sd, vtd, lo, hi, vbl, sum;
+	__m128	dist, mask;
+
+	vs = _mm_add_epi32 (_mm_set1_epi32 (s), _mm_setr_epi32 (0, 1, 2, 3));
+	vtd = _mm_set1_epi32 (td);
+	for ( ; s+4<=send ; s+=4)
+	{
+		sd = _mm_cvttps_epi32 (_mm_sub_ps (_mm_set1_ps (local0),
+				_mm_cvtepi32_ps (_mm_slli_epi32 (vs, 4))));
+		sd = _mm_abs_epi32 (sd);
+		hi = _mm_max_epi32 (sd, vtd);
+		lo = _mm_min_epi32 (sd, vtd);
+		dist = _mm_cvtepi32_ps (_mm_add_epi32 (hi, _mm_srai_epi32 (lo, 1)));
+		mask = _mm_cmplt_ps (dist, _mm_set1_ps (minlight));
+		if (_mm_movemask_ps (mask))
+		{
+			vbl = _mm_loadu_si128 ((__m128i *)(bl + s));
+			sum = _mm_cvttps_epi32 (_mm_add_ps (_mm_cvtepi32_ps (vbl),
+					_mm_mul_ps (_mm_sub_ps (_mm_set1_ps (rad), dist), _mm_set1_ps (256))));
+			vbl = _mm_blendv_epi8 (vbl, sum, _mm_castps_si128 (mask));
+			_mm_storeu_si128 ((__m128i *)(bl + s), vbl);
+		}
+		vs = _mm_add_epi32 (vs, _mm_set1_epi32 (4));
+	}
+
+	R_AddLightRow_C (bl, s, send, local0, td, rad, minlight);
+}
+
+static addlightrowfunc_t	r_addlightrows[SIMD_AVX2+1] =
+	{R_AddLightRow_C, R_AddLightRow_C, R_AddLightRow_SSE41, R_AddLightRow_SSE41};
+
+#else	// !SIMD_X86
+
+static addlightrowfunc_t	r_addlightrows[SIMD_AVX2+1] =
+	{R_AddLightRow_C, R_AddLightRow_C, R_AddLightRow_C, R_AddLightRow_C};
+
+#endif	// SIMD_X86
+
+
 /*
 ===============
 R_AddDynamicLights
+
+Only the rows and columns of luxels within a light's reach are visited
 ===============
 */
 void R_AddDynamicLights (void)
 {
 	msurface_t *surf;
 	int			lnum;
-	int			sd, td;
+	int			td;
 	float		dist, rad, minlight;
 	vec3_t		impact, local;
-	int			s, t;
+	int			sfirst, send;
+	int			t;
 	int			i;
 	int			smax, tmax;
 	mtexinfo_t	*tex;
+	addlightrowfunc_t	addlightrow;
 
 	surf = r_drawsurf.surf;
 	smax = (surf->extents[0]>>4)+1;
 	tmax = (surf->extents[1]>>4)+1;
 	tex = surf->texinfo;
+	addlightrow = r_addlightrows[SIMD_Level ()];
 
 	for (lnum=0 ; lnum<MAX_DLIGHTS ; lnum++)
 	{
@@ -101,23 +184,25 @@ void R_AddDynamicLights (void)
 		local[0] -= surf->texturemins[0];
 		local[1] -= surf->texturemins[1];
 
+	// a luxel is lit only if it is within minlight along both axes, and the
+	// truncation to int can only bring it a texel closer
+		sfirst = (int)((local[0] - minlight) / 16) - 1;
+		if (sfirst < 0)
+			sfirst = 0;
+		send = (int)((local[0] + minlight) / 16) + 2;
+		if (send > smax)
+			send = smax;
+		if (sfirst >= send)
+			continue;
+
 		for (t = 0 ; t<tmax ; t++)
 		{
 			td = local[1] - t*16;
 			if (td < 0)
 				td = -td;
-			for (s=0 ; s<smax ; s++)
-			{
-				sd = local[0] - s*16;
-				if (sd < 0)
-					sd = -sd;
-				if (sd > td)
-					dist = sd + (td>>1);
-				else
-					dist = td + (sd>>1);
-				if (dist < minlight)
-					blocklights[t*smax + s] += (rad - dist)*256;
-			}
+			if (td >= minlight)
+				continue;
+			addlightrow (blocklights + t*smax, sfirst, send, local[0], td, rad, minlight);
 		}
 	}
 }
@@ -186,6 +271,131 @@ void R_BuildLightMap (void)
 }
 
 
+/*
+===============
+R_BuildLightMapRGB
+
+R_BuildLightMap for each of the three colors of a .lit file, into
+blocklightsrgb
+===============
+*/
+static void R_BuildLightMapRGB (void)
+{
+	int			smax, tmax;
+	int			t;
+	int			i, c, size;
+	byte		*lightmap;
+	unsigned	scale;
+	int			maps;
+	msurface_t	*surf;
+
+	surf = r_drawsurf.surf;
+
+	smax = (surf->extents[0]>>4)+1;
+	tmax = (surf->extents[1]>>4)+1;
+	size = smax*tmax;
+
+	for (c=0 ; c<3 ; c++)
+	{
+		if (r_fullbright.value)
+		{
+			for (i=0 ; i<size ; i++)
+				blocklights[i] = 0;
+		}
+		else
+		{
+		// clear to ambient
+			for (i=0 ; i<size ; i++)
+				blocklights[i] = r_refdef.ambientlight<<8;
+
+		// add all the lightmaps
+			if (surf->samples)
+			{
+				lightmap = r_litdata + (surf->samples - cl.worldmodel->lightdata)*3 + c;
+				for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ;
+					 maps++)
+				{
+					scale = r_drawsurf.lightadj[maps];	// 8.8 fraction
+					for (i=0 ; i<size ; i++)
+						blocklights[i] += lightmap[i*3] * scale;
+					lightmap += size*3;	// skip to next lightmap
+				}
+			}
+
+		// add all the dynamic lights, which are white
+			if (surf->dlightframe == r_framecount)
+				R_AddDynamicLights ();
+		}
+
+	// bound, invert, and shift
+		for (i=0 ; i<size ; i++)
+		{
+			t = (255*256 - (int)blocklights[i]) >> (8 - VID_CBITS);
+
+			if (t < (1 << 6))
+				t = (1 << 6);
+
+			blocklightsrgb[c][i] = t;
+		}
+	}
+}
+
+
+/*
+===============
+R_LoadColoredLight
+
+Called by R_NewMap.  Colored lightmaps come in a .lit file beside the map:
+"QLIT", version 1, then the map's lighting with three bytes for each of its
+bytes.  Only the 32 bit drawers can use them.
+===============
+*/
+void R_LoadColoredLight (void)
+{
+	char		name[MAX_QPATH];
+	byte		*data;
+	int			i, size, maps, end;
+	msurface_t	*surf;
+
+	for (i=0 ; i<256 ; i++)
+		r_fullbrights[i] = (vid.colormap[(VID_GRADES-1)*256 + i] == i);
+
+	r_litdata = NULL;
+	if (r_pixbytes != 4 || !cl.worldmodel->lightdata)
+		return;
+
+	COM_StripExtension (cl.worldmodel->name, name);
+	strcat (name, ".lit");
+	data = COM_LoadHunkFile (name);
+	if (!data)
+		return;
+
+// the lighting isn't kept with its size, so find where the faces' end
+	end = 0;
+	surf = cl.worldmodel->surfaces;
+	for (i=0 ; i<cl.worldmodel->numsurfaces ; i++, surf++)
+	{
+		if (!surf->samples)
+			continue;
+		size = ((surf->extents[0]>>4)+1) * ((surf->extents[1]>>4)+1);
+		for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ;
+			 maps++)
+			;
+		if (surf->samples - cl.worldmodel->lightdata + size*maps > end)
+			end = surf->samples - cl.worldmodel->lightdata + size*maps;
+	}
+
+	if (com_filesize < 8 + end*3 || memcmp (data, "QLIT", 4) ||
+		LittleLong (((int *)data)[1]) != 1)
+	{
+		Con_Printf ("%s isn't a version 1 lit file for this map\n", name);
+		return;
+	}
+
+	r_litdata = data + 8;
+}
+
+
 /*
 ===============
 R_TextureAnimation
@@ -240,7 +450,10 @@ void R_DrawSurface (void)
 	texture_t		*mt;
 
 // calculate the lightings
-	R_BuildLightMap ();
+	if (r_litdata)
+		R_BuildLightMapRGB ();
+	else
+		R_BuildLightMap ();
 
 	surfrowbytes = r_drawsurf.rowbytes;
 
@@ -264,9 +477,14 @@ void R_DrawSurface (void)
 
 //==============================
 
-	pblockdrawer = surfmiptable[r_drawsurf.surfmip];
+	if (r_pixbytes == 1)
+		pblockdrawer = surfmiptable[r_drawsurf.surfmip];
+	else if (r_litdata)
+		pblockdrawer = R_DrawSurfaceBlock32RGB;
+	else
+		pblockdrawer = R_DrawSurfaceBlock32;
 // TODO: only needs to be set when there is a display settings change
-	horzblockstep = blocksize;
+	horzblockstep = blocksize * r_pixbytes;
 
 	smax = mt->width >> r_drawsurf.surfmip;
 	twidth = texwidth;
@@ -507,6 +725,133 @@ void R_DrawSurfaceBlock8_mip3 (void)
 }
 
 
+/*
+================
+R_DrawSurfaceBlock32
+
+The 8 bit blocks for any mip level, lit through vid.colormap32
+================
+*/
+void R_DrawSurfaceBlock32 (void)
+{
+	int				v, i, b, lightstep, lighttemp, light;
+	unsigned char	*psource;
+	unsigned		*prowdest;
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		lightleft = r_lightptr[0];
+		lightright = r_lightptr[1];
+		r_lightptr += r_lightwidth;
+		lightleftstep = (r_lightptr[0] - lightleft) >> blockdivshift;
+		lightrightstep = (r_lightptr[1] - lightright) >> blockdivshift;
+
+		for (i=0 ; i<blocksize ; i++)
+		{
+			lighttemp = lightleft - lightright;
+			lightstep = lighttemp >> blockdivshift;
+
+			light = lightright;
+
+			for (b=blocksize-1; b>=0; b--)
+			{
+				prowdest[b] = vid.colormap32[(light & 0xFF00) + psource[b]];
+				light += lightstep;
+			}
+
+			psource += sourcetstep;
+			lightright += lightrightstep;
+			lightleft += lightleftstep;
+			prowdest = (unsigned *)((byte *)prowdest + surfrowbytes);
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+}
+
+
+/*
+================
+R_DrawSurfaceBlock32RGB
+
+R_DrawSurfaceBlock32 with a light for each color.  The colormap only has
+one, so each color of the texel is scaled the way a colormap row scales it:
+row 32 as it is, up to twice as bright at row 0.
+================
+*/
+void R_DrawSurfaceBlock32RGB (void)
+{
+	int				v, i, b, c, ofs, pix;
+	int				left[3], right[3], leftstep[3], rightstep[3];
+	int				light[3], step[3], color;
+	unsigned		*plight[3];
+	unsigned char	*psource;
+	unsigned		*prowdest, texel;
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+
+	ofs = r_lightptr - blocklights;
+	for (c=0 ; c<3 ; c++)
+		plight[c] = blocklightsrgb[c] + ofs;
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		for (c=0 ; c<3 ; c++)
+		{
+			left[c] = plight[c][0];
+			right[c] = plight[c][1];
+			plight[c] += r_lightwidth;
+			leftstep[c] = ((int)plight[c][0] - left[c]) >> blockdivshift;
+			rightstep[c] = ((int)plight[c][1] - right[c]) >> blockdivshift;
+		}
+
+		for (i=0 ; i<blocksize ; i++)
+		{
+			for (c=0 ; c<3 ; c++)
+			{
+				step[c] = (left[c] - right[c]) >> blockdivshift;
+				light[c] = right[c];
+			}
+
+			for (b=blocksize-1; b>=0; b--)
+			{
+				pix = psource[b];
+				texel = d_8to24table[pix];
+				if (!r_fullbrights[pix])
+				{
+					color = (((texel >> 16) & 0xFF) * (0x4000 - light[0])) >> 13;
+					texel = (texel & 0xFF00FFFF) | ((color > 255 ? 255 : color) << 16);
+					color = (((texel >> 8) & 0xFF) * (0x4000 - light[1])) >> 13;
+					texel = (texel & 0xFFFF00FF) | ((color > 255 ? 255 : color) << 8);
+					color = ((texel & 0xFF) * (0x4000 - light[2])) >> 13;
+					texel = (texel & 0xFFFFFF00) | (color > 255 ? 255 : color);
+				}
+				prowdest[b] = texel;
+
+				for (c=0 ; c<3 ; c++)
+					light[c] += step[c];
+			}
+
+			psource += sourcetstep;
+			for (c=0 ; c<3 ; c++)
+			{
+				right[c] += rightstep[c];
+				left[c] += leftstep[c];
+			}
+			prowdest = (unsigned *)((byte *)prowdest + surfrowbytes);
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+}
+
+
 /*
 ================
 R_DrawSurfaceBlock16
@@ -16,9 +16,24 @@ std::vector<short> zBuffer;
 
 byte* warpbuffer;
 
-byte  surfcache[8*1024*1024];
+std::vector<byte> surfcache;
 
-static uint32_t vid_current_palette[256];
+unsigned d_8to24table[256];
+static std::vector<unsigned> colormap32;
+
+// in 32 bit color a palette shift is first applied to each channel as the
+// frame is presented, so the cached surfaces don't have to be rebuilt while
+// a damage or pickup flash fades.  Once the palette has held still for
+// SHIFT_SETTLE frames, as it does underwater, with a powerup or with gamma,
+// it is built into d_8to24table and colormap32 instead and the surface
+// cache is flushed, which takes the per pixel pass away again.
+#define SHIFT_SETTLE	8
+
+static byte basepal[768];		// the palette the 32 bit colors were built from
+static byte shiftpal[768];
+static unsigned shiftred[256], shiftgreen[256], shiftblue[256];
+static bool shifted;
+static int shiftframes;
 
 static SDL_Window*   win = NULL;
 static SDL_Renderer* ren = NULL;
@@ -26,14 +41,15 @@ static SDL_Texture*  tex = NULL;
 
 static void setupSurfaces(int w, int h)
 {
-    renderBuffer.resize(w * h);
-    warpBuffer.resize(w * h);
+    renderBuffer.resize(w * h * r_pixbytes);
+    // the vector warp reads 16 bytes at a time, so leave room past the end
+    warpBuffer.resize(w * h * r_pixbytes + 16);
     zBuffer.resize(w * h);
 
 	vid.maxwarpwidth = vid.width = vid.conwidth = w;
 	vid.maxwarpheight = vid.height = vid.conheight = h;
     vid.buffer = vid.conbuffer = renderBuffer.data();
-	vid.rowbytes = vid.conrowbytes = w;
+	vid.rowbytes = vid.conrowbytes = w * r_pixbytes;
 
     r_warpbuffer = warpBuffer.data();
     d_pzbuffer = zBuffer.data();
@@ -44,17 +60,90 @@ static void setupSurfaces(int w, int h)
     if (!tex) exit(-1);
 }
 
-void VID_SetPalette (unsigned char *palette)
+static void setBasePalette (unsigned char *palette)
 {
     for(int i = 0; i < 256; ++i)
     {
-        vid_current_palette[i] =  
+        d_8to24table[i] =
             uint32_t(palette[2]) | (uint32_t(palette[1]) << 8) |
             (uint32_t(palette[0]) << 16) | 0xff000000;
         palette += 3;
     }
 }
 
+// a shifted palette moves every color channel through a curve of its own,
+// so a table for each channel is read off the base and shifted palettes
+static void setShiftTable (unsigned *table, unsigned char *palette, int c, int shift)
+{
+    int value[256];
+    int prev = -1;
+
+    for(int v = 0; v < 256; ++v)
+        value[v] = -1;
+    for(int i = 0; i < 256; ++i)
+        value[basepal[i*3+c]] = palette[i*3+c];
+
+    // channel values the base palette doesn't have are interpolated
+    for(int v = 0; v < 256; ++v)
+    {
+        if (value[v] < 0)
+            continue;
+        if (prev < 0)
+        {
+            for(int u = 0; u < v; ++u)
+                value[u] = value[v];
+        }
+        else
+        {
+            for(int u = prev + 1; u < v; ++u)
+                value[u] = value[prev] + (value[v] - value[prev]) * (u - prev) / (v - prev);
+        }
+        prev = v;
+    }
+    for(int u = prev + 1; u < 256; ++u)
+        value[u] = prev < 0 ? u : value[prev];
+
+    for(int v = 0; v < 256; ++v)
+        table[v] = uint32_t(value[v]) << shift;
+}
+
+static void setColormap32 (void)
+{
+    for(int i = 0; i < 256 * VID_GRADES; ++i)
+        vid.colormap32[i] = d_8to24table[vid.colormap[i]];
+}
+
+void VID_SetPalette (unsigned char *palette)
+{
+    if (!vid.colormap32)
+    {
+        setBasePalette (palette);
+        return;
+    }
+
+    shifted = memcmp (palette, basepal, sizeof(basepal)) != 0;
+    shiftframes = 0;
+    if (!shifted)
+        return;
+    memcpy (shiftpal, palette, sizeof(shiftpal));
+    setShiftTable (shiftred, palette, 0, 16);
+    setShiftTable (shiftgreen, palette, 1, 8);
+    setShiftTable (shiftblue, palette, 2, 0);
+}
+
+// called after a shifted frame is presented, so the next one is drawn in
+// the new colors
+static void settlePalette (void)
+{
+    if (++shiftframes < SHIFT_SETTLE)
+        return;
+    memcpy (basepal, shiftpal, sizeof(basepal));
+    setBasePalette (basepal);
+    setColormap32 ();
+    D_FlushCaches ();
+    shifted = false;
+}
+
 void VID_ShiftPalette (unsigned char *palette)
 {
     VID_SetPalette (palette);
@@ -65,6 +154,10 @@ void VID_Init (unsigned char *palette)
     int initialWidth = 1280;
     int initialHeight = 720;
 
+    // draw straight into a 32 bit buffer instead of expanding an 8 bit one
+    if (COM_CheckParm("-truecolor"))
+        r_pixbytes = 4;
+
     win = SDL_CreateWindow("Quake", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
         initialWidth, initialHeight, SDL_WINDOW_RESIZABLE);
     if (!win) exit(-1);
@@ -78,8 +171,18 @@ void VID_Init (unsigned char *palette)
 	vid.aspect = 1.0;
 	vid.numpages = 1;
 	vid.colormap = host_colormap;
+	// a 32 bit surface is four times the size
+	surfcache.resize(8*1024*1024 * r_pixbytes);
+	D_InitCaches (surfcache.data(), surfcache.size());
 
-	D_InitCaches (surfcache, sizeof(surfcache));
+	setBasePalette (palette);
+	if (r_pixbytes == 4)
+	{
+		memcpy (basepal, palette, sizeof(basepal));
+		colormap32.resize(256 * VID_GRADES);
+		vid.colormap32 = colormap32.data();
+		setColormap32 ();
+	}
 }
 
 void VID_Shutdown (void)
@@ -99,6 +202,38 @@ void VID_Resize(int w, int h)
 
 void VID_Update (vrect_t *rects)
 {
+    if (r_pixbytes == 4)
+    {
+        if (!shifted)
+            SDL_UpdateTexture(tex, nullptr, renderBuffer.data(), vid.rowbytes);
+        else
+        {
+            unsigned* psrc32 = (unsigned*)renderBuffer.data();
+            uint32_t* pdst;
+            int pitch;
+            if (0 == SDL_LockTexture(tex, nullptr, (void**)&pdst, &pitch))
+            {
+                pitch /= sizeof(uint32_t);
+                for(int row = 0; row < (int)vid.height; ++row)
+                {
+                    for(int i = 0; i < (int)vid.width; ++i)
+                    {
+                        unsigned p = *psrc32++;
+                        pdst[i] = 0xff000000 | shiftred[(p >> 16) & 255] |
+                            shiftgreen[(p >> 8) & 255] | shiftblue[p & 255];
+                    }
+                    pdst += pitch;
+                }
+                SDL_UnlockTexture(tex);
+            }
+        }
+        SDL_RenderCopy(ren, tex, nullptr, nullptr);
+        SDL_RenderPresent(ren);
+        if (shifted)
+            settlePalette ();
+        return;
+    }
+
     byte* psrc = renderBuffer.data();
     uint32_t* pdst;
     int pitch;
@@ -108,7 +243,7 @@ void VID_Update (vrect_t *rects)
         for(int row = 0; row < vid.height; ++row)
         {
             for(int i = 0; i < vid.width; ++i)
-                pdst[i] = vid_current_palette[*psrc++];
+                pdst[i] = d_8to24table[*psrc++];
             pdst += pitch;
         }
         SDL_UnlockTexture(tex);
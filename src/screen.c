@@ -601,6 +601,52 @@ void WritePCXfile (char *filename, byte *data, int width, int height,
 	length = pack - (byte *)pcx;
 	COM_WriteFile (filename, pcx, length);
 } 
+
+/* 
+============== 
+WriteTGAfile 
+
+Saves a 32 bit color screen as an uncompressed 24 bit targa
+============== 
+*/ 
+void WriteTGAfile (char *filename, byte *data, int width, int height,
+	int rowbytes) 
+{
+	int		i, j;
+	byte	*tga, *out, *in;
+
+	tga = Hunk_TempAlloc (width*height*3+18);
+	if (tga == NULL)
+	{
+		Con_Printf("SCR_ScreenShot_f: not enough memory\n");
+		return;
+	}
+
+	Q_memset (tga, 0, 18);
+	tga[2] = 2;						// uncompressed true color
+	tga[12] = width & 255;
+	tga[13] = width >> 8;
+	tga[14] = height & 255;
+	tga[15] = height >> 8;
+	tga[16] = 24;					// bits per pixel
+	tga[17] = 0x20;					// top row first
+
+// the pixels are stored blue, green, red, alpha, and the targa wants the first
+// three of them
+	out = tga + 18;
+	for (i=0 ; i<height ; i++)
+	{
+		in = data + i*rowbytes;
+		for (j=0 ; j<width ; j++, in += 4, out += 3)
+		{
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+		}
+	}
+
+	COM_WriteFile (filename, tga, out - tga);
+}
  
 
 
@@ -619,6 +665,8 @@ void SCR_ScreenShot_f (void)
 // find a file name to save it to 
 // 
 	strcpy(pcxname,"quake00.pcx");
+	if (vid.colormap32)
+		strcpy(pcxname,"quake00.tga");	// 32 bit color is saved as a targa
 		
 	for (i=0 ; i<=99 ; i++) 
 	{ 
@@ -637,8 +685,11 @@ void SCR_ScreenShot_f (void)
 // 
 // save the pcx file 
 // 
-	WritePCXfile (pcxname, vid.buffer, vid.width, vid.height, vid.rowbytes,
-				  host_basepal);
+	if (vid.colormap32)
+		WriteTGAfile (pcxname, vid.buffer, vid.width, vid.height, vid.rowbytes);
+	else
+		WritePCXfile (pcxname, vid.buffer, vid.width, vid.height, vid.rowbytes,
+					  host_basepal);
 
 	Con_Printf ("Wrote %s\n", pcxname);
 } 
@@ -211,6 +211,8 @@ void SV_ClientPrintf (const char *fmt, ...);
 void SV_BroadcastPrintf (char *fmt, ...);
 
 void SV_Physics (void);
+int ClipVelocity (vec3_t in, vec3_t normal, vec3_t out, float overbounce);
+void SV_PushBench_f (void);
 
 qboolean SV_CheckBottom (edict_t *ent);
 qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink);
@@ -223,3 +225,30 @@ void SV_CheckForNewClients (void);
 void SV_RunClients (void);
 void SV_SaveSpawnparms ();
 void SV_SpawnServer (char *server);
+
+void SV_SeedRandom (unsigned seed);
+int SV_Random (void);
+
+//
+// sv_nav.c
+//
+extern	cvar_t	sv_navgrid;
+
+void SV_BuildNavGrid (void);
+qboolean SV_NavNoFloor (edict_t *ent, vec3_t neworg);
+void SV_NavInfo_f (void);
+
+//
+// sv_replay.c
+//
+unsigned SV_SpawnSeed (void);
+void SV_RecordSpawn (void);
+void SV_RecordFrame (void);
+void SV_RecordState (void);
+void SV_StopRecord (void);
+void SV_StopReplay (void);
+struct qsocket_s *SV_NewConnection (void);
+int SV_GetClientMessage (void);
+void SV_Record_f (void);
+void SV_StopRecord_f (void);
+void SV_Replay_f (void);
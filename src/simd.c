@@ -0,0 +1,89 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// simd.c -- cpu feature detection
+
+#include "quakedef.h"
+#include "simd.h"
+
+cvar_t	sys_simd = {"sys_simd", "3"};	// 0 = plain C, 1 = sse2, 2 = sse4.1, 3 = avx2
+
+static int	simd_cpulevel;
+
+static char	*simd_names[] = {"C", "SSE2", "SSE4.1", "AVX2"};
+
+/*
+================
+SIMD_Init
+================
+*/
+void SIMD_Init (void)
+{
+	simd_cpulevel = SIMD_NONE;
+
+#if SIMD_X86
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("sse2"))
+	{
+		simd_cpulevel = SIMD_SSE2;
+		if (__builtin_cpu_supports ("sse4.1"))
+		{
+			simd_cpulevel = SIMD_SSE41;
+			if (__builtin_cpu_supports ("avx2"))
+				simd_cpulevel = SIMD_AVX2;
+		}
+	}
+#endif
+
+	if (COM_CheckParm ("-nosimd"))
+		simd_cpulevel = SIMD_NONE;
+
+	Cvar_RegisterVariable (&sys_simd);
+
+	Con_Printf ("SIMD: %s\n", simd_names[simd_cpulevel]);
+}
+
+/*
+================
+SIMD_Level
+================
+*/
+int SIMD_Level (void)
+{
+	int		level;
+
+	level = (int)sys_simd.value;
+	if (level > simd_cpulevel)
+		level = simd_cpulevel;
+	if (level < SIMD_NONE)
+		level = SIMD_NONE;
+	return level;
+}
+
+/*
+================
+SIMD_Name
+================
+*/
+char *SIMD_Name (int level)
+{
+	if (level < SIMD_NONE || level > SIMD_AVX2)
+		return "?";
+	return simd_names[level];
+}
@@ -0,0 +1,54 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// simd.h -- runtime selection of vectorized inner loops
+
+#ifndef __SIMD__
+#define __SIMD__
+
+//
+// the vector kernels are compiled with per-function target attributes so
+// the rest of the tree keeps building for the baseline instruction set.
+// every kernel has a portable C version that is used when SIMD_X86 is 0.
+//
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define	SIMD_X86		1
+#include <immintrin.h>
+#define	SIMD_TARGET(t)	__attribute__((target(t)))
+#else
+#define	SIMD_X86		0
+#define	SIMD_TARGET(t)
+#endif
+
+#define	SIMD_NONE		0
+#define	SIMD_SSE2		1
+#define	SIMD_SSE41		2
+#define	SIMD_AVX2		3
+
+extern	cvar_t	sys_simd;
+
+void SIMD_Init (void);
+
+// best level supported by the cpu, capped by the sys_simd cvar
+int SIMD_Level (void);
+
+// name of a SIMD_* level for benchmark output
+char *SIMD_Name (int level);
+
+#endif
@@ -76,6 +76,7 @@ cvar_t ambient_fade = {"ambient_fade", "100"};
 cvar_t snd_noextraupdate = {"snd_noextraupdate", "0"};
 cvar_t snd_show = {"snd_show", "0"};
 cvar_t _snd_mixahead = {"_snd_mixahead", "0.1", true};
+cvar_t snd_cullvolume = {"snd_cullvolume", "4"};
 
 
 // ====================================================================
@@ -121,6 +122,11 @@ void S_SoundInfo_f(void)
     Con_Printf("%5d speed\n", shm->speed);
     Con_Printf("0x%x dma buffer\n", shm->buffer);
 	Con_Printf("%5d total_channels\n", total_channels);
+	Con_Printf("%5d active voices\n", snd_activevoices);
+	Con_Printf("%5d culled voices\n", snd_culledvoices);
+	Con_Printf("%5d stolen voices\n", snd_stolenvoices);
+	if (snd_offline)
+		SND_FileInfo ();
 }
 
 
@@ -137,7 +143,15 @@ void S_Startup (void)
 	if (!snd_initialized)
 		return;
 
-	if (!fakedma)
+	if (snd_offline)
+	{
+		if (!SNDDMA_FileInit())
+		{
+			sound_started = 0;
+			return;
+		}
+	}
+	else if (!fakedma)
 	{
 		rc = SNDDMA_Init();
 
@@ -169,16 +183,22 @@ void S_Init (void)
 	if (COM_CheckParm("-simsound"))
 		fakedma = true;
 
+	if (COM_CheckParm("-sndfile") || COM_CheckParm("-sndnull"))
+		snd_offline = true;
+
 	Cmd_AddCommand("play", S_Play);
 	Cmd_AddCommand("playvol", S_PlayVol);
 	Cmd_AddCommand("stopsound", S_StopAllSoundsC);
 	Cmd_AddCommand("soundlist", S_SoundList);
 	Cmd_AddCommand("soundinfo", S_SoundInfo_f);
+	Cmd_AddCommand("snd_mixbench", SND_MixBench_f);
 
 	Cvar_RegisterVariable(&nosound);
 	Cvar_RegisterVariable(&volume);
 	Cvar_RegisterVariable(&precache);
 	Cvar_RegisterVariable(&loadas8bit);
+	Cvar_RegisterVariable(&snd_resample);
+	Cvar_RegisterVariable(&snd_diskcache);
 	Cvar_RegisterVariable(&bgmvolume);
 	Cvar_RegisterVariable(&bgmbuffer);
 	Cvar_RegisterVariable(&ambient_level);
@@ -186,6 +206,8 @@ void S_Init (void)
 	Cvar_RegisterVariable(&snd_noextraupdate);
 	Cvar_RegisterVariable(&snd_show);
 	Cvar_RegisterVariable(&_snd_mixahead);
+	Cvar_RegisterVariable(&snd_cullvolume);
+	Cvar_RegisterVariable(&snd_streamsize);
 
 	if (host_parms.memsize < 0x800000)
 	{
@@ -201,6 +223,11 @@ void S_Init (void)
 
 	SND_InitScaletable ();
 
+// offline mixing runs on the main thread and must not depend on the
+// reader keeping up, so long sounds are loaded whole instead
+	if (sound_started && !snd_offline)
+		S_InitStreams ();
+
 	known_sfx = Hunk_AllocName (MAX_SFX*sizeof(sfx_t), "sfx_t");
 	num_sfx = 0;
 
@@ -245,13 +272,17 @@ void S_Shutdown(void)
 	if (!sound_started)
 		return;
 
+	S_ShutdownStreams ();
+
 	if (shm)
 		shm->gamealive = 0;
 
 	shm = 0;
 	sound_started = 0;
 
-	if (!fakedma)
+	if (snd_offline)
+		SNDDMA_FileShutdown();
+	else if (!fakedma)
 	{
 		SNDDMA_Shutdown();
 	}
@@ -340,50 +371,217 @@ sfx_t *S_PrecacheSound (char *name)
 
 //=============================================================================
 
+/*
+===============================================================================
+
+VOICE POOL
+
+Dynamic channels are handed out from a free list.  A sound that replaces an
+entity's sound on the same channel is found through a hash on the entity
+number, and when the pool is empty the quietest voice is stolen.  The mixer
+frees finished channels on its own, so S_Update rebuilds the free list and
+the steal order once a frame.
+
+===============================================================================
+*/
+
+#define	VOICE_HASH_SIZE		64
+
+static int	voice_hash[VOICE_HASH_SIZE];	// channel index + 1, 0 ends the chain
+static int	voice_next[MAX_CHANNELS];
+static int	voice_hashed[MAX_CHANNELS];		// bucket + 1 the channel is chained in
+
+static int	voice_free[MAX_DYNAMIC_CHANNELS];
+static int	voice_numfree;
+
+static int	voice_steal[MAX_DYNAMIC_CHANNELS];	// active voices, quietest first
+static int	voice_numsteal, voice_stealpos;
+static int	voice_priority[MAX_CHANNELS];
+static int	voice_frame[MAX_CHANNELS];		// voice_framecount when last picked
+static int	voice_framecount;
+static int	voice_started[MAX_DYNAMIC_CHANNELS];	// picked since the last S_Update
+static int	voice_numstarted;
+
+int		snd_activevoices;
+int		snd_culledvoices;
+int		snd_stolenvoices;
+
 /*
 =================
-SND_PickChannel
+SND_UnhashVoice
 =================
 */
-channel_t *SND_PickChannel(int entnum, int entchannel)
+static void SND_UnhashVoice (int ch_idx)
 {
-    int ch_idx;
-    int first_to_die;
-    int life_left;
+	int		*link;
 
-// Check for replacement sound, or find the best one to replace
-    first_to_die = -1;
-    life_left = 0x7fffffff;
-    for (ch_idx=NUM_AMBIENTS ; ch_idx < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS ; ch_idx++)
-    {
-		if (entchannel != 0		// channel 0 never overrides
-		&& channels[ch_idx].entnum == entnum
-		&& (channels[ch_idx].entchannel == entchannel || entchannel == -1) )
-		{	// allways override sound from same entity
-			first_to_die = ch_idx;
+	if (!voice_hashed[ch_idx])
+		return;
+
+	for (link = &voice_hash[voice_hashed[ch_idx]-1] ; *link ; link = &voice_next[*link-1])
+	{
+		if (*link == ch_idx+1)
+		{
+			*link = voice_next[ch_idx];
 			break;
 		}
+	}
+	voice_hashed[ch_idx] = 0;
+}
 
+/*
+=================
+SND_HashVoice
+=================
+*/
+static void SND_HashVoice (int ch_idx, int entnum)
+{
+	int		*head;
+
+	SND_UnhashVoice (ch_idx);
+	head = &voice_hash[entnum & (VOICE_HASH_SIZE-1)];
+	voice_next[ch_idx] = *head;
+	*head = ch_idx+1;
+	voice_hashed[ch_idx] = (entnum & (VOICE_HASH_SIZE-1)) + 1;
+}
+
+/*
+=================
+SND_FindVoice
+
+Returns the dynamic channel an entity is playing on, or -1
+=================
+*/
+static int SND_FindVoice (int entnum, int entchannel)
+{
+	int		i;
+
+	for (i = voice_hash[entnum & (VOICE_HASH_SIZE-1)] ; i ; i = voice_next[i-1])
+	{
+		if (channels[i-1].entnum == entnum
+		&& (channels[i-1].entchannel == entchannel || entchannel == -1) )
+			return i-1;
+	}
+	return -1;
+}
+
+/*
+=================
+SND_ResetVoices
+=================
+*/
+static void SND_ResetVoices (void)
+{
+	int		i;
+
+	Q_memset (voice_hash, 0, sizeof(voice_hash));
+	Q_memset (voice_hashed, 0, sizeof(voice_hashed));
+
+	voice_numfree = 0;
+	for (i=NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS - 1 ; i>=NUM_AMBIENTS ; i--)
+		voice_free[voice_numfree++] = i;
+	voice_numsteal = voice_stealpos = 0;
+	voice_numstarted = 0;
+	snd_stolenvoices = 0;
+}
+
+/*
+=================
+SND_ReleaseChannel
+
+Stops a channel and closes its stream if it has one
+=================
+*/
+static void SND_ReleaseChannel (channel_t *ch)
+{
+	if (ch->stream)
+	{
+		S_CloseStream (ch->stream);
+		ch->stream = 0;
+	}
+	ch->sfx = NULL;
+}
+
+static int SND_ComparePriority (const void *a, const void *b)
+{
+	return voice_priority[*(int *)a] - voice_priority[*(int *)b];
+}
+
+/*
+=================
+SND_PickChannel
+=================
+*/
+channel_t *SND_PickChannel(int entnum, int entchannel, int priority)
+{
+	int		ch_idx;
+	int		i;
+
+// allways override sound from same entity, channel 0 never overrides
+	ch_idx = -1;
+	if (entchannel != 0)
+		ch_idx = SND_FindVoice (entnum, entchannel);
+
+// take a free voice
+	while (ch_idx == -1 && voice_numfree)
+	{
+		ch_idx = voice_free[--voice_numfree];
+		if (channels[ch_idx].sfx)
+			ch_idx = -1;		// picked as an override since the list was built
+	}
+
+// steal the quietest one that is not louder than the new sound
+	for (i=voice_stealpos ; ch_idx == -1 && i<voice_numsteal ; i++)
+	{
+		if (voice_priority[voice_steal[i]] > priority)
+			return NULL;
+		if (voice_frame[voice_steal[i]] == voice_framecount)
+		{	// already reused this frame
+			if (i == voice_stealpos)
+				voice_stealpos++;
+			continue;
+		}
 		// don't let monster sounds override player sounds
-		if (channels[ch_idx].entnum == cl.viewentity && entnum != cl.viewentity && channels[ch_idx].sfx)
+		if (channels[voice_steal[i]].entnum == cl.viewentity && entnum != cl.viewentity && channels[voice_steal[i]].sfx)
 			continue;
 
-		if (channels[ch_idx].end - paintedtime < life_left)
-		{
-			life_left = channels[ch_idx].end - paintedtime;
-			first_to_die = ch_idx;
-		}
-   }
+		ch_idx = voice_steal[i];
+		if (channels[ch_idx].sfx)
+			snd_stolenvoices++;
+	}
 
-	if (first_to_die == -1)
+	if (ch_idx == -1)
 		return NULL;
 
-	if (channels[first_to_die].sfx)
-		channels[first_to_die].sfx = NULL;
+	SND_ReleaseChannel (&channels[ch_idx]);
 
-    return &channels[first_to_die];    
+	voice_frame[ch_idx] = voice_framecount;
+	if (voice_numstarted < MAX_DYNAMIC_CHANNELS)
+		voice_started[voice_numstarted++] = ch_idx;
+	SND_HashVoice (ch_idx, entnum);
+
+    return &channels[ch_idx];    
 }       
 
+/*
+=================
+SND_CullChannel
+
+True if a channel is beyond its clip distance, which SND_Spatialize would
+turn into zero volume on both sides.  Saves the normalize for far sounds.
+=================
+*/
+static qboolean SND_CullChannel (channel_t *ch)
+{
+	vec3_t	source_vec;
+
+	if (ch->entnum == cl.viewentity || ch->dist_mult <= 0)
+		return false;
+
+	VectorSubtract (ch->origin, listener_origin, source_vec);
+	return DotProduct (source_vec, source_vec) * ch->dist_mult * ch->dist_mult >= 1.0;
+}
+
 /*
 =================
 SND_Spatialize
@@ -445,10 +643,13 @@ void SND_Spatialize(channel_t *ch)
 void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation)
 {
 	channel_t *target_chan, *check;
+	channel_t	newchan;
 	sfxcache_t	*sc;
 	int		vol;
-	int		ch_idx;
+	int		i;
 	int		skip;
+	int		stream;
+	char	name[MAX_QPATH+8];
 
 	if (!sound_started)
 		return;
@@ -461,27 +662,46 @@ void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float f
 
 	vol = fvol*255;
 
+// spatialize before picking a channel, so inaudible sounds don't take one
+	memset (&newchan, 0, sizeof(newchan));
+	VectorCopy(origin, newchan.origin);
+	newchan.dist_mult = attenuation / sound_nominal_clip_dist;
+	newchan.master_vol = vol;
+	newchan.entnum = entnum;
+	newchan.entchannel = entchannel;
+	if (SND_CullChannel(&newchan))
+		return;	// not audible at all
+	SND_Spatialize(&newchan);
+
+	if (!newchan.leftvol && !newchan.rightvol)
+		return;	// not audible at all
+
 	S_LockAudioDevice();
 
 // pick a channel to play on
-	target_chan = SND_PickChannel(entnum, entchannel);
+	target_chan = SND_PickChannel(entnum, entchannel,
+		newchan.leftvol > newchan.rightvol ? newchan.leftvol : newchan.rightvol);
 	if (!target_chan)
 		goto done;
-		
-// spatialize
-	memset (target_chan, 0, sizeof(*target_chan));
-	VectorCopy(origin, target_chan->origin);
-	target_chan->dist_mult = attenuation / sound_nominal_clip_dist;
-	target_chan->master_vol = vol;
-	target_chan->entnum = entnum;
-	target_chan->entchannel = entchannel;
-	SND_Spatialize(target_chan);
-
-	if (!target_chan->leftvol && !target_chan->rightvol)
-		goto done;	// not audible at all
+	*target_chan = newchan;
 
 // new channel
 	sc = S_LoadSound (sfx);
+	if (!sc && sfx->stream)
+	{	// long sound, play it from disk, reading its header with the mixer
+		// free to run; nothing else takes the silent channel meanwhile
+		sprintf (name, "sound/%s", sfx->name);
+		S_UnlockAudioDevice();
+		stream = S_OpenStream (name, false);
+		S_LockAudioDevice();
+		target_chan->stream = stream;
+		if (target_chan->stream)
+		{
+			target_chan->sfx = sfx;
+			target_chan->end = 0x7fffffff;
+		}
+		goto done;
+	}
 	if (!sc)
 	{
 		target_chan->sfx = NULL;
@@ -494,9 +714,9 @@ void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float f
 
 // if an identical sound has also been started this frame, offset the pos
 // a bit to keep it from just making the first one louder
-	check = &channels[NUM_AMBIENTS];
-    for (ch_idx=NUM_AMBIENTS ; ch_idx < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS ; ch_idx++, check++)
+    for (i=0 ; i<voice_numstarted ; i++)
     {
+		check = &channels[voice_started[i]];
 		if (check == target_chan)
 			continue;
 		if (check->sfx == sfx && !check->pos)
@@ -519,17 +739,12 @@ void S_StopSound(int entnum, int entchannel)
 	int i;
 
 	S_LockAudioDevice();
-	for (i=0 ; i<MAX_DYNAMIC_CHANNELS ; i++)
+	i = SND_FindVoice (entnum, entchannel);
+	if (i != -1 && channels[i].entchannel == entchannel)
 	{
-		if (channels[i].entnum == entnum
-			&& channels[i].entchannel == entchannel)
-		{
-			channels[i].end = 0;
-			channels[i].sfx = NULL;
-			goto done;
-		}
+		channels[i].end = 0;
+		SND_ReleaseChannel (&channels[i]);
 	}
-done:
 	S_UnlockAudioDevice();
 }
 
@@ -546,9 +761,10 @@ void S_StopAllSounds(qboolean clear)
 
 	for (i=0 ; i<MAX_CHANNELS ; i++)
 		if (channels[i].sfx)
-			channels[i].sfx = NULL;
+			SND_ReleaseChannel (&channels[i]);
 
 	Q_memset(channels, 0, MAX_CHANNELS * sizeof(channel_t));
+	SND_ResetVoices ();
 
 	if (clear)
 		S_ClearBuffer ();
@@ -591,6 +807,8 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 {
 	channel_t	*ss;
 	sfxcache_t	*sc;
+	int			stream;
+	char		name[MAX_QPATH+8];
 
 	if (!sfx)
 		return;
@@ -607,10 +825,19 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 	total_channels++;
 
 	sc = S_LoadSound (sfx);
-	if (!sc)
+	if (!sc && sfx->stream)
+	{	// long ambient loop, play it from disk, opened like in S_StartSound
+		sprintf (name, "sound/%s", sfx->name);
+		S_UnlockAudioDevice();
+		stream = S_OpenStream (name, true);
+		S_LockAudioDevice();
+		ss->stream = stream;
+		if (!ss->stream)
+			goto done;
+	}
+	else if (!sc)
 		goto done;
-
-	if (sc->loopstart == -1)
+	else if (sc->loopstart == -1)
 	{
 		Con_Printf ("Sound %s not looped\n", sfx->name);
 		goto done;
@@ -620,7 +847,10 @@ void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 	VectorCopy (origin, ss->origin);
 	ss->master_vol = vol;
 	ss->dist_mult = (attenuation/64) / sound_nominal_clip_dist;
-    ss->end = paintedtime + sc->length;	
+	if (sc)
+		ss->end = paintedtime + sc->length;
+	else
+		ss->end = 0x7fffffff;
 	
 	SND_Spatialize (ss);
 done:
@@ -694,10 +924,13 @@ Called once each time through the main loop
 */
 void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 {
-	int			i, j;
+	int			i;
 	int			total;
+	int			cull;
 	channel_t	*ch;
 	channel_t	*combine;
+	sfxcache_t	*sc;
+	static channel_t	*sfx_combine[MAX_SFX];
 
 	if (!sound_started || (snd_blocked > 0))
 		return;
@@ -712,54 +945,87 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 // update general area ambient sound sources
 	S_UpdateAmbientSounds ();
 
-	combine = NULL;
+	voice_framecount++;
+	voice_numstarted = 0;
+	voice_numfree = 0;
+	voice_numsteal = voice_stealpos = 0;
+	snd_activevoices = 0;
+	snd_culledvoices = 0;
+	cull = (int)snd_cullvolume.value;
+	Q_memset (sfx_combine, 0, num_sfx * sizeof(sfx_combine[0]));
 
 // update spatialization for static and dynamic sounds	
 	ch = channels+NUM_AMBIENTS;
 	for (i=NUM_AMBIENTS ; i<total_channels; i++, ch++)
 	{
 		if (!ch->sfx)
+		{
+			if (i < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS)
+				voice_free[voice_numfree++] = i;
 			continue;
-		SND_Spatialize(ch);         // respatialize channel
+		}
+
+		if (SND_CullChannel(ch))
+			ch->leftvol = ch->rightvol = 0;
+		else
+			SND_Spatialize(ch);         // respatialize channel
+
+		if (ch->leftvol < cull && ch->rightvol < cull)
+			ch->leftvol = ch->rightvol = 0;
+
+		if (i < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS)
+		{
+		// a one-shot that ran out while culled is finished, the mixer
+		// never saw it to free it
+			if (!ch->leftvol && !ch->rightvol && ch->end <= paintedtime)
+			{
+				sc = Cache_Check (&ch->sfx->cache);
+				if (sc && sc->loopstart < 0)
+				{
+					ch->sfx = NULL;
+					voice_free[voice_numfree++] = i;
+					continue;
+				}
+			}
+
+			voice_priority[i] = ch->leftvol > ch->rightvol ? ch->leftvol : ch->rightvol;
+			voice_steal[voice_numsteal++] = i;
+		}
+
 		if (!ch->leftvol && !ch->rightvol)
+		{
+			snd_culledvoices++;
 			continue;
+		}
+		snd_activevoices++;
 
 	// try to combine static sounds with a previous channel of the same
 	// sound effect so we don't mix five torches every frame
 	
 		if (i >= MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS)
 		{
-		// see if it can just use the last one
-			if (combine && combine->sfx == ch->sfx)
+			combine = sfx_combine[ch->sfx - known_sfx];
+			if (!combine)
 			{
-				combine->leftvol += ch->leftvol;
-				combine->rightvol += ch->rightvol;
-				ch->leftvol = ch->rightvol = 0;
-				continue;
-			}
-		// search for one
-			combine = channels+MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;
-			for (j=MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS ; j<i; j++, combine++)
-				if (combine->sfx == ch->sfx)
-					break;
-					
-			if (j == total_channels)
-			{
-				combine = NULL;
-			}
-			else
-			{
-				if (combine != ch)
-				{
-					combine->leftvol += ch->leftvol;
-					combine->rightvol += ch->rightvol;
-					ch->leftvol = ch->rightvol = 0;
-				}
+				sfx_combine[ch->sfx - known_sfx] = ch;
 				continue;
 			}
+
+			combine->leftvol += ch->leftvol;
+			combine->rightvol += ch->rightvol;
+			ch->leftvol = ch->rightvol = 0;
+			snd_activevoices--;
 		}
-		
-		
+	}
+
+	qsort (voice_steal, voice_numsteal, sizeof(voice_steal[0]), SND_ComparePriority);
+
+// free list is popped from the end, hand out low channels first
+	for (i=0 ; i<voice_numfree/2 ; i++)
+	{
+		total = voice_free[i];
+		voice_free[i] = voice_free[voice_numfree-1-i];
+		voice_free[voice_numfree-1-i] = total;
 	}
 
 //
@@ -776,10 +1042,14 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 				total++;
 			}
 		
-		Con_Printf ("----(%i)----\n", total);
+		Con_Printf ("----(%i)---- %i active %i culled %i stolen\n", total,
+			snd_activevoices, snd_culledvoices, snd_stolenvoices);
 	}
 
 	S_UnlockAudioDevice();
+
+	if (snd_offline)
+		SNDDMA_FileUpdate ();
 }
 
 /*
@@ -0,0 +1,254 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// snd_file.c -- offline dma that mixes by game time instead of a sound card
+
+#include "quakedef.h"
+
+//
+// With -sndfile <name.wav> or -sndnull no audio device is opened.  Every
+// S_Update mixes exactly host_frametime worth of samples on the main thread,
+// so with a fixed host_framerate a timedemo produces the same output on every
+// run.  The mix is optionally written to a wav file in the game directory, and
+// a checksum of it and the time spent mixing are reported so mixer changes can
+// be compared against each other.
+//
+
+#define	SNDFILE_SAMPLES		32768		// dma ring in mono samples, power of two
+#define	SNDFILE_CHUNK		4096		// frames mixed at a time
+#define	SNDFILE_HEADER		44
+
+qboolean	snd_offline;
+
+static volatile dma_t	sndfile_dma;
+static short	sndfile_buffer[SNDFILE_SAMPLES];
+
+static FILE		*sndfile;
+static char		sndfile_name[MAX_OSPATH];
+static double	sndfile_frac;			// samples owed to the mix
+static int		sndfile_frames;			// stereo frames mixed so far
+static unsigned	sndfile_sum;
+static double	sndfile_mixtime;
+
+/*
+================
+SND_FilePutLong
+================
+*/
+static byte *SND_FilePutLong (byte *p, int v)
+{
+	p[0] = v & 255;
+	p[1] = (v >> 8) & 255;
+	p[2] = (v >> 16) & 255;
+	p[3] = (v >> 24) & 255;
+	return p + 4;
+}
+
+/*
+================
+SND_FileWriteHeader
+
+Writes a 16 bit stereo wav header for the given number of frames
+================
+*/
+static void SND_FileWriteHeader (int frames)
+{
+	byte	header[SNDFILE_HEADER];
+	byte	*p;
+	int		datalen;
+
+	datalen = frames * 4;
+
+	p = header;
+	Q_memcpy (p, "RIFF", 4);
+	p = SND_FilePutLong (p+4, datalen + SNDFILE_HEADER - 8);
+	Q_memcpy (p, "WAVEfmt ", 8);
+	p = SND_FilePutLong (p+8, 16);
+	p[0] = 1;	p[1] = 0;			// pcm
+	p[2] = 2;	p[3] = 0;			// channels
+	p = SND_FilePutLong (p+4, sndfile_dma.speed);
+	p = SND_FilePutLong (p, sndfile_dma.speed * 4);
+	p[0] = 4;	p[1] = 0;			// block align
+	p[2] = 16;	p[3] = 0;			// bits
+	Q_memcpy (p+4, "data", 4);
+	SND_FilePutLong (p+8, datalen);
+
+	fseek (sndfile, 0, SEEK_SET);
+	fwrite (header, 1, SNDFILE_HEADER, sndfile);
+	fseek (sndfile, 0, SEEK_END);
+}
+
+/*
+================
+SNDDMA_FileInit
+
+Stands in for SNDDMA_Init when -sndfile or -sndnull is given
+================
+*/
+qboolean SNDDMA_FileInit (void)
+{
+	int		i, len;
+
+	shm = &sndfile_dma;
+	shm->splitbuffer = 0;
+	shm->samplebits = 16;
+	shm->speed = 44100;
+	i = COM_CheckParm("-sndspeed");
+	if (i && i < com_argc-1)
+		shm->speed = Q_atoi(com_argv[i+1]);
+	shm->channels = 2;
+	shm->samples = SNDFILE_SAMPLES;
+	shm->samplepos = 0;
+	shm->soundalive = true;
+	shm->gamealive = true;
+	shm->submission_chunk = 1;
+	shm->buffer = (unsigned char *)sndfile_buffer;
+
+	sndfile_frac = 0;
+	sndfile_frames = 0;
+	sndfile_sum = 2166136261u;
+	sndfile_mixtime = 0;
+
+	i = COM_CheckParm("-sndfile");
+	if (i && i < com_argc-1)
+	{
+		len = snprintf (sndfile_name, sizeof(sndfile_name), "%s/%s", com_gamedir, com_argv[i+1]);
+		if (len < 0 || len >= (int)sizeof(sndfile_name))
+		{
+			Con_Printf ("SNDDMA_FileInit: file name too long\n");
+			return false;
+		}
+		sndfile = fopen (sndfile_name, "wb");
+		if (!sndfile)
+		{
+			Con_Printf ("SNDDMA_FileInit: couldn't create %s\n", sndfile_name);
+			return false;
+		}
+		SND_FileWriteHeader (0);
+		Con_Printf ("Writing sound to %s\n", sndfile_name);
+	}
+	else
+		Con_Printf ("Mixing sound without output\n");
+
+	return true;
+}
+
+/*
+================
+SND_FileOutput
+
+Checksums and writes the frames painted into the ring since start
+================
+*/
+static void SND_FileOutput (int start, int end)
+{
+	int		i, count;
+	int		ofs;
+	short	*in;
+	short	out[SNDFILE_CHUNK*2];
+
+	while (start < end)
+	{
+		ofs = (start * 2) & (SNDFILE_SAMPLES-1);
+		count = (end - start) * 2;
+		if (count > SNDFILE_SAMPLES - ofs)
+			count = SNDFILE_SAMPLES - ofs;
+		if (count > SNDFILE_CHUNK*2)
+			count = SNDFILE_CHUNK*2;
+
+		in = sndfile_buffer + ofs;
+		for (i=0 ; i<count ; i++)
+		{
+			sndfile_sum = (sndfile_sum ^ (unsigned short)in[i]) * 16777619u;
+			out[i] = LittleShort (in[i]);
+		}
+		if (sndfile)
+			fwrite (out, 2, count, sndfile);
+
+		start += count / 2;
+	}
+}
+
+/*
+================
+SNDDMA_FileUpdate
+
+Mixes the samples for the time that passed this frame, called from S_Update
+================
+*/
+void SNDDMA_FileUpdate (void)
+{
+	int		count;
+	int		start;
+	double	time;
+
+	sndfile_frac += host_frametime * shm->speed;
+	count = (int)sndfile_frac;
+	sndfile_frac -= count;
+
+	while (count > 0)
+	{
+		start = paintedtime;
+		shm->samplepos = paintedtime + (count > SNDFILE_CHUNK ? SNDFILE_CHUNK : count);
+
+		time = Sys_FloatTime ();
+		S_PaintChannels (shm->samplepos);
+		sndfile_mixtime += Sys_FloatTime () - time;
+
+		SND_FileOutput (start, paintedtime);
+		sndfile_frames += paintedtime - start;
+		count -= paintedtime - start;
+	}
+}
+
+/*
+================
+SND_FileInfo
+
+Prints the checksum and cost of everything mixed so far
+================
+*/
+void SND_FileInfo (void)
+{
+	double	seconds;
+
+	seconds = sndfile_dma.speed ? (double)sndfile_frames / sndfile_dma.speed : 0;
+	Con_Printf ("offline: %i frames, %.2f seconds, checksum %08x\n",
+		sndfile_frames, seconds, sndfile_sum);
+	if (sndfile_mixtime > 0)
+		Con_Printf ("offline: %.1f ms mixing, %.0fx realtime\n",
+			sndfile_mixtime * 1000, seconds / sndfile_mixtime);
+}
+
+/*
+================
+SNDDMA_FileShutdown
+================
+*/
+void SNDDMA_FileShutdown (void)
+{
+	SND_FileInfo ();
+
+	if (sndfile)
+	{
+		SND_FileWriteHeader (sndfile_frames);
+		fclose (sndfile);
+		sndfile = NULL;
+	}
+}
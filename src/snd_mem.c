@@ -25,6 +25,236 @@ int			cache_full_cycle;
 
 byte *S_Alloc (int size);
 
+cvar_t	snd_resample = {"snd_resample", "1", true};	// band-limited resampling at load time
+cvar_t	snd_diskcache = {"snd_diskcache", "1", true};	// keep resampled sounds in <gamedir>/sndcache
+
+/*
+===============================================================================
+
+POLYPHASE RESAMPLING
+
+Input rate and output rate are reduced to a ratio up:down, and a windowed
+sinc is sampled at each of the up fractional offsets.  Output sample k sits
+at input position k*down/up, so it is a dot product of one phase against
+the taps input samples around it.  The tables are built once per rate pair
+and live in the cache, so they are rebuilt if they get flushed.
+
+===============================================================================
+*/
+
+#define	SND_FILTER_ZEROS	8			// sinc zero crossings on each side
+#define	SND_MAX_PHASES		1024
+#define	SND_MAX_FILTERS		4
+
+typedef struct
+{
+	int		inrate;
+	int		outrate;
+	cache_user_t	cache;
+} sndfilter_t;
+
+typedef struct
+{
+	int		up, down;
+	int		taps;				// per phase, even
+	float	coefs[1];			// [up][taps], variable sized
+} filtertable_t;
+
+static sndfilter_t	snd_filters[SND_MAX_FILTERS];
+static int			snd_nextfilter;
+
+/*
+================
+SND_BuildFilter
+================
+*/
+static filtertable_t *SND_BuildFilter (sndfilter_t *f, int up, int down)
+{
+	filtertable_t	*ft;
+	int		p, i;
+	int		taps, half;
+	float	*c;
+	double	cutoff, d, x, w, sum;
+
+// when decimating the cutoff drops to the output nyquist, and the
+// kernel has to widen to keep the same number of zero crossings
+	cutoff = up < down ? (double)up / down : 1.0;
+	half = (int)ceil (SND_FILTER_ZEROS / cutoff);
+	taps = half*2;
+
+	ft = Cache_Alloc (&f->cache, sizeof(filtertable_t) + up*taps*sizeof(float), "sndfilter");
+	if (!ft)
+		return NULL;
+
+	ft->up = up;
+	ft->down = down;
+	ft->taps = taps;
+
+	for (p=0 ; p<up ; p++)
+	{
+		c = ft->coefs + p*taps;
+		sum = 0;
+		for (i=0 ; i<taps ; i++)
+		{
+		// distance from the output position to input sample i
+			d = (double)p/up + half - 1 - i;
+			x = d * cutoff * M_PI;
+			c[i] = fabs(x) < 1e-9 ? 1.0 : sin(x) / x;
+
+		// blackman window over the kernel
+			x = d / half;
+			if (x <= -1 || x >= 1)
+				w = 0;
+			else
+				w = 0.42 + 0.5*cos(M_PI*x) + 0.08*cos(2*M_PI*x);
+			c[i] *= w;
+			sum += c[i];
+		}
+
+	// unity gain at dc for every phase
+		for (i=0 ; i<taps ; i++)
+			c[i] /= sum;
+	}
+
+	return ft;
+}
+
+/*
+================
+SND_FilterForRates
+
+Returns NULL if the ratio does not reduce to a usable table size
+================
+*/
+static filtertable_t *SND_FilterForRates (int inrate, int outrate)
+{
+	int		i;
+	int		gcd;
+	sndfilter_t	*f;
+	filtertable_t	*ft;
+
+	if (inrate <= 0 || outrate <= 0)
+		return NULL;
+
+	gcd = GreatestCommonDivisor (inrate, outrate);
+	if (outrate / gcd > SND_MAX_PHASES)
+		return NULL;
+
+	for (i=0, f=snd_filters ; i<SND_MAX_FILTERS ; i++, f++)
+	{
+		if (f->inrate == inrate && f->outrate == outrate)
+		{
+			ft = Cache_Check (&f->cache);
+			if (ft)
+				return ft;
+			return SND_BuildFilter (f, outrate / gcd, inrate / gcd);
+		}
+	}
+
+// take over the next slot
+	f = &snd_filters[snd_nextfilter];
+	snd_nextfilter = (snd_nextfilter + 1) % SND_MAX_FILTERS;
+	if (Cache_Check (&f->cache))
+		Cache_Free (&f->cache);
+	f->inrate = inrate;
+	f->outrate = outrate;
+
+	return SND_BuildFilter (f, outrate / gcd, inrate / gcd);
+}
+
+/*
+================
+SND_SourceSample
+
+Reads a source sample as 16 bit range, wrapping looped sounds past the end
+================
+*/
+static float SND_SourceSample (byte *data, int width, int numsamples, int loopstart, int i)
+{
+	if (i < 0)
+		return 0;
+	if (i >= numsamples)
+	{
+		if (loopstart < 0 || loopstart >= numsamples)
+			return 0;
+		i = loopstart + (i - numsamples) % (numsamples - loopstart);
+	}
+
+	if (width == 2)
+		return LittleShort (((short *)data)[i]);
+	return (int)((unsigned char)data[i] - 128) << 8;
+}
+
+/*
+================
+SND_ResamplePolyphase
+================
+*/
+static void SND_ResamplePolyphase (sfxcache_t *sc, filtertable_t *ft, int inwidth, int insamples, int inloop, byte *data)
+{
+	int		i, j;
+	int		phase, base, first;
+	int		step, stepphase;
+	int		half;
+	int		val;
+	float	*c;
+	float	sum;
+	short	*in16;
+
+	half = ft->taps / 2;
+	in16 = (short *)data;
+
+// the source position is base + phase / up, kept reduced so long sounds
+// can't overflow it
+	step = ft->down / ft->up;
+	stepphase = ft->down % ft->up;
+	base = phase = 0;
+	for (i=0 ; i<sc->length ; i++)
+	{
+		c = ft->coefs + phase * ft->taps;
+		first = base - half + 1;
+
+		sum = 0;
+		if (first >= 0 && first + ft->taps <= insamples)
+		{	// fast case, the whole kernel is inside the sample
+			if (inwidth == 2)
+			{
+				for (j=0 ; j<ft->taps ; j++)
+					sum += c[j] * LittleShort (in16[first + j]);
+			}
+			else
+			{
+				for (j=0 ; j<ft->taps ; j++)
+					sum += c[j] * ((int)(data[first + j] - 128) << 8);
+			}
+		}
+		else
+		{
+			for (j=0 ; j<ft->taps ; j++)
+				sum += c[j] * SND_SourceSample (data, inwidth, insamples, inloop, first + j);
+		}
+
+		val = (int)floor (sum + 0.5);
+		if (val > 32767)
+			val = 32767;
+		else if (val < -32768)
+			val = -32768;
+
+		if (sc->width == 2)
+			((short *)sc->data)[i] = val;
+		else
+			((signed char *)sc->data)[i] = val >> 8;
+
+		base += step;
+		phase += stepphase;
+		if (phase >= ft->up)
+		{
+			phase -= ft->up;
+			base++;
+		}
+	}
+}
+
 /*
 ================
 ResampleSfx
@@ -37,7 +267,14 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 	float	stepscale;
 	int		i;
 	int		sample, samplefrac, fracstep;
+	int		insamples, inloop;
 	sfxcache_t	*sc;
+	filtertable_t	*ft;
+
+// find the filter first, building it can flush other cache entries
+	ft = NULL;
+	if (snd_resample.value && inrate != shm->speed)
+		ft = SND_FilterForRates (inrate, shm->speed);
 	
 	sc = Cache_Check (&sfx->cache);
 	if (!sc)
@@ -45,10 +282,12 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 
 	stepscale = (float)inrate / shm->speed;	// this is usually 0.5, 1, or 2
 
-	outcount = sc->length / stepscale;
+	insamples = sc->length;
+	inloop = sc->loopstart;
+	outcount = SND_ResampledLength (sc->length, inrate);
 	sc->length = outcount;
 	if (sc->loopstart != -1)
-		sc->loopstart = sc->loopstart / stepscale;
+		sc->loopstart = SND_ResampledLength (sc->loopstart, inrate);
 
 	sc->speed = shm->speed;
 	if (loadas8bit.value)
@@ -66,6 +305,11 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 			((signed char *)sc->data)[i]
 			= (int)( (unsigned char)(data[i]) - 128);
 	}
+	else if (ft)
+	{
+// band-limited case
+		SND_ResamplePolyphase (sc, ft, inwidth, insamples, inloop, data);
+	}
 	else
 	{
 // general case
@@ -87,6 +331,173 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 	}
 }
 
+/*
+================
+SND_ResampledLength
+
+Number of output samples for a count of samples at inrate
+================
+*/
+int SND_ResampledLength (int samples, int inrate)
+{
+	if (inrate <= 0)
+		return samples;
+	return (int)((long long)samples * shm->speed / inrate);
+}
+
+/*
+===============================================================================
+
+DISK CACHE
+
+Resampled sounds are written to <gamedir>/sndcache/<rate>/<name>.pcm, tagged
+with a hash and length of the source file so edited sounds get redone.
+
+===============================================================================
+*/
+
+#define	SNDCACHE_VERSION	2
+
+typedef struct
+{
+	char	id[4];				// "QSND"
+	int		version;
+	int		srchash;
+	int		srclength;
+	int		speed;
+	int		width;
+	int		length;
+	int		loopstart;
+} sndcacheheader_t;
+
+/*
+================
+SND_CacheFileName
+
+False if the name doesn't fit in size
+================
+*/
+static qboolean SND_CacheFileName (sfx_t *s, char *out, int size)
+{
+	char	base[MAX_QPATH];
+	int		len;
+
+	COM_StripExtension (s->name, base);
+	len = snprintf (out, size, "%s/sndcache/%i/%s.pcm", com_gamedir, shm->speed, base);
+	return len >= 0 && len < size;
+}
+
+/*
+================
+SND_SourceHash
+
+32 bit FNV-1a of the source file, a 16 bit crc collides too easily
+================
+*/
+static int SND_SourceHash (byte *data, int len)
+{
+	unsigned	hash;
+	int		i;
+
+	hash = 2166136261u;
+	for (i=0 ; i<len ; i++)
+		hash = (hash ^ data[i]) * 16777619u;
+	return (int)hash;
+}
+
+/*
+================
+SND_ReadDiskCache
+
+Fills in an allocated sfxcache_t if a matching file exists
+================
+*/
+static qboolean SND_ReadDiskCache (sfx_t *s, sfxcache_t *sc, int srchash, int srclength)
+{
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	sndcacheheader_t	h;
+	int		i, size;
+	qboolean	ok;
+
+	if (!SND_CacheFileName (s, name, sizeof(name)))
+		return false;
+	f = fopen (name, "rb");
+	if (!f)
+		return false;
+
+	ok = false;
+	if (fread (&h, sizeof(h), 1, f) == 1
+		&& !Q_strncmp (h.id, "QSND", 4)
+		&& LittleLong (h.version) == SNDCACHE_VERSION
+		&& LittleLong (h.srchash) == srchash
+		&& LittleLong (h.srclength) == srclength
+		&& LittleLong (h.speed) == sc->speed
+		&& LittleLong (h.width) == sc->width
+		&& LittleLong (h.length) == sc->length)
+	{
+		size = sc->length * sc->width;
+		if (fread (sc->data, 1, size, f) == size)
+		{
+			sc->loopstart = LittleLong (h.loopstart);
+			if (sc->width == 2)
+				for (i=0 ; i<sc->length ; i++)
+					((short *)sc->data)[i] = LittleShort (((short *)sc->data)[i]);
+			ok = true;
+		}
+	}
+
+	fclose (f);
+	return ok;
+}
+
+/*
+================
+SND_WriteDiskCache
+================
+*/
+static void SND_WriteDiskCache (sfx_t *s, sfxcache_t *sc, int srchash, int srclength)
+{
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	sndcacheheader_t	h;
+	int		i;
+	short	val;
+
+	if (!SND_CacheFileName (s, name, sizeof(name)))
+		return;
+	COM_CreatePath (name);
+	f = fopen (name, "wb");
+	if (!f)
+	{
+		Con_DPrintf ("Couldn't write %s\n", name);
+		return;
+	}
+
+	memcpy (h.id, "QSND", 4);
+	h.version = LittleLong (SNDCACHE_VERSION);
+	h.srchash = LittleLong (srchash);
+	h.srclength = LittleLong (srclength);
+	h.speed = LittleLong (sc->speed);
+	h.width = LittleLong (sc->width);
+	h.length = LittleLong (sc->length);
+	h.loopstart = LittleLong (sc->loopstart);
+	fwrite (&h, sizeof(h), 1, f);
+
+	if (sc->width == 2)
+	{
+		for (i=0 ; i<sc->length ; i++)
+		{
+			val = LittleShort (((short *)sc->data)[i]);
+			fwrite (&val, 2, 1, f);
+		}
+	}
+	else
+		fwrite (sc->data, 1, sc->length, f);
+
+	fclose (f);
+}
+
 //=============================================================================
 
 /*
@@ -100,7 +511,9 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	byte	*data;
 	wavinfo_t	info;
 	int		len;
-	float	stepscale;
+	int		srclength, srchash;
+	qboolean	diskcache;
+	int		handle;
 	sfxcache_t	*sc;
 	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
 
@@ -109,11 +522,27 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	if (sc)
 		return sc;
 
+	if (s->stream)
+		return NULL;
+
 //Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
 // load it in
     Q_strcpy(namebuffer, "sound/");
     Q_strcat(namebuffer, s->name);
 
+// long sounds are played from disk instead of the cache
+	if (snd_streamsize.value > 0 && !snd_offline)
+	{
+		len = COM_OpenFile (namebuffer, &handle);
+		if (handle != -1)
+			COM_CloseFile (handle);
+		if (len > snd_streamsize.value)
+		{
+			s->stream = true;
+			return NULL;
+		}
+	}
+
 //	Con_Printf ("loading %s\n",namebuffer);
 
 	data = COM_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf));
@@ -123,22 +552,35 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		Con_Printf ("Couldn't load %s\n", namebuffer);
 		return NULL;
 	}
+	srclength = com_filesize;
 
-	info = GetWavinfo (s->name, data, com_filesize);
+	info = GetWavinfo (s->name, data, srclength);
 	if (info.channels != 1)
 	{
 		Con_Printf ("%s is a stereo sample\n",s->name);
 		return NULL;
 	}
 
-	stepscale = (float)info.rate / shm->speed;	
-	len = info.samples / stepscale;
+	len = SND_ResampledLength (info.samples, info.rate);
 
-	len = len * info.width * info.channels;
+	len = len * (loadas8bit.value ? 1 : info.width) * info.channels;
 
 	sc = Cache_Alloc ( &s->cache, len + sizeof(sfxcache_t), s->name);
 	if (!sc)
 		return NULL;
+
+// only filtered sounds are worth keeping on disk
+	diskcache = snd_diskcache.value && snd_resample.value && info.rate != shm->speed;
+	if (diskcache)
+	{
+		srchash = SND_SourceHash (data, srclength);
+		sc->length = SND_ResampledLength (info.samples, info.rate);
+		sc->speed = shm->speed;
+		sc->width = loadas8bit.value ? 1 : info.width;
+		sc->stereo = 0;
+		if (SND_ReadDiskCache (s, sc, srchash, srclength))
+			return sc;
+	}
 	
 	sc->length = info.samples;
 	sc->loopstart = info.loopstart;
@@ -148,6 +590,14 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
 
+// building the filter can have flushed the sound itself
+	sc = Cache_Check (&s->cache);
+	if (!sc)
+		return NULL;
+
+	if (diskcache)
+		SND_WriteDiskCache (s, sc, srchash, srclength);
+
 	return sc;
 }
 
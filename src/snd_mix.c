@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // snd_mix.c -- portable code to mix sounds for snd_dma.c
 
 #include "quakedef.h"
+#include "simd.h"
 
 #define DWORD	unsigned long
 
@@ -29,39 +30,382 @@ int		snd_scaletable[32][256];
 int 	*snd_p, snd_linear_count, snd_vol;
 short	*snd_out;
 
-void Snd_WriteLinearBlastStereo16 (void)
+// a channel ready to be mixed: sample pointer and per-side multipliers
+typedef struct
+{
+	void	*data;
+	int		leftvol;
+	int		rightvol;
+} mixsource_t;
+
+// channels that cover the whole paint buffer are mixed this many at a time
+// so the paint buffer is only read and written once per batch
+#define	MAX_MIX_BATCH	8
+
+typedef void (*paintfunc_t) (portable_samplepair_t *out, mixsource_t *src, int numsrc, int count);
+typedef void (*blastfunc_t) (short *out, int *in, int count, int vol);
+
+static paintfunc_t	snd_paint8[SIMD_AVX2+1];
+static paintfunc_t	snd_paint16[SIMD_AVX2+1];
+static blastfunc_t	snd_blast[SIMD_AVX2+1];
+
+/*
+===============================================================================
+
+MIXING KERNELS
+
+8 bit samples are scaled by (vol & ~7), matching snd_scaletable.
+16 bit samples are scaled by vol and shifted down by 8.
+
+===============================================================================
+*/
+
+static void SND_Paint8_C (portable_samplepair_t *out, mixsource_t *src, int numsrc, int count)
+{
+	int		i, j;
+	int		data;
+	int		*lscale, *rscale;
+	unsigned char *sfx;
+
+	for (j=0 ; j<numsrc ; j++, src++)
+	{
+		lscale = snd_scaletable[src->leftvol >> 3];
+		rscale = snd_scaletable[src->rightvol >> 3];
+		sfx = (unsigned char *)src->data;
+
+		for (i=0 ; i<count ; i++)
+		{
+			data = sfx[i];
+			out[i].left += lscale[data];
+			out[i].right += rscale[data];
+		}
+	}
+}
+
+static void SND_Paint16_C (portable_samplepair_t *out, mixsource_t *src, int numsrc, int count)
+{
+	int		i, j;
+	int		data;
+	int		leftvol, rightvol;
+	signed short *sfx;
+
+	for (j=0 ; j<numsrc ; j++, src++)
+	{
+		leftvol = src->leftvol;
+		rightvol = src->rightvol;
+		sfx = (signed short *)src->data;
+
+		for (i=0 ; i<count ; i++)
+		{
+			data = sfx[i];
+			out[i].left += (data * leftvol) >> 8;
+			out[i].right += (data * rightvol) >> 8;
+		}
+	}
+}
+
+static void Snd_Blast_C (short *out, int *in, int count, int vol)
 {
 	int		i;
 	int		val;
 
-	for (i=0 ; i<snd_linear_count ; i+=2)
+	for (i=0 ; i<count ; i++)
 	{
-		val = (snd_p[i]*snd_vol)>>8;
+		val = (in[i]*vol)>>8;
 		if (val > 0x7fff)
-			snd_out[i] = 0x7fff;
+			out[i] = 0x7fff;
 		else if (val < (short)0x8000)
-			snd_out[i] = (short)0x8000;
+			out[i] = (short)0x8000;
 		else
-			snd_out[i] = val;
+			out[i] = val;
+	}
+}
 
-		val = (snd_p[i+1]*snd_vol)>>8;
-		if (val > 0x7fff)
-			snd_out[i+1] = 0x7fff;
-		else if (val < (short)0x8000)
-			snd_out[i+1] = (short)0x8000;
-		else
-			snd_out[i+1] = val;
+#if SIMD_X86
+
+// sse2 has no 32 bit multiply, but the low half of an unsigned product is
+// the same as the low half of the signed one
+SIMD_TARGET("sse2") static inline __m128i SND_MulLo32_SSE2 (__m128i a, __m128i b)
+{
+	__m128i	even, odd;
+
+	even = _mm_mul_epu32 (a, b);
+	odd = _mm_mul_epu32 (_mm_srli_si128 (a, 4), _mm_srli_si128 (b, 4));
+	return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE(0,0,2,0)),
+		_mm_shuffle_epi32 (odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+// adds 8 left and 8 right sums into 8 interleaved sample pairs
+SIMD_TARGET("sse2") static inline void SND_Accum8_SSE2 (portable_samplepair_t *out,
+	__m128i l0, __m128i l1, __m128i r0, __m128i r1)
+{
+	__m128i	*p;
+
+	p = (__m128i *)out;
+	_mm_storeu_si128 (p+0, _mm_add_epi32 (_mm_loadu_si128 (p+0), _mm_unpacklo_epi32 (l0, r0)));
+	_mm_storeu_si128 (p+1, _mm_add_epi32 (_mm_loadu_si128 (p+1), _mm_unpackhi_epi32 (l0, r0)));
+	_mm_storeu_si128 (p+2, _mm_add_epi32 (_mm_loadu_si128 (p+2), _mm_unpacklo_epi32 (l1, r1)));
+	_mm_storeu_si128 (p+3, _mm_add_epi32 (_mm_loadu_si128 (p+3), _mm_unpackhi_epi32 (l1, r1)));
+}
+
+SIMD_TARGET("sse2") static void SND_Paint8_SSE2 (portable_samplepair_t *out, mixsource_t *src, int numsrc, int count)
+{
+	int		i, j;
+	int		tail;
+	__m128i	l0, l1, r0, r1;
+	__m128i	d, lv, rv, p;
+
+	tail = count & ~7;
+	for (i=0 ; i<tail ; i+=8)
+	{
+		l0 = l1 = r0 = r1 = _mm_setzero_si128 ();
+		for (j=0 ; j<numsrc ; j++)
+		{
+			d = _mm_loadl_epi64 ((__m128i *)((signed char *)src[j].data + i));
+			d = _mm_srai_epi16 (_mm_unpacklo_epi8 (d, d), 8);
+			lv = _mm_set1_epi16 (src[j].leftvol & ~7);
+			rv = _mm_set1_epi16 (src[j].rightvol & ~7);
+
+			// products fit in 16 bits, widen with sign
+			p = _mm_mullo_epi16 (d, lv);
+			l0 = _mm_add_epi32 (l0, _mm_srai_epi32 (_mm_unpacklo_epi16 (p, p), 16));
+			l1 = _mm_add_epi32 (l1, _mm_srai_epi32 (_mm_unpackhi_epi16 (p, p), 16));
+			p = _mm_mullo_epi16 (d, rv);
+			r0 = _mm_add_epi32 (r0, _mm_srai_epi32 (_mm_unpacklo_epi16 (p, p), 16));
+			r1 = _mm_add_epi32 (r1, _mm_srai_epi32 (_mm_unpackhi_epi16 (p, p), 16));
+		}
+		SND_Accum8_SSE2 (out + i, l0, l1, r0, r1);
+	}
+
+	if (tail < count)
+	{
+		for (j=0 ; j<numsrc ; j++)
+		{
+			mixsource_t	s = src[j];
+			s.data = (signed char *)s.data + tail;
+			SND_Paint8_C (out + tail, &s, 1, count - tail);
+		}
+	}
+}
+
+SIMD_TARGET("sse2") static void SND_Paint16_SSE2 (portable_samplepair_t *out, mixsource_t *src, int numsrc, int count)
+{
+	int		i, j;
+	int		tail;
+	__m128i	l0, l1, r0, r1;
+	__m128i	d, v, lo, hi;
+
+	tail = count & ~7;
+	for (i=0 ; i<tail ; i+=8)
+	{
+		l0 = l1 = r0 = r1 = _mm_setzero_si128 ();
+		for (j=0 ; j<numsrc ; j++)
+		{
+			d = _mm_loadu_si128 ((__m128i *)((signed short *)src[j].data + i));
+
+			// 16x16 -> 32 bit products from the low and high halves
+			v = _mm_set1_epi16 (src[j].leftvol);
+			lo = _mm_mullo_epi16 (d, v);
+			hi = _mm_mulhi_epi16 (d, v);
+			l0 = _mm_add_epi32 (l0, _mm_srai_epi32 (_mm_unpacklo_epi16 (lo, hi), 8));
+			l1 = _mm_add_epi32 (l1, _mm_srai_epi32 (_mm_unpackhi_epi16 (lo, hi), 8));
+
+			v = _mm_set1_epi16 (src[j].rightvol);
+			lo = _mm_mullo_epi16 (d, v);
+			hi = _mm_mulhi_epi16 (d, v);
+			r0 = _mm_add_epi32 (r0, _mm_srai_epi32 (_mm_unpacklo_epi16 (lo, hi), 8));
+			r1 = _mm_add_epi32 (r1, _mm_srai_epi32 (_mm_unpackhi_epi16 (lo, hi), 8));
+		}
+		SND_Accum8_SSE2 (out + i, l0, l1, r0, r1);
+	}
+
+	if (tail < count)
+	{
+		for (j=0 ; j<numsrc ; j++)
+		{
+			mixsource_t	s = src[j];
+			s.data = (signed short *)s.data + tail;
+			SND_Paint16_C (out + tail, &s, 1, count - tail);
+		}
+	}
+}
+
+SIMD_TARGET("sse2") static void Snd_Blast_SSE2 (short *out, int *in, int count, int vol)
+{
+	int		i;
+	int		tail;
+	__m128i	v, a, b;
+
+	v = _mm_set1_epi32 (vol);
+	tail = count & ~7;
+	for (i=0 ; i<tail ; i+=8)
+	{
+		a = _mm_loadu_si128 ((__m128i *)(in + i));
+		b = _mm_loadu_si128 ((__m128i *)(in + i + 4));
+		a = _mm_srai_epi32 (SND_MulLo32_SSE2 (a, v), 8);
+		b = _mm_srai_epi32 (SND_MulLo32_SSE2 (b, v), 8);
+		_mm_storeu_si128 ((__m128i *)(out + i), _mm_packs_epi32 (a, b));
+	}
+
+	Snd_Blast_C (out + tail, in + tail, count - tail, vol);
+}
+
+// adds 8 left and 8 right sums into 8 interleaved sample pairs
+SIMD_TARGET("avx2") static inline void SND_Accum8_AVX2 (portable_samplepair_t *out, __m256i l, __m256i r)
+{
+	__m256i	*p;
+	__m256i	lo, hi;
+
+	// unpack works inside 128 bit lanes, so swap the middle halves back
+	lo = _mm256_unpacklo_epi32 (l, r);
+	hi = _mm256_unpackhi_epi32 (l, r);
+	p = (__m256i *)out;
+	_mm256_storeu_si256 (p+0, _mm256_add_epi32 (_mm256_loadu_si256 (p+0), _mm256_permute2x128_si256 (lo, hi, 0x20)));
+	_mm256_storeu_si256 (p+1, _mm256_add_epi32 (_mm256_loadu_si256 (p+1), _mm256_permute2x128_si256 (lo, hi, 0x31)));
+}
+
+SIMD_TARGET("avx2") static void SND_Paint8_AVX2 (portable_samplepair_t *out, mixsource_t *src, int numsrc, int count)
+{
+	int		i, j;
+	int		tail;
+	__m256i	l, r, d;
+
+	tail = count & ~7;
+	for (i=0 ; i<tail ; i+=8)
+	{
+		l = r = _mm256_setzero_si256 ();
+		for (j=0 ; j<numsrc ; j++)
+		{
+			d = _mm256_cvtepi8_epi32 (_mm_loadl_epi64 ((__m128i *)((signed char *)src[j].data + i)));
+			l = _mm256_add_epi32 (l, _mm256_mullo_epi32 (d, _mm256_set1_epi32 (src[j].leftvol & ~7)));
+			r = _mm256_add_epi32 (r, _mm256_mullo_epi32 (d, _mm256_set1_epi32 (src[j].rightvol & ~7)));
+		}
+		SND_Accum8_AVX2 (out + i, l, r);
+	}
+
+	if (tail < count)
+	{
+		for (j=0 ; j<numsrc ; j++)
+		{
+			mixsource_t	s = src[j];
+			s.data = (signed char *)s.data + tail;
+			SND_Paint8_C (out + tail, &s, 1, count - tail);
+		}
 	}
 }
 
+SIMD_TARGET("avx2") static void SND_Paint16_AVX2 (portable_samplepair_t *out, mixsource_t *src, int numsrc, int count)
+{
+	int		i, j;
+	int		tail;
+	__m256i	l, r, d;
+
+	tail = count & ~7;
+	for (i=0 ; i<tail ; i+=8)
+	{
+		l = r = _mm256_setzero_si256 ();
+		for (j=0 ; j<numsrc ; j++)
+		{
+			d = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((__m128i *)((signed short *)src[j].data + i)));
+			l = _mm256_add_epi32 (l, _mm256_srai_epi32 (_mm256_mullo_epi32 (d, _mm256_set1_epi32 (src[j].leftvol)), 8));
+			r = _mm256_add_epi32 (r, _mm256_srai_epi32 (_mm256_mullo_epi32 (d, _mm256_set1_epi32 (src[j].rightvol)), 8));
+		}
+		SND_Accum8_AVX2 (out + i, l, r);
+	}
+
+	if (tail < count)
+	{
+		for (j=0 ; j<numsrc ; j++)
+		{
+			mixsource_t	s = src[j];
+			s.data = (signed short *)s.data + tail;
+			SND_Paint16_C (out + tail, &s, 1, count - tail);
+		}
+	}
+}
+
+SIMD_TARGET("avx2") static void Snd_Blast_AVX2 (short *out, int *in, int count, int vol)
+{
+	int		i;
+	int		tail;
+	__m256i	v, a, b;
+
+	v = _mm256_set1_epi32 (vol);
+	tail = count & ~15;
+	for (i=0 ; i<tail ; i+=16)
+	{
+		a = _mm256_loadu_si256 ((__m256i *)(in + i));
+		b = _mm256_loadu_si256 ((__m256i *)(in + i + 8));
+		a = _mm256_srai_epi32 (_mm256_mullo_epi32 (a, v), 8);
+		b = _mm256_srai_epi32 (_mm256_mullo_epi32 (b, v), 8);
+		// packs works inside 128 bit lanes
+		a = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (a, b), _MM_SHUFFLE(3,1,2,0));
+		_mm256_storeu_si256 ((__m256i *)(out + i), a);
+	}
+
+	Snd_Blast_C (out + tail, in + tail, count - tail, vol);
+}
+
+#endif	// SIMD_X86
+
+/*
+================
+SND_InitMixer
+
+Fills the kernel tables, one entry per SIMD_* level
+================
+*/
+static void SND_InitMixer (void)
+{
+	int		i;
+
+	for (i=0 ; i<=SIMD_AVX2 ; i++)
+	{
+		snd_paint8[i] = SND_Paint8_C;
+		snd_paint16[i] = SND_Paint16_C;
+		snd_blast[i] = Snd_Blast_C;
+	}
+
+#if SIMD_X86
+	for (i=SIMD_SSE2 ; i<=SIMD_AVX2 ; i++)
+	{
+		snd_paint8[i] = SND_Paint8_SSE2;
+		snd_paint16[i] = SND_Paint16_SSE2;
+		snd_blast[i] = Snd_Blast_SSE2;
+	}
+	snd_paint8[SIMD_AVX2] = SND_Paint8_AVX2;
+	snd_paint16[SIMD_AVX2] = SND_Paint16_AVX2;
+	snd_blast[SIMD_AVX2] = Snd_Blast_AVX2;
+#endif
+}
+
+/*
+================
+SND_MasterVolume
+
+The SDL callback used to scale its output by volume a second time after
+the transfer, so keep the same loudness curve now that it is a single pass.
+================
+*/
+static int SND_MasterVolume (void)
+{
+	return (int)(volume.value * volume.value * 256);
+}
+
+//=============================================================================
+
+void Snd_WriteLinearBlastStereo16 (void)
+{
+	snd_blast[SIMD_Level ()] (snd_out, snd_p, snd_linear_count, snd_vol);
+}
+
 void S_TransferStereo16 (int endtime)
 {
 	int		lpos;
 	int		lpaintedtime;
 	DWORD	*pbuf;
 	
-	snd_vol = volume.value*256;
-
+	snd_vol = SND_MasterVolume ();
 	snd_p = (int *) paintbuffer;
 	lpaintedtime = paintedtime;
 
@@ -112,7 +456,7 @@ void S_TransferPaintBuffer(int endtime)
 	out_mask = shm->samples - 1; 
 	out_idx = paintedtime * shm->channels & out_mask;
 	step = 3 - shm->channels;
-	snd_vol = volume.value*256;
+	snd_vol = SND_MasterVolume ();
 
 	pbuf = (DWORD *)shm->buffer;
 
@@ -157,8 +501,29 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int endtime);
-void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int endtime);
+/*
+================
+SND_SetupSource
+
+Clamps the channel volumes the way the 8 bit scale table needs them
+================
+*/
+static void SND_SetupSource (mixsource_t *src, channel_t *ch, sfxcache_t *sc)
+{
+	if (sc->width == 1)
+	{
+		if (ch->leftvol > 255)
+			ch->leftvol = 255;
+		if (ch->rightvol > 255)
+			ch->rightvol = 255;
+		src->data = (signed char *)sc->data + ch->pos;
+	}
+	else
+		src->data = (signed short *)sc->data + ch->pos;
+
+	src->leftvol = ch->leftvol;
+	src->rightvol = ch->rightvol;
+}
 
 void S_PaintChannels(int endtime)
 {
@@ -167,6 +532,12 @@ void S_PaintChannels(int endtime)
 	channel_t *ch;
 	sfxcache_t	*sc;
 	int		ltime, count;
+	int		level;
+	mixsource_t	src;
+	mixsource_t	batch8[MAX_MIX_BATCH], batch16[MAX_MIX_BATCH];
+	int		numbatch8, numbatch16;
+
+	level = SIMD_Level ();
 
 	while (paintedtime < endtime)
 	{
@@ -178,12 +549,24 @@ void S_PaintChannels(int endtime)
 	// clear the paint buffer
 		Q_memset(paintbuffer, 0, (end - paintedtime) * sizeof(portable_samplepair_t));
 
+		numbatch8 = numbatch16 = 0;
+
 	// paint in the channels.
 		ch = channels;
 		for (i=0; i<total_channels ; i++, ch++)
 		{
 			if (!ch->sfx)
 				continue;
+			if (ch->stream)
+			{
+				if (!S_PaintStream (ch->stream, paintbuffer, end - paintedtime, ch->leftvol, ch->rightvol))
+				{	// stream ran out
+					S_CloseStream (ch->stream);
+					ch->stream = 0;
+					ch->sfx = NULL;
+				}
+				continue;
+			}
 			if (!ch->leftvol && !ch->rightvol)
 				continue;
 			sc = S_LoadSound (ch->sfx);
@@ -201,11 +584,37 @@ void S_PaintChannels(int endtime)
 
 				if (count > 0)
 				{	
-					if (sc->width == 1)
-						SND_PaintChannelFrom8(ch, sc, count);
+					SND_SetupSource (&src, ch, sc);
+
+				// runs that fill the whole buffer are batched with other
+				// channels, partial runs at a loop point are painted now
+					if (count == end - paintedtime)
+					{
+						if (sc->width == 1)
+						{
+							batch8[numbatch8++] = src;
+							if (numbatch8 == MAX_MIX_BATCH)
+							{
+								snd_paint8[level] (paintbuffer, batch8, numbatch8, count);
+								numbatch8 = 0;
+							}
+						}
+						else
+						{
+							batch16[numbatch16++] = src;
+							if (numbatch16 == MAX_MIX_BATCH)
+							{
+								snd_paint16[level] (paintbuffer, batch16, numbatch16, count);
+								numbatch16 = 0;
+							}
+						}
+					}
+					else if (sc->width == 1)
+						snd_paint8[level] (paintbuffer + ltime - paintedtime, &src, 1, count);
 					else
-						SND_PaintChannelFrom16(ch, sc, count);
-	
+						snd_paint16[level] (paintbuffer + ltime - paintedtime, &src, 1, count);
+
+					ch->pos += count;
 					ltime += count;
 				}
 
@@ -227,6 +636,13 @@ void S_PaintChannels(int endtime)
 															  
 		}
 
+		if (numbatch8)
+			snd_paint8[level] (paintbuffer, batch8, numbatch8, end - paintedtime);
+		if (numbatch16)
+			snd_paint16[level] (paintbuffer, batch16, numbatch16, end - paintedtime);
+
+		S_PaintMusic (paintbuffer, end - paintedtime);
+
 	// transfer out according to DMA format
 		S_TransferPaintBuffer(end);
 		paintedtime = end;
@@ -240,56 +656,110 @@ void SND_InitScaletable (void)
 	for (i=0 ; i<32 ; i++)
 		for (j=0 ; j<256 ; j++)
 			snd_scaletable[i][j] = ((signed char)j) * i * 8;
+
+	SND_InitMixer ();
 }
 
+/*
+===============================================================================
 
-void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count)
-{
-	int 	data;
-	int		*lscale, *rscale;
-	unsigned char *sfx;
-	int		i;
+BENCHMARK
 
-	if (ch->leftvol > 255)
-		ch->leftvol = 255;
-	if (ch->rightvol > 255)
-		ch->rightvol = 255;
-		
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
-	sfx = (signed char *)sc->data + ch->pos;
+===============================================================================
+*/
 
-	for (i=0 ; i<count ; i++)
-	{
-		data = sfx[i];
-		paintbuffer[i].left += lscale[data];
-		paintbuffer[i].right += rscale[data];
-	}
-	
-	ch->pos += count;
-}
+#define	MIXBENCH_LENGTH		(PAINTBUFFER_SIZE*4)
+#define	MIXBENCH_LOOPS		256
 
-void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count)
-{
-	int data;
-	int left, right;
-	int leftvol, rightvol;
-	signed short *sfx;
-	int	i;
+/*
+================
+SND_MixBench
 
-	leftvol = ch->leftvol;
-	rightvol = ch->rightvol;
-	sfx = (signed short *)sc->data + ch->pos;
+Mixes numch channels of the given width through the kernels of one level,
+returns seconds per paint buffer
+================
+*/
+static double SND_MixBench (int level, int width, byte *sfx, int numch, portable_samplepair_t *pb, short *out)
+{
+	int		i, j, n;
+	int		pos;
+	mixsource_t	src[MAX_MIX_BATCH];
+	double	start;
 
-	for (i=0 ; i<count ; i++)
+	start = Sys_FloatTime ();
+	for (i=0 ; i<MIXBENCH_LOOPS ; i++)
 	{
-		data = sfx[i];
-		left = (data * leftvol) >> 8;
-		right = (data * rightvol) >> 8;
-		paintbuffer[i].left += left;
-		paintbuffer[i].right += right;
+		Q_memset (pb, 0, PAINTBUFFER_SIZE * sizeof(portable_samplepair_t));
+		for (j=0 ; j<numch ; j+=n)
+		{
+			n = numch - j;
+			if (n > MAX_MIX_BATCH)
+				n = MAX_MIX_BATCH;
+			for (pos=0 ; pos<n ; pos++)
+			{
+			// spread the channels through the sample and across the volume range
+				src[pos].data = sfx + ((j+pos)*97 % (MIXBENCH_LENGTH - PAINTBUFFER_SIZE))*width;
+				src[pos].leftvol = (j+pos)*37 & 255;
+				src[pos].rightvol = 255 - src[pos].leftvol;
+			}
+			if (width == 1)
+				snd_paint8[level] (pb, src, n, PAINTBUFFER_SIZE);
+			else
+				snd_paint16[level] (pb, src, n, PAINTBUFFER_SIZE);
+		}
+		snd_blast[level] (out, (int *)pb, PAINTBUFFER_SIZE*2, 179);
 	}
 
-	ch->pos += count;
+	return (Sys_FloatTime () - start) / MIXBENCH_LOOPS;
 }
 
+/*
+================
+SND_MixBench_f
+
+For program optimization: times the paint and transfer kernels at every
+available SIMD level and checks them against the C version
+================
+*/
+void SND_MixBench_f (void)
+{
+	static int	numchannels[] = {8, 16, 64};
+	int		i, w, level, maxlevel;
+	int		width;
+	byte	*sfx;
+	short	*sfx16;
+	portable_samplepair_t	*pb;
+	short	*ref, *out;
+	double	t;
+
+	sfx = Hunk_TempAlloc (MIXBENCH_LENGTH*2 + PAINTBUFFER_SIZE*(sizeof(portable_samplepair_t) + 8));
+	pb = (portable_samplepair_t *)(sfx + MIXBENCH_LENGTH*2);
+	ref = (short *)(pb + PAINTBUFFER_SIZE);
+	out = ref + PAINTBUFFER_SIZE*2;
+
+// something noisy that uses the whole range
+	sfx16 = (short *)sfx;
+	for (i=0 ; i<MIXBENCH_LENGTH ; i++)
+		sfx16[i] = (short)(sin(i*0.05) * 20000 + ((i*7919) & 0x1fff) - 0x1000);
+
+	maxlevel = SIMD_Level ();
+
+	for (w=0 ; w<2 ; w++)
+	{
+		width = w ? 2 : 1;
+		Con_Printf ("%i bit samples, usec per %i sample buffer\n", width*8, PAINTBUFFER_SIZE);
+
+		for (i=0 ; i<sizeof(numchannels)/sizeof(numchannels[0]) ; i++)
+		{
+			Con_Printf ("%3i ch:", numchannels[i]);
+			for (level=SIMD_NONE ; level<=maxlevel ; level++)
+			{
+				t = SND_MixBench (level, width, sfx, numchannels[i], pb, level ? out : ref);
+				Con_Printf (" %s %6.2f", SIMD_Name (level), t*1000000);
+				if (level && Q_memcmp (ref, out, PAINTBUFFER_SIZE*2*sizeof(short)))
+					Con_Printf (" (MISMATCH)");
+			}
+			Con_Printf ("\n");
+		}
+	}
+}
@@ -34,24 +34,20 @@ void SDLCALL render_audio (void *userdata, Uint8* stream, int len)
 		shm->samplepos += len/(shm->samplebits/8)/2;
 		S_PaintChannels (shm->samplepos);
         shm->buffer = NULL;
-
-        // apply volume control
-        int16_t* p = (int16_t*)stream;
-        int16_t* end = (int16_t*)(stream + len);
-        while (p < end)
-        {
-            *p = round(*p * volume.value);
-            ++p;
-        }
 	}
 }
 
 qboolean SNDDMA_Init(void)
 {
+    int i;
+
     shm = &sn;
     shm->splitbuffer = 0;
     shm->samplebits = 16;
-    shm->speed = 22050;
+    shm->speed = 44100;
+    i = COM_CheckParm("-sndspeed");
+    if (i && i < com_argc-1)
+        shm->speed = Q_atoi(com_argv[i+1]);
     shm->channels = 2;
     shm->samples = AUDIO_BUFFER_SAMPLES * shm->channels;
     shm->samplepos = 0;
@@ -0,0 +1,601 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// snd_stream.c -- incremental playback of long sounds and music
+
+#include "quakedef.h"
+
+//
+// Each stream owns a FILE opened on the wav (inside a pak or not) and a ring
+// of stereo output samples at shm->speed.  A single reader thread decodes
+// small chunks into the rings that have room, and the mixer drains them from
+// the audio thread.  Once the main thread has opened the file and started
+// the stream, the reader is the only one that touches the file; the mixer and
+// the main thread only move the state along.  The positions and the state
+// are published with release stores and read with acquire loads, so the
+// samples and fields written before them are seen with them.
+//
+
+#define	MAX_STREAMS			8
+#define	STREAM_FRAMES		16384		// output ring size, power of two
+#define	STREAM_CHUNK		2048		// output frames decoded per pass
+#define	STREAM_READSIZE		4096		// bytes read from the file at a time
+#define	STREAM_PEEKSIZE		4096		// header bytes read to start a stream
+
+enum
+{
+	ss_free,
+	ss_playing,			// the reader keeps the ring full
+	ss_closing			// the reader closes the file and frees the slot
+};
+
+typedef struct
+{
+	volatile int	state;
+	volatile int	finished;		// reader hit the end of a non-looping sound
+	volatile int	writepos;		// output frames, only moved by the reader
+	volatile int	readpos;		// output frames, only moved by the mixer
+
+	FILE	*file;
+	int		dataofs;				// file offset of the first source frame
+	int		rate;
+	int		width;
+	int		channels;
+	int		frames;					// source frames
+	int		loopstart;				// source frames, -1 = play once
+
+// reader state
+	int		srcpos;					// source frame after next[]
+	int		step;					// source frames per output frame, 16.16
+	int		frac;
+	int		cur[2], next[2];
+	byte	*in, *inend;
+	byte	inbuf[STREAM_READSIZE];
+
+	short	ring[STREAM_FRAMES*2];
+} sndstream_t;
+
+static sndstream_t	streams[MAX_STREAMS];
+static void		*stream_thread;
+static void		*stream_wake;
+static volatile qboolean	stream_quit;
+
+static int		music_stream;		// 1 based, 0 = none
+static qboolean	music_paused;
+
+cvar_t	snd_streamsize = {"snd_streamsize", "524288"};	// wavs larger than this are streamed
+
+/*
+===============================================================================
+
+READER
+
+===============================================================================
+*/
+
+/*
+================
+S_StreamRewind
+
+Positions the decoder on a source frame
+================
+*/
+static void S_StreamRewind (sndstream_t *st, int frame)
+{
+	fseek (st->file, st->dataofs + frame * st->width * st->channels, SEEK_SET);
+	st->srcpos = frame;
+	st->in = st->inend = st->inbuf;
+}
+
+/*
+================
+S_StreamFetch
+
+Reads the next source frame as 16 bit stereo, false at the end of the data
+================
+*/
+static qboolean S_StreamFetch (sndstream_t *st, int *out)
+{
+	int		framesize;
+	int		count, len;
+	int		c;
+
+	if (st->srcpos >= st->frames)
+	{
+		if (st->loopstart < 0)
+			return false;
+		S_StreamRewind (st, st->loopstart);
+	}
+
+	framesize = st->width * st->channels;
+	if (st->inend - st->in < framesize)
+	{
+		count = (st->frames - st->srcpos) * framesize;
+		if (count <= 0)
+			return false;
+		if (count > STREAM_READSIZE)
+			count = STREAM_READSIZE;
+		len = fread (st->inbuf, 1, count, st->file);
+		if (len < framesize)
+			return false;		// truncated file
+		st->in = st->inbuf;
+		st->inend = st->inbuf + len - len % framesize;
+	}
+
+	for (c=0 ; c<2 ; c++)
+	{
+		if (st->width == 2)
+			out[c] = LittleShort (((short *)st->in)[c < st->channels ? c : 0]);
+		else
+			out[c] = (int)((unsigned char)st->in[c < st->channels ? c : 0] - 128) << 8;
+	}
+	st->in += framesize;
+	st->srcpos++;
+
+	return true;
+}
+
+/*
+================
+S_StreamDecode
+
+Fills up to count frames of the ring with linear interpolation to the
+output rate
+================
+*/
+static void S_StreamDecode (sndstream_t *st, int count)
+{
+	int		i;
+	int		pos;
+	short	*out;
+	qboolean	finished;
+
+	finished = false;
+	pos = st->writepos;
+	for (i=0 ; i<count ; i++)
+	{
+		while (st->frac >= 0x10000)
+		{
+			st->frac -= 0x10000;
+			st->cur[0] = st->next[0];
+			st->cur[1] = st->next[1];
+			if (!S_StreamFetch (st, st->next))
+			{
+				finished = true;
+				break;
+			}
+		}
+		if (finished)
+			break;
+
+		out = st->ring + (pos & (STREAM_FRAMES-1))*2;
+		out[0] = st->cur[0] + (((st->next[0] - st->cur[0]) * (st->frac >> 1)) >> 15);
+		out[1] = st->cur[1] + (((st->next[1] - st->cur[1]) * (st->frac >> 1)) >> 15);
+		st->frac += st->step;
+		pos++;
+	}
+
+// the mixer must see the last samples once it sees finished
+	Sys_AtomicStore (&st->writepos, pos);
+	if (finished)
+		Sys_AtomicStore (&st->finished, true);
+}
+
+/*
+================
+S_StreamThread
+================
+*/
+static void S_StreamThread (void *arg)
+{
+	int		i;
+	int		room;
+	int		state;
+	sndstream_t	*st;
+
+	while (!stream_quit)
+	{
+		Sys_SemaphoreWait (stream_wake);
+
+		for (i=0, st=streams ; i<MAX_STREAMS ; i++, st++)
+		{
+			state = Sys_AtomicLoad (&st->state);
+			if (state == ss_closing)
+			{
+				fclose (st->file);
+				st->file = NULL;
+				Sys_AtomicStore (&st->state, ss_free);
+				continue;
+			}
+			if (state != ss_playing || st->finished)
+				continue;
+
+			room = STREAM_FRAMES - (st->writepos - Sys_AtomicLoad (&st->readpos));
+			while (room >= STREAM_CHUNK && !st->finished && Sys_AtomicLoad (&st->state) == ss_playing)
+			{
+				S_StreamDecode (st, STREAM_CHUNK);
+				room -= STREAM_CHUNK;
+			}
+		}
+	}
+}
+
+/*
+===============================================================================
+
+INTERFACE
+
+===============================================================================
+*/
+
+/*
+================
+S_InitStreams
+================
+*/
+void S_InitStreams (void)
+{
+	stream_wake = Sys_CreateSemaphore (0);
+	stream_thread = Sys_CreateThread (S_StreamThread, NULL);
+}
+
+/*
+================
+S_ShutdownStreams
+================
+*/
+void S_ShutdownStreams (void)
+{
+	int		i;
+
+	if (!stream_thread)
+		return;
+
+	for (i=0 ; i<MAX_STREAMS ; i++)
+		if (Sys_AtomicLoad (&streams[i].state) == ss_playing)
+			Sys_AtomicStore (&streams[i].state, ss_closing);
+
+	stream_quit = true;
+	Sys_SemaphorePost (stream_wake);
+	Sys_WaitThread (stream_thread);
+	stream_thread = NULL;
+
+// the thread may have quit before getting to everything
+	for (i=0 ; i<MAX_STREAMS ; i++)
+		if (streams[i].file)
+		{
+			fclose (streams[i].file);
+			streams[i].file = NULL;
+			streams[i].state = ss_free;
+		}
+
+	Sys_DestroySemaphore (stream_wake);
+	stream_wake = NULL;
+	music_stream = 0;
+}
+
+/*
+================
+S_StreamTailChunks
+
+Copies the cue and LIST chunks that follow the samples to out, returning the
+bytes copied
+================
+*/
+static int S_StreamTailChunks (FILE *f, int start, int ofs, int filelen, byte *out, int room)
+{
+	byte	chunk[8];
+	int		len, size, used;
+
+	used = 0;
+	while (ofs + 8 <= filelen)
+	{
+		fseek (f, start + ofs, SEEK_SET);
+		if (fread (chunk, 1, 8, f) != 8)
+			break;
+		len = chunk[4] + (chunk[5]<<8) + (chunk[6]<<16) + (chunk[7]<<24);
+		if (len < 0)
+			break;
+		size = 8 + ((len + 1) & ~1);
+
+		if ((!memcmp (chunk, "cue ", 4) || !memcmp (chunk, "LIST", 4))
+			&& size <= room - used)
+		{
+			memcpy (out + used, chunk, 8);
+			used += 8 + fread (out + used + 8, 1, size - 8, f);
+		}
+		ofs += size;
+	}
+
+	return used;
+}
+
+/*
+================
+S_OpenStream
+
+Returns a 1 based stream number, or 0 if the file can't be streamed.  Reads
+the file, so it is called without the audio device locked.
+================
+*/
+int S_OpenStream (char *name, qboolean loop)
+{
+	int		i;
+	int		len, filelen;
+	int		start, datalen, dataend, samples;
+	sndstream_t	*st;
+	FILE	*f;
+	wavinfo_t	info, loopinfo;
+	byte	header[STREAM_PEEKSIZE*2];
+	byte	*p;
+
+	if (!stream_thread || !shm)
+		return 0;
+
+// only the reader frees slots, and only this thread takes them
+	for (i=0, st=streams ; i<MAX_STREAMS ; i++, st++)
+		if (Sys_AtomicLoad (&st->state) == ss_free)
+			break;
+	if (i == MAX_STREAMS)
+	{
+		Con_DPrintf ("S_OpenStream: no free streams for %s\n", name);
+		return 0;
+	}
+
+	filelen = COM_FOpenFile (name, &f);
+	if (!f)
+		return 0;
+
+// the header is small and comes first, so peek at it without loading the rest
+	start = ftell (f);
+	len = filelen;
+	if (len > STREAM_PEEKSIZE)
+		len = STREAM_PEEKSIZE;
+	len = fread (header, 1, len, f);
+	info = GetWavinfo (name, header, len);
+	if (!info.rate || (info.width != 1 && info.width != 2)
+		|| info.channels < 1 || info.channels > 2 || info.dataofs > len)
+	{
+		Con_Printf ("S_OpenStream: %s is not a pcm wav\n", name);
+		fclose (f);
+		return 0;
+	}
+
+// a cue and its loop length can follow the samples, so parse again with
+// those chunks read in where the samples start, ahead of the data chunk
+	p = header + info.dataofs - 8;
+	datalen = p[4] + (p[5]<<8) + (p[6]<<16) + (p[7]<<24);
+	dataend = info.dataofs + ((datalen + 1) & ~1);
+	if (dataend < filelen)
+	{
+		memmove (header + sizeof(header) - 8, p, 8);
+		len = S_StreamTailChunks (f, start, dataend, filelen, p, header + sizeof(header) - 8 - p);
+		if (len)
+		{
+			memmove (p + len, header + sizeof(header) - 8, 8);
+			loopinfo = GetWavinfo (name, header, p + len + 8 - header);
+			info.loopstart = loopinfo.loopstart;
+			info.samples = loopinfo.samples;
+		}
+	}
+
+	st->file = f;
+	st->dataofs = start + info.dataofs;
+	st->rate = info.rate;
+	st->width = info.width;
+	st->channels = info.channels;
+
+// a mark chunk gives the loop end in frames, otherwise samples counts the
+// whole data chunk in single channel samples
+	samples = datalen / info.width;
+	st->frames = samples / info.channels;
+	if (info.samples != samples && info.samples < st->frames)
+		st->frames = info.samples;
+	if (loop)
+	{
+		st->loopstart = info.loopstart >= 0 ? info.loopstart : 0;
+		if (st->loopstart >= st->frames)
+		{
+			Con_DPrintf ("S_OpenStream: %s has a bad loop start\n", name);
+			st->loopstart = 0;
+		}
+	}
+	else
+		st->loopstart = -1;
+	st->step = (int)((double)st->rate * 0x10000 / shm->speed);
+
+	st->finished = false;
+	st->writepos = st->readpos = 0;
+	S_StreamRewind (st, 0);
+	st->cur[0] = st->cur[1] = 0;
+	if (!S_StreamFetch (st, st->next))
+		st->finished = true;
+	st->frac = 0x10000;
+
+	Sys_AtomicStore (&st->state, ss_playing);
+	Sys_SemaphorePost (stream_wake);
+
+	return i+1;
+}
+
+/*
+================
+S_CloseStream
+
+Can be called from the mixer
+================
+*/
+void S_CloseStream (int stream)
+{
+	sndstream_t	*st;
+
+	if (stream < 1 || stream > MAX_STREAMS)
+		return;
+	st = &streams[stream-1];
+	if (Sys_AtomicLoad (&st->state) != ss_playing)
+		return;
+
+	Sys_AtomicStore (&st->state, ss_closing);
+	Sys_SemaphorePost (stream_wake);
+}
+
+/*
+================
+S_StreamLooped
+================
+*/
+qboolean S_StreamLooped (int stream)
+{
+	if (stream < 1 || stream > MAX_STREAMS)
+		return false;
+	return streams[stream-1].loopstart >= 0;
+}
+
+/*
+================
+S_PaintStream
+
+Mixes count frames from a stream into the paint buffer, called by the mixer.
+A zero volume still drains the ring so the sound keeps its place in time.
+Returns false once a finished stream has been drained.
+================
+*/
+qboolean S_PaintStream (int stream, portable_samplepair_t *out, int count, int leftvol, int rightvol)
+{
+	int		i;
+	int		avail;
+	int		pos;
+	int		finished;
+	short	*in;
+	sndstream_t	*st;
+
+	if (stream < 1 || stream > MAX_STREAMS)
+		return false;
+	st = &streams[stream-1];
+	if (Sys_AtomicLoad (&st->state) != ss_playing)
+		return false;
+
+// finished first, so the samples written before it are all counted
+	finished = Sys_AtomicLoad (&st->finished);
+	pos = st->readpos;
+	avail = Sys_AtomicLoad (&st->writepos) - pos;
+	if (avail <= 0 && finished)
+		return false;
+	if (count > avail)
+		count = avail;		// underrun, the reader will catch up
+
+	if (leftvol || rightvol)
+	{
+		for (i=0 ; i<count ; i++, pos++)
+		{
+			in = st->ring + (pos & (STREAM_FRAMES-1))*2;
+			out[i].left += (in[0] * leftvol) >> 8;
+			out[i].right += (in[1] * rightvol) >> 8;
+		}
+	}
+	pos = st->readpos + count;
+	Sys_AtomicStore (&st->readpos, pos);
+
+	if (STREAM_FRAMES - (Sys_AtomicLoad (&st->writepos) - pos) >= STREAM_CHUNK)
+		Sys_SemaphorePost (stream_wake);
+
+	return true;
+}
+
+/*
+===============================================================================
+
+MUSIC
+
+===============================================================================
+*/
+
+/*
+================
+S_StartMusic
+
+Plays a wav from the game directories as background music
+================
+*/
+qboolean S_StartMusic (char *name, qboolean loop)
+{
+	int		stream;
+
+	S_StopMusic ();
+
+	stream = S_OpenStream (name, loop);
+	if (!stream)
+		return false;
+
+	S_LockAudioDevice ();
+	music_stream = stream;
+	music_paused = false;
+	S_UnlockAudioDevice ();
+	return true;
+}
+
+/*
+================
+S_StopMusic
+================
+*/
+void S_StopMusic (void)
+{
+	S_LockAudioDevice ();
+	if (music_stream)
+	{
+		S_CloseStream (music_stream);
+		music_stream = 0;
+	}
+	S_UnlockAudioDevice ();
+}
+
+/*
+================
+S_PauseMusic
+================
+*/
+void S_PauseMusic (qboolean pause)
+{
+	music_paused = pause;
+}
+
+/*
+================
+S_PaintMusic
+
+Called by the mixer after the channels
+================
+*/
+void S_PaintMusic (portable_samplepair_t *out, int count)
+{
+	int		vol;
+
+	if (!music_stream || music_paused)
+		return;
+
+	vol = (int)(bgmvolume.value * 255);
+	if (vol < 0)
+		vol = 0;
+	if (!S_PaintStream (music_stream, out, count, vol, vol))
+	{
+		S_CloseStream (music_stream);
+		music_stream = 0;
+	}
+}
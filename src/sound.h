@@ -36,6 +36,7 @@ typedef struct sfx_s
 {
 	char 	name[MAX_QPATH];
 	cache_user_t	cache;
+	qboolean	stream;		// too big for the cache, played from disk
 } sfx_t;
 
 // !!! if this is changed, it much be changed in asm_i386.h too !!!
@@ -77,6 +78,7 @@ typedef struct
 	vec3_t	origin;			// origin of sound effect
 	vec_t	dist_mult;		// distance multiplier (attenuation/clipK)
 	int		master_vol;		// 0-255 master volume
+	int		stream;			// 1 based stream when sfx->stream is set
 } channel_t;
 
 typedef struct
@@ -107,7 +109,8 @@ void S_EndPrecaching (void);
 void S_PaintChannels(int endtime);
 
 // picks a channel based on priorities, empty slots, number of channels
-channel_t *SND_PickChannel(int entnum, int entchannel);
+// priority is the louder side of the spatialized volume
+channel_t *SND_PickChannel(int entnum, int entchannel, int priority);
 
 // spatializes a channel
 void SND_Spatialize(channel_t *ch);
@@ -121,6 +124,12 @@ int SNDDMA_GetDMAPos(void);
 // shutdown the DMA xfer.
 void SNDDMA_Shutdown(void);
 
+// offline dma for -sndfile / -sndnull, mixed from S_Update by game time
+qboolean SNDDMA_FileInit(void);
+void SNDDMA_FileUpdate(void);
+void SNDDMA_FileShutdown(void);
+void SND_FileInfo(void);
+
 void S_LockAudioDevice();
 void S_UnlockAudioDevice();
 
@@ -128,8 +137,8 @@ void S_UnlockAudioDevice();
 // User-setable variables
 // ====================================================================
 
-#define	MAX_CHANNELS			128
-#define	MAX_DYNAMIC_CHANNELS	8
+#define	MAX_CHANNELS			512
+#define	MAX_DYNAMIC_CHANNELS	128
 
 
 extern	channel_t   channels[MAX_CHANNELS];
@@ -139,6 +148,11 @@ extern	channel_t   channels[MAX_CHANNELS];
 
 extern	int			total_channels;
 
+// voice pool counters, updated by S_Update
+extern	int			snd_activevoices;	// audible this frame
+extern	int			snd_culledvoices;	// playing but below audibility this frame
+extern	int			snd_stolenvoices;	// voices taken from another sound since the level started
+
 //
 // Fake dma is a synchronous faking of the DMA progress used for
 // isolating performance in the renderer.  The fakedma_updates is
@@ -146,6 +160,7 @@ extern	int			total_channels;
 //
 
 extern qboolean 		fakedma;
+extern qboolean		snd_offline;
 extern int 			fakedma_updates;
 extern int		paintedtime;
 extern vec3_t listener_origin;
@@ -157,6 +172,8 @@ extern volatile dma_t sn;
 extern vec_t sound_nominal_clip_dist;
 
 extern	cvar_t loadas8bit;
+extern	cvar_t snd_resample;
+extern	cvar_t snd_diskcache;
 extern	cvar_t bgmvolume;
 extern	cvar_t volume;
 
@@ -166,10 +183,25 @@ extern int		snd_blocked;
 
 void S_LocalSound (char *s);
 sfxcache_t *S_LoadSound (sfx_t *s);
+int SND_ResampledLength (int samples, int inrate);
 
 wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength);
 
+// snd_stream.c
+extern	cvar_t snd_streamsize;
+
+void S_InitStreams (void);
+void S_ShutdownStreams (void);
+int S_OpenStream (char *name, qboolean loop);
+void S_CloseStream (int stream);
+qboolean S_PaintStream (int stream, portable_samplepair_t *out, int count, int leftvol, int rightvol);
+qboolean S_StartMusic (char *name, qboolean loop);
+void S_StopMusic (void);
+void S_PauseMusic (qboolean pause);
+void S_PaintMusic (portable_samplepair_t *out, int count);
+
 void SND_InitScaletable (void);
+void SND_MixBench_f (void);
 void SNDDMA_Submit(void);
 
 void S_AmbientOff (void);
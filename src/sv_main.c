@@ -46,6 +46,8 @@ void SV_Init (void)
 	extern	cvar_t	sv_accelerate;
 	extern	cvar_t	sv_idealpitchscale;
 	extern	cvar_t	sv_aim;
+	extern	cvar_t	sv_tracecache;
+	extern	cvar_t	sv_parallelphysics;
 
 	Cvar_RegisterVariable (&sv_maxvelocity);
 	Cvar_RegisterVariable (&sv_gravity);
@@ -57,6 +59,16 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_idealpitchscale);
 	Cvar_RegisterVariable (&sv_aim);
 	Cvar_RegisterVariable (&sv_nostep);
+	Cvar_RegisterVariable (&sv_tracecache);
+	Cvar_RegisterVariable (&sv_parallelphysics);
+	Cvar_RegisterVariable (&sv_navgrid);
+
+	Cmd_AddCommand ("sv_areastats", SV_AreaStats_f);
+	Cmd_AddCommand ("sv_pushbench", SV_PushBench_f);
+	Cmd_AddCommand ("sv_record", SV_Record_f);
+	Cmd_AddCommand ("sv_stoprecord", SV_StopRecord_f);
+	Cmd_AddCommand ("sv_replay", SV_Replay_f);
+	Cmd_AddCommand ("sv_navinfo", SV_NavInfo_f);
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -309,7 +321,7 @@ void SV_CheckForNewClients (void)
 //
 	while (1)
 	{
-		ret = NET_CheckNewConnections ();
+		ret = SV_NewConnection ();
 		if (!ret)
 			break;
 
@@ -1016,6 +1028,34 @@ void SV_SaveSpawnparms (void)
 }
 
 
+static unsigned	sv_randseed;
+
+/*
+================
+SV_SeedRandom
+================
+*/
+void SV_SeedRandom (unsigned seed)
+{
+	sv_randseed = seed;
+}
+
+/*
+================
+SV_Random
+
+The game's own random numbers, 0 - 0x7fff.  They are kept apart from rand ()
+so the client and the sound code can't change what happens on the server,
+which a replay depends on.
+================
+*/
+int SV_Random (void)
+{
+	sv_randseed = sv_randseed * 214013 + 2531011;
+	return (sv_randseed >> 16) & 0x7fff;
+}
+
+
 /*
 ================
 SV_SpawnServer
@@ -1038,6 +1078,9 @@ void SV_SpawnServer (char *server)
 	Con_DPrintf ("SpawnServer: %s\n",server);
 	svs.changelevel_issued = false;		// now safe to issue another
 
+// a recording only covers one level
+	SV_StopRecord ();
+
 //
 // tell all connected clients that we are going to a new level
 //
@@ -1116,6 +1159,7 @@ void SV_SpawnServer (char *server)
 // clear world interaction links
 //
 	SV_ClearWorld ();
+	SV_BuildNavGrid ();
 	
 	sv.sound_precache[0] = pr_strings;
 
@@ -1147,6 +1191,8 @@ void SV_SpawnServer (char *server)
 
 // serverflags are for cross level information (sigils)
 	pr_global_struct->serverflags = svs.serverflags;
+
+	SV_SeedRandom (SV_SpawnSeed ());
 	
 	ED_LoadFromFile (sv.worldmodel->entities);
 
@@ -1167,6 +1213,8 @@ void SV_SpawnServer (char *server)
 	for (i=0,host_client = svs.clients ; i<svs.maxclients ; i++, host_client++)
 		if (host_client->active)
 			SV_SendServerinfo (host_client);
+
+	SV_RecordSpawn ();
 	
 	Con_DPrintf ("Server spawned.\n");
 }
@@ -155,6 +155,11 @@ qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink)
 		return false;
 	}
 
+// the floor grid knows about most steps into walls and off ledges
+	if (sv_navgrid.value && !((int)ent->v.flags & FL_PARTIALGROUND)
+	&& SV_NavNoFloor (ent, neworg))
+		return false;
+
 // push down from a step height above the wished position
 	neworg[2] += STEPSIZE;
 	VectorCopy (neworg, end);
@@ -318,7 +323,7 @@ void SV_NewChaseDir (edict_t *actor, edict_t *enemy, float dist)
 	}
 
 // try other directions
-	if ( ((rand()&3) & 1) ||  abs(deltay)>abs(deltax))
+	if ( ((SV_Random()&3) & 1) ||  abs(deltay)>abs(deltax))
 	{
 		tdir=d[1];
 		d[1]=d[2];
@@ -338,7 +343,7 @@ void SV_NewChaseDir (edict_t *actor, edict_t *enemy, float dist)
 	if (olddir!=DI_NODIR && SV_StepDirection(actor, olddir, dist))
 			return;
 
-	if (rand()&1) 	/*randomly determine direction of search*/
+	if (SV_Random()&1) 	/*randomly determine direction of search*/
 	{
 		for (tdir=0 ; tdir<=315 ; tdir += 45)
 			if (tdir!=turnaround && SV_StepDirection(actor, tdir, dist) )
@@ -410,7 +415,7 @@ void SV_MoveToGoal (void)
 		return;
 
 // bump around...
-	if ( (rand()&3)==1 ||
+	if ( (SV_Random()&3)==1 ||
 	!SV_StepDirection (ent, ent->v.ideal_yaw, dist))
 	{
 		SV_NewChaseDir (ent, goal, dist);
@@ -0,0 +1,299 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_nav.c -- floor grid for monster steps
+
+#include "quakedef.h"
+
+//
+// With sv_navgrid set when a map starts, every NAV_CELL units across the world
+// the player sized clipping hull is traced from top to bottom and the heights
+// of all the floors it lands on are kept.  SV_movestep asks the grid before
+// tracing a walking step: if none of the four grid points around the new
+// position has a floor within a step of it, and no other solid is near, the
+// step down could only fall through or start in a wall, so it fails without
+// tracing.  Most of the steps SV_NewChaseDir tries against walls and ledges
+// end that way.
+//
+// The grid samples the world, so a floor narrower than a cell that falls
+// between grid points can be missed, which turns the step into a wall.  It is
+// off by default and sv_record keeps its setting.
+//
+
+cvar_t	sv_navgrid = {"sv_navgrid", "0"};
+
+#define	NAV_CELL		16
+#define	NAV_MAXPOINTS	(512*512)
+#define	NAV_FLOORS		6
+#define	NAV_UNKNOWN		255			// more floors than fit, never skip
+#define	NAV_MARGIN		24			// slopes between grid points
+#define	NAV_SOLIDSTEP	8
+#define	NAV_MAXENTS		16
+#define	STEPSIZE		18
+
+static int		nav_width, nav_height;		// grid points
+static vec3_t	nav_mins;
+static byte		*nav_counts;				// floors at each point
+static short	*nav_floors;				// NAV_FLOORS heights per point
+static int		nav_numfloors;
+static double	nav_buildtime;
+
+static int		nav_checks;
+static int		nav_skips;
+
+/*
+================
+SV_NavTrace
+
+A line through world hull 1
+================
+*/
+static void SV_NavTrace (vec3_t start, vec3_t end, trace_t *trace)
+{
+	hull_t	*hull;
+
+	hull = &sv.worldmodel->hulls[1];
+
+	memset (trace, 0, sizeof(trace_t));
+	trace->fraction = 1;
+	trace->allsolid = true;
+	VectorCopy (end, trace->endpos);
+	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start, end, trace);
+}
+
+/*
+================
+SV_NavColumn
+
+Stores the heights of the floors below top, highest first
+================
+*/
+static void SV_NavColumn (int point, float x, float y, float top, float bottom)
+{
+	hull_t	*hull;
+	vec3_t	start, end;
+	trace_t	trace;
+	int		count;
+	short	*floors;
+
+	hull = &sv.worldmodel->hulls[1];
+	floors = nav_floors + point*NAV_FLOORS;
+	count = 0;
+
+	start[0] = end[0] = x;
+	start[1] = end[1] = y;
+	start[2] = top;
+	end[2] = bottom;
+
+	while (start[2] > bottom)
+	{
+	// get out of the solid above the next open space
+		if (SV_HullPointContents (hull, hull->firstclipnode, start) == CONTENTS_SOLID)
+		{
+			SV_NavTrace (start, end, &trace);
+			if (trace.allsolid)
+				break;		// solid all the way down
+			while (start[2] > bottom
+			&& SV_HullPointContents (hull, hull->firstclipnode, start) == CONTENTS_SOLID)
+				start[2] -= NAV_SOLIDSTEP;
+			continue;
+		}
+
+	// fall to the next floor
+		SV_NavTrace (start, end, &trace);
+		if (trace.fraction == 1)
+			break;
+
+		if (count == NAV_FLOORS)
+		{
+			count = NAV_UNKNOWN;
+			break;
+		}
+		floors[count++] = (short)trace.endpos[2];
+		nav_numfloors++;
+
+		start[2] = trace.endpos[2] - 1;
+	}
+
+	nav_counts[point] = count;
+}
+
+/*
+================
+SV_BuildNavGrid
+
+Called by SV_SpawnServer once the world model is in
+================
+*/
+void SV_BuildNavGrid (void)
+{
+	int		x, y;
+	float	top, bottom;
+	double	time;
+
+	nav_counts = NULL;
+	nav_floors = NULL;
+	nav_numfloors = 0;
+	nav_checks = 0;
+	nav_skips = 0;
+
+	if (!sv_navgrid.value)
+		return;
+
+	time = Sys_FloatTime ();
+
+	VectorCopy (sv.worldmodel->mins, nav_mins);
+	nav_width = (int)((sv.worldmodel->maxs[0] - nav_mins[0]) / NAV_CELL) + 2;
+	nav_height = (int)((sv.worldmodel->maxs[1] - nav_mins[1]) / NAV_CELL) + 2;
+	if (nav_width * nav_height > NAV_MAXPOINTS)
+	{
+		Con_Printf ("SV_BuildNavGrid: %s is too big for a grid\n", sv.name);
+		return;
+	}
+
+	nav_counts = Hunk_AllocName (nav_width*nav_height, "navgrid");
+	nav_floors = Hunk_AllocName (nav_width*nav_height*NAV_FLOORS*sizeof(short), "navgrid");
+
+	top = sv.worldmodel->maxs[2] + 32;
+	bottom = sv.worldmodel->mins[2] - 32;
+	for (y=0 ; y<nav_height ; y++)
+		for (x=0 ; x<nav_width ; x++)
+			SV_NavColumn (y*nav_width + x, nav_mins[0] + x*NAV_CELL,
+				nav_mins[1] + y*NAV_CELL, top, bottom);
+
+	nav_buildtime = Sys_FloatTime () - time;
+	Con_DPrintf ("nav grid: %i x %i, %i floors, %.0f ms\n",
+		nav_width, nav_height, nav_numfloors, nav_buildtime*1000);
+}
+
+/*
+================
+SV_NavPointFloor
+
+True if the grid point may have a floor between zlo and zhi
+================
+*/
+static qboolean SV_NavPointFloor (int x, int y, float zlo, float zhi)
+{
+	int		i, count;
+	short	*floors;
+
+	count = nav_counts[y*nav_width + x];
+	if (count == NAV_UNKNOWN)
+		return true;
+
+	floors = nav_floors + (y*nav_width + x)*NAV_FLOORS;
+	for (i=0 ; i<count ; i++)
+		if (floors[i] >= zlo && floors[i] <= zhi)
+			return true;
+	return false;
+}
+
+/*
+================
+SV_NavNoFloor
+
+True when the step down SV_movestep would trace from neworg is sure to fail,
+because no floor is within a step of it and nothing else solid is around
+================
+*/
+qboolean SV_NavNoFloor (edict_t *ent, vec3_t neworg)
+{
+	vec3_t	size, org, mins, maxs;
+	float	fx, fy;
+	int		x, y;
+	edict_t	*list[NAV_MAXENTS];
+	int		i, count;
+
+	if (!nav_counts)
+		return false;
+
+// only boxes that clip with hull 1
+	VectorSubtract (ent->v.maxs, ent->v.mins, size);
+	if (size[0] < 3 || size[0] > 32)
+		return false;
+
+	nav_checks++;
+
+// the hull 1 point the move traces
+	org[0] = neworg[0] + ent->v.mins[0] + 16;
+	org[1] = neworg[1] + ent->v.mins[1] + 16;
+	org[2] = neworg[2] + ent->v.mins[2] + 24;
+
+	fx = (org[0] - nav_mins[0]) / NAV_CELL;
+	fy = (org[1] - nav_mins[1]) / NAV_CELL;
+	if (fx < 0 || fy < 0)
+		return false;
+	x = (int)fx;
+	y = (int)fy;
+	if (x >= nav_width-1 || y >= nav_height-1)
+		return false;
+
+	if (SV_NavPointFloor (x, y, org[2] - STEPSIZE - NAV_MARGIN, org[2] + STEPSIZE + NAV_MARGIN)
+	|| SV_NavPointFloor (x+1, y, org[2] - STEPSIZE - NAV_MARGIN, org[2] + STEPSIZE + NAV_MARGIN)
+	|| SV_NavPointFloor (x, y+1, org[2] - STEPSIZE - NAV_MARGIN, org[2] + STEPSIZE + NAV_MARGIN)
+	|| SV_NavPointFloor (x+1, y+1, org[2] - STEPSIZE - NAV_MARGIN, org[2] + STEPSIZE + NAV_MARGIN))
+		return false;
+
+// bsp models and monsters are floors too
+	VectorAdd (neworg, ent->v.mins, mins);
+	VectorAdd (neworg, ent->v.maxs, maxs);
+	mins[2] -= STEPSIZE + 1;
+	maxs[2] += STEPSIZE + 1;
+	count = SV_AreaEdicts (mins, maxs, list, NAV_MAXENTS);
+	if (count == NAV_MAXENTS)
+		return false;
+	for (i=0 ; i<count ; i++)
+	{
+		if (list[i] == ent)
+			continue;
+		if (list[i]->v.solid != SOLID_NOT && list[i]->v.solid != SOLID_TRIGGER)
+			return false;
+	}
+
+	nav_skips++;
+	return true;
+}
+
+/*
+================
+SV_NavInfo_f
+
+Prints the grid size and how many monster steps it has answered
+================
+*/
+void SV_NavInfo_f (void)
+{
+	if (!sv.active)
+	{
+		Con_Printf ("no server running\n");
+		return;
+	}
+	if (!nav_counts)
+	{
+		Con_Printf ("no nav grid, set sv_navgrid 1 and restart the map\n");
+		return;
+	}
+
+	Con_Printf ("%i x %i points, %i floors, %i k, built in %.0f ms\n",
+		nav_width, nav_height, nav_numfloors,
+		(nav_width*nav_height*(1 + NAV_FLOORS*(int)sizeof(short)) + 1023) / 1024,
+		nav_buildtime*1000);
+	Con_Printf ("%i steps checked, %i failed without tracing\n", nav_checks, nav_skips);
+}
@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // sv_phys.c
 
 #include "quakedef.h"
+#include "job.h"
 
 /*
 
@@ -44,10 +45,12 @@ cvar_t	sv_stopspeed = {"sv_stopspeed","100"};
 cvar_t	sv_gravity = {"sv_gravity","800",false,true};
 cvar_t	sv_maxvelocity = {"sv_maxvelocity","2000"};
 cvar_t	sv_nostep = {"sv_nostep","0"};
+cvar_t	sv_parallelphysics = {"sv_parallelphysics","0"};	// experimental, see SV_RunHeldMoves
 
 #define	MOVE_EPSILON	0.01
 
 void SV_Physics_Toss (edict_t *ent);
+trace_t SV_PushEntity (edict_t *ent, vec3_t push);
 
 /*
 ================
@@ -208,150 +211,65 @@ int ClipVelocity (vec3_t in, vec3_t normal, vec3_t out, float overbounce)
 
 /*
 ============
-SV_FlyMove
+SV_MoveTrace
 
-The basic solid body movement clip that slides along multiple planes
-Returns the clipflags if the velocity was modified (hit something solid)
-1 = floor
-2 = wall / step
-4 = dead stop
-If steptrace is not NULL, the trace of any vertical wall hit will be stored
+The pmove_t callbacks for an edict, SV_Move and the touch functions
 ============
 */
-#define	MAX_CLIP_PLANES	5
-int SV_FlyMove (edict_t *ent, float time, trace_t *steptrace)
+static trace_t SV_MoveTrace (pmove_t *pm, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type)
 {
-	int			bumpcount, numbumps;
-	vec3_t		dir;
-	float		d;
-	int			numplanes;
-	vec3_t		planes[MAX_CLIP_PLANES];
-	vec3_t		primal_velocity, original_velocity, new_velocity;
-	int			i, j;
-	trace_t		trace;
-	vec3_t		end;
-	float		time_left;
-	int			blocked;
-	
-	numbumps = 4;
-	
-	blocked = 0;
-	VectorCopy (ent->v.velocity, original_velocity);
-	VectorCopy (ent->v.velocity, primal_velocity);
-	numplanes = 0;
-	
-	time_left = time;
-
-	for (bumpcount=0 ; bumpcount<numbumps ; bumpcount++)
-	{
-		if (!ent->v.velocity[0] && !ent->v.velocity[1] && !ent->v.velocity[2])
-			break;
-
-		for (i=0 ; i<3 ; i++)
-			end[i] = ent->v.origin[i] + time_left * ent->v.velocity[i];
-
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, false, ent);
-
-		if (trace.allsolid)
-		{	// entity is trapped in another solid
-			VectorCopy (vec3_origin, ent->v.velocity);
-			return 3;
-		}
-
-		if (trace.fraction > 0)
-		{	// actually covered some distance
-			VectorCopy (trace.endpos, ent->v.origin);
-			VectorCopy (ent->v.velocity, original_velocity);
-			numplanes = 0;
-		}
-
-		if (trace.fraction == 1)
-			 break;		// moved the entire distance
+	return SV_Move (start, mins, maxs, end, type, pm->ent);
+}
 
-		if (!trace.ent)
-			Sys_Error ("SV_FlyMove: !trace.ent");
+static trace_t SV_MovePush (pmove_t *pm, vec3_t push)
+{
+	return SV_PushEntity (pm->ent, push);
+}
 
-		if (trace.plane.normal[2] > 0.7)
-		{
-			blocked |= 1;		// floor
-			if (trace.ent->v.solid == SOLID_BSP)
-			{
-				ent->v.flags =	(int)ent->v.flags | FL_ONGROUND;
-				ent->v.groundentity = EDICT_TO_PROG(trace.ent);
-			}
-		}
-		if (!trace.plane.normal[2])
-		{
-			blocked |= 2;		// step
-			if (steptrace)
-				*steptrace = trace;	// save for player extrafriction
-		}
+static void SV_MoveGround (pmove_t *pm, edict_t *ground)
+{
+	pm->ent->v.groundentity = EDICT_TO_PROG(ground);
+}
 
-//
-// run the impact function
-//
-		SV_Impact (ent, trace.ent);
-		if (ent->free)
-			break;		// removed by the impact function
+static qboolean SV_MoveImpact (pmove_t *pm, edict_t *other)
+{
+	SV_Impact (pm->ent, other);
+	return !pm->ent->free;
+}
 
-		
-		time_left -= time_left * trace.fraction;
-		
-	// cliped to another plane
-		if (numplanes >= MAX_CLIP_PLANES)
-		{	// this shouldn't really happen
-			VectorCopy (vec3_origin, ent->v.velocity);
-			return 3;
-		}
+/*
+============
+SV_InitMove
 
-		VectorCopy (trace.plane.normal, planes[numplanes]);
-		numplanes++;
+============
+*/
+void SV_InitMove (pmove_t *pm, edict_t *ent)
+{
+	memset (pm, 0, sizeof(*pm));
+	pm->v = &ent->v;
+	pm->frametime = host_frametime;
+	pm->time = sv.time;
+	pm->ent = ent;
+	pm->trace = SV_MoveTrace;
+	pm->pointcontents = SV_PointContents;
+	pm->push = SV_MovePush;
+	pm->ground = SV_MoveGround;
+	pm->impact = SV_MoveImpact;
+}
 
-//
-// modify original_velocity so it parallels all of the clip planes
-//
-		for (i=0 ; i<numplanes ; i++)
-		{
-			ClipVelocity (original_velocity, planes[i], new_velocity, 1);
-			for (j=0 ; j<numplanes ; j++)
-				if (j != i)
-				{
-					if (DotProduct (new_velocity, planes[j]) < 0)
-						break;	// not ok
-				}
-			if (j == numplanes)
-				break;
-		}
-		
-		if (i != numplanes)
-		{	// go along this plane
-			VectorCopy (new_velocity, ent->v.velocity);
-		}
-		else
-		{	// go along the crease
-			if (numplanes != 2)
-			{
-//				Con_Printf ("clip velocity, numplanes == %i\n",numplanes);
-				VectorCopy (vec3_origin, ent->v.velocity);
-				return 7;
-			}
-			CrossProduct (planes[0], planes[1], dir);
-			d = DotProduct (dir, ent->v.velocity);
-			VectorScale (dir, d, ent->v.velocity);
-		}
+/*
+============
+SV_FlyMove
 
-//
-// if original velocity is against the original velocity, stop dead
-// to avoid tiny occilations in sloping corners
-//
-		if (DotProduct (ent->v.velocity, primal_velocity) <= 0)
-		{
-			VectorCopy (vec3_origin, ent->v.velocity);
-			return blocked;
-		}
-	}
+PM_FlyMove for any edict
+============
+*/
+int SV_FlyMove (edict_t *ent, float time, trace_t *steptrace)
+{
+	pmove_t		pm;
 
-	return blocked;
+	SV_InitMove (&pm, ent);
+	return PM_FlyMove (&pm, time, steptrace);
 }
 
 
@@ -385,6 +303,38 @@ PUSHMOVE
 ===============================================================================
 */
 
+/*
+============
+SV_PushType
+
+The SV_Move type for an entity moved by SV_PushEntity
+============
+*/
+static int SV_PushType (edict_t *ent)
+{
+	if (ent->v.movetype == MOVETYPE_FLYMISSILE)
+		return MOVE_MISSILE;
+	if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
+		return MOVE_NOMONSTERS;		// only clip against bmodels
+	return MOVE_NORMAL;
+}
+
+/*
+============
+SV_FinishPush
+
+Puts the entity at the end of the trace and runs the touches
+============
+*/
+static void SV_FinishPush (edict_t *ent, trace_t *trace)
+{
+	VectorCopy (trace->endpos, ent->v.origin);
+	SV_LinkEdict (ent, true);
+
+	if (trace->ent)
+		SV_Impact (ent, trace->ent);		
+}
+
 /*
 ============
 SV_PushEntity
@@ -399,24 +349,38 @@ trace_t SV_PushEntity (edict_t *ent, vec3_t push)
 		
 	VectorAdd (ent->v.origin, push, end);
 
-	if (ent->v.movetype == MOVETYPE_FLYMISSILE)
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_MISSILE, ent);
-	else if (ent->v.solid == SOLID_TRIGGER || ent->v.solid == SOLID_NOT)
-	// only clip against bmodels
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NOMONSTERS, ent);
-	else
-		trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, MOVE_NORMAL, ent);	
-	
-	VectorCopy (trace.endpos, ent->v.origin);
-	SV_LinkEdict (ent, true);
-
-	if (trace.ent)
-		SV_Impact (ent, trace.ent);		
+	trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, SV_PushType (ent), ent);
+	SV_FinishPush (ent, &trace);
 
 	return trace;
 }					
 
 
+static qboolean	sv_pushscanall;		// the old way, for sv_pushbench
+
+/*
+============
+SV_PushCandidates
+
+Gathers the edicts a pusher sweeping through mins/maxs could move: the ones
+overlapping its final position, and riders, which touch its current box.
+============
+*/
+static int SV_PushCandidates (vec3_t mins, vec3_t maxs, edict_t **list)
+{
+	int			e, count;
+	edict_t		*check;
+
+	if (!sv_pushscanall)
+		return SV_AreaEdicts (mins, maxs, list, MAX_EDICTS);
+
+	count = 0;
+	check = NEXT_EDICT(sv.edicts);
+	for (e=1 ; e<sv.num_edicts ; e++, check = NEXT_EDICT(check))
+		list[count++] = check;
+	return count;
+}
+
 /*
 ============
 SV_PushMove
@@ -428,8 +392,11 @@ void SV_PushMove (edict_t *pusher, float movetime)
 	int			i, e;
 	edict_t		*check, *block;
 	vec3_t		mins, maxs, move;
+	vec3_t		sweptmins, sweptmaxs;
 	vec3_t		entorig, pushorig;
 	int			num_moved;
+	int			num_check;
+	edict_t		*check_edict[MAX_EDICTS];
 	edict_t		*moved_edict[MAX_EDICTS];
 	vec3_t		moved_from[MAX_EDICTS];
 
@@ -444,6 +411,8 @@ void SV_PushMove (edict_t *pusher, float movetime)
 		move[i] = pusher->v.velocity[i] * movetime;
 		mins[i] = pusher->v.absmin[i] + move[i];
 		maxs[i] = pusher->v.absmax[i] + move[i];
+		sweptmins[i] = move[i] < 0 ? mins[i] : pusher->v.absmin[i];
+		sweptmaxs[i] = move[i] > 0 ? maxs[i] : pusher->v.absmax[i];
 	}
 
 	VectorCopy (pusher->v.origin, pushorig);
@@ -457,9 +426,10 @@ void SV_PushMove (edict_t *pusher, float movetime)
 
 // see if any solid entities are inside the final position
 	num_moved = 0;
-	check = NEXT_EDICT(sv.edicts);
-	for (e=1 ; e<sv.num_edicts ; e++, check = NEXT_EDICT(check))
+	num_check = SV_PushCandidates (sweptmins, sweptmaxs, check_edict);
+	for (e=0 ; e<num_check ; e++)
 	{
+		check = check_edict[e];
 		if (check->free)
 			continue;
 		if (check->v.movetype == MOVETYPE_PUSH
@@ -583,6 +553,106 @@ void SV_Physics_Pusher (edict_t *ent)
 
 }
 
+/*
+=============
+SV_RunPushBench
+
+Bobs the pushers up and down, returns the seconds taken
+=============
+*/
+static double SV_RunPushBench (edict_t **pushers, int count, int frames)
+{
+	int		i, f;
+	double	start;
+
+	start = Sys_FloatTime ();
+	for (f=0 ; f<frames ; f++)
+		for (i=0 ; i<count ; i++)
+		{
+			pushers[i]->v.velocity[2] = (f & 1) ? -100 : 100;
+			SV_PushMove (pushers[i], 0.05);
+		}
+	return Sys_FloatTime () - start;
+}
+
+/*
+=============
+SV_PushBench_f
+
+sv_pushbench [pushers] [frames]
+
+Spreads copies of the first brush model over the map and moves them with a
+full edict scan and then with the area tree.  Anything they carry or touch
+is moved too, so use it on a test map.
+=============
+*/
+void SV_PushBench_f (void)
+{
+	int		i, count, frames;
+	int		side, x, y;
+	float	fx, fy;
+	double	scantime, areatime;
+	model_t	*mod;
+	edict_t	*ent;
+	edict_t	*pushers[MAX_EDICTS];
+
+	if (!sv.active)
+	{
+		Con_Printf ("no active server\n");
+		return;
+	}
+	if (sv.worldmodel->numsubmodels < 2 || !sv.models[2])
+	{
+		Con_Printf ("the map has no brush models\n");
+		return;
+	}
+
+	count = Cmd_Argc() > 1 ? Q_atoi (Cmd_Argv(1)) : 100;
+	frames = Cmd_Argc() > 2 ? Q_atoi (Cmd_Argv(2)) : 100;
+	if (count > sv.max_edicts - sv.num_edicts - 32)
+		count = sv.max_edicts - sv.num_edicts - 32;
+	if (count < 1 || frames < 1)
+		return;
+
+// a grid over the world, each copy offset from where the model was built
+	mod = sv.models[2];
+	for (side=1 ; side*side < count ; side++)
+		;
+	for (i=0 ; i<count ; i++)
+	{
+		ent = ED_Alloc ();
+		x = i % side;
+		y = i / side;
+		fx = (x + 0.5) / side;
+		fy = (y + 0.5) / side;
+		ent->v.origin[0] = sv.worldmodel->mins[0] + fx * (sv.worldmodel->maxs[0] - sv.worldmodel->mins[0])
+			- 0.5 * (mod->mins[0] + mod->maxs[0]);
+		ent->v.origin[1] = sv.worldmodel->mins[1] + fy * (sv.worldmodel->maxs[1] - sv.worldmodel->mins[1])
+			- 0.5 * (mod->mins[1] + mod->maxs[1]);
+		ent->v.model = sv.model_precache[2] - pr_strings;
+		ent->v.modelindex = 2;
+		ent->v.solid = SOLID_BSP;
+		ent->v.movetype = MOVETYPE_PUSH;
+		VectorCopy (mod->mins, ent->v.mins);
+		VectorCopy (mod->maxs, ent->v.maxs);
+		VectorSubtract (mod->maxs, mod->mins, ent->v.size);
+		SV_LinkEdict (ent, false);
+		pushers[i] = ent;
+	}
+
+	sv_pushscanall = true;
+	scantime = SV_RunPushBench (pushers, count, frames);
+	sv_pushscanall = false;
+	areatime = SV_RunPushBench (pushers, count, frames);
+
+	for (i=0 ; i<count ; i++)
+		ED_Free (pushers[i]);
+
+	Con_Printf ("%i pushers, %i edicts, %i frames\n", count, sv.num_edicts, frames);
+	Con_Printf ("full scan: %.3f ms per frame\n", scantime * 1000 / frames);
+	Con_Printf ("area tree: %.3f ms per frame\n", areatime * 1000 / frames);
+}
+
 
 /*
 ===============================================================================
@@ -641,233 +711,6 @@ void SV_CheckStuck (edict_t *ent)
 }
 
 
-/*
-=============
-SV_CheckWater
-=============
-*/
-qboolean SV_CheckWater (edict_t *ent)
-{
-	vec3_t	point;
-	int		cont;
-
-	point[0] = ent->v.origin[0];
-	point[1] = ent->v.origin[1];
-	point[2] = ent->v.origin[2] + ent->v.mins[2] + 1;	
-	
-	ent->v.waterlevel = 0;
-	ent->v.watertype = CONTENTS_EMPTY;
-	cont = SV_PointContents (point);
-	if (cont <= CONTENTS_WATER)
-	{
-		ent->v.watertype = cont;
-		ent->v.waterlevel = 1;
-		point[2] = ent->v.origin[2] + (ent->v.mins[2] + ent->v.maxs[2])*0.5;
-		cont = SV_PointContents (point);
-		if (cont <= CONTENTS_WATER)
-		{
-			ent->v.waterlevel = 2;
-			point[2] = ent->v.origin[2] + ent->v.view_ofs[2];
-			cont = SV_PointContents (point);
-			if (cont <= CONTENTS_WATER)
-				ent->v.waterlevel = 3;
-		}
-	}
-	
-	return ent->v.waterlevel > 1;
-}
-
-/*
-============
-SV_WallFriction
-
-============
-*/
-void SV_WallFriction (edict_t *ent, trace_t *trace)
-{
-	vec3_t		forward, right, up;
-	float		d, i;
-	vec3_t		into, side;
-	
-	AngleVectors (ent->v.v_angle, forward, right, up);
-	d = DotProduct (trace->plane.normal, forward);
-	
-	d += 0.5;
-	if (d >= 0)
-		return;
-		
-// cut the tangential velocity
-	i = DotProduct (trace->plane.normal, ent->v.velocity);
-	VectorScale (trace->plane.normal, i, into);
-	VectorSubtract (ent->v.velocity, into, side);
-	
-	ent->v.velocity[0] = side[0] * (1 + d);
-	ent->v.velocity[1] = side[1] * (1 + d);
-}
-
-/*
-=====================
-SV_TryUnstick
-
-Player has come to a dead stop, possibly due to the problem with limited
-float precision at some angle joins in the BSP hull.
-
-Try fixing by pushing one pixel in each direction.
-
-This is a hack, but in the interest of good gameplay...
-======================
-*/
-int SV_TryUnstick (edict_t *ent, vec3_t oldvel)
-{
-	int		i;
-	vec3_t	oldorg;
-	vec3_t	dir;
-	int		clip;
-	trace_t	steptrace;
-	
-	VectorCopy (ent->v.origin, oldorg);
-	VectorCopy (vec3_origin, dir);
-
-	for (i=0 ; i<8 ; i++)
-	{
-// try pushing a little in an axial direction
-		switch (i)
-		{
-			case 0:	dir[0] = 2; dir[1] = 0; break;
-			case 1:	dir[0] = 0; dir[1] = 2; break;
-			case 2:	dir[0] = -2; dir[1] = 0; break;
-			case 3:	dir[0] = 0; dir[1] = -2; break;
-			case 4:	dir[0] = 2; dir[1] = 2; break;
-			case 5:	dir[0] = -2; dir[1] = 2; break;
-			case 6:	dir[0] = 2; dir[1] = -2; break;
-			case 7:	dir[0] = -2; dir[1] = -2; break;
-		}
-		
-		SV_PushEntity (ent, dir);
-
-// retry the original move
-		ent->v.velocity[0] = oldvel[0];
-		ent->v. velocity[1] = oldvel[1];
-		ent->v. velocity[2] = 0;
-		clip = SV_FlyMove (ent, 0.1, &steptrace);
-
-		if ( fabs(oldorg[1] - ent->v.origin[1]) > 4
-		|| fabs(oldorg[0] - ent->v.origin[0]) > 4 )
-		{
-//Con_DPrintf ("unstuck!\n");
-			return clip;
-		}
-			
-// go back to the original pos and try again
-		VectorCopy (oldorg, ent->v.origin);
-	}
-	
-	VectorCopy (vec3_origin, ent->v.velocity);
-	return 7;		// still not moving
-}
-
-/*
-=====================
-SV_WalkMove
-
-Only used by players
-======================
-*/
-#define	STEPSIZE	18
-void SV_WalkMove (edict_t *ent)
-{
-	vec3_t		upmove, downmove;
-	vec3_t		oldorg, oldvel;
-	vec3_t		nosteporg, nostepvel;
-	int			clip;
-	int			oldonground;
-	trace_t		steptrace, downtrace;
-	
-//
-// do a regular slide move unless it looks like you ran into a step
-//
-	oldonground = (int)ent->v.flags & FL_ONGROUND;
-	ent->v.flags = (int)ent->v.flags & ~FL_ONGROUND;
-	
-	VectorCopy (ent->v.origin, oldorg);
-	VectorCopy (ent->v.velocity, oldvel);
-	
-	clip = SV_FlyMove (ent, host_frametime, &steptrace);
-
-	if ( !(clip & 2) )
-		return;		// move didn't block on a step
-
-	if (!oldonground && ent->v.waterlevel == 0)
-		return;		// don't stair up while jumping
-	
-	if (ent->v.movetype != MOVETYPE_WALK)
-		return;		// gibbed by a trigger
-	
-	if (sv_nostep.value)
-		return;
-	
-	if ( (int)sv_player->v.flags & FL_WATERJUMP )
-		return;
-
-	VectorCopy (ent->v.origin, nosteporg);
-	VectorCopy (ent->v.velocity, nostepvel);
-
-//
-// try moving up and forward to go up a step
-//
-	VectorCopy (oldorg, ent->v.origin);	// back to start pos
-
-	VectorCopy (vec3_origin, upmove);
-	VectorCopy (vec3_origin, downmove);
-	upmove[2] = STEPSIZE;
-	downmove[2] = -STEPSIZE + oldvel[2]*host_frametime;
-
-// move up
-	SV_PushEntity (ent, upmove);	// FIXME: don't link?
-
-// move forward
-	ent->v.velocity[0] = oldvel[0];
-	ent->v. velocity[1] = oldvel[1];
-	ent->v. velocity[2] = 0;
-	clip = SV_FlyMove (ent, host_frametime, &steptrace);
-
-// check for stuckness, possibly due to the limited precision of floats
-// in the clipping hulls
-	if (clip)
-	{
-		if ( fabs(oldorg[1] - ent->v.origin[1]) < 0.03125
-		&& fabs(oldorg[0] - ent->v.origin[0]) < 0.03125 )
-		{	// stepping up didn't make any progress
-			clip = SV_TryUnstick (ent, oldvel);
-		}
-	}
-	
-// extra friction based on view angle
-	if ( clip & 2 )
-		SV_WallFriction (ent, &steptrace);
-
-// move down
-	downtrace = SV_PushEntity (ent, downmove);	// FIXME: don't link?
-
-	if (downtrace.plane.normal[2] > 0.7)
-	{
-		if (ent->v.solid == SOLID_BSP)
-		{
-			ent->v.flags =	(int)ent->v.flags | FL_ONGROUND;
-			ent->v.groundentity = EDICT_TO_PROG(downtrace.ent);
-		}
-	}
-	else
-	{
-// if the push down didn't end up on good ground, use the move without
-// the step up.  This happens near wall / slope combinations, and can
-// cause the player to hop up higher on a slope too steep to climb	
-		VectorCopy (nosteporg, ent->v.origin);
-		VectorCopy (nostepvel, ent->v.velocity);
-	}
-}
-
-
 /*
 ================
 SV_Physics_Client
@@ -877,6 +720,8 @@ Player character actions
 */
 void SV_Physics_Client (edict_t	*ent, int num)
 {
+	pmove_t		pm;
+
 	if ( ! svs.clients[num-1].active )
 		return;		// unconnected slot
 
@@ -905,10 +750,11 @@ void SV_Physics_Client (edict_t	*ent, int num)
 	case MOVETYPE_WALK:
 		if (!SV_RunThink (ent))
 			return;
-		if (!SV_CheckWater (ent) && ! ((int)ent->v.flags & FL_WATERJUMP) )
+		SV_InitMove (&pm, ent);
+		if (!PM_CheckWater (&pm) && ! ((int)ent->v.flags & FL_WATERJUMP) )
 			SV_AddGravity (ent);
 		SV_CheckStuck (ent);
-		SV_WalkMove (ent);
+		PM_WalkMove (&pm);
 
 		break;
 		
@@ -1024,23 +870,20 @@ void SV_CheckWaterTransition (edict_t *ent)
 
 /*
 =============
-SV_Physics_Toss
+SV_StartToss
 
-Toss, bounce, and fly movement.  When onground, do nothing.
+Thinks and adds gravity, false if the entity isn't going to move
 =============
 */
-void SV_Physics_Toss (edict_t *ent)
+static qboolean SV_StartToss (edict_t *ent)
 {
-	trace_t	trace;
-	vec3_t	move;
-	float	backoff;
 	// regular thinking
 	if (!SV_RunThink (ent))
-		return;
+		return false;
 
 // if onground, return without moving
 	if ( ((int)ent->v.flags & FL_ONGROUND) )
-		return;
+		return false;
 
 	SV_CheckVelocity (ent);
 
@@ -1052,10 +895,21 @@ void SV_Physics_Toss (edict_t *ent)
 // move angles
 	VectorMA (ent->v.angles, host_frametime, ent->v.avelocity, ent->v.angles);
 
-// move origin
-	VectorScale (ent->v.velocity, host_frametime, move);
-	trace = SV_PushEntity (ent, move);
-	if (trace.fraction == 1)
+	return true;
+}
+
+/*
+=============
+SV_FinishToss
+
+Bounces or lands after the move
+=============
+*/
+static void SV_FinishToss (edict_t *ent, trace_t *trace)
+{
+	float	backoff;
+
+	if (trace->fraction == 1)
 		return;
 	if (ent->free)
 		return;
@@ -1065,15 +919,15 @@ void SV_Physics_Toss (edict_t *ent)
 	else
 		backoff = 1;
 
-	ClipVelocity (ent->v.velocity, trace.plane.normal, ent->v.velocity, backoff);
+	ClipVelocity (ent->v.velocity, trace->plane.normal, ent->v.velocity, backoff);
 
 // stop if on ground
-	if (trace.plane.normal[2] > 0.7)
+	if (trace->plane.normal[2] > 0.7)
 	{		
 		if (ent->v.velocity[2] < 60 || ent->v.movetype != MOVETYPE_BOUNCE)
 		{
 			ent->v.flags = (int)ent->v.flags | FL_ONGROUND;
-			ent->v.groundentity = EDICT_TO_PROG(trace.ent);
+			ent->v.groundentity = EDICT_TO_PROG(trace->ent);
 			VectorCopy (vec3_origin, ent->v.velocity);
 			VectorCopy (vec3_origin, ent->v.avelocity);
 		}
@@ -1083,6 +937,27 @@ void SV_Physics_Toss (edict_t *ent)
 	SV_CheckWaterTransition (ent);
 }
 
+/*
+=============
+SV_Physics_Toss
+
+Toss, bounce, and fly movement.  When onground, do nothing.
+=============
+*/
+void SV_Physics_Toss (edict_t *ent)
+{
+	trace_t	trace;
+	vec3_t	move;
+
+	if (!SV_StartToss (ent))
+		return;
+
+// move origin
+	VectorScale (ent->v.velocity, host_frametime, move);
+	trace = SV_PushEntity (ent, move);
+	SV_FinishToss (ent, &trace);
+}
+
 /*
 ===============================================================================
 
@@ -1134,6 +1009,233 @@ void SV_Physics_Step (edict_t *ent)
 
 //============================================================================
 
+/*
+===============================================================================
+
+PARALLEL TOSS MOVES
+
+===============================================================================
+*/
+
+//
+// With sv_parallelphysics set, toss, bounce and fly entities think in the
+// usual order but hold their moves until every other entity has run.  The
+// traces for the held moves are then made on the worker threads against the
+// world as it stands, and applied in edict order on the main thread, where
+// the touch and impact functions run.  A move whose box overlaps another held
+// move, or whose part of the world was changed by an earlier touch, is traced
+// again when it is applied, so the outcome depends on edict order only and
+// never on thread timing.  It is not the same outcome as the serial loop,
+// which moves each entity straight after its think.
+//
+
+typedef struct
+{
+	edict_t		*ent;			// NULL if it no longer moves
+	int			type;
+	vec3_t		start, end;
+	vec3_t		mins, maxs;		// everything the move can see or touch
+	qboolean	overlap;		// shares space with another held move
+	trace_t		trace;
+} heldmove_t;
+
+static	heldmove_t	sv_heldmoves[MAX_EDICTS];
+static	int			sv_numheldmoves;
+
+/*
+=============
+SV_HeldMoveBounds
+
+A box around the swept move, the entity's absolute box at either end and the
+area SV_Move searches
+=============
+*/
+static void SV_HeldMoveBounds (heldmove_t *hm)
+{
+	int		i;
+	float	lo, hi;
+	edict_t	*ent;
+
+	ent = hm->ent;
+	for (i=0 ; i<3 ; i++)
+	{
+		lo = ent->v.mins[i];
+		hi = ent->v.maxs[i];
+		if (hm->type == MOVE_MISSILE)
+		{
+			if (lo > -15)
+				lo = -15;
+			if (hi < 15)
+				hi = 15;
+		}
+		if (hm->start[i] < hm->end[i])
+		{
+			lo += hm->start[i];
+			hi += hm->end[i];
+		}
+		else
+		{
+			lo += hm->end[i];
+			hi += hm->start[i];
+		}
+	// covers the item pickup margin and the epsilons
+		hm->mins[i] = lo - 16;
+		hm->maxs[i] = hi + 16;
+	}
+}
+
+/*
+=============
+SV_HeldMoveOrder
+
+=============
+*/
+static int SV_HeldMoveOrder (const void *a, const void *b)
+{
+	float	d;
+
+	d = sv_heldmoves[*(int *)a].mins[0] - sv_heldmoves[*(int *)b].mins[0];
+	if (d < 0)
+		return -1;
+	if (d > 0)
+		return 1;
+	return *(int *)a - *(int *)b;
+}
+
+/*
+=============
+SV_MarkOverlaps
+
+Sweeps the held moves along x and flags every pair that shares space
+=============
+*/
+static void SV_MarkOverlaps (void)
+{
+	static int	order[MAX_EDICTS];
+	int			i, j;
+	heldmove_t	*a, *b;
+
+	for (i=0 ; i<sv_numheldmoves ; i++)
+		order[i] = i;
+	qsort (order, sv_numheldmoves, sizeof(order[0]), SV_HeldMoveOrder);
+
+	for (i=0 ; i<sv_numheldmoves ; i++)
+	{
+		a = &sv_heldmoves[order[i]];
+		if (!a->ent)
+			continue;
+		for (j=i+1 ; j<sv_numheldmoves ; j++)
+		{
+			b = &sv_heldmoves[order[j]];
+			if (b->mins[0] > a->maxs[0])
+				break;
+			if (!b->ent)
+				continue;
+			if (a->mins[1] > b->maxs[1] || a->maxs[1] < b->mins[1]
+			|| a->mins[2] > b->maxs[2] || a->maxs[2] < b->mins[2])
+				continue;
+			a->overlap = b->overlap = true;
+		}
+	}
+}
+
+/*
+=============
+SV_TraceHeldMove
+
+Runs on the worker threads
+=============
+*/
+static void SV_TraceHeldMove (int index, void *arg)
+{
+	heldmove_t	*hm;
+
+	hm = &sv_heldmoves[index];
+	if (!hm->ent || hm->overlap)
+		return;
+	hm->trace = SV_Move (hm->start, hm->ent->v.mins, hm->ent->v.maxs, hm->end, hm->type, hm->ent);
+}
+
+/*
+=============
+SV_HoldToss
+
+The first half of SV_Physics_Toss, the move is made by SV_RunHeldMoves
+=============
+*/
+static void SV_HoldToss (edict_t *ent)
+{
+	if (!SV_StartToss (ent))
+		return;
+	sv_heldmoves[sv_numheldmoves++].ent = ent;
+}
+
+/*
+=============
+SV_RunHeldMoves
+
+=============
+*/
+static void SV_RunHeldMoves (void)
+{
+	int			i;
+	heldmove_t	*hm;
+	edict_t		*ent;
+	vec3_t		end;
+	qboolean	retrace;
+
+// later thinks may have moved or removed the entities since they were held
+	for (i=0, hm=sv_heldmoves ; i<sv_numheldmoves ; i++, hm++)
+	{
+		ent = hm->ent;
+		if (ent->free || ((int)ent->v.flags & FL_ONGROUND))
+		{
+			hm->ent = NULL;
+			continue;
+		}
+		hm->type = SV_PushType (ent);
+		hm->overlap = false;
+		VectorCopy (ent->v.origin, hm->start);
+		VectorMA (ent->v.origin, host_frametime, ent->v.velocity, hm->end);
+		SV_HeldMoveBounds (hm);
+	}
+
+	SV_MarkOverlaps ();
+
+	sv_threadedmoves = true;
+	Job_ParallelFor (sv_numheldmoves, 4, SV_TraceHeldMove, NULL);
+	sv_threadedmoves = false;
+
+	SV_BeginChangeLog ();
+
+	for (i=0, hm=sv_heldmoves ; i<sv_numheldmoves ; i++, hm++)
+	{
+		ent = hm->ent;
+		if (!ent || ent->free)
+			continue;
+
+	// an earlier touch may have changed the entity or its surroundings
+		VectorMA (ent->v.origin, host_frametime, ent->v.velocity, end);
+		retrace = hm->overlap
+			|| !VectorCompare (ent->v.origin, hm->start)
+			|| !VectorCompare (end, hm->end)
+			|| SV_PushType (ent) != hm->type
+			|| SV_ChangedInBox (hm->mins, hm->maxs);
+		if (!retrace && hm->trace.ent && hm->trace.ent != sv.edicts)
+			retrace = hm->trace.ent->free || hm->trace.ent->v.solid == SOLID_NOT
+				|| hm->trace.ent->v.solid == SOLID_TRIGGER;
+
+		if (retrace)
+			hm->trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, end, SV_PushType (ent), ent);
+
+		SV_FinishPush (ent, &hm->trace);
+		SV_FinishToss (ent, &hm->trace);
+	}
+
+	SV_EndChangeLog ();
+	sv_numheldmoves = 0;
+}
+
 /*
 ================
 SV_Physics
@@ -1145,6 +1247,9 @@ void SV_Physics (void)
 	int		i;
 	edict_t	*ent;
 
+// moves remembered since the last frame may have seen stale progs fields
+	SV_ClearTraceCache ();
+
 // let the progs know that a new frame has started
 	pr_global_struct->self = EDICT_TO_PROG(sv.edicts);
 	pr_global_struct->other = EDICT_TO_PROG(sv.edicts);
@@ -1181,13 +1286,23 @@ void SV_Physics (void)
 		|| ent->v.movetype == MOVETYPE_BOUNCE
 		|| ent->v.movetype == MOVETYPE_FLY
 		|| ent->v.movetype == MOVETYPE_FLYMISSILE)
-			SV_Physics_Toss (ent);
+		{
+			if (sv_parallelphysics.value)
+				SV_HoldToss (ent);
+			else
+				SV_Physics_Toss (ent);
+		}
 		else
 			Sys_Error ("SV_Physics: bad movetype %i", (int)ent->v.movetype);			
 	}
+
+	if (sv_numheldmoves)
+		SV_RunHeldMoves ();
 	
 	if (pr_global_struct->force_retouch)
 		pr_global_struct->force_retouch--;	
 
+	SV_ClearTraceCache ();
+
 	sv.time += host_frametime;
 }
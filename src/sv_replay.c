@@ -0,0 +1,1124 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_replay.c -- server recordings and bit exact replay
+
+#include "quakedef.h"
+
+//
+// A recording holds everything that reaches the server from outside during
+// one level: the frame times, new connections and the messages read from each
+// client.  After every frame it also stores the edict fields and progs globals
+// that changed, so sv_replay can run the same frames without a client or a
+// renderer and name the first frame, entity and field that comes out
+// different.
+//
+// Values are compared in a form that doesn't depend on where things sit in
+// memory: entity references become edict numbers and strings become a hash
+// of their text, so a build with a different edict_t or hunk layout can be
+// checked against a recording made before the change.  The file is written in
+// the native byte order, like the vcr files.
+//
+
+#define	REPLAY_IDENT	(('R'<<24)+('V'<<16)+('S'<<8)+'Q')
+#define	REPLAY_VERSION	1
+
+#define	REPLAY_FRAME	1		// double frametime, byte in game
+#define	REPLAY_CONNECT	2
+#define	REPLAY_MESSAGE	3		// byte client, int ret, int length, data
+#define	REPLAY_STATE	4		// changed words, then the checksum
+#define	REPLAY_END		5
+
+#define	WORD_RAW		0
+#define	WORD_STRING		1
+#define	WORD_ENTITY		2
+#define	WORD_SKIP		3		// temporaries without a def
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		seed;
+	int		maxclients;
+	int		serverflags;
+	int		crc;
+	int		entityfields;
+	int		numglobals;
+	char	map[MAX_QPATH];
+	int		numcvars;
+} replayheader_t;
+
+typedef struct
+{
+	char	name[32];
+	char	value[64];
+} replaycvar_t;
+
+// the settings that change what the progs and the physics do
+static char	*replay_cvars[] =
+{
+	"skill", "deathmatch", "coop", "teamplay", "fraglimit", "timelimit",
+	"noexit", "samelevel", "registered", "temp1",
+	"sv_gravity", "sv_friction", "edgefriction", "sv_stopspeed",
+	"sv_maxspeed", "sv_accelerate", "sv_maxvelocity", "sv_nostep",
+	"sv_idealpitchscale", "sv_aim", "sv_navgrid", "sv_tracecache",
+	"sv_parallelphysics",
+	NULL
+};
+#define	MAX_REPLAY_CVARS	24
+
+static char		sv_recordname[MAX_OSPATH];	// set by sv_record until a map starts
+static FILE		*sv_recordfile;
+static FILE		*sv_replayfile;
+static qboolean	sv_replaying;
+static qboolean	sv_replaybad;			// read past the end
+static int		sv_frames;
+static unsigned	sv_spawnseed;
+static unsigned	sv_checksum;
+
+static int		sv_nextop = -1;			// replay lookahead
+static int		sv_nextclient;
+
+static replaycvar_t	sv_savedcvars[MAX_REPLAY_CVARS];
+static int		sv_numsavedcvars;
+static double	sv_savedframetime;
+
+// the state as of the last frame, in compared form
+static int		sv_rowsize;				// entityfields plus the free flag
+static byte		*sv_fieldtypes;
+static byte		*sv_globaltypes;
+static int		*sv_rows;
+static int		*sv_globals;
+static int		*sv_canon;				// scratch row
+static int		*sv_changes;			// scratch ofs, value pairs
+
+// replayed clients send into these and nothing reads them
+static qsocket_t	sv_sinks[MAX_SCOREBOARD];
+
+/*
+===============================================================================
+
+FILE ACCESS
+
+===============================================================================
+*/
+
+static void SV_RecWrite (void *data, int len)
+{
+	fwrite (data, 1, len, sv_recordfile);
+}
+
+static void SV_RecWriteLong (int l)
+{
+	fwrite (&l, 4, 1, sv_recordfile);
+}
+
+static void SV_RecWriteByte (int b)
+{
+	byte	c;
+
+	c = b;
+	fwrite (&c, 1, 1, sv_recordfile);
+}
+
+static void SV_ReplayRead (void *data, int len)
+{
+	if (fread (data, 1, len, sv_replayfile) != len)
+	{
+		memset (data, 0, len);
+		sv_replaybad = true;
+	}
+}
+
+static int SV_ReplayReadLong (void)
+{
+	int		l;
+
+	SV_ReplayRead (&l, 4);
+	return l;
+}
+
+static int SV_ReplayReadByte (void)
+{
+	byte	c;
+
+	SV_ReplayRead (&c, 1);
+	return c;
+}
+
+/*
+================
+SV_PeekOp
+
+Returns the next op in the replay without taking it
+================
+*/
+static int SV_PeekOp (void)
+{
+	if (sv_nextop < 0)
+	{
+		sv_nextop = SV_ReplayReadByte ();
+		if (sv_replaybad)
+			sv_nextop = REPLAY_END;
+		else if (sv_nextop == REPLAY_MESSAGE)
+			sv_nextclient = SV_ReplayReadByte ();
+	}
+	return sv_nextop;
+}
+
+/*
+================
+SV_TakeOp
+================
+*/
+static int SV_TakeOp (void)
+{
+	int		op;
+
+	op = SV_PeekOp ();
+	sv_nextop = -1;
+	return op;
+}
+
+/*
+===============================================================================
+
+COMPARED STATE
+
+===============================================================================
+*/
+
+/*
+================
+SV_SetWordTypes
+
+Marks the words covered by a list of defs
+================
+*/
+static void SV_SetWordTypes (byte *types, int count, ddef_t *defs, int numdefs)
+{
+	int		i, j;
+	int		type, ofs;
+	int		mark;
+
+	for (i=0 ; i<numdefs ; i++)
+	{
+		type = defs[i].type & ~DEF_SAVEGLOBAL;
+		ofs = defs[i].ofs;
+		switch (type)
+		{
+		case ev_string:
+			mark = WORD_STRING;
+			break;
+		case ev_entity:
+			mark = WORD_ENTITY;
+			break;
+		case ev_float:
+		case ev_vector:
+		case ev_field:
+		case ev_function:
+			mark = WORD_RAW;
+			break;
+		default:
+			continue;		// pointers are only ever temporaries
+		}
+		for (j=0 ; j<(type == ev_vector ? 3 : 1) ; j++)
+			if (ofs+j >= 0 && ofs+j < count)
+				types[ofs+j] = mark;
+	}
+}
+
+/*
+================
+SV_SetupCompare
+
+Called once the progs are loaded
+================
+*/
+static void SV_SetupCompare (void)
+{
+	int		scratch;
+
+	sv_rowsize = progs->entityfields + 1;
+	scratch = sv_rowsize > progs->numglobals ? sv_rowsize : progs->numglobals;
+
+	sv_fieldtypes = Hunk_AllocName (progs->entityfields, "replay");
+	sv_globaltypes = Hunk_AllocName (progs->numglobals, "replay");
+	sv_rows = Hunk_AllocName (sv.max_edicts * sv_rowsize * 4, "replay");
+	sv_globals = Hunk_AllocName (progs->numglobals * 4, "replay");
+	sv_canon = Hunk_AllocName (scratch * 4, "replay");
+	sv_changes = Hunk_AllocName (scratch * 8, "replay");
+
+// fields without a def are kept as they are, globals without one are
+// temporaries and parameters that can hold raw edict offsets
+	memset (sv_fieldtypes, WORD_RAW, progs->entityfields);
+	memset (sv_globaltypes, WORD_SKIP, progs->numglobals);
+	SV_SetWordTypes (sv_fieldtypes, progs->entityfields, pr_fielddefs, progs->numfielddefs);
+	SV_SetWordTypes (sv_globaltypes, progs->numglobals, pr_globaldefs, progs->numglobaldefs);
+}
+
+/*
+================
+SV_CanonWord
+================
+*/
+static int SV_CanonWord (int type, int value)
+{
+	unsigned	hash;
+	char		*s;
+
+	switch (type)
+	{
+	case WORD_STRING:
+		if (!value)
+			return 0;
+		hash = 2166136261u;
+		for (s = pr_strings + value ; *s ; s++)
+			hash = (hash ^ (byte)*s) * 16777619u;
+		return hash;
+	case WORD_ENTITY:
+		return value / pr_edict_size;
+	case WORD_SKIP:
+		return 0;
+	default:
+		return value;
+	}
+}
+
+/*
+================
+SV_CanonEdict
+
+Fills sv_canon with an edict in compared form
+================
+*/
+static void SV_CanonEdict (int num)
+{
+	int		i;
+	int		*v;
+	edict_t	*ent;
+
+	memset (sv_canon, 0, sv_rowsize * 4);
+	if (num >= sv.num_edicts)
+		return;
+	ent = EDICT_NUM(num);
+	if (ent->free)
+	{
+		sv_canon[progs->entityfields] = 1;
+		return;
+	}
+
+	v = (int *)&ent->v;
+	for (i=0 ; i<progs->entityfields ; i++)
+		sv_canon[i] = SV_CanonWord (sv_fieldtypes[i], v[i]);
+}
+
+/*
+================
+SV_CanonGlobals
+================
+*/
+static void SV_CanonGlobals (void)
+{
+	int		i;
+
+	for (i=0 ; i<progs->numglobals ; i++)
+		sv_canon[i] = SV_CanonWord (sv_globaltypes[i], ((int *)pr_globals)[i]);
+}
+
+/*
+================
+SV_Checksum
+================
+*/
+static unsigned SV_Checksum (unsigned sum, int *words, int count)
+{
+	int		i;
+
+	for (i=0 ; i<count ; i++)
+		sum = (sum ^ (unsigned)words[i]) * 16777619u;
+	return sum;
+}
+
+/*
+================
+SV_WriteChanges
+
+Stores the words of a row that changed since the last frame
+================
+*/
+static void SV_WriteChanges (int num, int *row, int count)
+{
+	int		i;
+	int		changed;
+
+	changed = 0;
+	for (i=0 ; i<count ; i++)
+	{
+		if (row[i] == sv_canon[i])
+			continue;
+		sv_changes[changed*2] = i;
+		sv_changes[changed*2+1] = sv_canon[i];
+		row[i] = sv_canon[i];
+		changed++;
+	}
+	if (!changed)
+		return;
+
+	SV_RecWriteLong (num);
+	SV_RecWriteLong (changed);
+	SV_RecWrite (sv_changes, changed*8);
+}
+
+/*
+================
+SV_WriteState
+================
+*/
+static void SV_WriteState (void)
+{
+	int		i;
+	unsigned	sum;
+
+	SV_RecWriteByte (REPLAY_STATE);
+	SV_RecWriteLong (sv.num_edicts);
+	SV_RecWrite (&sv.time, sizeof(sv.time));
+
+	sum = 2166136261u;
+	for (i=0 ; i<sv.num_edicts ; i++)
+	{
+		SV_CanonEdict (i);
+		SV_WriteChanges (i, sv_rows + i*sv_rowsize, sv_rowsize);
+		sum = SV_Checksum (sum, sv_canon, sv_rowsize);
+	}
+	SV_CanonGlobals ();
+	SV_WriteChanges (-1, sv_globals, progs->numglobals);
+	sum = SV_Checksum (sum, sv_canon, progs->numglobals);
+
+	SV_RecWriteLong (-2);
+	SV_RecWriteLong (sum);
+	sv_checksum = sum;
+}
+
+/*
+===============================================================================
+
+RECORDING
+
+===============================================================================
+*/
+
+/*
+================
+SV_SpawnSeed
+
+Picks the seed for the game's random numbers as a server spawns
+================
+*/
+unsigned SV_SpawnSeed (void)
+{
+	if (!sv_replaying)
+		sv_spawnseed = (unsigned)rand () ^ (unsigned)(Sys_FloatTime () * 1000);
+	return sv_spawnseed;
+}
+
+/*
+================
+SV_RecordSpawn
+
+Called at the end of SV_SpawnServer, starts a recording that sv_record set up
+================
+*/
+void SV_RecordSpawn (void)
+{
+	int		i, len;
+	char	name[MAX_OSPATH];
+	cvar_t	*var;
+	replayheader_t	header;
+	replaycvar_t	cv;
+
+	if (!sv_recordname[0] || sv_replaying)
+		return;
+
+	len = snprintf (name, sizeof(name), "%s/%s", com_gamedir, sv_recordname);
+	sv_recordname[0] = 0;
+	if (len < 0 || len >= (int)sizeof(name))
+	{
+		Con_Printf ("ERROR: recording name too long\n");
+		return;
+	}
+	sv_recordfile = fopen (name, "wb");
+	if (!sv_recordfile)
+	{
+		Con_Printf ("ERROR: couldn't open %s\n", name);
+		return;
+	}
+
+	memset (&header, 0, sizeof(header));
+	header.ident = REPLAY_IDENT;
+	header.version = REPLAY_VERSION;
+	header.seed = sv_spawnseed;
+	header.maxclients = svs.maxclients;
+	header.serverflags = svs.serverflags;
+	header.crc = pr_crc;
+	header.entityfields = progs->entityfields;
+	header.numglobals = progs->numglobals;
+	Q_strncpy (header.map, sv.name, sizeof(header.map)-1);
+	for (i=0 ; replay_cvars[i] ; i++)
+		if (Cvar_FindVar (replay_cvars[i]))
+			header.numcvars++;
+	SV_RecWrite (&header, sizeof(header));
+
+	for (i=0 ; replay_cvars[i] ; i++)
+	{
+		var = Cvar_FindVar (replay_cvars[i]);
+		if (!var)
+			continue;
+		memset (&cv, 0, sizeof(cv));
+		Q_strncpy (cv.name, var->name, sizeof(cv.name)-1);
+		Q_strncpy (cv.value, var->string, sizeof(cv.value)-1);
+		SV_RecWrite (&cv, sizeof(cv));
+	}
+
+	SV_SetupCompare ();
+	SV_WriteState ();
+	sv_frames = 0;
+
+	Con_Printf ("recording server to %s\n", name);
+}
+
+/*
+================
+SV_StopRecord
+================
+*/
+void SV_StopRecord (void)
+{
+	if (!sv_recordfile)
+		return;
+
+	SV_RecWriteByte (REPLAY_END);
+	fclose (sv_recordfile);
+	sv_recordfile = NULL;
+	Con_Printf ("server recording stopped: %i frames, checksum %08x\n", sv_frames, sv_checksum);
+}
+
+/*
+================
+SV_RecordFrame
+
+Called as Host_ServerFrame starts
+================
+*/
+void SV_RecordFrame (void)
+{
+	if (!sv_recordfile)
+		return;
+
+	SV_RecWriteByte (REPLAY_FRAME);
+	SV_RecWrite (&host_frametime, sizeof(host_frametime));
+	SV_RecWriteByte (key_dest == key_game);
+}
+
+/*
+================
+SV_RecordState
+
+Called as Host_ServerFrame ends
+================
+*/
+void SV_RecordState (void)
+{
+	if (!sv_recordfile)
+		return;
+
+	SV_WriteState ();
+	sv_frames++;
+}
+
+/*
+================
+SV_NewConnection
+
+NET_CheckNewConnections for the server, recorded or replayed
+================
+*/
+struct qsocket_s *SV_NewConnection (void)
+{
+	int			i;
+	qsocket_t	*sock;
+
+	if (!sv_replaying)
+	{
+		sock = NET_CheckNewConnections ();
+		if (sock && sv_recordfile)
+			SV_RecWriteByte (REPLAY_CONNECT);
+		return sock;
+	}
+
+	if (SV_PeekOp () != REPLAY_CONNECT)
+		return NULL;
+	SV_TakeOp ();
+
+	for (i=0 ; i<MAX_SCOREBOARD ; i++)
+		if (!sv_sinks[i].driverdata)
+			break;
+	sock = NET_NewQSocket ();
+	if (!sock || i == MAX_SCOREBOARD)
+		Host_Error ("SV_NewConnection: no free sockets for the replay");
+
+// loopback sends into the sink, which is emptied after every frame
+	sock->driver = 0;
+	sock->driverdata = &sv_sinks[i];
+	sv_sinks[i].driverdata = sock;
+	sv_sinks[i].receiveMessageLength = 0;
+	strcpy (sock->address, "replay");
+
+	return sock;
+}
+
+/*
+================
+SV_GetClientMessage
+
+NET_GetMessage for host_client, recorded or replayed
+================
+*/
+int SV_GetClientMessage (void)
+{
+	int		ret;
+	int		len;
+
+	if (!sv_replaying)
+	{
+		ret = NET_GetMessage (host_client->netconnection);
+		if (ret && sv_recordfile)
+		{
+			SV_RecWriteByte (REPLAY_MESSAGE);
+			SV_RecWriteByte (host_client - svs.clients);
+			SV_RecWriteLong (ret);
+			if (ret > 0)
+			{
+				SV_RecWriteLong (net_message.cursize);
+				SV_RecWrite (net_message.data, net_message.cursize);
+			}
+		}
+		return ret;
+	}
+
+	if (SV_PeekOp () != REPLAY_MESSAGE || sv_nextclient != host_client - svs.clients)
+		return 0;
+	SV_TakeOp ();
+
+	ret = SV_ReplayReadLong ();
+	if (ret > 0)
+	{
+		len = SV_ReplayReadLong ();
+		if (len < 0 || len > net_message.maxsize)
+			Host_Error ("SV_GetClientMessage: bad message in the replay");
+		SZ_Clear (&net_message);
+		SV_ReplayRead (SZ_GetSpace (&net_message, len), len);
+	}
+	return ret;
+}
+
+/*
+================
+SV_Record_f
+
+sv_record <name> [map]
+================
+*/
+void SV_Record_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2 && Cmd_Argc() != 3)
+	{
+		Con_Printf ("sv_record <name> [map] : record the server from the start of a map\n");
+		return;
+	}
+
+	SV_StopRecord ();
+
+	Q_strncpy (sv_recordname, Cmd_Argv(1), sizeof(sv_recordname)-5);
+	sv_recordname[sizeof(sv_recordname)-5] = 0;
+	COM_DefaultExtension (sv_recordname, ".svr");
+
+	if (Cmd_Argc() == 3)
+		Cbuf_InsertText (va("map %s\n", Cmd_Argv(2)));
+	else
+		Con_Printf ("the next map will be recorded to %s\n", sv_recordname);
+}
+
+/*
+================
+SV_StopRecord_f
+================
+*/
+void SV_StopRecord_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+
+	if (!sv_recordfile)
+	{
+		if (sv_recordname[0])
+			Con_Printf ("sv_record cancelled\n");
+		else
+			Con_Printf ("Not recording the server.\n");
+		sv_recordname[0] = 0;
+		return;
+	}
+	SV_StopRecord ();
+}
+
+/*
+===============================================================================
+
+REPLAY
+
+===============================================================================
+*/
+
+/*
+================
+SV_ReplayFieldDef
+
+Finds the def naming a word, preferring the components of vectors
+================
+*/
+static ddef_t *SV_ReplayFieldDef (ddef_t *defs, int numdefs, int ofs)
+{
+	int		i;
+	int		type;
+	ddef_t	*vec;
+
+	vec = NULL;
+	for (i=0 ; i<numdefs ; i++)
+	{
+		type = defs[i].type & ~DEF_SAVEGLOBAL;
+		if (type == ev_vector)
+		{
+			if (ofs >= defs[i].ofs && ofs < defs[i].ofs + 3 && !vec)
+				vec = &defs[i];
+			continue;
+		}
+		if (defs[i].ofs == ofs && type != ev_void)
+			return &defs[i];
+	}
+	return vec;
+}
+
+/*
+================
+SV_ReplayValue
+
+Prints a compared word, with the text of strings that are still around
+================
+*/
+static char *SV_ReplayValue (ddef_t *def, int value, int raw, qboolean live)
+{
+	static char	buf[2][128];
+	static int	which;
+	char	*s;
+	int		type;
+	eval_t	val;
+
+	which ^= 1;
+	s = buf[which];
+
+	type = def ? def->type & ~DEF_SAVEGLOBAL : ev_float;
+	val._int = value;
+	switch (type)
+	{
+	case ev_string:
+		if (live && raw)
+			sprintf (s, "\"%.100s\"", pr_strings + raw);
+		else
+			sprintf (s, "string %08x", value);
+		break;
+	case ev_entity:
+		sprintf (s, "entity %i", value);
+		break;
+	case ev_function:
+		if (value > 0 && value < progs->numfunctions)
+			sprintf (s, "%.100s()", pr_strings + pr_functions[value].s_name);
+		else
+			sprintf (s, "function %i", value);
+		break;
+	case ev_field:
+		sprintf (s, "field %i", value);
+		break;
+	default:
+		sprintf (s, "%.9g (%08x)", val._float, value);
+		break;
+	}
+	return s;
+}
+
+/*
+================
+SV_ReplayReport
+
+Names the first word of a row that doesn't match the recording
+================
+*/
+static void SV_ReplayReport (int num, int *row, int count)
+{
+	int		i;
+	int		raw;
+	ddef_t	*def;
+	char	*name;
+	char	*what;
+	edict_t	*ent;
+
+	for (i=0 ; i<count ; i++)
+		if (row[i] != sv_canon[i])
+			break;
+
+	if (num < 0)
+	{
+		def = SV_ReplayFieldDef (pr_globaldefs, progs->numglobaldefs, i);
+		raw = ((int *)pr_globals)[i];
+		name = def ? pr_strings + def->s_name : "?";
+		Con_Printf ("frame %i: global %s (%i): recorded %s, replayed %s\n", sv_frames, name, i,
+			SV_ReplayValue (def, row[i], 0, false), SV_ReplayValue (def, sv_canon[i], raw, true));
+		return;
+	}
+
+	ent = num < sv.num_edicts ? EDICT_NUM(num) : NULL;
+	what = ent && !ent->free && ent->v.classname ? pr_strings + ent->v.classname : "";
+	if (i == progs->entityfields)
+	{
+		Con_Printf ("frame %i: edict %i (%s): recorded %s, replayed %s\n", sv_frames, num, what,
+			row[i] ? "free" : "in use", sv_canon[i] ? "free" : "in use");
+		return;
+	}
+
+	def = SV_ReplayFieldDef (pr_fielddefs, progs->numfielddefs, i);
+	raw = ((int *)&ent->v)[i];
+	name = def ? pr_strings + def->s_name : "?";
+	Con_Printf ("frame %i: edict %i (%s) field %s (%i): recorded %s, replayed %s\n", sv_frames, num, what, name, i,
+		SV_ReplayValue (def, row[i], 0, false), SV_ReplayValue (def, sv_canon[i], raw, true));
+}
+
+/*
+================
+SV_ReplayCheck
+
+Reads the state recorded after a frame and compares the server against it.
+Returns false at the first difference.
+================
+*/
+static qboolean SV_ReplayCheck (void)
+{
+	int		i;
+	int		num, count;
+	int		numedicts;
+	int		first, differ;
+	int		*row;
+	double	time;
+	unsigned	sum, recorded;
+
+	if (SV_TakeOp () != REPLAY_STATE)
+	{
+		Con_Printf ("frame %i: the server didn't read everything the clients sent\n", sv_frames);
+		return false;
+	}
+
+	numedicts = SV_ReplayReadLong ();
+	SV_ReplayRead (&time, sizeof(time));
+	while (1)
+	{
+		num = SV_ReplayReadLong ();
+		if (num == -2 || sv_replaybad)
+			break;
+		count = SV_ReplayReadLong ();
+		if (num < -1 || num >= sv.max_edicts)
+			Host_Error ("SV_ReplayCheck: bad edict in the replay");
+		row = num < 0 ? sv_globals : sv_rows + num*sv_rowsize;
+		for (i=0 ; i<count ; i++)
+		{
+			SV_ReplayRead (sv_changes, 8);
+			if (sv_changes[0] < 0 || sv_changes[0] >= (num < 0 ? progs->numglobals : sv_rowsize))
+				Host_Error ("SV_ReplayCheck: bad field in the replay");
+			row[sv_changes[0]] = sv_changes[1];
+		}
+	}
+	recorded = SV_ReplayReadLong ();
+	if (sv_replaybad)
+	{
+		Con_Printf ("frame %i: the recording is cut short\n", sv_frames);
+		return false;
+	}
+
+	if (numedicts != sv.num_edicts)
+	{
+		Con_Printf ("frame %i: recorded %i edicts, replayed %i\n", sv_frames, numedicts, sv.num_edicts);
+		return false;
+	}
+	if (time != sv.time)
+	{
+		Con_Printf ("frame %i: recorded time %.9g, replayed %.9g\n", sv_frames, time, sv.time);
+		return false;
+	}
+
+	sum = 2166136261u;
+	first = -1;
+	differ = 0;
+	for (i=0 ; i<sv.num_edicts ; i++)
+	{
+		SV_CanonEdict (i);
+		row = sv_rows + i*sv_rowsize;
+		if (memcmp (row, sv_canon, sv_rowsize * 4))
+		{
+			if (first < 0)
+			{
+				SV_ReplayReport (i, row, sv_rowsize);
+				first = i;
+			}
+			differ++;
+		}
+		sum = SV_Checksum (sum, sv_canon, sv_rowsize);
+	}
+	if (first >= 0)
+	{
+		if (differ > 1)
+			Con_Printf ("%i edicts differ\n", differ);
+		return false;
+	}
+
+	SV_CanonGlobals ();
+	if (memcmp (sv_globals, sv_canon, progs->numglobals * 4))
+	{
+		SV_ReplayReport (-1, sv_globals, progs->numglobals);
+		return false;
+	}
+	sum = SV_Checksum (sum, sv_canon, progs->numglobals);
+
+	if (sum != recorded)
+	{
+		Con_Printf ("frame %i: checksum %08x doesn't match the recorded %08x\n", sv_frames, sum, recorded);
+		return false;
+	}
+	sv_checksum = sum;
+	return true;
+}
+
+/*
+================
+SV_ReplayDrain
+
+Throws away what the server sent to the replayed clients
+================
+*/
+static void SV_ReplayDrain (void)
+{
+	int		i;
+
+	for (i=0 ; i<MAX_SCOREBOARD ; i++)
+	{
+		if (!sv_sinks[i].driverdata)
+			continue;
+		sv_sinks[i].receiveMessageLength = 0;
+		((qsocket_t *)sv_sinks[i].driverdata)->canSend = true;
+	}
+}
+
+/*
+================
+SV_StopReplay
+
+Called from Host_ShutdownServer, so an error in the middle of a replay
+cleans up as well
+================
+*/
+void SV_StopReplay (void)
+{
+	int		i;
+
+	if (!sv_replayfile)
+		return;
+
+	SV_ReplayDrain ();
+	fclose (sv_replayfile);
+	sv_replayfile = NULL;
+	sv_replaying = false;
+
+	for (i=0 ; i<sv_numsavedcvars ; i++)
+		Cvar_Set (sv_savedcvars[i].name, sv_savedcvars[i].value);
+	sv_numsavedcvars = 0;
+	host_frametime = sv_savedframetime;
+}
+
+/*
+================
+SV_Replay_f
+
+sv_replay <name>
+
+Runs the server frames of a recording as fast as possible and reports the
+first place the result differs
+================
+*/
+void SV_Replay_f (void)
+{
+	int		i, len;
+	int		ingame;
+	char	name[MAX_OSPATH];
+	FILE	*f;
+	cvar_t	*var;
+	keydest_t	savedkey;
+	qboolean	ok;
+	double	start, frametime;
+	double	servertime;
+	replayheader_t	header;
+	replaycvar_t	cv;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("sv_replay <name> : run a server recording and compare the results\n");
+		return;
+	}
+
+// leave room for the extension
+	len = snprintf (name, sizeof(name)-4, "%s/%s", com_gamedir, Cmd_Argv(1));
+	if (len < 0 || len >= (int)sizeof(name)-4)
+	{
+		Con_Printf ("ERROR: recording name too long\n");
+		return;
+	}
+	COM_DefaultExtension (name, ".svr");
+	f = fopen (name, "rb");
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't open %s\n", name);
+		return;
+	}
+
+	if (fread (&header, 1, sizeof(header), f) != sizeof(header)
+		|| header.ident != REPLAY_IDENT || header.version != REPLAY_VERSION
+		|| header.numcvars < 0 || header.numcvars > MAX_REPLAY_CVARS)
+	{
+		Con_Printf ("%s is not a server recording\n", name);
+		fclose (f);
+		return;
+	}
+	if (header.maxclients < 1 || header.maxclients > svs.maxclientslimit)
+	{
+		Con_Printf ("%s needs %i clients\n", name, header.maxclients);
+		fclose (f);
+		return;
+	}
+
+	CL_Disconnect ();
+	Host_ShutdownServer (false);
+
+	sv_replayfile = f;
+	sv_replaybad = false;
+	sv_replaying = true;
+	sv_nextop = -1;
+	sv_savedframetime = host_frametime;
+	memset (sv_sinks, 0, sizeof(sv_sinks));
+
+	sv_numsavedcvars = 0;
+	for (i=0 ; i<header.numcvars ; i++)
+	{
+		SV_ReplayRead (&cv, sizeof(cv));
+		cv.name[sizeof(cv.name)-1] = 0;
+		cv.value[sizeof(cv.value)-1] = 0;
+		var = Cvar_FindVar (cv.name);
+		if (!var)
+			continue;
+		strcpy (sv_savedcvars[sv_numsavedcvars].name, var->name);
+		Q_strncpy (sv_savedcvars[sv_numsavedcvars].value, var->string, sizeof(cv.value)-1);
+		sv_savedcvars[sv_numsavedcvars].value[sizeof(cv.value)-1] = 0;
+		sv_numsavedcvars++;
+		Cvar_Set (cv.name, cv.value);
+	}
+
+	svs.maxclients = header.maxclients;
+	svs.serverflags = header.serverflags;
+	sv_spawnseed = header.seed;
+	header.map[sizeof(header.map)-1] = 0;
+
+	SV_SpawnServer (header.map);
+	if (!sv.active)
+	{
+		SV_StopReplay ();
+		return;
+	}
+	if (pr_crc != header.crc || progs->entityfields != header.entityfields
+		|| progs->numglobals != header.numglobals)
+	{
+		Con_Printf ("%s was recorded with different progs\n", name);
+		Host_ShutdownServer (false);
+		return;
+	}
+
+	Con_Printf ("replaying %s on %s\n", name, header.map);
+
+	SV_SetupCompare ();
+	sv_frames = 0;
+	ok = SV_ReplayCheck ();
+
+	start = Sys_FloatTime ();
+	servertime = 0;
+	savedkey = key_dest;
+	while (ok)
+	{
+		i = SV_TakeOp ();
+		if (i == REPLAY_END)
+			break;
+		if (i != REPLAY_FRAME)
+		{
+			Con_Printf ("frame %i: the clients sent more than the server read\n", sv_frames);
+			ok = false;
+			break;
+		}
+
+		SV_ReplayRead (&frametime, sizeof(frametime));
+		ingame = SV_ReplayReadByte ();
+		host_frametime = frametime;
+		key_dest = ingame ? key_game : key_console;
+
+		frametime = Sys_FloatTime ();
+		Host_ServerFrame ();
+		servertime += Sys_FloatTime () - frametime;
+
+		key_dest = savedkey;
+		SV_ReplayDrain ();
+		sv_frames++;
+
+		ok = SV_ReplayCheck ();
+	}
+	key_dest = savedkey;
+
+	if (ok)
+		Con_Printf ("%i frames match, checksum %08x\n", sv_frames, sv_checksum);
+	Con_Printf ("%.2f seconds, %.3f ms of server time per frame\n", Sys_FloatTime () - start,
+		sv_frames ? servertime * 1000 / sv_frames : 0);
+
+	Host_ShutdownServer (false);
+}
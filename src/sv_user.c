@@ -23,23 +23,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 edict_t	*sv_player;
 
-extern	cvar_t	sv_friction;
 cvar_t	sv_edgefriction = {"edgefriction", "2"};
-extern	cvar_t	sv_stopspeed;
-
-static	vec3_t		forward, right, up;
-
-vec3_t	wishdir;
-float	wishspeed;
+cvar_t	sv_maxspeed = {"sv_maxspeed", "320", false, true};
+cvar_t	sv_accelerate = {"sv_accelerate", "10"};
 
 // world
 float	*angles;
-float	*origin;
-float	*velocity;
-
-qboolean	onground;
-
-usercmd_t	cmd;
 
 cvar_t	sv_idealpitchscale = {"sv_idealpitchscale","0.8"};
 
@@ -113,119 +102,6 @@ void SV_SetIdealPitch (void)
 }
 
 
-/*
-==================
-SV_UserFriction
-
-==================
-*/
-void SV_UserFriction (void)
-{
-	float	*vel;
-	float	speed, newspeed, control;
-	vec3_t	start, stop;
-	float	friction;
-	trace_t	trace;
-	
-	vel = velocity;
-	
-	speed = sqrt(vel[0]*vel[0] +vel[1]*vel[1]);
-	if (!speed)
-		return;
-
-// if the leading edge is over a dropoff, increase friction
-	start[0] = stop[0] = origin[0] + vel[0]/speed*16;
-	start[1] = stop[1] = origin[1] + vel[1]/speed*16;
-	start[2] = origin[2] + sv_player->v.mins[2];
-	stop[2] = start[2] - 34;
-
-	trace = SV_Move (start, vec3_origin, vec3_origin, stop, true, sv_player);
-
-	if (trace.fraction == 1.0)
-		friction = sv_friction.value*sv_edgefriction.value;
-	else
-		friction = sv_friction.value;
-
-// apply friction	
-	control = speed < sv_stopspeed.value ? sv_stopspeed.value : speed;
-	newspeed = speed - host_frametime*control*friction;
-	
-	if (newspeed < 0)
-		newspeed = 0;
-	newspeed /= speed;
-
-	vel[0] = vel[0] * newspeed;
-	vel[1] = vel[1] * newspeed;
-	vel[2] = vel[2] * newspeed;
-}
-
-/*
-==============
-SV_Accelerate
-==============
-*/
-cvar_t	sv_maxspeed = {"sv_maxspeed", "320", false, true};
-cvar_t	sv_accelerate = {"sv_accelerate", "10"};
-#if 0
-void SV_Accelerate (vec3_t wishvel)
-{
-	int			i;
-	float		addspeed, accelspeed;
-	vec3_t		pushvec;
-
-	if (wishspeed == 0)
-		return;
-
-	VectorSubtract (wishvel, velocity, pushvec);
-	addspeed = VectorNormalize (pushvec);
-
-	accelspeed = sv_accelerate.value*host_frametime*addspeed;
-	if (accelspeed > addspeed)
-		accelspeed = addspeed;
-	
-	for (i=0 ; i<3 ; i++)
-		velocity[i] += accelspeed*pushvec[i];	
-}
-#endif
-void SV_Accelerate (void)
-{
-	int			i;
-	float		addspeed, accelspeed, currentspeed;
-
-	currentspeed = DotProduct (velocity, wishdir);
-	addspeed = wishspeed - currentspeed;
-	if (addspeed <= 0)
-		return;
-	accelspeed = sv_accelerate.value*host_frametime*wishspeed;
-	if (accelspeed > addspeed)
-		accelspeed = addspeed;
-	
-	for (i=0 ; i<3 ; i++)
-		velocity[i] += accelspeed*wishdir[i];	
-}
-
-void SV_AirAccelerate (vec3_t wishveloc)
-{
-	int			i;
-	float		addspeed, wishspd, accelspeed, currentspeed;
-		
-	wishspd = VectorNormalize (wishveloc);
-	if (wishspd > 30)
-		wishspd = 30;
-	currentspeed = DotProduct (velocity, wishveloc);
-	addspeed = wishspd - currentspeed;
-	if (addspeed <= 0)
-		return;
-//	accelspeed = sv_accelerate.value * host_frametime;
-	accelspeed = sv_accelerate.value*wishspeed * host_frametime;
-	if (accelspeed > addspeed)
-		accelspeed = addspeed;
-	
-	for (i=0 ; i<3 ; i++)
-		velocity[i] += accelspeed*wishveloc[i];	
-}
-
-
 void DropPunchAngle (void)
 {
 	float	len;
@@ -238,72 +114,6 @@ void DropPunchAngle (void)
 	VectorScale (sv_player->v.punchangle, len, sv_player->v.punchangle);
 }
 
-/*
-===================
-SV_WaterMove
-
-===================
-*/
-void SV_WaterMove (void)
-{
-	int		i;
-	vec3_t	wishvel;
-	float	speed, newspeed, wishspeed, addspeed, accelspeed;
-
-//
-// user intentions
-//
-	AngleVectors (sv_player->v.v_angle, forward, right, up);
-
-	for (i=0 ; i<3 ; i++)
-		wishvel[i] = forward[i]*cmd.forwardmove + right[i]*cmd.sidemove;
-
-	if (!cmd.forwardmove && !cmd.sidemove && !cmd.upmove)
-		wishvel[2] -= 60;		// drift towards bottom
-	else
-		wishvel[2] += cmd.upmove;
-
-	wishspeed = Length(wishvel);
-	if (wishspeed > sv_maxspeed.value)
-	{
-		VectorScale (wishvel, sv_maxspeed.value/wishspeed, wishvel);
-		wishspeed = sv_maxspeed.value;
-	}
-	wishspeed *= 0.7;
-
-//
-// water friction
-//
-	speed = Length (velocity);
-	if (speed)
-	{
-		newspeed = speed - host_frametime * speed * sv_friction.value;
-		if (newspeed < 0)
-			newspeed = 0;	
-		VectorScale (velocity, newspeed/speed, velocity);
-	}
-	else
-		newspeed = 0;
-	
-//
-// water acceleration
-//
-	if (!wishspeed)
-		return;
-
-	addspeed = wishspeed - newspeed;
-	if (addspeed <= 0)
-		return;
-
-	VectorNormalize (wishvel);
-	accelspeed = sv_accelerate.value * wishspeed * host_frametime;
-	if (accelspeed > addspeed)
-		accelspeed = addspeed;
-
-	for (i=0 ; i<3 ; i++)
-		velocity[i] += accelspeed * wishvel[i];
-}
-
 void SV_WaterJump (void)
 {
 	if (sv.time > sv_player->v.teleport_time
@@ -317,58 +127,6 @@ void SV_WaterJump (void)
 }
 
 
-/*
-===================
-SV_AirMove
-
-===================
-*/
-void SV_AirMove (void)
-{
-	int			i;
-	vec3_t		wishvel;
-	float		fmove, smove;
-
-	AngleVectors (sv_player->v.angles, forward, right, up);
-
-	fmove = cmd.forwardmove;
-	smove = cmd.sidemove;
-	
-// hack to not let you back into teleporter
-	if (sv.time < sv_player->v.teleport_time && fmove < 0)
-		fmove = 0;
-		
-	for (i=0 ; i<3 ; i++)
-		wishvel[i] = forward[i]*fmove + right[i]*smove;
-
-	if ( (int)sv_player->v.movetype != MOVETYPE_WALK)
-		wishvel[2] = cmd.upmove;
-	else
-		wishvel[2] = 0;
-
-	VectorCopy (wishvel, wishdir);
-	wishspeed = VectorNormalize(wishdir);
-	if (wishspeed > sv_maxspeed.value)
-	{
-		VectorScale (wishvel, sv_maxspeed.value/wishspeed, wishvel);
-		wishspeed = sv_maxspeed.value;
-	}
-	
-	if ( sv_player->v.movetype == MOVETYPE_NOCLIP)
-	{	// noclip
-		VectorCopy (wishvel, velocity);
-	}
-	else if ( onground )
-	{
-		SV_UserFriction ();
-		SV_Accelerate ();
-	}
-	else
-	{	// not on ground, so little effect on velocity
-		SV_AirAccelerate (wishvel);
-	}		
-}
-
 /*
 ===================
 SV_ClientThink
@@ -380,14 +138,10 @@ the angle fields specify an exact angular motion in degrees
 void SV_ClientThink (void)
 {
 	vec3_t		v_angle;
+	pmove_t		pm;
 
 	if (sv_player->v.movetype == MOVETYPE_NONE)
 		return;
-	
-	onground = (int)sv_player->v.flags & FL_ONGROUND;
-
-	origin = sv_player->v.origin;
-	velocity = sv_player->v.velocity;
 
 	DropPunchAngle ();
 	
@@ -400,7 +154,8 @@ void SV_ClientThink (void)
 //
 // angles
 // show 1/3 the pitch angle and all the roll angle
-	cmd = host_client->cmd;
+	SV_InitMove (&pm, sv_player);
+	pm.cmd = host_client->cmd;
 	angles = sv_player->v.angles;
 	
 	VectorAdd (sv_player->v.v_angle, sv_player->v.punchangle, v_angle);
@@ -422,11 +177,11 @@ void SV_ClientThink (void)
 	if ( (sv_player->v.waterlevel >= 2)
 	&& (sv_player->v.movetype != MOVETYPE_NOCLIP) )
 	{
-		SV_WaterMove ();
+		PM_WaterMove (&pm);
 		return;
 	}
 
-	SV_AirMove ();	
+	PM_AirMove (&pm);
 }
 
 
@@ -483,7 +238,7 @@ qboolean SV_ReadClientMessage (void)
 	do
 	{
 nextmsg:
-		ret = NET_GetMessage (host_client->netconnection);
+		ret = SV_GetClientMessage ();
 		if (ret == -1)
 		{
 			Sys_Printf ("SV_ReadClientMessage: NET_GetMessage failed\n");
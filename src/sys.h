@@ -59,3 +59,37 @@ void Sys_Sleep (void);
 
 void Sys_SendKeyEvents (void);
 // Perform Key_Event () callbacks until the input que is empty
+
+//
+// threads
+//
+typedef void (*sys_threadfunc_t) (void *arg);
+
+void *Sys_CreateThread (sys_threadfunc_t func, void *arg);
+void Sys_WaitThread (void *thread);
+// joins and frees the thread
+
+void *Sys_CreateSemaphore (int count);
+void Sys_DestroySemaphore (void *sem);
+void Sys_SemaphoreWait (void *sem);
+void Sys_SemaphorePost (void *sem);
+
+int Sys_AtomicAdd (volatile int *value, int add);
+// returns the new value
+
+int Sys_AtomicLoad (volatile int *value);
+// acquire, so what was written before the matching store is seen after it
+
+void Sys_AtomicStore (volatile int *value, int set);
+// release, so what was written before it is seen by a matching load
+
+int Sys_NumCPUs (void);
+// logical processors, at least 1
+
+// a separate copy of the variable for each thread, for state used by code
+// that runs inside Job_ParallelFor
+#ifdef _MSC_VER
+#define	THREADLOCAL	__declspec(thread)
+#else
+#define	THREADLOCAL	__thread
+#endif
@@ -21,6 +21,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <SDL2/SDL.h>
 #include <chrono>
 #include <cerrno>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#ifdef _WIN32
+#include <direct.h>
+#include <intrin.h>
+#else
+#include <sys/stat.h>
+#endif
 
 extern "C"
 {
@@ -138,6 +148,11 @@ int     Sys_FileTime (char *path)
 
 void Sys_mkdir (char *path)
 {
+#ifdef _WIN32
+	_mkdir (path);
+#else
+	mkdir (path, 0777);
+#endif
 }
 
 
@@ -192,6 +207,104 @@ void Sys_Sleep (void)
 {
 }
 
+/*
+===============================================================================
+
+THREADS
+
+===============================================================================
+*/
+
+struct sys_semaphore_t
+{
+	std::mutex				lock;
+	std::condition_variable	cond;
+	int						count;
+};
+
+void *Sys_CreateThread (sys_threadfunc_t func, void *arg)
+{
+	return new std::thread (func, arg);
+}
+
+void Sys_WaitThread (void *thread)
+{
+	std::thread *t = (std::thread *)thread;
+
+	t->join ();
+	delete t;
+}
+
+void *Sys_CreateSemaphore (int count)
+{
+	sys_semaphore_t *sem = new sys_semaphore_t;
+
+	sem->count = count;
+	return sem;
+}
+
+void Sys_DestroySemaphore (void *sem)
+{
+	delete (sys_semaphore_t *)sem;
+}
+
+void Sys_SemaphoreWait (void *sem)
+{
+	sys_semaphore_t *s = (sys_semaphore_t *)sem;
+	std::unique_lock<std::mutex> lock (s->lock);
+
+	s->cond.wait (lock, [s] { return s->count > 0; });
+	s->count--;
+}
+
+void Sys_SemaphorePost (void *sem)
+{
+	sys_semaphore_t *s = (sys_semaphore_t *)sem;
+	{
+		std::lock_guard<std::mutex> lock (s->lock);
+		s->count++;
+	}
+	s->cond.notify_one ();
+}
+
+int Sys_AtomicAdd (volatile int *value, int add)
+{
+#ifdef _MSC_VER
+	return _InterlockedExchangeAdd ((volatile long *)value, add) + add;
+#else
+	return __sync_add_and_fetch (value, add);
+#endif
+}
+
+int Sys_AtomicLoad (volatile int *value)
+{
+#ifdef _MSC_VER
+	int		v = *value;
+
+	std::atomic_thread_fence (std::memory_order_acquire);
+	return v;
+#else
+	return __atomic_load_n (value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void Sys_AtomicStore (volatile int *value, int set)
+{
+#ifdef _MSC_VER
+	std::atomic_thread_fence (std::memory_order_release);
+	*value = set;
+#else
+	__atomic_store_n (value, set, __ATOMIC_RELEASE);
+#endif
+}
+
+int Sys_NumCPUs (void)
+{
+	unsigned n = std::thread::hardware_concurrency ();
+
+	return n ? n : 1;
+}
+
 static int MapKey( unsigned int sdlkey )
 {
 	switch(sdlkey)
@@ -290,6 +403,20 @@ int main (int argc, char **argv)
 
 	COM_InitArgv (argc, argv);
 
+	// big -particles counts need more than the default heap
+	int j = COM_CheckParm ("-mem");
+	if (j && j < com_argc-1)
+	{
+		// the hunk is sized with an int
+		double mem = Q_atof (com_argv[j+1]) * 1024 * 1024;
+		if (mem < 1 || mem > 0x7fffffff)
+			Sys_Error ("-mem %s: give a size from 1 to 2047 megabytes\n", com_argv[j+1]);
+		parms.memsize = (int)mem;
+		parms.membase = (byte *)malloc (parms.memsize);
+		if (!parms.membase)
+			Sys_Error ("Can't allocate %d bytes\n", parms.memsize);
+	}
+
 	parms.argc = com_argc;
 	parms.argv = com_argv;
 
@@ -36,6 +36,8 @@ typedef struct
 	pixel_t			*buffer;		// invisible buffer
 	pixel_t			*colormap;		// 256 * VID_GRADES size
 	unsigned short	*colormap16;	// 256 * VID_GRADES size
+	unsigned		*colormap32;	// 256 * VID_GRADES size, NULL unless the
+									//  buffer is 32 bit color
 	unsigned		rowbytes;	// may be > width if displayed in a window
 	unsigned		width;		
 	unsigned		height;
@@ -30,6 +30,38 @@ line of sight checks trace->crosscontent, but bullets don't
 */
 
 
+// a node of the area tree, see ENTITY AREA CHECKING
+typedef struct areanode_s
+{
+	int		axis;		// -1 = leaf node
+	float	dist;
+	struct areanode_s	*children[2];
+	link_t	trigger_edicts;
+	link_t	solid_edicts;
+	link_t	passive_edicts;	// SOLID_NOT
+	int		numedicts;	// linked directly into this node, not passive
+	int		depth;
+	vec3_t	mins, maxs;		// region the node is responsible for
+	vec3_t	lmins, lmaxs;	// loose bounds, every edict below fits in these
+	int		tracesequence;	// traces is valid if == sv_tracesequence
+	int		traces;			// first link of the cached moves that visited it
+} areanode_t;
+
+#define	AREA_NODES		1024
+#define	AREA_MAXDEPTH	12
+#define	AREA_SPLIT		8
+
+#define	MOVE_MAXNODES	128		// area nodes a cached move can visit
+
+// bounding boxes are clipped against as six plane hulls, each move has its
+// own so SV_Move can run on several threads
+typedef struct
+{
+	hull_t		hull;
+	mplane_t	planes[6];
+	mclipnode_t	nodes[6];
+} boxhull_t;
+
 typedef struct
 {
 	vec3_t		boxmins, boxmaxs;// enclose the test object along entire move
@@ -39,11 +71,14 @@ typedef struct
 	trace_t		trace;
 	int			type;
 	edict_t		*passedict;
+	boxhull_t	box;			// hull for the monster being tested
+	int			tests;			// edict boxes tested, for sv_areastats
+	int			nodetests;
+	int			numnodes;		// area nodes visited, listed in nodes
+	short		nodes[MOVE_MAXNODES];
 } moveclip_t;
 
 
-int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
-
 /*
 ===============================================================================
 
@@ -53,9 +88,26 @@ HULL BOXES
 */
 
 
-static	hull_t		box_hull;
+static	boxhull_t	box_hull;
+static	boxhull_t	box_template;	// everything but the six distances
 static	dclipnode_t	box_clipnodes[6];
-static	mplane_t	box_planes[6];
+
+// set while SV_Move runs on worker threads, which skips the trace cache and
+// the statistics
+qboolean	sv_threadedmoves;
+
+/*
+===================
+SV_SetupBoxHull
+
+===================
+*/
+static void SV_SetupBoxHull (boxhull_t *box)
+{
+	*box = box_template;
+	box->hull.planes = box->planes;
+	box->hull.nodes = box->nodes;
+}
 
 /*
 ===================
@@ -69,11 +121,12 @@ void SV_InitBoxHull (void)
 {
 	int		i;
 	int		side;
+	boxhull_t	*box;
 
-	box_hull.clipnodes = box_clipnodes;
-	box_hull.planes = box_planes;
-	box_hull.firstclipnode = 0;
-	box_hull.lastclipnode = 5;
+	box = &box_template;
+	box->hull.clipnodes = box_clipnodes;
+	box->hull.firstclipnode = 0;
+	box->hull.lastclipnode = 5;
 
 	for (i=0 ; i<6 ; i++)
 	{
@@ -86,47 +139,73 @@ void SV_InitBoxHull (void)
 			box_clipnodes[i].children[side^1] = i + 1;
 		else
 			box_clipnodes[i].children[side^1] = CONTENTS_SOLID;
-		
-		box_planes[i].type = i>>1;
-		box_planes[i].normal[i>>1] = 1;
+
+		box->planes[i].type = i>>1;
+		VectorCopy (vec3_origin, box->planes[i].normal);
+		box->planes[i].normal[i>>1] = 1;
+
+		box->nodes[i].type = i>>1;
+		VectorCopy (box->planes[i].normal, box->nodes[i].normal);
+		box->nodes[i].children[0] = box_clipnodes[i].children[0];
+		box->nodes[i].children[1] = box_clipnodes[i].children[1];
 	}
-	
+
+	SV_SetupBoxHull (&box_hull);
 }
 
 
 /*
 ===================
-SV_HullForBox
+SV_HullForBoxInto
 
 To keep everything totally uniform, bounding boxes are turned into small
 BSP trees instead of being compared directly.
 ===================
 */
-hull_t	*SV_HullForBox (vec3_t mins, vec3_t maxs)
+static hull_t *SV_HullForBoxInto (boxhull_t *box, vec3_t mins, vec3_t maxs)
 {
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = mins[0];
-	box_planes[2].dist = maxs[1];
-	box_planes[3].dist = mins[1];
-	box_planes[4].dist = maxs[2];
-	box_planes[5].dist = mins[2];
+	box->planes[0].dist = maxs[0];
+	box->planes[1].dist = mins[0];
+	box->planes[2].dist = maxs[1];
+	box->planes[3].dist = mins[1];
+	box->planes[4].dist = maxs[2];
+	box->planes[5].dist = mins[2];
+
+	box->nodes[0].dist = maxs[0];
+	box->nodes[1].dist = mins[0];
+	box->nodes[2].dist = maxs[1];
+	box->nodes[3].dist = mins[1];
+	box->nodes[4].dist = maxs[2];
+	box->nodes[5].dist = mins[2];
+
+	return &box->hull;
+}
 
-	return &box_hull;
+/*
+===================
+SV_HullForBox
+
+===================
+*/
+hull_t	*SV_HullForBox (vec3_t mins, vec3_t maxs)
+{
+	return SV_HullForBoxInto (&box_hull, mins, maxs);
 }
 
 
 
 /*
 ================
-SV_HullForEntity
+SV_EntityHull
 
 Returns a hull that can be used for testing or clipping an object of mins/maxs
 size.
 Offset is filled in to contain the adjustment that must be added to the
 testing object's origin to get a point to use with the returned hull.
+Bounding boxes are built in box.
 ================
 */
-hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
+static hull_t *SV_EntityHull (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset, boxhull_t *box)
 {
 	model_t		*model;
 	vec3_t		size;
@@ -161,7 +240,7 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 
 		VectorSubtract (ent->v.mins, maxs, hullmins);
 		VectorSubtract (ent->v.maxs, mins, hullmaxs);
-		hull = SV_HullForBox (hullmins, hullmaxs);
+		hull = SV_HullForBoxInto (box, hullmins, hullmaxs);
 		
 		VectorCopy (ent->v.origin, offset);
 	}
@@ -170,74 +249,478 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
 	return hull;
 }
 
+/*
+================
+SV_HullForEntity
+
+================
+*/
+hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset)
+{
+	return SV_EntityHull (ent, mins, maxs, offset, &box_hull);
+}
+
 /*
 ===============================================================================
 
-ENTITY AREA CHECKING
+TRACE CACHE
 
 ===============================================================================
 */
 
-typedef struct areanode_s
+//
+// Monster navigation asks for the same moves over and over within a frame.
+// With sv_tracecache set, SV_Move results are kept until the end of the
+// server frame, keyed on everything passed in.  Each cached move is also
+// listed on every area node SV_ClipToLinks visited for it.  Linking a solid
+// into a node or unlinking it drops the moves listed on that node whose box
+// touches the solid's, since a move that never visited the node never saw the
+// solid.  Splitting a node drops all the moves listed on it.  QC can still
+// change solid, owner or flags without relinking, which the cache won't
+// notice until the next frame, so it is off by default.
+//
+
+#define	TRACE_CACHE		512			// power of two
+
+typedef struct
 {
-	int		axis;		// -1 = leaf node
-	float	dist;
-	struct areanode_s	*children[2];
-	link_t	trigger_edicts;
-	link_t	solid_edicts;
-} areanode_t;
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	int			type;
+	edict_t		*passedict;
+} tracekey_t;
 
-#define	AREA_DEPTH	4
-#define	AREA_NODES	32
+typedef struct
+{
+	tracekey_t	key;
+	int			sequence;			// valid if == sv_tracesequence
+	int			stamp;				// changes each time the entry is stored
+	vec3_t		boxmins, boxmaxs;	// area the move looked at
+	trace_t		trace;
+} tracecache_t;
+
+// lists a cached move on an area node
+typedef struct
+{
+	int			entry;				// in sv_tracecache_entries
+	int			stamp;				// stale unless the entry still has it
+	int			next;				// -1 = end of the node's list
+} tracelink_t;
+
+#define	TRACE_LINKS		(TRACE_CACHE*16)
+
+cvar_t	sv_tracecache = {"sv_tracecache", "0"};
+
+static	tracecache_t	sv_tracecache_entries[TRACE_CACHE];
+static	int		sv_tracesequence = 1;
+static	int		sv_tracecached;		// valid entries
+static	int		sv_tracestamp;
+
+static	tracelink_t	sv_tracelinks[TRACE_LINKS];
+static	int		sv_numtracelinks;
 
 static	areanode_t	sv_areanodes[AREA_NODES];
+
+static	int		sv_tracehits;
+static	int		sv_tracemisses;
+static	int		sv_traceinvalidated;
+
+/*
+================
+SV_ClearTraceCache
+
+Called at the start and end of each server frame
+================
+*/
+void SV_ClearTraceCache (void)
+{
+	sv_tracesequence++;
+	sv_tracecached = 0;
+	sv_numtracelinks = 0;
+}
+
+/*
+================
+SV_InvalidateTraces
+
+Drops the cached moves listed on node that looked at any part of the box,
+or all of them if mins is NULL
+================
+*/
+static void SV_InvalidateTraces (areanode_t *node, vec3_t mins, vec3_t maxs)
+{
+	int				i;
+	tracelink_t		*link;
+	tracecache_t	*tc;
+
+	if (!sv_tracecached || node->tracesequence != sv_tracesequence)
+		return;
+
+	for (i=node->traces ; i != -1 ; i=link->next)
+	{
+		link = &sv_tracelinks[i];
+		tc = &sv_tracecache_entries[link->entry];
+		if (tc->sequence != sv_tracesequence || tc->stamp != link->stamp)
+			continue;
+		if (mins && (mins[0] > tc->boxmaxs[0] || mins[1] > tc->boxmaxs[1] || mins[2] > tc->boxmaxs[2]
+		|| maxs[0] < tc->boxmins[0] || maxs[1] < tc->boxmins[1] || maxs[2] < tc->boxmins[2]))
+			continue;
+		tc->sequence = 0;
+		sv_tracecached--;
+		sv_traceinvalidated++;
+	}
+}
+
+/*
+================
+SV_CacheTrace
+
+Keeps a move's result and lists it on the area nodes it visited
+================
+*/
+static void SV_CacheTrace (tracecache_t *tc, tracekey_t *key, moveclip_t *clip)
+{
+	int			i;
+	areanode_t	*node;
+	tracelink_t	*link;
+
+// a move that can't be listed on every node it visited can't be kept
+	if (clip->numnodes > MOVE_MAXNODES || sv_numtracelinks + clip->numnodes > TRACE_LINKS)
+		return;
+
+	if (tc->sequence != sv_tracesequence)
+		sv_tracecached++;
+	tc->key = *key;
+	tc->sequence = sv_tracesequence;
+	tc->stamp = ++sv_tracestamp;
+	VectorCopy (clip->boxmins, tc->boxmins);
+	VectorCopy (clip->boxmaxs, tc->boxmaxs);
+	tc->trace = clip->trace;
+
+	for (i=0 ; i<clip->numnodes ; i++)
+	{
+		node = &sv_areanodes[clip->nodes[i]];
+		if (node->tracesequence != sv_tracesequence)
+		{
+			node->tracesequence = sv_tracesequence;
+			node->traces = -1;
+		}
+		link = &sv_tracelinks[sv_numtracelinks];
+		link->entry = tc - sv_tracecache_entries;
+		link->stamp = tc->stamp;
+		link->next = node->traces;
+		node->traces = sv_numtracelinks++;
+	}
+}
+
+/*
+================
+SV_TraceCacheSlot
+
+================
+*/
+static tracecache_t *SV_TraceCacheSlot (tracekey_t *key)
+{
+	unsigned	hash;
+	int			i;
+	byte		*p;
+
+	hash = 2166136261u;
+	p = (byte *)key;
+	for (i=0 ; i<sizeof(*key) ; i++)
+		hash = (hash ^ p[i]) * 16777619u;
+
+	return &sv_tracecache_entries[(hash ^ (hash >> 16)) & (TRACE_CACHE-1)];
+}
+
+/*
+===============================================================================
+
+CHANGE LOG
+
+===============================================================================
+*/
+
+//
+// While the log is open, the boxes of solids that are linked or unlinked are
+// remembered, so moves worked out against an earlier state of the world can
+// tell whether they still hold.
+//
+
+#define	MAX_WORLD_CHANGES	256
+
+static	qboolean	sv_changelog;
+static	qboolean	sv_changeoverflow;
+static	int			sv_numchanges;
+static	vec3_t		sv_changemins[MAX_WORLD_CHANGES];
+static	vec3_t		sv_changemaxs[MAX_WORLD_CHANGES];
+
+/*
+================
+SV_WorldChanged
+
+A solid was linked into node or unlinked from it
+================
+*/
+static void SV_WorldChanged (areanode_t *node, vec3_t mins, vec3_t maxs)
+{
+	SV_InvalidateTraces (node, mins, maxs);
+
+	if (!sv_changelog)
+		return;
+	if (sv_numchanges == MAX_WORLD_CHANGES)
+	{
+		sv_changeoverflow = true;
+		return;
+	}
+	VectorCopy (mins, sv_changemins[sv_numchanges]);
+	VectorCopy (maxs, sv_changemaxs[sv_numchanges]);
+	sv_numchanges++;
+}
+
+/*
+================
+SV_BeginChangeLog
+
+================
+*/
+void SV_BeginChangeLog (void)
+{
+	sv_changelog = true;
+	sv_changeoverflow = false;
+	sv_numchanges = 0;
+}
+
+/*
+================
+SV_EndChangeLog
+
+================
+*/
+void SV_EndChangeLog (void)
+{
+	sv_changelog = false;
+}
+
+/*
+================
+SV_ChangedInBox
+
+True if a solid linked or unlinked since SV_BeginChangeLog touches the box
+================
+*/
+qboolean SV_ChangedInBox (vec3_t mins, vec3_t maxs)
+{
+	int		i;
+
+	if (sv_changeoverflow)
+		return true;
+
+	for (i=0 ; i<sv_numchanges ; i++)
+	{
+		if (mins[0] > sv_changemaxs[i][0] || mins[1] > sv_changemaxs[i][1] || mins[2] > sv_changemaxs[i][2]
+		|| maxs[0] < sv_changemins[i][0] || maxs[1] < sv_changemins[i][1] || maxs[2] < sv_changemins[i][2])
+			continue;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+===============================================================================
+
+ENTITY AREA CHECKING
+
+===============================================================================
+*/
+
+//
+// The area tree is a loose kd-tree that only grows where entities are.  Each
+// node covers a box of the world; an edict is linked into the deepest node
+// whose box holds its center and whose box, expanded by half its size on
+// every side, holds the whole edict.  Queries walk the children whose expanded
+// boxes they touch, so edicts crossing a split plane still end up in small
+// lists instead of piling up near the root.  A leaf is split in two along its
+// longest axis when more than AREA_SPLIT edicts are linked into it.  Nodes are
+// only freed by SV_ClearWorld.
+//
+// SOLID_NOT edicts are kept in their own lists so pushers can find corpses and
+// gibs riding them.  Nothing else looks at those lists, and they don't count
+// towards splitting a node.
+//
+
 static	int			sv_numareanodes;
 
+// statistics for sv_areastats
+static	int			sv_areamoves;		// SV_Move calls
+static	int			sv_areatests;		// edict bounding box tests in SV_ClipToLinks
+static	int			sv_areanodetests;	// nodes visited by SV_ClipToLinks
+
 /*
 ===============
-SV_CreateAreaNode
+SV_AllocAreaNode
 
 ===============
 */
-areanode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
+static areanode_t *SV_AllocAreaNode (int depth, vec3_t mins, vec3_t maxs)
 {
 	areanode_t	*anode;
-	vec3_t		size;
-	vec3_t		mins1, maxs1, mins2, maxs2;
+	int			i;
+	float		loose;
+
+	if (sv_numareanodes == AREA_NODES)
+		return NULL;
 
 	anode = &sv_areanodes[sv_numareanodes];
 	sv_numareanodes++;
 
 	ClearLink (&anode->trigger_edicts);
 	ClearLink (&anode->solid_edicts);
-	
-	if (depth == AREA_DEPTH)
+	ClearLink (&anode->passive_edicts);
+	anode->axis = -1;
+	anode->children[0] = anode->children[1] = NULL;
+	anode->numedicts = 0;
+	anode->depth = depth;
+
+	for (i=0 ; i<3 ; i++)
 	{
-		anode->axis = -1;
-		anode->children[0] = anode->children[1] = NULL;
-		return anode;
+		anode->mins[i] = mins[i];
+		anode->maxs[i] = maxs[i];
+		loose = 0.5 * (maxs[i] - mins[i]);
+		anode->lmins[i] = mins[i] - loose;
+		anode->lmaxs[i] = maxs[i] + loose;
 	}
-	
-	VectorSubtract (maxs, mins, size);
-	if (size[0] > size[1])
-		anode->axis = 0;
-	else
-		anode->axis = 1;
-	
-	anode->dist = 0.5 * (maxs[anode->axis] + mins[anode->axis]);
-	VectorCopy (mins, mins1);	
-	VectorCopy (mins, mins2);	
-	VectorCopy (maxs, maxs1);	
-	VectorCopy (maxs, maxs2);	
-	
-	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
-	
-	anode->children[0] = SV_CreateAreaNode (depth+1, mins2, maxs2);
-	anode->children[1] = SV_CreateAreaNode (depth+1, mins1, maxs1);
 
 	return anode;
 }
 
+/*
+===============
+SV_AreaChild
+
+Returns the child of node that can hold ent, or NULL if it has to stay in node
+===============
+*/
+static areanode_t *SV_AreaChild (areanode_t *node, edict_t *ent)
+{
+	areanode_t	*child;
+	int			i;
+
+	if (node->axis == -1)
+		return NULL;
+
+	if (ent->v.absmin[node->axis] + ent->v.absmax[node->axis] > 2 * node->dist)
+		child = node->children[0];
+	else
+		child = node->children[1];
+
+	for (i=0 ; i<3 ; i++)
+		if (ent->v.absmin[i] < child->lmins[i] || ent->v.absmax[i] > child->lmaxs[i])
+			return NULL;
+
+	return child;
+}
+
+/*
+===============
+SV_LinkToAreaNode
+
+===============
+*/
+static void SV_LinkToAreaNode (edict_t *ent, areanode_t *node)
+{
+	ent->areanode = node;
+	ent->areapassive = ent->v.solid == SOLID_NOT;
+	ent->areasolid = !ent->areapassive && ent->v.solid != SOLID_TRIGGER;
+	if (ent->areapassive)
+	{
+		InsertLinkBefore (&ent->area, &node->passive_edicts);
+		return;
+	}
+
+	if (ent->areasolid)
+		InsertLinkBefore (&ent->area, &node->solid_edicts);
+	else
+		InsertLinkBefore (&ent->area, &node->trigger_edicts);
+	node->numedicts++;
+}
+
+/*
+===============
+SV_SplitAreaNode
+
+Turns a crowded leaf into a node and pushes its edicts down where they fit
+===============
+*/
+static void SV_SplitAreaNode (areanode_t *node)
+{
+	vec3_t		size;
+	vec3_t		mins1, maxs1, mins2, maxs2;
+	link_t		*list, *l, *next;
+	edict_t		*ent;
+	areanode_t	*child;
+	int			i;
+
+	if (node->depth == AREA_MAXDEPTH || sv_numareanodes > AREA_NODES - 2)
+		return;
+
+// the moves listed on node won't be listed on the children the solids move to
+	SV_InvalidateTraces (node, NULL, NULL);
+
+	VectorSubtract (node->maxs, node->mins, size);
+	if (size[0] >= size[1] && size[0] >= size[2])
+		node->axis = 0;
+	else if (size[1] >= size[2])
+		node->axis = 1;
+	else
+		node->axis = 2;
+
+	node->dist = 0.5 * (node->maxs[node->axis] + node->mins[node->axis]);
+	VectorCopy (node->mins, mins1);
+	VectorCopy (node->mins, mins2);
+	VectorCopy (node->maxs, maxs1);
+	VectorCopy (node->maxs, maxs2);
+
+	maxs1[node->axis] = mins2[node->axis] = node->dist;
+
+	node->children[0] = SV_AllocAreaNode (node->depth+1, mins2, maxs2);
+	node->children[1] = SV_AllocAreaNode (node->depth+1, mins1, maxs1);
+
+	for (i=0 ; i<3 ; i++)
+	{
+		if (i == 0)
+			list = &node->trigger_edicts;
+		else if (i == 1)
+			list = &node->solid_edicts;
+		else
+			list = &node->passive_edicts;
+		for (l = list->next ; l != list ; l = next)
+		{
+			next = l->next;
+			ent = EDICT_FROM_AREA(l);
+			child = SV_AreaChild (node, ent);
+			if (!child)
+				continue;
+
+		// keep it in the same kind of list, whatever QC did to its solid
+			RemoveLink (&ent->area);
+			ent->areanode = child;
+			if (i == 0)
+				InsertLinkBefore (&ent->area, &child->trigger_edicts);
+			else if (i == 1)
+				InsertLinkBefore (&ent->area, &child->solid_edicts);
+			else
+				InsertLinkBefore (&ent->area, &child->passive_edicts);
+			if (!ent->areapassive)
+			{
+				node->numedicts--;
+				child->numedicts++;
+			}
+		}
+	}
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -250,7 +733,8 @@ void SV_ClearWorld (void)
 	
 	memset (sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
-	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
+	SV_ClearTraceCache ();
+	SV_AllocAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
 }
 
 
@@ -264,37 +748,109 @@ void SV_UnlinkEdict (edict_t *ent)
 {
 	if (!ent->area.prev)
 		return;		// not linked in anywhere
+	if (ent->areasolid)
+		SV_WorldChanged (ent->areanode, ent->v.absmin, ent->v.absmax);
 	RemoveLink (&ent->area);
 	ent->area.prev = ent->area.next = NULL;
+	if (!ent->areapassive)
+		ent->areanode->numedicts--;
+	ent->areanode = NULL;
+	ent->areasolid = false;
 }
 
 
 /*
 ====================
-SV_TouchLinks
+SV_BoxInAreaNode
+
+True if the box reaches the loose bounds of node
 ====================
 */
-void SV_TouchLinks ( edict_t *ent, areanode_t *node )
+static qboolean SV_BoxInAreaNode (vec3_t mins, vec3_t maxs, areanode_t *node)
 {
-	link_t		*l, *next;
+	return mins[0] <= node->lmaxs[0] && maxs[0] >= node->lmins[0]
+		&& mins[1] <= node->lmaxs[1] && maxs[1] >= node->lmins[1]
+		&& mins[2] <= node->lmaxs[2] && maxs[2] >= node->lmins[2];
+}
+
+/*
+====================
+SV_TouchesEdict
+
+====================
+*/
+static qboolean SV_TouchesEdict (edict_t *ent, edict_t *touch)
+{
+	return !(ent->v.absmin[0] > touch->v.absmax[0]
+		|| ent->v.absmin[1] > touch->v.absmax[1]
+		|| ent->v.absmin[2] > touch->v.absmax[2]
+		|| ent->v.absmax[0] < touch->v.absmin[0]
+		|| ent->v.absmax[1] < touch->v.absmin[1]
+		|| ent->v.absmax[2] < touch->v.absmin[2]);
+}
+
+/*
+====================
+SV_AreaTriggers
+
+Gathers the triggers whose boxes touch ent
+====================
+*/
+static int SV_AreaTriggers (edict_t *ent, areanode_t *node, edict_t **list, int count)
+{
+	link_t		*l;
 	edict_t		*touch;
-	int			old_self, old_other;
+	int			i;
 
-// touch linked edicts
-	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = next)
+	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = l->next)
 	{
-		next = l->next;
 		touch = EDICT_FROM_AREA(l);
 		if (touch == ent)
 			continue;
 		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
 			continue;
-		if (ent->v.absmin[0] > touch->v.absmax[0]
-		|| ent->v.absmin[1] > touch->v.absmax[1]
-		|| ent->v.absmin[2] > touch->v.absmax[2]
-		|| ent->v.absmax[0] < touch->v.absmin[0]
-		|| ent->v.absmax[1] < touch->v.absmin[1]
-		|| ent->v.absmax[2] < touch->v.absmin[2] )
+		if (!SV_TouchesEdict (ent, touch))
+			continue;
+		if (count == MAX_EDICTS)
+			return count;
+		list[count++] = touch;
+	}
+
+// recurse down the children whose loose bounds reach the box
+	if (node->axis == -1)
+		return count;
+
+	for (i=0 ; i<2 ; i++)
+		if (SV_BoxInAreaNode (ent->v.absmin, ent->v.absmax, node->children[i]))
+			count = SV_AreaTriggers (ent, node->children[i], list, count);
+
+	return count;
+}
+
+/*
+====================
+SV_TouchLinks
+
+The touch functions can relink or remove any edict, including ones in the
+lists being walked, so the triggers are gathered before any are called
+====================
+*/
+void SV_TouchLinks ( edict_t *ent, areanode_t *node )
+{
+	edict_t		*touchlist[MAX_EDICTS];
+	edict_t		*touch;
+	int			i, numtouch;
+	int			old_self, old_other;
+
+	numtouch = SV_AreaTriggers (ent, node, touchlist, 0);
+
+	for (i=0 ; i<numtouch ; i++)
+	{
+		touch = touchlist[i];
+	// an earlier touch may have moved or removed it
+		if (touch->free || !touch->v.touch || touch->v.solid != SOLID_TRIGGER)
+			continue;
+		if (!SV_TouchesEdict (ent, touch))
 			continue;
 		old_self = pr_global_struct->self;
 		old_other = pr_global_struct->other;
@@ -307,15 +863,76 @@ void SV_TouchLinks ( edict_t *ent, areanode_t *node )
 		pr_global_struct->self = old_self;
 		pr_global_struct->other = old_other;
 	}
-	
-// recurse down both sides
+}
+
+
+/*
+====================
+SV_GatherAreaEdicts
+
+====================
+*/
+static int SV_GatherAreaEdicts (vec3_t mins, vec3_t maxs, areanode_t *node, edict_t **list, int count, int maxcount)
+{
+	link_t		*l, *head;
+	edict_t		*check;
+	int			i;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		if (i == 0)
+			head = &node->trigger_edicts;
+		else if (i == 1)
+			head = &node->solid_edicts;
+		else
+			head = &node->passive_edicts;
+		for (l = head->next ; l != head ; l = l->next)
+		{
+			check = EDICT_FROM_AREA(l);
+			if (check->v.absmin[0] > maxs[0]
+			|| check->v.absmin[1] > maxs[1]
+			|| check->v.absmin[2] > maxs[2]
+			|| check->v.absmax[0] < mins[0]
+			|| check->v.absmax[1] < mins[1]
+			|| check->v.absmax[2] < mins[2])
+				continue;
+			if (count == maxcount)
+				return count;
+			list[count++] = check;
+		}
+	}
+
 	if (node->axis == -1)
-		return;
-	
-	if ( ent->v.absmax[node->axis] > node->dist )
-		SV_TouchLinks ( ent, node->children[0] );
-	if ( ent->v.absmin[node->axis] < node->dist )
-		SV_TouchLinks ( ent, node->children[1] );
+		return count;
+
+	for (i=0 ; i<2 ; i++)
+		if (SV_BoxInAreaNode (mins, maxs, node->children[i]))
+			count = SV_GatherAreaEdicts (mins, maxs, node->children[i], list, count, maxcount);
+
+	return count;
+}
+
+static int SV_EdictOrder (const void *a, const void *b)
+{
+	edict_t	*e1 = *(edict_t **)a;
+	edict_t	*e2 = *(edict_t **)b;
+
+	return (e1 > e2) - (e1 < e2);
+}
+
+/*
+====================
+SV_AreaEdicts
+
+====================
+*/
+int SV_AreaEdicts (vec3_t mins, vec3_t maxs, edict_t **list, int maxcount)
+{
+	int		count;
+
+	count = SV_GatherAreaEdicts (mins, maxs, sv_areanodes, list, 0, maxcount);
+	qsort (list, count, sizeof(*list), SV_EdictOrder);
+	return count;
 }
 
 
@@ -371,7 +988,7 @@ SV_LinkEdict
 */
 void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 {
-	areanode_t	*node;
+	areanode_t	*node, *child;
 
 	if (ent->area.prev)
 		SV_UnlinkEdict (ent);	// unlink from old position
@@ -414,29 +1031,19 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 	if (ent->v.modelindex)
 		SV_FindTouchedLeafs (ent, sv.worldmodel->nodes);
 
-	if (ent->v.solid == SOLID_NOT)
-		return;
-
-// find the first node that the ent's box crosses
+// find the deepest node that holds the ent's box
 	node = sv_areanodes;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if (ent->v.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if (ent->v.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
-	}
+	while ( (child = SV_AreaChild (node, ent)) )
+		node = child;
 	
 // link it in	
-
-	if (ent->v.solid == SOLID_TRIGGER)
-		InsertLinkBefore (&ent->area, &node->trigger_edicts);
-	else
-		InsertLinkBefore (&ent->area, &node->solid_edicts);
+	SV_LinkToAreaNode (ent, node);
+	if (ent->areapassive)
+		return;
+	if (ent->areasolid)
+		SV_WorldChanged (node, ent->v.absmin, ent->v.absmax);
+	if (node->axis == -1 && node->numedicts > AREA_SPLIT)
+		SV_SplitAreaNode (node);
 	
 // if touch_triggers, touch all entities at this node and decend for more
 	if (touch_triggers)
@@ -462,21 +1069,19 @@ SV_HullPointContents
 int SV_HullPointContents (hull_t *hull, int num, vec3_t p)
 {
 	float		d;
-	dclipnode_t	*node;
-	mplane_t	*plane;
+	mclipnode_t	*node;
 
 	while (num >= 0)
 	{
 		if (num < hull->firstclipnode || num > hull->lastclipnode)
 			Sys_Error ("SV_HullPointContents: bad node number");
 	
-		node = hull->clipnodes + num;
-		plane = hull->planes + node->planenum;
+		node = hull->nodes + num;
 		
-		if (plane->type < 3)
-			d = p[plane->type] - plane->dist;
+		if (node->type < 3)
+			d = p[node->type] - node->dist;
 		else
-			d = DotProduct (plane->normal, p) - plane->dist;
+			d = DotProduct (node->normal, p) - node->dist;
 		if (d < 0)
 			num = node->children[1];
 		else
@@ -549,8 +1154,7 @@ SV_RecursiveHullCheck
 */
 qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace)
 {
-	dclipnode_t	*node;
-	mplane_t	*plane;
+	mclipnode_t	*node;
 	float		t1, t2;
 	float		frac;
 	int			i;
@@ -580,18 +1184,17 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 //
 // find the point distances
 //
-	node = hull->clipnodes + num;
-	plane = hull->planes + node->planenum;
+	node = hull->nodes + num;
 
-	if (plane->type < 3)
+	if (node->type < 3)
 	{
-		t1 = p1[plane->type] - plane->dist;
-		t2 = p2[plane->type] - plane->dist;
+		t1 = p1[node->type] - node->dist;
+		t2 = p2[node->type] - node->dist;
 	}
 	else
 	{
-		t1 = DotProduct (plane->normal, p1) - plane->dist;
-		t2 = DotProduct (plane->normal, p2) - plane->dist;
+		t1 = DotProduct (node->normal, p1) - node->dist;
+		t2 = DotProduct (node->normal, p2) - node->dist;
 	}
 	
 #if 1
@@ -648,13 +1251,13 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 //==================
 	if (!side)
 	{
-		VectorCopy (plane->normal, trace->plane.normal);
-		trace->plane.dist = plane->dist;
+		VectorCopy (node->normal, trace->plane.normal);
+		trace->plane.dist = node->dist;
 	}
 	else
 	{
-		VectorSubtract (vec3_origin, plane->normal, trace->plane.normal);
-		trace->plane.dist = -plane->dist;
+		VectorSubtract (vec3_origin, node->normal, trace->plane.normal);
+		trace->plane.dist = -node->dist;
 	}
 
 	while (SV_HullPointContents (hull, hull->firstclipnode, mid)
@@ -665,7 +1268,8 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 		{
 			trace->fraction = midf;
 			VectorCopy (mid, trace->endpos);
-			Con_DPrintf ("backup past 0\n");
+			if (!sv_threadedmoves)
+				Con_DPrintf ("backup past 0\n");
 			return false;
 		}
 		midf = p1f + (p2f - p1f)*frac;
@@ -682,13 +1286,13 @@ qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec
 
 /*
 ==================
-SV_ClipMoveToEntity
+SV_ClipMove
 
 Handles selection or creation of a clipping hull, and offseting (and
 eventually rotation) of the end points
 ==================
 */
-trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+static trace_t SV_ClipMove (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, boxhull_t *box)
 {
 	trace_t		trace;
 	vec3_t		offset;
@@ -702,7 +1306,7 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 	VectorCopy (end, trace.endpos);
 
 // get the clipping hull
-	hull = SV_HullForEntity (ent, mins, maxs, offset);
+	hull = SV_EntityHull (ent, mins, maxs, offset, box);
 
 	VectorSubtract (start, offset, start_l);
 	VectorSubtract (end, offset, end_l);
@@ -721,6 +1325,17 @@ trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t max
 	return trace;
 }
 
+/*
+==================
+SV_ClipMoveToEntity
+
+==================
+*/
+trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end)
+{
+	return SV_ClipMove (ent, start, mins, maxs, end, &box_hull);
+}
+
 //===========================================================================
 
 /*
@@ -735,6 +1350,12 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 	link_t		*l, *next;
 	edict_t		*touch;
 	trace_t		trace;
+	int			i;
+
+	clip->nodetests++;
+	if (clip->numnodes < MOVE_MAXNODES)
+		clip->nodes[clip->numnodes] = node - sv_areanodes;
+	clip->numnodes++;
 
 // touch linked edicts
 	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
@@ -751,6 +1372,7 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 		if (clip->type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
 			continue;
 
+		clip->tests++;
 		if (clip->boxmins[0] > touch->v.absmax[0]
 		|| clip->boxmins[1] > touch->v.absmax[1]
 		|| clip->boxmins[2] > touch->v.absmax[2]
@@ -774,9 +1396,9 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 		}
 
 		if ((int)touch->v.flags & FL_MONSTER)
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins2, clip->maxs2, clip->end);
+			trace = SV_ClipMove (touch, clip->start, clip->mins2, clip->maxs2, clip->end, &clip->box);
 		else
-			trace = SV_ClipMoveToEntity (touch, clip->start, clip->mins, clip->maxs, clip->end);
+			trace = SV_ClipMove (touch, clip->start, clip->mins, clip->maxs, clip->end, &clip->box);
 		if (trace.allsolid || trace.startsolid ||
 		trace.fraction < clip->trace.fraction)
 		{
@@ -793,14 +1415,13 @@ void SV_ClipToLinks ( areanode_t *node, moveclip_t *clip )
 			clip->trace.startsolid = true;
 	}
 	
-// recurse down both sides
+// recurse down the children whose loose bounds reach the move
 	if (node->axis == -1)
 		return;
 
-	if ( clip->boxmaxs[node->axis] > node->dist )
-		SV_ClipToLinks ( node->children[0], clip );
-	if ( clip->boxmins[node->axis] < node->dist )
-		SV_ClipToLinks ( node->children[1], clip );
+	for (i=0 ; i<2 ; i++)
+		if (SV_BoxInAreaNode (clip->boxmins, clip->boxmaxs, node->children[i]))
+			SV_ClipToLinks ( node->children[i], clip );
 }
 
 
@@ -843,11 +1464,34 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 {
 	moveclip_t	clip;
 	int			i;
+	tracekey_t	key;
+	tracecache_t	*tc;
+
+	tc = NULL;
+	if (sv_tracecache.value && !sv_threadedmoves)
+	{
+		memset (&key, 0, sizeof(key));
+		VectorCopy (start, key.start);
+		VectorCopy (end, key.end);
+		VectorCopy (mins, key.mins);
+		VectorCopy (maxs, key.maxs);
+		key.type = type;
+		key.passedict = passedict;
+
+		tc = SV_TraceCacheSlot (&key);
+		if (tc->sequence == sv_tracesequence && !memcmp (&tc->key, &key, sizeof(key)))
+		{
+			sv_tracehits++;
+			return tc->trace;
+		}
+		sv_tracemisses++;
+	}
 
 	memset ( &clip, 0, sizeof ( moveclip_t ) );
+	SV_SetupBoxHull (&clip.box);
 
 // clip to world
-	clip.trace = SV_ClipMoveToEntity ( sv.edicts, start, mins, maxs, end );
+	clip.trace = SV_ClipMove ( sv.edicts, start, mins, maxs, end, &clip.box );
 
 	clip.start = start;
 	clip.end = end;
@@ -876,6 +1520,62 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 // clip to entities
 	SV_ClipToLinks ( sv_areanodes, &clip );
 
+	if (!sv_threadedmoves)
+	{
+		sv_areamoves++;
+		sv_areatests += clip.tests;
+		sv_areanodetests += clip.nodetests;
+	}
+
+	if (tc)
+		SV_CacheTrace (tc, &key, &clip);
+
 	return clip.trace;
 }
 
+/*
+==================
+SV_AreaStats_f
+
+Shows the shape of the area tree and how much work SV_Move has done in it
+since the last call, with the sv_tracecache results
+==================
+*/
+void SV_AreaStats_f (void)
+{
+	int			i;
+	int			depth, leafs;
+	int			linked[2];
+	areanode_t	*node;
+
+	if (!sv.active)
+	{
+		Con_Printf ("no active server\n");
+		return;
+	}
+
+	depth = leafs = 0;
+	linked[0] = linked[1] = 0;
+	for (i=0, node=sv_areanodes ; i<sv_numareanodes ; i++, node++)
+	{
+		if (node->depth > depth)
+			depth = node->depth;
+		if (node->axis == -1)
+			leafs++;
+		linked[node->axis == -1] += node->numedicts;
+	}
+
+	Con_Printf ("%i area nodes, %i leafs, depth %i\n", sv_numareanodes, leafs, depth);
+	Con_Printf ("%i edicts in leafs, %i in nodes\n", linked[1], linked[0]);
+	if (sv_areamoves)
+		Con_Printf ("%i moves, %.1f box tests and %.1f nodes per move\n", sv_areamoves,
+			(float)sv_areatests / sv_areamoves, (float)sv_areanodetests / sv_areamoves);
+	if (sv_tracehits + sv_tracemisses)
+		Con_Printf ("trace cache: %i hits, %i misses (%.1f%%), %i invalidated\n",
+			sv_tracehits, sv_tracemisses,
+			100.0 * sv_tracehits / (sv_tracehits + sv_tracemisses), sv_traceinvalidated);
+
+	sv_areamoves = sv_areatests = sv_areanodetests = 0;
+	sv_tracehits = sv_tracemisses = sv_traceinvalidated = 0;
+}
+
@@ -62,8 +62,39 @@ int SV_TruePointContents (vec3_t p);
 // does not check any entities at all
 // the non-true version remaps the water current contents to content_water
 
+hull_t *SV_HullForBox (vec3_t mins, vec3_t maxs);
+// a hull for a box, which stays valid until the next call
+
+int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
+// the contents of a point in any clipping hull, as traced from node num
+
 edict_t	*SV_TestEntityPosition (edict_t *ent);
 
+void SV_AreaStats_f (void);
+// prints the area tree shape and the bounding box tests per SV_Move
+
+int SV_AreaEdicts (vec3_t mins, vec3_t maxs, edict_t **list, int maxcount);
+// fills list with every linked edict whose box touches mins/maxs, including
+// SOLID_NOT ones, in edict order.  Returns the count.
+
+qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+// traces the line p1 to p2 through a hull, starting at clipnode num
+// trace should be set up with fraction 1, allsolid and endpos p2
+
+extern	qboolean	sv_threadedmoves;
+// set while SV_Move is called from worker threads, nothing may be linked,
+// unlinked or printed meanwhile
+
+void SV_BeginChangeLog (void);
+void SV_EndChangeLog (void);
+qboolean SV_ChangedInBox (vec3_t mins, vec3_t maxs);
+// while the log is open, records where solids are linked and unlinked, so
+// traces made earlier can be checked against what moved since
+
+void SV_ClearTraceCache (void);
+// forgets the SV_Move results remembered with sv_tracecache, called between
+// server frames
+
 trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, edict_t *passedict);
 // mins and maxs are reletive
 